@@ -0,0 +1,500 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// bench/war_bench.c — headless benchmark for the audio path (make bench)
+//
+// Builds synthetic capture slots (N voices, M effects each, K export notes)
+// in a calloc'd env and times the real mixer code from war_mix.h and
+// war_keymap_functions.h: the per-sample effect chain, EQ, the transposed
+// (sinc) slot read, the voice mixer, the wwav note render and the play ring
+// buffer. No Wayland, Vulkan or
+// Pipewire is opened. Reports ns/sample and how many voices one core mixes
+// in real time at 48kHz.
+//
+// The keymap case builds the default keymap (war_keymap.h) and replays a
+// recorded key stream through it the way war_handle_key does: once through
+// the sparse edge table and once through the dense mode x state x keysym x
+// mod next_state array it replaced. Reports ns/key.
+//
+//     make bench BENCH_ARGS="-v 64 -e 9 -n 256 -s 20"
+//     make bench BENCH_CFLAGS="-march=native"   (compare against scalar)
+//-----------------------------------------------------------------------------
+
+#include "h/war_config.h"
+#include "h/war_data.h"
+#include "h/war_keymap.h"
+#include "h/war_mix.h"
+#include "h/war_perf.h"
+#include "h/war_pool.h"
+#include "h/war_resample.h"
+#include "h/war_sample.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WAR_BENCH_RATE         48000
+#define WAR_BENCH_SLOT_SECONDS 2
+#define WAR_BENCH_FRAME_NS     (1e9 / WAR_BENCH_RATE)
+#define WAR_BENCH_KEY_EVENTS   4096 // recorded key stream length
+#define WAR_BENCH_KEY_MISS     8    // one key in 8 is unbound (digits, typos)
+
+// cheapest first, so -e M enables a realistic prefix of the chain
+static const uint8_t war_bench_effect_order[WAR_EFFECT_COUNT] = {
+    WAR_EFFECT_COMPRESS, WAR_EFFECT_SATURATE, WAR_EFFECT_GATE,
+    WAR_EFFECT_DEESSER,  WAR_EFFECT_DELAY,    WAR_EFFECT_CHORUS,
+    WAR_EFFECT_REVERB,   WAR_EFFECT_COMPRESS2, WAR_EFFECT_AUTOTUNE,
+};
+
+// the ON (defaults) values of each effect command
+static const double war_bench_effect_defaults[WAR_EFFECT_COUNT + 1][WAR_EFFECT_PARAMS] = {
+    [WAR_EFFECT_COMPRESS] = {-20.0, 4.0, 1.0, 40.0, 4.0},
+    [WAR_EFFECT_SATURATE] = {3.0, 0.4, 2.0},
+    [WAR_EFFECT_REVERB] = {0.4, 0.15, 0.0, 0.3},
+    [WAR_EFFECT_DELAY] = {60.0, 0.2, 0.4, 0.3},
+    [WAR_EFFECT_CHORUS] = {0.3, 8.0, 0.3, 25.0},
+    [WAR_EFFECT_GATE] = {-40.0, 2.0, 10.0, 50.0, -80.0},
+    [WAR_EFFECT_DEESSER] = {-30.0, 6000.0, 1.0, 30.0},
+    [WAR_EFFECT_AUTOTUNE] = {3.0},
+    [WAR_EFFECT_COMPRESS2] = {-1.0, 20.0, 2.0, 60.0, 0.0},
+};
+
+typedef struct war_bench_args {
+    uint32_t voices;
+    uint32_t effects;
+    uint32_t notes;
+    double seconds;
+} war_bench_args;
+
+static void war_bench_usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-v voices 1-%d] [-e effects 0-%d] [-n export notes] [-s seconds]\n",
+            argv0, WAR_PLAY_BAR_VOICES, WAR_EFFECT_COUNT);
+}
+
+static void war_bench_report(const char* name, uint64_t ns, double samples, double voices) {
+    double per = samples > 0 ? (double)ns / samples : 0.0;
+    printf("%-10s %12.2f ms %10.3f ns/sample", name, (double)ns / 1e6, per);
+    if (voices > 0 && per > 0) printf("  %8.1f voices/core", WAR_BENCH_FRAME_NS / per);
+    printf("\n");
+}
+
+// a detuned saw pair with a decaying envelope and a little noise: enough
+// harmonics and level movement that every effect does real work
+static float* war_bench_make_samples(uint32_t note, uint64_t floats, uint32_t* seed) {
+    float* s = malloc(sizeof(float) * floats);
+    if (!s) return NULL;
+    double hz = 440.0 * pow(2.0, ((double)note - 69.0) / 12.0);
+    double ph_l = 0.0, ph_r = 0.0;
+    for (uint64_t f = 0; f < floats / 2; f++) {
+        *seed = *seed * 1664525u + 1013904223u;
+        float noise = ((float)(*seed >> 8) / 16777216.0f - 0.5f) * 0.02f;
+        float env = expf(-(float)f / (WAR_BENCH_RATE * 0.8f));
+        ph_l += hz / WAR_BENCH_RATE;
+        ph_r += hz * 1.003 / WAR_BENCH_RATE;
+        ph_l -= floor(ph_l);
+        ph_r -= floor(ph_r);
+        s[f * 2 + 0] = (float)(ph_l * 2.0 - 1.0) * 0.5f * env + noise;
+        s[f * 2 + 1] = (float)(ph_r * 2.0 - 1.0) * 0.5f * env + noise;
+    }
+    return s;
+}
+
+typedef struct war_bench_key {
+    uint32_t mode;
+    uint32_t keysym;
+    uint32_t mod;
+} war_bench_key;
+
+// the old dense next_state layout, keysyms widened to cover every bound one
+typedef struct war_bench_dense {
+    uint64_t* next_state;
+    size_t states;
+    size_t keysyms;
+    size_t mods;
+} war_bench_dense;
+
+static inline uint64_t war_bench_key_next(war_keymap_context* keymap, war_config_context* config,
+                                          const war_bench_dense* dense, uint32_t mode, uint64_t state,
+                                          uint32_t keysym, uint32_t mod) {
+    if (!dense) return war_keymap_next(keymap, config, mode, state, keysym, mod);
+    if (keysym >= dense->keysyms || mod >= dense->mods) return 0;
+    return dense->next_state[((mode * dense->states + state) * dense->keysyms + keysym) * dense->mods + mod];
+}
+
+// war_handle_key's lookup: prefix state first, then the root; returns how
+// many functions the stream dispatched so both tables can be checked
+static uint64_t war_bench_key_replay(war_keymap_context* keymap, war_config_context* config,
+                                     const war_bench_dense* dense, const war_bench_key* keys, uint32_t n) {
+    uint64_t state = 0;
+    uint64_t dispatched = 0;
+    size_t sc = config->KEYMAP_STATE_CAPACITY;
+    for (uint32_t i = 0; i < n; i++) {
+        const war_bench_key* k = &keys[i];
+        uint64_t next = 0;
+        if (state) next = war_bench_key_next(keymap, config, dense, k->mode, state, k->keysym, k->mod);
+        if (!next) {
+            state = 0;
+            next = war_bench_key_next(keymap, config, dense, k->mode, 0, k->keysym, k->mod);
+        }
+        if (!next) continue;
+        uint8_t count = keymap->function_count[k->mode * sc + next];
+        if (!count) {
+            if (keymap->flags[k->mode * sc + state] & WAR_KEYMAP_PREFIX) state = next;
+            continue;
+        }
+        dispatched += count;
+        state = 0;
+    }
+    return dispatched;
+}
+
+static uint32_t war_bench_slot_idx(uint32_t v) {
+    return (24 + v) * WAR_CAPTURE_SLOT_LAYERS;
+}
+
+static void war_bench_voice_start(war_env* env, uint32_t v, uint64_t read_pos) {
+    war_capture_slot* slot = &env->capture_slots[war_bench_slot_idx(v)];
+    _war_delay_line_release(env, env->play_bar_voice_delay_line[v]);
+    env->play_bar_voice_active[v] = 1;
+    env->play_bar_voice_note[v] = 24 + v;
+    env->play_bar_voice_layer[v] = 1;
+    env->play_bar_voice_read_pos[v] = read_pos;
+    env->play_bar_voice_read_limit[v] = slot->count;
+    env->play_bar_voice_env_samples[v] = 0;
+    memset(env->play_bar_voice_effect_state[v], 0, sizeof(env->play_bar_voice_effect_state[v]));
+    memset(env->play_bar_voice_delay_pos[v], 0, sizeof(env->play_bar_voice_delay_pos[v]));
+    memset(&env->play_bar_voice_autotune[v], 0, sizeof(env->play_bar_voice_autotune[v]));
+    memset(&env->play_bar_voice_limiter[v], 0, sizeof(env->play_bar_voice_limiter[v]));
+}
+
+int main(int argc, char** argv) {
+    war_bench_args args = {.voices = 32, .effects = 4, .notes = 64, .seconds = 10.0};
+    int opt;
+    while ((opt = getopt(argc, argv, "v:e:n:s:h")) != -1) {
+        switch (opt) {
+        case 'v': args.voices = (uint32_t)atoi(optarg); break;
+        case 'e': args.effects = (uint32_t)atoi(optarg); break;
+        case 'n': args.notes = (uint32_t)atoi(optarg); break;
+        case 's': args.seconds = atof(optarg); break;
+        default: war_bench_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (args.voices < 1 || args.voices > WAR_PLAY_BAR_VOICES || args.effects > WAR_EFFECT_COUNT ||
+        args.seconds <= 0.0) {
+        war_bench_usage(argv[0]);
+        return 1;
+    }
+
+    war_config_context config = {0};
+    war_config_default(&config);
+    war_env* env = calloc(1, sizeof(war_env));
+    if (!env) return 1;
+    env->delay_pool_count = (uint32_t)config.A_DELAY_LINES;
+    env->delay_pool_frames = war_delay_pool_frames(&config);
+    env->delay_pool = calloc((uint64_t)env->delay_pool_count * 2 * env->delay_pool_frames, sizeof(float));
+    env->delay_pool_used = calloc(env->delay_pool_count ? env->delay_pool_count : 1, 1);
+    env->layer_visible = 0x1FF;
+    env->play_bar_playing = 1;
+    env->master_limit_active = 1;
+    memcpy(env->master_limit_params, war_bench_effect_defaults[WAR_EFFECT_COMPRESS2],
+           sizeof(env->master_limit_params));
+    if (!env->delay_pool || !env->delay_pool_used) return 1;
+    env->resample_table = aligned_alloc(64, sizeof(float) * WAR_RESAMPLE_TABLE_FLOATS);
+    if (!env->resample_table) return 1;
+    war_resample_table_init(env->resample_table);
+
+    uint64_t slot_floats = (uint64_t)WAR_BENCH_SLOT_SECONDS * WAR_BENCH_RATE * 2;
+    uint32_t seed = 1;
+    for (uint32_t v = 0; v < args.voices; v++) {
+        war_capture_slot* slot = &env->capture_slots[war_bench_slot_idx(v)];
+        if (!war_slot_adopt(slot, war_bench_make_samples(24 + v, slot_floats, &seed), slot_floats)) return 1;
+        slot->pan = (int)(v * 131 % 2001) - 1000;
+        slot->eq1 = 300;
+        slot->eq2 = -200;
+        slot->attack = 5.0f;
+        slot->release = 50.0f;
+        for (uint32_t e = 0; e < args.effects; e++) {
+            uint8_t type = war_bench_effect_order[e];
+            for (uint8_t p = 0; p < WAR_EFFECT_PARAMS; p++)
+                _war_effect_set_param(slot, type, p, war_bench_effect_defaults[type][p]);
+            _war_effect_set_active(slot, type, 1);
+        }
+    }
+
+    printf("war_bench: %u voices, %u effects, %u export notes, %.1fs per case\n",
+           args.voices, args.effects, args.notes, args.seconds);
+    uint64_t frames = (uint64_t)(args.seconds * WAR_BENCH_RATE);
+    volatile float sink = 0.0f;
+
+    // per-sample effect chain on one slot, looping over its samples
+    {
+        war_capture_slot* slot = &env->capture_slots[war_bench_slot_idx(0)];
+        float state[32] = {0};
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t f = 0; f < frames; f++) {
+            uint64_t i = (f * 2) % slot->count;
+            float l = slot->samples[i], r = slot->samples[i + 1];
+            _war_process_effects(slot, state, &l, &r);
+            sink += l + r;
+        }
+        war_bench_report("effects", war_perf_now_ns() - t0, (double)frames, 0);
+    }
+
+    // EQ1 + EQ2 pass filters
+    {
+        war_capture_slot* slot = &env->capture_slots[war_bench_slot_idx(0)];
+        float state[32] = {0};
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t f = 0; f < frames; f++) {
+            uint64_t i = (f * 2) % slot->count;
+            float l = slot->samples[i], r = slot->samples[i + 1];
+            _war_process_eq(slot, state, &l, &r);
+            sink += l + r;
+        }
+        war_bench_report("eq", war_perf_now_ns() - t0, (double)frames, 0);
+    }
+
+    // transposed read of one slot a fifth up, one mixer chunk at a time
+    {
+        war_capture_slot* slot = &env->capture_slots[war_bench_slot_idx(0)];
+        slot->transpose = 7;
+        uint64_t play = war_slot_play_count(slot);
+        float blk[WAR_MIX_CHUNK_FLOATS];
+        uint64_t chunks = frames / (WAR_MIX_CHUNK_FLOATS / 2);
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t c = 0; c < chunks; c++) {
+            war_resample_slot(env, slot, c * WAR_MIX_CHUNK_FLOATS % play, blk, WAR_MIX_CHUNK_FLOATS);
+            sink += blk[0];
+        }
+        war_bench_report("resample", war_perf_now_ns() - t0, (double)chunks * (WAR_MIX_CHUNK_FLOATS / 2), 0);
+        slot->transpose = 0;
+    }
+
+    // live mixer: every voice plays its slot on a loop, staggered so voices
+    // start and release at different chunks like a real arrangement
+    {
+        uint64_t voice_batch[WAR_PREVIEW_VOICES + WAR_PLAY_BAR_VOICES] = {0};
+        float mix[WAR_MIX_CHUNK_FLOATS];
+        for (uint32_t v = 0; v < args.voices; v++)
+            war_bench_voice_start(env, v, (uint64_t)v * 4001 * 2 % slot_floats);
+        uint64_t chunks = frames / (WAR_MIX_CHUNK_FLOATS / 2);
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t c = 0; c < chunks; c++) {
+            env->autotune_budget = (uint32_t)config.A_AUTOTUNE_BUDGET;
+            war_mix_voices(env, mix, voice_batch);
+            war_mix_master(env, mix);
+            war_mix_advance(env, voice_batch);
+            sink += mix[0];
+            for (uint32_t v = 0; v < args.voices; v++)
+                if (env->play_bar_voice_active[v] != 1) war_bench_voice_start(env, v, 0);
+        }
+        uint64_t ns = war_perf_now_ns() - t0;
+        double mixed = (double)chunks * (WAR_MIX_CHUNK_FLOATS / 2);
+        war_bench_report("mixer", ns, mixed, 0);
+        war_bench_report("mix/voice", ns, mixed * args.voices, 1);
+        for (uint32_t v = 0; v < args.voices; v++) {
+            env->play_bar_voice_active[v] = 0;
+            _war_delay_line_release(env, env->play_bar_voice_delay_line[v]);
+        }
+    }
+
+    // wwav note render: K notes spread over the timeline, one slot each in turn
+    if (args.notes) {
+        uint64_t note_frames = slot_floats / 2;
+        uint64_t total_frames = (uint64_t)args.notes * (note_frames / 4) + note_frames;
+        float* out = calloc(total_frames * 2, sizeof(float));
+        float* send = calloc(total_frames * 2, sizeof(float));
+        float* xline = malloc(sizeof(float) * 2 * env->delay_pool_frames * WAR_DELAY_LINE_KINDS);
+        if (!out || !send || !xline) return 1;
+        uint64_t t0 = war_perf_now_ns();
+        for (uint32_t k = 0; k < args.notes; k++) {
+            uint32_t idx = war_bench_slot_idx(k % args.voices);
+            uint64_t start = (uint64_t)k * (note_frames / 4);
+            float rmix = _war_effect_active(&env->capture_slots[idx], WAR_EFFECT_REVERB) ?
+                             (float)_war_effect_get_param(&env->capture_slots[idx], WAR_EFFECT_REVERB, 1) :
+                             0.0f;
+            if (!war_export_note(env, idx, note_frames, note_frames, out + start * 2,
+                                 rmix > 0.0f ? send + start * 2 : NULL, rmix, xline))
+                return 1;
+        }
+        uint64_t ns = war_perf_now_ns() - t0;
+        sink += out[total_frames / 2];
+        war_bench_report("export", ns, (double)args.notes * note_frames, 0);
+        free(out);
+        free(send);
+        free(xline);
+    }
+
+    // play ring: one mixer chunk in, one out, as the main loop and the
+    // Pipewire callback do
+    {
+        war_producer_consumer pc = {0};
+        pc.size = (uint64_t)config.PC_PLAY_BUFFER_SIZE;
+        pc.to_a = calloc(1, pc.size);
+        pc.to_wr = calloc(1, pc.size);
+        if (!pc.to_a || !pc.to_wr) return 1;
+        float chunk[WAR_MIX_CHUNK_FLOATS] = {0};
+        float back[WAR_MIX_CHUNK_FLOATS];
+        uint32_t header, size;
+        uint64_t chunks = frames / (WAR_MIX_CHUNK_FLOATS / 2);
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t c = 0; c < chunks; c++) {
+            chunk[0] = (float)c;
+            war_pc_to_a(&pc, 0, sizeof(chunk), chunk);
+            if (war_pc_from_wr(&pc, &header, &size, back)) sink += back[0];
+        }
+        war_bench_report("ring", war_perf_now_ns() - t0, (double)chunks * (WAR_MIX_CHUNK_FLOATS / 2), 0);
+        free(pc.to_a);
+        free(pc.to_wr);
+    }
+
+    // keymap: the default bindings, a key stream recorded by walking them
+    // (sequences like gg complete, modes change every 256 keys), replayed
+    // through both transition tables
+    {
+        size_t states = (size_t)config.KEYMAP_MODE_CAPACITY * config.KEYMAP_STATE_CAPACITY;
+        size_t functions = states * config.KEYMAP_FUNCTION_CAPACITY;
+        war_keymap_context keymap = {0};
+        keymap.function_id = calloc(functions, sizeof(war_function_id));
+        keymap.function = calloc(functions, sizeof(void*));
+        keymap.function_count = calloc(states, sizeof(uint8_t));
+        keymap.flags = calloc(states, sizeof(war_keymap_flags));
+        keymap.edge_key = malloc(sizeof(uint64_t) * config.KEYMAP_EDGE_CAPACITY);
+        keymap.edge_next = malloc(sizeof(uint32_t) * config.KEYMAP_EDGE_CAPACITY);
+        keymap.state_count = calloc(config.KEYMAP_MODE_CAPACITY, sizeof(uint32_t));
+        war_bench_key* keys = malloc(sizeof(war_bench_key) * WAR_BENCH_KEY_EVENTS);
+        uint64_t* edges = malloc(sizeof(uint64_t) * config.KEYMAP_EDGE_CAPACITY);
+        if (!keymap.function_id || !keymap.function || !keymap.function_count || !keymap.flags ||
+            !keymap.edge_key || !keymap.edge_next || !keymap.state_count || !keys || !edges)
+            return 1;
+        war_keymap_clear(&keymap, &config);
+        war_keymap_default(&keymap, &config);
+
+        // bound edges, and the dense table's shape
+        uint32_t edge_count = 0;
+        uint32_t max_keysym = 0;
+        uint32_t max_mod = 0;
+        for (uint32_t i = 0; i < config.KEYMAP_EDGE_CAPACITY; i++) {
+            uint64_t key = keymap.edge_key[i];
+            if (key == WAR_KEYMAP_EDGE_EMPTY) continue;
+            uint32_t keysym = (uint32_t)(key >> 8);
+            if (keysym > max_keysym) max_keysym = keysym;
+            if ((key & 0xFF) > max_mod) max_mod = (uint32_t)(key & 0xFF);
+            edges[edge_count++] = key;
+        }
+
+        // record: follow a bound edge from the current state, or press an
+        // unbound key; the state advances exactly as the replay will
+        uint32_t mode = 0;
+        uint64_t state = 0;
+        uint32_t recorded = 0;
+        while (recorded < WAR_BENCH_KEY_EVENTS) {
+            if (recorded % 256 == 0) {
+                mode = (mode + 1) % config.KEYMAP_MODE_CAPACITY;
+                state = 0;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t pick = seed >> 8;
+            war_bench_key* k = &keys[recorded];
+            k->mode = mode;
+            uint32_t from = 0;
+            for (uint32_t e = 0; e < edge_count; e++)
+                if ((edges[e] >> 56) == mode && ((edges[e] >> 40) & 0xFFFF) == state) from++;
+            if (!from || pick % WAR_BENCH_KEY_MISS == 0) {
+                k->keysym = pick % (max_keysym + 1);
+                k->mod = 0;
+            } else {
+                uint32_t nth = pick % from;
+                for (uint32_t e = 0; e < edge_count; e++) {
+                    if ((edges[e] >> 56) != mode || ((edges[e] >> 40) & 0xFFFF) != state) continue;
+                    if (nth-- == 0) {
+                        k->keysym = (uint32_t)(edges[e] >> 8);
+                        k->mod = (uint32_t)(edges[e] & 0xFF);
+                        break;
+                    }
+                }
+            }
+            recorded++;
+            uint64_t next = state ? war_keymap_next(&keymap, &config, mode, state, k->keysym, k->mod) : 0;
+            if (!next) next = war_keymap_next(&keymap, &config, mode, 0, k->keysym, k->mod);
+            if (!next) {
+                state = 0;
+                continue;
+            }
+            if (keymap.function_count[mode * (size_t)config.KEYMAP_STATE_CAPACITY + next])
+                state = 0;
+            else if (keymap.flags[mode * (size_t)config.KEYMAP_STATE_CAPACITY + state] & WAR_KEYMAP_PREFIX)
+                state = next;
+            else
+                state = 0;
+        }
+
+        uint64_t passes = frames / 64 ? frames / 64 : 1;
+        uint64_t want = war_bench_key_replay(&keymap, &config, NULL, keys, WAR_BENCH_KEY_EVENTS);
+        uint64_t t0 = war_perf_now_ns();
+        for (uint64_t p = 0; p < passes; p++)
+            sink += (float)war_bench_key_replay(&keymap, &config, NULL, keys, WAR_BENCH_KEY_EVENTS);
+        uint64_t ns = war_perf_now_ns() - t0;
+        double pressed = (double)passes * WAR_BENCH_KEY_EVENTS;
+        printf("%-10s %12.2f ms %10.3f ns/key    %u edges, %zu KB\n", "keymap", (double)ns / 1e6,
+               (double)ns / pressed, edge_count,
+               (size_t)config.KEYMAP_EDGE_CAPACITY * (sizeof(uint64_t) + sizeof(uint32_t)) / 1024);
+
+        // calloc'd, so only the rows the edges and the stream touch are ever
+        // backed by memory
+        war_bench_dense dense = {
+            .states = config.KEYMAP_STATE_CAPACITY,
+            .keysyms = max_keysym + 1 > config.KEYMAP_KEYSYM_CAPACITY ? max_keysym + 1 : config.KEYMAP_KEYSYM_CAPACITY,
+            .mods = max_mod + 1 > config.KEYMAP_MOD_CAPACITY ? max_mod + 1 : config.KEYMAP_MOD_CAPACITY,
+        };
+        size_t cells = (size_t)config.KEYMAP_MODE_CAPACITY * dense.states * dense.keysyms * dense.mods;
+        dense.next_state = calloc(cells, sizeof(uint64_t));
+        if (!dense.next_state) {
+            printf("%-10s skipped, %zu MB table not allocated\n", "keymap/old", cells * sizeof(uint64_t) >> 20);
+        } else {
+            for (uint32_t i = 0; i < config.KEYMAP_EDGE_CAPACITY; i++) {
+                uint64_t key = keymap.edge_key[i];
+                if (key == WAR_KEYMAP_EDGE_EMPTY) continue;
+                size_t cell = (((key >> 56) * dense.states + ((key >> 40) & 0xFFFF)) * dense.keysyms +
+                               (uint32_t)(key >> 8)) * dense.mods + (key & 0xFF);
+                dense.next_state[cell] = keymap.edge_next[i];
+            }
+            if (war_bench_key_replay(&keymap, &config, &dense, keys, WAR_BENCH_KEY_EVENTS) != want) {
+                fprintf(stderr, "war_bench: dense and sparse keymaps disagree\n");
+                return 1;
+            }
+            t0 = war_perf_now_ns();
+            for (uint64_t p = 0; p < passes; p++)
+                sink += (float)war_bench_key_replay(&keymap, &config, &dense, keys, WAR_BENCH_KEY_EVENTS);
+            ns = war_perf_now_ns() - t0;
+            printf("%-10s %12.2f ms %10.3f ns/key    dense, %zu MB\n", "keymap/old", (double)ns / 1e6,
+                   (double)ns / pressed, cells * sizeof(uint64_t) >> 20);
+            free(dense.next_state);
+        }
+        free(keymap.function_id);
+        free(keymap.function);
+        free(keymap.function_count);
+        free(keymap.flags);
+        free(keymap.edge_key);
+        free(keymap.edge_next);
+        free(keymap.state_count);
+        free(keys);
+        free(edges);
+    }
+
+    if (sink == 12345.0f) printf("\n");
+    for (uint32_t v = 0; v < args.voices; v++) war_slot_clear(&env->capture_slots[war_bench_slot_idx(v)]);
+    free(env->delay_pool);
+    free(env->delay_pool_used);
+    free(env->resample_table);
+    free(env);
+    return 0;
+}
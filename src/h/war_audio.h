@@ -0,0 +1,174 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_audio.h — audio backends
+//
+// The audio thread is whichever backend main() picks:
+//
+//     pipewire  war_pipewire() in war_main.c, the default
+//     null      a CLOCK_MONOTONIC clock ticking WAR_AUDIO_NULL_PERIOD frames
+//               at 48kHz, the same quantum the Pipewire streams ask for
+//
+// The null backend pulls pc_play exactly like on_pw_play_process and either
+// discards the audio or streams it to a float WAV (--audio-out). With
+// --audio-in it plays a WAV into pc_capture and pc_loopback one period per
+// tick, standing in for the mic and the sink monitor. It needs no daemon, so
+// capture and playback run the same way in containers and on build machines.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_AUDIO_H
+#define WAR_AUDIO_H
+
+#include "war_data.h"
+#include "war_functions.h"
+#include "war_perf.h"
+#include "war_stem.h"
+#include "war_trace.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WAR_AUDIO_NULL_PERIOD 128 // frames per tick, matches node.latency
+#define WAR_AUDIO_NULL_RATE   48000
+
+extern void* war_pipewire(void* args);
+extern void war_pipewire_stop(war_env* env);
+
+// 44-byte stereo WAV header: 32 bits is IEEE float, 16 and 24 are PCM
+static inline void war_wav_write_header(FILE* f, uint32_t rate, uint16_t bits, uint32_t data_bytes) {
+    uint32_t riff = data_bytes + 36, fmt_size = 16;
+    uint16_t audio_fmt = bits == 32 ? 3 : 1, channels = 2;
+    uint32_t byte_rate = rate * channels * (bits / 8);
+    uint16_t block_align = channels * (bits / 8);
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riff, 4, 1, f);
+    fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f);
+    fwrite(&fmt_size, 4, 1, f);
+    fwrite(&audio_fmt, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&byte_rate, 4, 1, f);
+    fwrite(&block_align, 2, 1, f);
+    fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&data_bytes, 4, 1, f);
+}
+
+// float stereo WAV with the sizes patched in by _war_audio_wav_close
+static inline FILE* _war_audio_wav_open(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (f) war_wav_write_header(f, WAR_AUDIO_NULL_RATE, 32, 0);
+    return f;
+}
+
+static inline void _war_audio_wav_close(FILE* f, uint64_t data_bytes) {
+    if (data_bytes > 0xFFFFFFFFull - 36) data_bytes = 0xFFFFFFFFull - 36;
+    uint32_t data = (uint32_t)data_bytes;
+    uint32_t riff = data + 36;
+    fseek(f, 4, SEEK_SET);
+    fwrite(&riff, 4, 1, f);
+    fseek(f, 40, SEEK_SET);
+    fwrite(&data, 4, 1, f);
+    fclose(f);
+}
+
+static inline void _war_audio_null_feed(war_env* env, const float* in, uint64_t in_count, uint64_t* in_pos) {
+    float period[WAR_AUDIO_NULL_PERIOD * 2];
+    uint64_t n = in_count - *in_pos;
+    if (n > WAR_AUDIO_NULL_PERIOD * 2) n = WAR_AUDIO_NULL_PERIOD * 2;
+    memcpy(period, in + *in_pos, sizeof(float) * n);
+    // past the end of the file the inputs go quiet, like an idle mic
+    memset(period + n, 0, sizeof(float) * (WAR_AUDIO_NULL_PERIOD * 2 - n));
+    *in_pos += n;
+    uint8_t stored = war_pc_to_wr(env->pc_capture, 0, sizeof(period), period);
+    env->atomics->capture_frames++;
+    war_perf_capture_callback(&env->perf,
+                              _war_perf_ring_used(env->pc_capture->i_to_wr, env->pc_capture->i_from_a, env->pc_capture->size),
+                              stored);
+    if (env->atomics->capture_loopback) {
+        war_pc_to_wr(env->pc_loopback, 0, sizeof(period), period);
+        env->atomics->loopback_frames++;
+    }
+}
+
+static void* war_audio_null(void* args) {
+    war_env* env = (war_env*)args;
+    war_trace_thread_name("audio null");
+    FILE* out = NULL;
+    uint64_t out_bytes = 0;
+    if (env->audio_out_path[0]) {
+        out = _war_audio_wav_open(env->audio_out_path);
+        if (!out) call_king_terry("audio null: cannot open %s, discarding", env->audio_out_path);
+    }
+    float* in = NULL;
+    uint64_t in_count = 0, in_pos = 0;
+    if (env->audio_in_path[0]) {
+        in = _war_stem_load_wav_f32(env->audio_in_path, &in_count, 0);
+        if (!in) call_king_terry("audio null: cannot read %s, no capture input", env->audio_in_path);
+    }
+    env->atomics->capture_loopback = 1; // enabled by default, as with Pipewire
+    call_king_terry("audio null: %u frames @ %uHz%s%s%s%s", WAR_AUDIO_NULL_PERIOD, WAR_AUDIO_NULL_RATE,
+                    out ? ", out " : "", out ? env->audio_out_path : "",
+                    in ? ", in " : "", in ? env->audio_in_path : "");
+
+    const uint64_t period_ns = (uint64_t)WAR_AUDIO_NULL_PERIOD * 1000000000ull / WAR_AUDIO_NULL_RATE;
+    uint8_t buf[WAR_AUDIO_NULL_PERIOD * 8];
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!atomic_load_explicit(&env->audio_quit, memory_order_acquire)) {
+        uint64_t t = (uint64_t)next.tv_nsec + period_ns;
+        next.tv_sec += (time_t)(t / 1000000000ull);
+        next.tv_nsec = (long)(t % 1000000000ull);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        // after a stall (suspend, debugger) restart the clock instead of
+        // bursting through every missed period
+        uint64_t now = war_perf_now_ns();
+        uint64_t due = (uint64_t)next.tv_sec * 1000000000ull + (uint64_t)next.tv_nsec;
+        if (now > due + 100000000ull) clock_gettime(CLOCK_MONOTONIC, &next);
+
+        uint64_t _tr = war_trace_begin();
+        uint32_t max = sizeof(buf), written = 0, hdr, sz;
+        uint32_t fill = _war_perf_ring_used(env->pc_play->i_to_a, env->pc_play->i_from_wr, env->pc_play->size);
+        while (written < max &&
+               war_pc_from_wr(env->pc_play, &hdr, &sz, buf + written) &&
+               sz <= max - written) {
+            written += sz;
+        }
+        if (written < max) memset(buf + written, 0, max - written);
+        war_perf_play_callback(&env->perf, fill, written, max);
+        if (out) out_bytes += fwrite(buf, 1, max, out);
+        if (in) _war_audio_null_feed(env, in, in_count, &in_pos);
+        war_trace_end("null play", _tr);
+    }
+
+    if (out) _war_audio_wav_close(out, out_bytes);
+    free(in);
+    return NULL;
+}
+
+static inline void war_audio_null_stop(war_env* env) {
+    atomic_store_explicit(&env->audio_quit, 1, memory_order_release);
+}
+
+static const war_audio_backend war_audio_backends[] = {
+    {"pipewire", war_pipewire, war_pipewire_stop},
+    {"null", war_audio_null, war_audio_null_stop},
+};
+
+// NULL for an unknown name
+static inline const war_audio_backend* war_audio_backend_find(const char* name) {
+    for (size_t i = 0; i < sizeof(war_audio_backends) / sizeof(war_audio_backends[0]); i++)
+        if (strcmp(war_audio_backends[i].name, name) == 0) return &war_audio_backends[i];
+    return NULL;
+}
+
+#endif // WAR_AUDIO_H
@@ -0,0 +1,353 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_autotune.h — pitch tracking and correction for WAR_EFFECT_AUTOTUNE
+//
+// Pitch is tracked with YIN, its difference function built from an FFT
+// cross-correlation so one analysis costs three 2048-point FFTs instead of
+// WINDOW * TAU_MAX multiplies. Correction is TD-PSOLA toward the nearest
+// semitone: Hann grains two periods wide are taken around analysis marks one
+// detected period apart and overlap-added at the corrected spacing.
+//
+// Voices play from stored slots, so the corrector reads ahead in the slot
+// and adds no latency. Live voices share A_AUTOTUNE_BUDGET analyses per mixer
+// chunk and keep their last estimate when the budget runs out. ":autotune
+// render" runs the same corrector over whole slots on a worker thread.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_AUTOTUNE_H
+#define WAR_AUTOTUNE_H
+
+#include "war_data.h"
+#include "war_sample.h"
+#include "war_trace.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// in-place iterative radix-2 FFT, n a power of two. inverse is unscaled.
+static inline void _war_autotune_fft(float* re, float* im, uint32_t n, int inverse) {
+    for (uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        double ang = (inverse ? 2.0 : -2.0) * M_PI / (double)len;
+        double wr = cos(ang), wi = sin(ang);
+        for (uint32_t i = 0; i < n; i += len) {
+            double cr = 1.0, ci = 0.0;
+            for (uint32_t k = 0; k < len / 2; k++) {
+                uint32_t a = i + k, b = i + k + len / 2;
+                float tr = (float)(re[b] * cr - im[b] * ci);
+                float ti = (float)(re[b] * ci + im[b] * cr);
+                re[b] = re[a] - tr; im[b] = im[a] - ti;
+                re[a] += tr; im[a] += ti;
+                double t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+}
+
+// YIN over mono x[0, WINDOW + TAU_MAX). Returns the period in frames (parabolic
+// interpolated) or 0 when the block is silent or aperiodic.
+static inline float _war_autotune_detect(const float* x) {
+    enum { W = WAR_AUTOTUNE_WINDOW, T = WAR_AUTOTUNE_TAU_MAX, N = WAR_AUTOTUNE_FFT };
+    float ar[N], ai[N], br[N], bi[N];
+    double e0 = 0.0;
+    for (uint32_t j = 0; j < N; j++) {
+        ar[j] = j < W ? x[j] : 0.0f;
+        br[j] = j < W + T ? x[j] : 0.0f;
+        ai[j] = bi[j] = 0.0f;
+        if (j < W) e0 += (double)x[j] * x[j];
+    }
+    if (e0 < 1e-7 * W) return 0.0f;
+    // r(tau) = sum_j x[j] * x[j + tau] = IFFT(conj(A) * B)
+    _war_autotune_fft(ar, ai, N, 0);
+    _war_autotune_fft(br, bi, N, 0);
+    for (uint32_t j = 0; j < N; j++) {
+        float r = ar[j] * br[j] + ai[j] * bi[j];
+        float i = ar[j] * bi[j] - ai[j] * br[j];
+        ar[j] = r; ai[j] = i;
+    }
+    _war_autotune_fft(ar, ai, N, 1);
+    // cumulative mean normalized difference, d(tau) = e0 + e(tau) - 2 r(tau)
+    float cmnd[T];
+    double et = e0, run = 0.0;
+    cmnd[0] = 1.0f;
+    for (uint32_t tau = 1; tau < T; tau++) {
+        et += (double)x[tau + W - 1] * x[tau + W - 1] - (double)x[tau - 1] * x[tau - 1];
+        double d = e0 + et - 2.0 * (double)ar[tau] / (double)N;
+        if (d < 0.0) d = 0.0;
+        run += d;
+        cmnd[tau] = run > 0.0 ? (float)(d * tau / run) : 1.0f;
+    }
+    uint32_t tau = WAR_AUTOTUNE_TAU_MIN;
+    for (; tau < T - 1; tau++) {
+        if (cmnd[tau] < WAR_AUTOTUNE_THRESHOLD) {
+            while (tau + 1 < T - 1 && cmnd[tau + 1] < cmnd[tau]) tau++;
+            break;
+        }
+    }
+    if (tau >= T - 1) return 0.0f;
+    float a = cmnd[tau - 1], b = cmnd[tau], c = cmnd[tau + 1];
+    float den = a - 2.0f * b + c;
+    float off = fabsf(den) > 1e-9f ? 0.5f * (a - c) / den : 0.0f;
+    if (off > 0.5f) off = 0.5f;
+    if (off < -0.5f) off = -0.5f;
+    return (float)tau + off;
+}
+
+// ratio that moves a period onto the nearest equal-tempered semitone
+static inline float _war_autotune_target(float period) {
+    double f0 = 48000.0 / (double)period;
+    double midi = 69.0 + 12.0 * log2(f0 / 440.0);
+    return (float)pow(2.0, (floor(midi + 0.5) - midi) / 12.0);
+}
+
+// Renders `floats` interleaved stereo samples of corrected slot audio starting
+// at input frame t0. x/count is the whole slot (read ahead freely), ring a
+// planar stereo overlap-add ring of WAR_AUTOTUNE_RING frames. budget counts
+// analyses still allowed; NULL is unlimited (offline).
+static inline void _war_autotune_render(war_autotune_state* st, double retune_ms, float* ring,
+                                        const float* x, uint64_t count, uint64_t t0,
+                                        float* out, uint64_t floats, uint32_t* budget) {
+    enum { W = WAR_AUTOTUNE_WINDOW, T = WAR_AUTOTUNE_TAU_MAX };
+    const uint64_t mask = WAR_AUTOTUNE_RING - 1;
+    uint64_t frames = count / 2, n = floats / 2;
+    float* rl = ring;
+    float* rr = ring + WAR_AUTOTUNE_RING;
+    if (!st->primed || st->out_pos != t0) {
+        memset(ring, 0, sizeof(float) * 2 * WAR_AUTOTUNE_RING);
+        st->primed = 1;
+        st->voiced = 0;
+        st->out_pos = t0;
+        st->next_detect = t0;
+        st->syn_mark = st->ana_mark = (double)t0;
+        st->period = WAR_AUTOTUNE_UNVOICED;
+        st->target = st->ratio = 1.0f;
+    }
+    while (st->syn_mark - st->period < (double)(t0 + n)) {
+        double s = st->syn_mark;
+        int64_t si = (int64_t)floor(s + 0.5);
+        if (si >= (int64_t)st->next_detect && (!budget || *budget)) {
+            float mono[W + T];
+            int64_t a0 = si - W / 2;
+            for (int64_t j = 0; j < W + T; j++) {
+                int64_t k = a0 + j;
+                mono[j] = (k >= 0 && (uint64_t)k < frames) ? 0.5f * (x[k * 2] + x[k * 2 + 1]) : 0.0f;
+            }
+            float p = _war_autotune_detect(mono);
+            st->voiced = p > 0.0f;
+            st->period = st->voiced ? p : WAR_AUTOTUNE_UNVOICED;
+            st->target = st->voiced ? _war_autotune_target(p) : 1.0f;
+            st->next_detect = (uint64_t)si + WAR_AUTOTUNE_HOP;
+            if (budget) (*budget)--;
+        }
+        float P = st->period;
+        // glide toward the target over retune_ms (0 = hard snap)
+        double hop = (double)P / (double)st->ratio;
+        double k = retune_ms > 0.0 ? 1.0 - exp(-hop / (retune_ms * 48.0)) : 1.0;
+        st->ratio += (float)((double)(st->target - st->ratio) * k);
+        hop = (double)P / (double)st->ratio;
+        // analysis marks advance one period at a time; take the nearest one
+        while (st->ana_mark + 0.5 * P < s) st->ana_mark += P;
+        if (st->ana_mark - 0.5 * P > s) st->ana_mark = s;
+        int64_t ai = (int64_t)floor(st->ana_mark + 0.5);
+        int32_t pi = (int32_t)(P + 0.5f);
+        if (pi < 1) pi = 1;
+        float g = 1.0f / st->ratio; // Hann grains at hop P/ratio sum to ratio
+        for (int32_t j = -pi; j < pi; j++) {
+            int64_t ts = si + j, src = ai + j;
+            if (ts < (int64_t)t0 || src < 0 || (uint64_t)src >= frames) continue;
+            float w = g * (0.5f - 0.5f * cosf((float)M_PI * (float)(j + pi) / (float)pi));
+            rl[ts & mask] += x[src * 2] * w;
+            rr[ts & mask] += x[src * 2 + 1] * w;
+        }
+        st->syn_mark += hop;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t r = (t0 + i) & mask;
+        out[i * 2] = rl[r];
+        out[i * 2 + 1] = rr[r];
+        rl[r] = rr[r] = 0.0f;
+    }
+    st->out_pos = t0 + n;
+}
+
+// offline: malloc'd corrected copy of the first `floats` samples of x/count
+static inline float* war_autotune_render_copy(const float* x, uint64_t count, uint64_t floats, double retune_ms) {
+    if (floats > count) floats = count;
+    float* out = malloc(sizeof(float) * (floats ? floats : 1));
+    float* ring = malloc(sizeof(float) * 2 * WAR_AUTOTUNE_RING);
+    if (!out || !ring) {
+        free(out);
+        free(ring);
+        return NULL;
+    }
+    war_autotune_state st = {0};
+    for (uint64_t f = 0; f + 1 < floats; f += WAR_AUTOTUNE_HOP * 2) {
+        uint64_t chunk = floats - f < WAR_AUTOTUNE_HOP * 2 ? floats - f : WAR_AUTOTUNE_HOP * 2;
+        _war_autotune_render(&st, retune_ms, ring, x, count, f / 2, out + f, chunk & ~1ULL, NULL);
+    }
+    if (floats & 1) out[floats - 1] = x[floats - 1];
+    free(ring);
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+// offline render: worker corrects snapshots, main thread installs results
+//-----------------------------------------------------------------------------
+
+static void* _war_autotune_worker(void* arg) {
+    war_env* env = (war_env*)arg;
+    war_trace_thread_name("autotune worker");
+    for (;;) {
+        pthread_mutex_lock(&env->autotune_mutex);
+        if (env->autotune_cancel || env->autotune_queue_len == 0) {
+            for (uint32_t i = 0; i < env->autotune_queue_len; i++)
+                war_sample_buf_unref(env->autotune_queue[i].src);
+            env->autotune_queue_len = 0;
+            env->autotune_cancel = 0;
+            env->autotune_thread_alive = 0;
+            pthread_mutex_unlock(&env->autotune_mutex);
+            break;
+        }
+        war_autotune_job job = env->autotune_queue[0];
+        for (uint32_t i = 1; i < env->autotune_queue_len; i++)
+            env->autotune_queue[i - 1] = env->autotune_queue[i];
+        env->autotune_queue_len--;
+        pthread_mutex_unlock(&env->autotune_mutex);
+
+        uint64_t _tr = war_trace_begin();
+        // packed sources are decoded here, off the main thread
+        const float* in = war_sample_unpack(job.src, job.in, job.count);
+        float* out = in ? war_autotune_render_copy(in, job.count, job.count, job.retune_ms) : NULL;
+        war_sample_unpack_free(job.in, in);
+        war_trace_end("autotune render", _tr);
+        job.out = out;
+        pthread_mutex_lock(&env->autotune_mutex);
+        int keep = out && env->autotune_done_len < WAR_AUTOTUNE_QUEUE_MAX;
+        if (keep) env->autotune_done[env->autotune_done_len++] = job;
+        pthread_mutex_unlock(&env->autotune_mutex);
+        if (!keep) {
+            free(out);
+            war_sample_buf_unref(job.src);
+        }
+    }
+    return NULL;
+}
+
+static inline void war_autotune_init(war_env* env) {
+    pthread_mutex_init(&env->autotune_mutex, NULL);
+    env->autotune_thread_alive = 0;
+    env->autotune_cancel = 0;
+    env->autotune_queue_len = 0;
+    env->autotune_done_len = 0;
+}
+
+static inline void war_autotune_shutdown(war_env* env) {
+    pthread_mutex_lock(&env->autotune_mutex);
+    env->autotune_cancel = 1;
+    pthread_mutex_unlock(&env->autotune_mutex);
+    // detached worker exits after its current job; brief wait
+    for (int i = 0; i < 50; i++) {
+        pthread_mutex_lock(&env->autotune_mutex);
+        int alive = env->autotune_thread_alive;
+        pthread_mutex_unlock(&env->autotune_mutex);
+        if (!alive) break;
+        usleep(100000);
+    }
+    for (uint32_t i = 0; i < env->autotune_done_len; i++) {
+        free(env->autotune_done[i].out);
+        war_sample_buf_unref(env->autotune_done[i].src);
+    }
+    env->autotune_done_len = 0;
+    pthread_mutex_destroy(&env->autotune_mutex);
+}
+
+// snapshot slot idx (a buffer reference) and queue it; returns 0 when queued
+static inline int war_autotune_enqueue(war_env* env, uint32_t idx, double retune_ms) {
+    war_capture_slot* slot = &env->capture_slots[idx];
+    if (!slot->samples || slot->count < 2) return -1;
+    war_sample_buf* snap = war_sample_buf_ref(slot->buf);
+    pthread_mutex_lock(&env->autotune_mutex);
+    if (env->autotune_queue_len >= WAR_AUTOTUNE_QUEUE_MAX) {
+        pthread_mutex_unlock(&env->autotune_mutex);
+        war_sample_buf_unref(snap);
+        return -1;
+    }
+    war_autotune_job* job = &env->autotune_queue[env->autotune_queue_len++];
+    job->idx = idx;
+    job->src = snap;
+    job->in = slot->samples;
+    job->out = NULL;
+    job->count = slot->count;
+    job->retune_ms = retune_ms;
+    int spawn = !env->autotune_thread_alive;
+    if (spawn) env->autotune_thread_alive = 1;
+    pthread_mutex_unlock(&env->autotune_mutex);
+    if (spawn) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&env->autotune_thread, &attr, _war_autotune_worker, env) != 0) {
+            pthread_mutex_lock(&env->autotune_mutex);
+            env->autotune_thread_alive = 0;
+            env->autotune_queue_len--;
+            pthread_mutex_unlock(&env->autotune_mutex);
+            war_sample_buf_unref(snap);
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return 0;
+}
+
+// main thread: swap finished renders into their slots. A slot whose audio
+// changed since the snapshot keeps its new audio. Returns the installed count.
+static inline uint32_t war_autotune_poll(war_env* env) {
+    if (!env->autotune_done_len) return 0; // racy peek, rechecked under lock
+    war_autotune_job done[WAR_AUTOTUNE_QUEUE_MAX];
+    pthread_mutex_lock(&env->autotune_mutex);
+    uint32_t n = env->autotune_done_len;
+    memcpy(done, env->autotune_done, sizeof(war_autotune_job) * n);
+    env->autotune_done_len = 0;
+    pthread_mutex_unlock(&env->autotune_mutex);
+    uint32_t installed = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        war_capture_slot* slot = &env->capture_slots[done[i].idx];
+        // the job's reference keeps done[i].in alive, so a match is never a
+        // recycled address
+        int same = slot->buf == done[i].src && slot->samples == done[i].in && slot->count == done[i].count;
+        war_sample_buf_unref(done[i].src);
+        if (!same) {
+            free(done[i].out);
+            continue;
+        }
+        if (!war_slot_adopt(slot, done[i].out, done[i].count)) continue;
+        // baked in: playing the live corrector on top would correct twice
+        slot->effect_flags &= ~(1ULL << (WAR_EFFECT_AUTOTUNE - 1));
+        installed++;
+    }
+    if (installed)
+        snprintf(env->status_msg, sizeof(env->status_msg), "autotune: rendered %u slot(s)", installed);
+    return installed;
+}
+
+#endif // WAR_AUTOTUNE_H
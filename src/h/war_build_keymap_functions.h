@@ -121,6 +121,7 @@ else if (strcmp(name, "war_toggle_resample") == 0) { return war_toggle_resample;
 else if (strcmp(name, "war_toggle_crop") == 0) { return war_toggle_crop; }
 else if (strcmp(name, "war_offall") == 0) { return war_offall; }
 else if (strcmp(name, "war_compress") == 0) { return war_compress; }
+else if (strcmp(name, "war_compress2") == 0) { return war_compress2; }
 else if (strcmp(name, "war_clear") == 0) { return war_clear; }
 else if (strcmp(name, "war_clear_all") == 0) { return war_clear_all; }
 else if (strcmp(name, "war_eq1") == 0) { return war_eq1; }
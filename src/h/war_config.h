@@ -47,6 +47,11 @@ static inline void war_config_default(war_config_context* config) {
     config->CONFIG_PATH_MAX = 4096;
     config->A_SCHED_FIFO_PRIORITY = 10;
     config->A_BUILDER_DATA_SIZE = 1024;
+    config->A_DELAY_MAX_MS = 2000.0; // longest :delay/:chorus time, sizes each pooled line
+    config->A_DELAY_LINES = 16;      // pooled delay lines shared by all voices
+    config->A_AUTOTUNE_BUDGET = 4;   // autotune pitch analyses per 32-frame mixer chunk
+    config->A_PERF_DUMP_SEC = 0.0;   // append telemetry to war_perf.log every N sec, 0 = off
+    config->A_AUTOSAVE_SEC = 300.0;  // write <project>.autosave every N sec while dirty, 0 = off
     // window render
     config->WR_VIEWS_SAVED = 13;
     config->WR_COLOR_STEP = 43.2;
@@ -196,10 +201,14 @@ static inline void war_config_default(war_config_context* config) {
     config->WR_FN_NAME_LIMIT = 4096;
     // pool context
     config->POOL_MAX_ALLOCATIONS = WAR_POOL_ID_COUNT;
+    config->POOL_HUGEPAGES = 1; // 0 off, 1 madvise THP, 2 MAP_HUGETLB
+    config->POOL_PREFAULT = 0; // 1 touches every page at startup
+    config->POOL_GUARD = 1; // guard pages between entries (DEBUG builds)
     // keymap context
     config->KEYMAP_STATE_CAPACITY = 500;
     config->KEYMAP_KEYSYM_CAPACITY = 256;
     config->KEYMAP_MOD_CAPACITY = 32;
+    config->KEYMAP_EDGE_CAPACITY = 8192; // power of two
     config->KEYMAP_FUNCTION_CAPACITY = 4;
     config->KEYMAP_MODE_CAPACITY = WAR_MODE_COUNT;
     // core directories
@@ -216,6 +225,7 @@ static inline void war_config_default(war_config_context* config) {
     // hot context
     config->HOT_CONTEXT_NAME_LIMIT = 256;
     config->HOT_CONTEXT_CMD_LIMIT = 256;
+    config->HOT_CONTEXT_JOBS = 0; // 0 = one compiler per online cpu
     config->HOT_CONTEXT_TEMPLATE =
         "cc -shared -fPIC -std=c99 "
         "-D_GNU_SOURCE "
@@ -374,6 +374,92 @@ typedef struct war_atomics {
 #define WAR_EFFECT_COUNT     9
 #define WAR_EFFECT_PARAMS    6 // max params per effect
 
+// immutable sample storage (war_sample.h): slots, undo entries and worker jobs
+// hold references, edits build a new buffer or a view into an existing one.
+// Freed when the last reference is dropped, from whichever thread drops it.
+// storage formats (war_sample_buf.format). count is in interleaved stereo
+// floats whatever the storage; war_sample_decode reads any of them as that.
+#define WAR_SAMPLE_F32 0
+#define WAR_SAMPLE_F16 1
+#define WAR_SAMPLE_S16 2
+
+typedef struct war_sample_buf {
+    _Atomic uint32_t refs;
+    uint64_t count; // interleaved stereo floats
+    float* data;    // F32 stereo; other layouts hold packed frames, see war_sample_plain
+    uint8_t format;
+    uint8_t channels; // 2 = interleaved, 1 = mono played on both sides
+    // file-backed buffers (war_page.h): data points into a read-only mapping
+    // of map_bytes at map_base, unmapped instead of freed. Main thread only:
+    // touch_us is when the mixer last needed it, resident is cleared once the
+    // pages were dropped.
+    void* map_base;
+    uint64_t map_bytes;
+    uint64_t touch_us;
+    uint8_t resident;
+} war_sample_buf;
+
+// paged slot storage: project loads map sample blocks of at least
+// WAR_PAGE_MAP_MIN bytes straight from the file. Every WAR_PAGE_SCAN_US the
+// main loop prefetches WAR_PAGE_LOOKAHEAD_SEC of what the playbar will reach
+// and drops mappings idle for WAR_PAGE_IDLE_US.
+#define WAR_PAGE_MAP_MIN       (1ull << 20)
+#define WAR_PAGE_LOOKAHEAD_SEC 2.0
+#define WAR_PAGE_SCAN_US       100000ull
+#define WAR_PAGE_IDLE_US       20000000ull
+
+// capture spill (war_spill.h): the main-thread drain copies capture audio into
+// fixed blocks, a writer thread appends them to an unlinked file in DIR_CACHE
+// and the finished take is mapped back as the slot's buffer
+#define WAR_SPILL_BLOCK_FLOATS 65536          // 256KB, ~0.7s of 48kHz stereo
+#define WAR_SPILL_BLOCKS       32             // in flight between drain and writer
+#define WAR_SPILL_GROW         (64ull << 20)  // file preallocation step, bytes
+
+typedef struct war_spill_job {
+    uint32_t block;
+    uint32_t floats;
+    uint64_t offset; // bytes into the spill file
+} war_spill_job;
+
+// headless `war --render` (war_render.h): workers take projects off next and
+// count the ones that fail
+#define WAR_RENDER_RATE  48000 // the mixer's rate; other output rates are resampled
+#define WAR_RENDER_BLOCK 4096  // frames converted and written at a time
+
+typedef struct war_render_batch {
+    char** projects;
+    uint32_t count;
+    _Atomic uint32_t next;
+    _Atomic uint32_t failed;
+    const char* out; // a file for one project, a directory for several, NULL beside each
+    uint32_t rate;
+    uint32_t bits; // 16 or 24 PCM, 32 float
+    uint8_t raw;   // headerless interleaved samples instead of WAV
+    struct war_config_context* config;
+    float* table; // shared sinc table, read-only
+} war_render_batch;
+
+// an export in progress (war_encode.h): war_export_mix publishes how many
+// frames of mix are final, a consumer thread takes them as they come
+typedef struct war_export_stream {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    const float* mix;     // time-aligned output
+    uint64_t ready;       // frames of mix that will not change
+    uint64_t written;     // frames the consumer has taken
+    uint8_t done;         // producer finished, ready is final
+    uint8_t failed;       // either side gave up
+    uint8_t writer_done;  // consumer has stopped reading mix
+} war_export_stream;
+
+// :wmp3 encoder: ffmpeg reading float PCM from a pipe
+typedef struct war_encode {
+    war_export_stream stream;
+    pid_t pid;
+    int fd;
+    pthread_t thread;
+} war_encode;
+
 // stem kind (which extracted stem to write into a new slot above)
 #define WAR_STEM_OFF          0
 #define WAR_STEM_VOCALS       1
@@ -387,10 +473,21 @@ typedef struct war_atomics {
 typedef struct war_stem_job {
     uint32_t src_idx;
     uint8_t kind;
+    war_sample_buf* src; // reference taken at enqueue, the worker never reads the slot
+    const float* in;     // source audio (a view into src)
+    uint64_t count;
 } war_stem_job;
 
+// extracted stem waiting for war_stem_poll to install it on the main thread
+typedef struct war_stem_result {
+    uint32_t src_idx;
+    uint8_t kind;
+    war_sample_buf* buf;
+} war_stem_result;
+
 typedef struct war_capture_slot {
-    float* samples;
+    war_sample_buf* buf; // owned reference, set only through war_slot_* helpers
+    float* samples;      // read-only view into buf->data (packed: first frame of the view)
     uint64_t count;
     uint64_t capacity;
     float gain;
@@ -402,8 +499,223 @@ typedef struct war_capture_slot {
     float release;
     uint64_t effect_flags; // bitmask: bit N = 1 if effect N+1 is active
     double effect_params[WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS];
+    int32_t transpose; // semitones; nonzero plays the view resampled (war_resample.h)
+    uint32_t root;     // 1 + idx of the slot whose audio this one follows, 0 = own audio
 } war_capture_slot;
 
+// audio side of an undo entry: the affected slots' views, each holding a reference
+typedef struct war_undo_slot {
+    uint32_t idx;
+    war_sample_buf* buf; // NULL = slot was empty
+    uint64_t offset;     // floats into buf->data
+    uint64_t count;
+} war_undo_slot;
+
+typedef struct war_undo_audio {
+    uint32_t n;
+    war_undo_slot slot[];
+} war_undo_audio;
+
+// project saves off the main thread (war_save.h)
+#define WAR_SAVE_QUEUE_MAX 4
+#define WAR_SAVE_IO_BUFFER (4u << 20) // stdio buffer the header fields batch into
+
+// one non-empty slot as it was when the save was requested
+typedef struct war_save_slot {
+    uint32_t idx;
+    uint64_t count;        // floats written, 0 = stored as the root link alone
+    war_capture_slot slot; // copy holding its own buf reference
+} war_save_slot;
+
+typedef struct war_save_job {
+    char path[1024];
+    uint8_t autosave; // <project>.autosave, leaves the dirty flag alone
+    uint8_t ok;       // filled by the worker
+    float bpm;
+    uint32_t note_count;
+    struct war_vulkan_note_instance* notes; // copy
+    uint32_t slot_count;
+    war_save_slot* slots;
+} war_save_job;
+
+// project audio read by a thread pool (war_load.h)
+#define WAR_LOAD_THREADS_MAX 8
+#define WAR_LOAD_CHUNK       (8u << 20) // bytes per pread
+
+// one slot's audio block in the project file
+typedef struct war_load_job {
+    uint32_t idx;
+    uint64_t off;   // file offset
+    uint64_t bytes;
+    uint64_t count; // floats
+    uint8_t format;
+    uint8_t channels;
+    war_sample_buf* buf; // filled by a worker, NULL when the read failed
+} war_load_job;
+
+// layer freeze (war_freeze.h): a layer's notes bounced into one slot
+#define WAR_FREEZE_RENDERING 1
+#define WAR_FREEZE_FROZEN    2
+
+typedef struct war_freeze_job {
+    uint32_t layer; // 1-9
+    uint32_t gen;   // war_freeze_state.gen when started
+    struct war_env* owner;
+    struct war_freeze_job* next; // owner->freeze_done list
+    struct war_env* render;                 // private env: the layer's notes and slots
+    pthread_t thread;                       // joined by war_freeze_poll
+    struct war_vulkan_note_instance* notes; // the layer's notes in the grid, in order
+    uint32_t note_count;
+    float bpm;
+    double start_col; // just ahead of the first note; the bounce plays from here
+    uint64_t lead;    // frames of the render before start_col
+    float* out;       // bounce, filled by the worker; NULL on failure
+    uint64_t count;
+    char error[96];
+} war_freeze_job;
+
+typedef struct war_freeze_state {
+    uint8_t state;  // 0 or WAR_FREEZE_*
+    uint32_t gen;   // bumped by :unfreeze, so a render in flight is dropped
+    uint32_t slot;  // bounce slot
+    uint64_t tick;  // bounce note
+    const float* samples;      // the bounce, to tell the slot still holds it
+    war_capture_slot slot_was; // the bounce slot's settings before, no audio
+    struct war_vulkan_note_instance* notes; // originals while frozen
+    uint32_t note_count;
+} war_freeze_state;
+
+// shared reverb send bus — one FDN per reverb slot, fed by every voice playing it
+#define WAR_REVERB_BUSES        16
+#define WAR_REVERB_LINES        4
+#define WAR_REVERB_LINE_MAX     2048  // frames, longest FDN line
+#define WAR_REVERB_PREDELAY_MAX 12000 // frames (250ms @ 48kHz)
+#define WAR_REVERB_BLOCK_MAX    64    // floats per mixer chunk
+#define WAR_REVERB_SILENCE      1e-6f // tail peak below which a bus is released
+
+// delay-line pool kinds: a voice holds at most one line per kind
+#define WAR_DELAY_LINE_DELAY    0
+#define WAR_DELAY_LINE_CHORUS   1
+#define WAR_DELAY_LINE_AUTOTUNE 2 // PSOLA overlap-add ring
+#define WAR_DELAY_LINE_KINDS    3
+
+// autotune — YIN pitch tracker + TD-PSOLA corrector (48kHz frames)
+#define WAR_AUTOTUNE_WINDOW    1024 // YIN integration window
+#define WAR_AUTOTUNE_TAU_MIN   40   // ~1200Hz
+#define WAR_AUTOTUNE_TAU_MAX   600  // ~80Hz
+#define WAR_AUTOTUNE_FFT       2048 // >= WINDOW + TAU_MAX, power of two
+#define WAR_AUTOTUNE_HOP       256  // frames between pitch analyses
+#define WAR_AUTOTUNE_THRESHOLD 0.12 // YIN aperiodicity threshold
+#define WAR_AUTOTUNE_UNVOICED  256  // grain half-width when no pitch is found
+#define WAR_AUTOTUNE_RING      4096 // overlap-add ring frames, power of two
+#define WAR_AUTOTUNE_QUEUE_MAX 256
+
+typedef struct war_autotune_state {
+    uint8_t primed;       // marks below are valid for out_pos
+    uint8_t voiced;
+    uint64_t out_pos;     // next output frame (voice read position)
+    uint64_t next_detect; // frame at which the next pitch analysis is due
+    double syn_mark;      // next synthesis grain centre
+    double ana_mark;      // analysis grain centre paired with it
+    float period;         // grain half-width / detected period in frames
+    float target;         // correction ratio to the nearest semitone
+    float ratio;          // smoothed correction ratio (retune_ms)
+} war_autotune_state;
+
+// offline render job: corrected copy of a slot, installed by the main thread
+typedef struct war_autotune_job {
+    uint32_t idx;
+    war_sample_buf* src; // reference to the slot audio at enqueue
+    const float* in;     // slot->samples at enqueue; result is dropped if the slot changed
+    float* out;          // corrected copy, filled by the worker
+    uint64_t count;
+    double retune_ms;
+} war_autotune_job;
+
+// transposed slot playback — polyphase windowed sinc, stereo rows stored LRLR
+// so a tap pair is one SIMD lane pair. Pitching up N semitones uses the kernel
+// with cutoff 2^(-N/12) of Nyquist; past WAR_RESAMPLE_CUTOFFS - 1 it aliases.
+#define WAR_RESAMPLE_TAPS    16
+#define WAR_RESAMPLE_PHASES  64 // per input frame, linearly interpolated between
+#define WAR_RESAMPLE_CUTOFFS 25 // 0..24 semitones up
+#define WAR_RESAMPLE_ROW     (WAR_RESAMPLE_TAPS * 2)
+#define WAR_RESAMPLE_TABLE_FLOATS \
+    (WAR_RESAMPLE_CUTOFFS * (WAR_RESAMPLE_PHASES + 1) * WAR_RESAMPLE_ROW)
+#define WAR_RESAMPLE_WINDOW 1024 // decoded source floats a packed slot reads on the stack
+
+// look-ahead limiter (WAR_EFFECT_COMPRESS2 and the master stage): gain is
+// computed in dB once per WAR_LIMITER_SUB frames and ramped across the sub-block
+#define WAR_LIMITER_SUB           16
+#define WAR_LIMITER_LOOKAHEAD_MAX 512 // frames, multiple of WAR_LIMITER_SUB
+#define WAR_LIMITER_PEAKS         (WAR_LIMITER_LOOKAHEAD_MAX / WAR_LIMITER_SUB + 1)
+
+typedef struct war_limiter {
+    uint32_t pos;      // look-ahead write position, frames
+    uint32_t peak_pos; // sub-block peak ring position
+    float gr_db;       // gain reduction at the end of the last sub-block (<= 0)
+    float gain;        // linear gain at the end of the last sub-block
+    float peak[WAR_LIMITER_PEAKS];
+    float delay[WAR_LIMITER_LOOKAHEAD_MAX * 2]; // interleaved stereo
+} war_limiter;
+
+// telemetry (:perf): lock-free counters and log-linear latency histograms.
+// A histogram bucket covers 1/8 of a power of two of nanoseconds.
+#define WAR_PERF_HIST_SUB_BITS 3
+#define WAR_PERF_HIST_BUCKETS  264 // covers up to 2^34 ns
+#define WAR_PERF_HUD_LINES     9
+#define WAR_PERF_HUD_COLS      44
+
+// font instance buffer layout: status bar labels from 0, the command line
+// from WAR_FONT_CMD_BASE, the perf overlay after it; the ranges never overlap
+#define WAR_FONT_INSTANCES 2048
+#define WAR_CMD_MAX        256 // cmd_buf, one glyph per char
+#define WAR_FONT_CMD_BASE  1024
+#define WAR_FONT_PERF_BASE (WAR_FONT_CMD_BASE + WAR_CMD_MAX)
+#if WAR_FONT_PERF_BASE + WAR_PERF_HUD_LINES * WAR_PERF_HUD_COLS > WAR_FONT_INSTANCES
+#error "perf overlay text does not fit in the font instance buffer"
+#endif
+
+typedef struct war_perf_hist {
+    _Atomic uint64_t count;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t bucket[WAR_PERF_HIST_BUCKETS];
+} war_perf_hist;
+
+typedef struct war_perf {
+    _Atomic uint64_t play_callbacks;
+    _Atomic uint64_t play_underruns;    // empty play buffer while the mixer was producing
+    _Atomic uint64_t play_short;        // partly filled play buffer while producing
+    _Atomic uint64_t capture_callbacks;
+    _Atomic uint64_t capture_overruns;  // pc_capture full, captured block lost
+    _Atomic uint32_t play_fill;         // pc_play bytes queued at the last callback
+    _Atomic uint32_t play_fill_min;     // since reset, while producing
+    _Atomic uint32_t capture_fill;      // pc_capture bytes queued at the last callback
+    _Atomic uint32_t capture_fill_max;
+    _Atomic uint32_t voices;            // active voices in the last mixer chunk
+    _Atomic uint32_t voices_max;
+    _Atomic uint8_t producing;          // mixer wrote chunks on its last pass
+    uint64_t play_last_ns;              // audio thread only
+    uint32_t chunk_frames;              // mixer chunk size, for the mix budget
+    uint64_t reset_ns;
+    war_perf_hist mix;         // one mixer chunk
+    war_perf_hist frame;       // war_render_frame
+    war_perf_hist play_period; // interval between play callbacks
+} war_perf;
+
+typedef struct war_reverb_bus {
+    uint8_t active;
+    uint8_t fed;   // a voice sent into this bus during the current block
+    uint32_t slot; // capture slot index
+    uint64_t idle; // frames since the last send (predelay must drain before release)
+    uint64_t quiet; // frames every line has read below WAR_REVERB_SILENCE
+    uint32_t pre_pos;
+    uint32_t line_pos[WAR_REVERB_LINES];
+    float lp[WAR_REVERB_LINES];
+    float send[WAR_REVERB_BLOCK_MAX];
+    float pre[WAR_REVERB_PREDELAY_MAX * 2];
+    float line[WAR_REVERB_LINES][WAR_REVERB_LINE_MAX];
+} war_reverb_bus;
+
 typedef struct war_glyph_info {
     float advance_x;
     float advance_y;
@@ -1568,6 +1880,17 @@ typedef struct war_nsgt_context {
 
 typedef struct war_env war_env;
 
+// audio backend: run() is the audio thread body and returns once stop() has
+// been called from the main thread
+#define WAR_AUDIO_PATH_MAX 256
+#define WAR_DEVICES_MAX 128 // entries in dev_names / midi_dev_names
+#define WAR_DEVICES_NAME_MAX 256
+typedef struct war_audio_backend {
+    const char* name;
+    void* (*run)(void* env);
+    void (*stop)(war_env* env);
+} war_audio_backend;
+
 // macro register event (Neovim-style: q<register> record, @<register> play)
 typedef struct war_macro_event {
     uint32_t raw_sym;
@@ -1919,11 +2242,28 @@ typedef struct war_keymap_context {
     void (**function)(war_env* env);
     uint8_t* function_count;
     war_keymap_flags* flags;
-    uint64_t* next_state;
+    // sparse transitions: open-addressed (mode, state, keysym, mod) -> state
+    uint64_t* edge_key;
+    uint32_t* edge_next;
+    uint32_t edge_count;
     //
     uint32_t* state_count; // per mode
 } war_keymap_context;
 
+// on-disk image of the default keymap FSM, see war_keymap_cache_load
+#define WAR_KEYMAP_CACHE_VERSION 1
+typedef struct war_keymap_cache_header {
+    char magic[4]; // "WARK"
+    uint32_t version;
+    uint8_t key[32];
+    uint32_t mode_capacity;
+    uint32_t state_capacity;
+    uint32_t function_capacity;
+    uint32_t edge_capacity;
+    uint32_t edge_count;
+    uint32_t pad;
+} war_keymap_cache_header;
+
 typedef struct war_lock_context {
     atomic_flag config;
     atomic_flag keymap;
@@ -2138,6 +2478,11 @@ typedef struct war_config_context {
     int A_BUILDER_DATA_SIZE;
     int A_PLAY_DATA_SIZE;
     int A_CAPTURE_DATA_SIZE;
+    double A_DELAY_MAX_MS;
+    int A_DELAY_LINES;
+    int A_AUTOTUNE_BUDGET;
+    double A_PERF_DUMP_SEC;
+    double A_AUTOSAVE_SEC;
     int CACHE_FILE_CAPACITY;
     int CONFIG_PATH_MAX;
     int A_WARMUP_FRAMES_FACTOR;
@@ -2272,10 +2617,14 @@ typedef struct war_config_context {
     int HUD_CURSOR_DEFAULT_INSTANCE_MAX;
     // pool context
     int POOL_MAX_ALLOCATIONS;
+    int POOL_HUGEPAGES;
+    int POOL_PREFAULT;
+    int POOL_GUARD;
     // keymap context
     uint32_t KEYMAP_STATE_CAPACITY;
     uint32_t KEYMAP_KEYSYM_CAPACITY;
     uint32_t KEYMAP_MOD_CAPACITY;
+    uint32_t KEYMAP_EDGE_CAPACITY;
     uint32_t KEYMAP_FUNCTION_CAPACITY;
     uint32_t KEYMAP_MODE_CAPACITY;
     // core directories
@@ -2292,6 +2641,7 @@ typedef struct war_config_context {
     // hot context
     uint32_t HOT_CONTEXT_NAME_LIMIT;
     uint32_t HOT_CONTEXT_CMD_LIMIT;
+    uint32_t HOT_CONTEXT_JOBS;
     char* HOT_CONTEXT_TEMPLATE;
     // command context
     uint32_t COMMAND_CONTEXT_STATE_CAPACITY;
@@ -2354,6 +2704,10 @@ typedef enum war_pool_id_enum {
     WAR_POOL_ID_AUDIO_PLAY_LAST_READ_TIME,
     WAR_POOL_ID_AUDIO_CAPTURE_READ_COUNT,
     WAR_POOL_ID_AUDIO_CAPTURE_LAST_READ_TIME,
+    WAR_POOL_ID_AUDIO_DELAY_POOL,
+    WAR_POOL_ID_AUDIO_DELAY_POOL_USED,
+    WAR_POOL_ID_AUDIO_RESAMPLE_TABLE,
+    WAR_POOL_ID_AUDIO_SPILL_BLOCKS,
     //-------------------------------------------------------------------------
     // MAIN
     //-------------------------------------------------------------------------
@@ -2679,7 +3033,8 @@ typedef enum war_pool_id_enum {
     WAR_POOL_ID_KEYMAP_CONTEXT_FUNCTION,
     WAR_POOL_ID_KEYMAP_CONTEXT_FUNCTION_COUNT,
     WAR_POOL_ID_KEYMAP_CONTEXT_FLAGS,
-    WAR_POOL_ID_KEYMAP_CONTEXT_NEXT_STATE,
+    WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_KEY,
+    WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_NEXT,
     WAR_POOL_ID_KEYMAP_CONTEXT_STATE_COUNT,
     // wayland context
     WAR_POOL_ID_WAYLAND_CONTEXT,
@@ -2694,13 +3049,16 @@ typedef struct war_pool_context {
     uint64_t* offset;
     uint32_t* alignment;
     war_pool_id* id;
+    uint32_t* index; // WAR_POOL_ID_COUNT, entry + 1 per id (0 = unset)
     //
     uint8_t* pool;
     //
     uint32_t count;
     uint64_t total_size;
+    uint64_t guard_size;
 } war_pool_context;
 
+#define WAR_HOT_WATCH_MAX 128
 typedef uint32_t war_hot_id;
 typedef enum war_hot_id_enum {
     WAR_HOT_ID_CONFIG,
@@ -2712,6 +3070,15 @@ typedef enum war_hot_id_enum {
     //
     WAR_HOT_ID_COUNT,
 } war_hot_id_enum;
+typedef struct war_hot_source {
+    char src_path[4096];
+    char so_path[4096];
+    char hash_path[4096];
+    char hash[65]; // hex blake2b of source + compile template
+    uint8_t stale;
+    pid_t pid;
+} war_hot_source;
+
 typedef struct war_hot_context {
     void** function;
     void** handle;
@@ -2719,6 +3086,13 @@ typedef struct war_hot_context {
     //
     uint32_t fn_count;
     war_hot_id* fn_id;
+    // source each id was resolved from, used to map inotify events to ids
+    char source[WAR_HOT_ID_COUNT][4096];
+    // live reload watcher (inotify is not recursive, one wd per directory)
+    int watch_fd;
+    uint32_t watch_count;
+    int watch_wd[WAR_HOT_WATCH_MAX];
+    char (*watch_dir)[4096];
 } war_hot_context;
 
 struct war_env {
@@ -2741,9 +3115,28 @@ struct war_env {
     war_misc_context* ctx_misc;
     // capture slots: 128 notes × 9 layers
     war_capture_slot capture_slots[128 * WAR_CAPTURE_SLOT_LAYERS];
-    float* capture_accumulator;
-    uint64_t capture_accumulator_count;
-    uint64_t capture_accumulator_capacity;
+    // capture spill (war_spill.h)
+    pthread_t spill_thread;
+    pthread_mutex_t spill_mutex;
+    pthread_cond_t spill_wake; // writer: block queued or quit
+    pthread_cond_t spill_idle; // queue written out
+    uint8_t spill_thread_alive;
+    uint8_t spill_quit;
+    uint8_t spill_writing;
+    uint8_t spill_failed; // write error this take, the take is dropped
+    int spill_fd;         // -1 outside a take
+    uint64_t spill_file_bytes;
+    float* spill_blocks; // WAR_SPILL_BLOCKS x WAR_SPILL_BLOCK_FLOATS
+    uint32_t spill_free[WAR_SPILL_BLOCKS];
+    uint32_t spill_free_len;
+    war_spill_job spill_queue[WAR_SPILL_BLOCKS];
+    uint32_t spill_queue_head;
+    uint32_t spill_queue_len;
+    uint32_t spill_fill; // block the drain is filling, UINT32_MAX = none
+    uint32_t spill_fill_floats;
+    uint64_t spill_count;   // floats captured this take
+    uint64_t spill_dropped; // floats lost while every block was queued
+    uint64_t page_scan_us;  // last war_page_scan
     // preview playback state (now uses preview_voice_* arrays)
     // new
     war_config_context* ctx_config;
@@ -2759,6 +3152,10 @@ struct war_env {
     war_simple_line_context* ctx_line;
     uint32_t active_mode;
     war_pipewire_context* ctx_pw; // ADD: pipewire context, allocated from pool
+    const war_audio_backend* audio_backend;
+    _Atomic uint8_t audio_quit;                // null backend: set by stop()
+    char audio_out_path[WAR_AUDIO_PATH_MAX];   // null backend: play stream to this WAV
+    char audio_in_path[WAR_AUDIO_PATH_MAX];    // null backend: capture from this WAV
     war_wayland_context* ctx_wayland;
     war_font_context* ctx_font;
     // playback bar
@@ -2782,11 +3179,17 @@ struct war_env {
     float play_bar_voice_filter_lp[WAR_PLAY_BAR_VOICES][5]; // [v][0]=lp_l, [1]=lp_r, [2]=smoothed_alpha, [3]=smoothed_t, [4]=last_eq
     uint64_t play_bar_voice_env_samples[WAR_PLAY_BAR_VOICES];
     float play_bar_voice_effect_state[WAR_PLAY_BAR_VOICES][32]; // per-voice state for real-time effects
-    float* play_bar_voice_delay_line[WAR_PLAY_BAR_VOICES]; // per-voice delay buffer (allocated on demand)
-    uint64_t play_bar_voice_delay_len[WAR_PLAY_BAR_VOICES]; // delay line length
+    uint32_t play_bar_voice_delay_line[WAR_PLAY_BAR_VOICES][WAR_DELAY_LINE_KINDS]; // pooled line id + 1, 0 = none
+    uint32_t play_bar_voice_delay_pos[WAR_PLAY_BAR_VOICES][WAR_DELAY_LINE_KINDS]; // line write position
+    war_autotune_state play_bar_voice_autotune[WAR_PLAY_BAR_VOICES];
+    war_limiter play_bar_voice_limiter[WAR_PLAY_BAR_VOICES];
     float play_bar_direct_filter_lp[128 * WAR_CAPTURE_SLOT_LAYERS][4];
     uint32_t play_bar_mute_mask;
     float master_gain;
+    // master look-ahead limiter (:compress2 master), same params as COMPRESS2
+    uint8_t master_limit_active;
+    double master_limit_params[WAR_EFFECT_PARAMS];
+    war_limiter master_limiter;
     uint8_t preview_voice_active[WAR_PREVIEW_VOICES];
     uint32_t preview_voice_note[WAR_PREVIEW_VOICES];
     uint32_t preview_voice_layer[WAR_PREVIEW_VOICES];
@@ -2795,9 +3198,24 @@ struct war_env {
     float preview_voice_filter_lp[WAR_PREVIEW_VOICES][5]; // [v][0]=lp_l, [1]=lp_r, [2]=smoothed_alpha, [3]=smoothed_t, [4]=last_eq
     uint64_t preview_voice_env_samples[WAR_PREVIEW_VOICES];
     float preview_voice_effect_state[WAR_PREVIEW_VOICES][32]; // per-voice state for real-time effects
-    float* preview_voice_delay_line[WAR_PREVIEW_VOICES]; // per-voice delay buffer
-    uint64_t preview_voice_delay_len[WAR_PREVIEW_VOICES];
+    uint32_t preview_voice_delay_line[WAR_PREVIEW_VOICES][WAR_DELAY_LINE_KINDS]; // pooled line id + 1, 0 = none
+    uint32_t preview_voice_delay_pos[WAR_PREVIEW_VOICES][WAR_DELAY_LINE_KINDS];
+    war_autotune_state preview_voice_autotune[WAR_PREVIEW_VOICES];
+    war_limiter preview_voice_limiter[WAR_PREVIEW_VOICES];
     float preview_voice_gain[WAR_PREVIEW_VOICES]; // per-voice gain multiplier (velocity, default 1.0)
+    war_reverb_bus reverb_bus[WAR_REVERB_BUSES]; // live reverb send buses (tails outlive voices)
+    uint32_t reverb_bus_active;
+    // delay-line pool: A_DELAY_LINES planar stereo lines of delay_pool_frames each
+    float* delay_pool;
+    uint8_t* delay_pool_used;
+    uint32_t delay_pool_count;
+    uint32_t delay_pool_frames; // power of two
+    uint32_t autotune_budget;   // pitch analyses left in the current mixer chunk
+    float* resample_table;      // windowed-sinc kernels for transposed slots, see war_resample.h
+    war_perf perf;
+    uint8_t perf_hud;        // :perf overlay
+    double perf_dump_sec;    // periodic dump interval, 0 = off
+    uint64_t perf_dump_next_ns;
     int midi_velocity_sense; // velocity sensitivity toggle (Alt+S)
     int midi_ctrl_play; // MIDI controller playback toggle (Ctrl+M), default on
     // simple popup HUD
@@ -2816,7 +3234,6 @@ struct war_env {
     uint32_t dev_sel_offset;
     uint32_t dev_sel_text_offset;
     int32_t capture_note_idx;
-    uint32_t loopback_modules[4]; // pactl module indices for virtual sinks
     uint32_t dev_count;
     char** dev_names;
     char* dev_nodes[4]; // PipeWire node name for each capture mode
@@ -2833,6 +3250,7 @@ struct war_env {
     int midi_seq_client; // ALSA sequencer client ID of the device
     uint8_t across_mode;
     uint8_t across_resample;
+    uint8_t across_root; // :across links neighbours to the source instead of copying it
     uint8_t midi_toggle;
     uint16_t layer_visible;
     uint8_t tap_tempo_active;
@@ -2855,7 +3273,7 @@ struct war_env {
     uint64_t recording_press_time_us[WAR_PREVIEW_VOICES];
     // command mode (Neovim-style :)
     uint8_t cmd_active;
-    char cmd_buf[256];
+    char cmd_buf[WAR_CMD_MAX];
     uint32_t cmd_len;
     // tab completion
     char cmd_tab_matches[64][128];
@@ -2889,6 +3307,73 @@ struct war_env {
     uint8_t stem_last_kind;
     uint32_t stem_last_src;
     uint32_t stem_last_dst; // UINT32_MAX = no destination
+    war_stem_result stem_ready[WAR_STEM_QUEUE_MAX]; // extracted, not yet installed
+    uint32_t stem_ready_len;
+    // offline autotune render queue (async worker, installed by main thread)
+    pthread_t autotune_thread;
+    pthread_mutex_t autotune_mutex;
+    uint8_t autotune_thread_alive;
+    uint8_t autotune_cancel;
+    war_autotune_job autotune_queue[WAR_AUTOTUNE_QUEUE_MAX];
+    uint32_t autotune_queue_len;
+    war_autotune_job autotune_done[WAR_AUTOTUNE_QUEUE_MAX];
+    uint32_t autotune_done_len;
+    // background project saves (war_save.h): the worker writes queued
+    // snapshots, war_save_poll reports them from the main loop
+    pthread_t save_thread;
+    pthread_mutex_t save_mutex;
+    uint8_t save_thread_alive;
+    war_save_job* save_queue[WAR_SAVE_QUEUE_MAX];
+    uint32_t save_queue_len;
+    war_save_job* save_done[WAR_SAVE_QUEUE_MAX];
+    uint32_t save_done_len;
+    double autosave_sec;  // A_AUTOSAVE_SEC, 0 = off
+    uint64_t autosave_us; // dirty since, or last autosave
+    uint64_t autosave_seq; // edit_seq the last autosave wrote
+    // project load (war_load.h): workers pread the queued blocks and append
+    // their index to load_done, war_load_poll installs them in order
+    pthread_t load_threads[WAR_LOAD_THREADS_MAX];
+    uint32_t load_thread_count;
+    uint32_t load_threads_used;
+    pthread_mutex_t load_mutex;
+    int load_fd;
+    war_load_job* load_jobs;
+    uint32_t load_job_count;
+    uint32_t load_job_cap;
+    _Atomic uint32_t load_next; // next job a worker takes
+    _Atomic uint8_t load_cancel;
+    _Atomic uint32_t load_worker_seq; // numbers the workers' trace names
+    uint32_t* load_done;
+    uint32_t load_done_len;
+    uint32_t load_installed; // main thread: load_done entries installed
+    uint64_t load_start_us;
+    char load_status[128]; // status_msg once everything is in
+    // layer freeze (war_freeze.h): renders run on their own threads and
+    // queue up in freeze_done for war_freeze_poll
+    war_freeze_state freeze[9];
+    pthread_mutex_t freeze_mutex;
+    pthread_cond_t freeze_cond; // signalled as each render finishes
+    war_freeze_job* freeze_done;
+    uint32_t freeze_running;
+    _Atomic uint8_t freeze_cancel; // shutdown: renders in flight stop early
+    // war_export_mix gives up between notes once *export_cancel is set;
+    // NULL for an export nothing cancels
+    _Atomic uint8_t* export_cancel;
+    // device discovery (war_devices.h): the worker publishes under
+    // devices_mutex and bumps devices_gen, war_devices_sync copies into
+    // dev_names/midi_dev_names on the main thread
+    pthread_t devices_thread;
+    pthread_mutex_t devices_mutex;
+    _Atomic uint32_t devices_gen;
+    uint32_t devices_seen_gen; // main thread only
+    uint8_t devices_thread_alive;
+    uint8_t devices_quit;
+    struct pw_loop* devices_loop;
+    struct spa_source* devices_quit_event;
+    uint32_t devices_audio_count;
+    uint32_t devices_midi_count;
+    char devices_audio[WAR_DEVICES_MAX][WAR_DEVICES_NAME_MAX];
+    char devices_midi[WAR_DEVICES_MAX][WAR_DEVICES_NAME_MAX];
     // freetype
     FT_Library ft_lib;
     FT_Face ft_face;
@@ -2904,11 +3389,11 @@ struct war_env {
     uint32_t undo_pos; // current position in tree (0 = no undo, >0 = can undo)
     uint32_t* undo_note_counts; // instance_count per snapshot
     struct war_vulkan_note_instance** undo_notes; // instance copies
-    uint8_t** undo_audio_data; // flat per-entry: [n_slots(uint32), slot_idx(uint32), count(uint64), cap(uint64), samples(count*float), ...]
-    uint64_t* undo_audio_size; // byte size of each undo_audio_data entry
+    war_undo_audio** undo_audio; // per-entry slot audio references, NULL when none
     char current_project_path[1024];
     uint8_t file_dirty;
     uint32_t undo_save_marker; // undo_pos at last save; file clean iff undo_pos == undo_save_marker
+    uint64_t edit_seq;         // bumped by every edit, undo and redo
 };
 
 typedef struct war_wayland_context {
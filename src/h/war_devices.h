@@ -0,0 +1,325 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_devices.h — audio source and MIDI port discovery
+//
+// One background thread runs a private pw_main_loop with two inputs:
+//
+//     Pipewire registry   Audio/Source nodes by node.name and Audio/Sink
+//                         nodes as "<node.name>.monitor" (what pactl list
+//                         sources short printed)
+//     ALSA sequencer      clients with a readable, subscribable port (what
+//                         aconnect -i printed), rescanned on every
+//                         client/port announcement from System:Announce
+//
+// Each change is published under devices_mutex and bumps devices_gen; the
+// main loop calls war_devices_sync, which copies the lists into dev_names and
+// midi_dev_names only when the generation moved. The device selector HUD
+// therefore follows hotplug without ever spawning a process.
+//
+// The thread also owns the war_loopback2..4 null sinks. They are created on
+// its Pipewire connection without object.linger, so they disappear with the
+// process instead of needing pactl unload-module at exit.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_DEVICES_H
+#define WAR_DEVICES_H
+
+#include "war_data.h"
+#include "war_trace.h"
+
+#include <alsa/asoundlib.h>
+#include <pipewire-0.3/pipewire/pipewire.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAR_DEVICES_NODES_MAX 256
+
+typedef struct war_devices_node {
+    uint32_t id;
+    char name[WAR_DEVICES_NAME_MAX];
+} war_devices_node;
+
+// thread-private state, lives on the devices thread stack
+typedef struct war_devices_ctx {
+    war_env* env;
+    struct pw_main_loop* loop;
+    snd_seq_t* seq;
+    war_devices_node nodes[WAR_DEVICES_NODES_MAX];
+    uint32_t node_count;
+} war_devices_ctx;
+
+// ALSA client id whose name matches dev_name (exact first, then substring,
+// as the old aconnect grep did), -1 if none
+static inline int war_devices_seq_find_client(snd_seq_t* seq, const char* dev_name) {
+    snd_seq_client_info_t* cinfo;
+    snd_seq_client_info_alloca(&cinfo);
+    int partial = -1;
+    snd_seq_client_info_set_client(cinfo, -1);
+    while (snd_seq_query_next_client(seq, cinfo) >= 0) {
+        const char* name = snd_seq_client_info_get_name(cinfo);
+        int client = snd_seq_client_info_get_client(cinfo);
+        if (!name) continue;
+        if (strcmp(name, dev_name) == 0) return client;
+        if (partial < 0 && strstr(name, dev_name)) partial = client;
+    }
+    return partial;
+}
+
+static inline void _war_devices_publish_audio(war_devices_ctx* ctx) {
+    war_env* env = ctx->env;
+    pthread_mutex_lock(&env->devices_mutex);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < ctx->node_count && n < WAR_DEVICES_MAX; i++) {
+        int dup = 0;
+        for (uint32_t j = 0; j < n; j++)
+            if (strcmp(env->devices_audio[j], ctx->nodes[i].name) == 0) { dup = 1; break; }
+        if (dup) continue;
+        memcpy(env->devices_audio[n++], ctx->nodes[i].name, WAR_DEVICES_NAME_MAX);
+    }
+    env->devices_audio_count = n;
+    pthread_mutex_unlock(&env->devices_mutex);
+    atomic_fetch_add_explicit(&env->devices_gen, 1, memory_order_release);
+}
+
+static inline void _war_devices_scan_midi(war_devices_ctx* ctx) {
+    war_env* env = ctx->env;
+    snd_seq_client_info_t* cinfo;
+    snd_seq_port_info_t* pinfo;
+    snd_seq_client_info_alloca(&cinfo);
+    snd_seq_port_info_alloca(&pinfo);
+    const unsigned want = SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+    pthread_mutex_lock(&env->devices_mutex);
+    uint32_t n = 0;
+    snd_seq_client_info_set_client(cinfo, -1);
+    while (snd_seq_query_next_client(ctx->seq, cinfo) >= 0 && n < WAR_DEVICES_MAX) {
+        int client = snd_seq_client_info_get_client(cinfo);
+        if (client == SND_SEQ_CLIENT_SYSTEM) continue;
+        snd_seq_port_info_set_client(pinfo, client);
+        snd_seq_port_info_set_port(pinfo, -1);
+        while (snd_seq_query_next_port(ctx->seq, pinfo) >= 0) {
+            unsigned caps = snd_seq_port_info_get_capability(pinfo);
+            if ((caps & want) != want || (caps & SND_SEQ_PORT_CAP_NO_EXPORT)) continue;
+            snprintf(env->devices_midi[n++], WAR_DEVICES_NAME_MAX, "%s", snd_seq_client_info_get_name(cinfo));
+            break;
+        }
+    }
+    env->devices_midi_count = n;
+    pthread_mutex_unlock(&env->devices_mutex);
+    atomic_fetch_add_explicit(&env->devices_gen, 1, memory_order_release);
+}
+
+static void _war_devices_on_global(void* data, uint32_t id, uint32_t permissions, const char* type,
+                                   uint32_t version, const struct spa_dict* props) {
+    (void)permissions;
+    (void)version;
+    war_devices_ctx* ctx = data;
+    if (!props || strcmp(type, PW_TYPE_INTERFACE_Node) != 0) return;
+    const char* cls = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+    const char* name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
+    if (!cls || !name || ctx->node_count >= WAR_DEVICES_NODES_MAX) return;
+    war_devices_node* node = &ctx->nodes[ctx->node_count];
+    if (strncmp(cls, "Audio/Source", 12) == 0)
+        snprintf(node->name, sizeof(node->name), "%s", name);
+    else if (strncmp(cls, "Audio/Sink", 10) == 0)
+        snprintf(node->name, sizeof(node->name), "%s.monitor", name);
+    else
+        return;
+    node->id = id;
+    ctx->node_count++;
+    _war_devices_publish_audio(ctx);
+}
+
+static void _war_devices_on_global_remove(void* data, uint32_t id) {
+    war_devices_ctx* ctx = data;
+    for (uint32_t i = 0; i < ctx->node_count; i++) {
+        if (ctx->nodes[i].id != id) continue;
+        ctx->nodes[i] = ctx->nodes[--ctx->node_count];
+        _war_devices_publish_audio(ctx);
+        return;
+    }
+}
+
+static const struct pw_registry_events war_devices_registry_events = {
+    PW_VERSION_REGISTRY_EVENTS,
+    .global = _war_devices_on_global,
+    .global_remove = _war_devices_on_global_remove,
+};
+
+static void _war_devices_on_seq(void* data, int fd, uint32_t mask) {
+    (void)fd;
+    (void)mask;
+    war_devices_ctx* ctx = data;
+    snd_seq_event_t* ev = NULL;
+    int rescan = 0;
+    while (snd_seq_event_input(ctx->seq, &ev) >= 0 && ev) {
+        switch (ev->type) {
+        case SND_SEQ_EVENT_CLIENT_START:
+        case SND_SEQ_EVENT_CLIENT_EXIT:
+        case SND_SEQ_EVENT_CLIENT_CHANGE:
+        case SND_SEQ_EVENT_PORT_START:
+        case SND_SEQ_EVENT_PORT_EXIT:
+        case SND_SEQ_EVENT_PORT_CHANGE:
+            rescan = 1;
+            break;
+        default:
+            break;
+        }
+    }
+    if (rescan) _war_devices_scan_midi(ctx);
+}
+
+static void _war_devices_on_quit(void* data, uint64_t count) {
+    (void)count;
+    pw_main_loop_quit(((war_devices_ctx*)data)->loop);
+}
+
+static void* _war_devices_worker(void* args) {
+    war_env* env = (war_env*)args;
+    war_trace_thread_name("devices");
+    war_devices_ctx ctx = {.env = env};
+    pw_init(NULL, NULL);
+    ctx.loop = pw_main_loop_new(NULL);
+    struct pw_loop* loop = pw_main_loop_get_loop(ctx.loop);
+    struct spa_source* quit = pw_loop_add_event(loop, _war_devices_on_quit, &ctx);
+    pthread_mutex_lock(&env->devices_mutex);
+    int stop = env->devices_quit;
+    env->devices_loop = loop;
+    env->devices_quit_event = quit;
+    pthread_mutex_unlock(&env->devices_mutex);
+
+    // MIDI: a private client subscribed to System:Announce for hotplug
+    struct spa_source* seq_source = NULL;
+    if (snd_seq_open(&ctx.seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) == 0) {
+        snd_seq_set_client_name(ctx.seq, "WAR devices");
+        int port = snd_seq_create_simple_port(ctx.seq, "announce",
+                                              SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT,
+                                              SND_SEQ_PORT_TYPE_APPLICATION);
+        if (port >= 0)
+            snd_seq_connect_from(ctx.seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE);
+        struct pollfd pfd;
+        if (snd_seq_poll_descriptors(ctx.seq, &pfd, 1, POLLIN) == 1)
+            seq_source = pw_loop_add_io(loop, pfd.fd, SPA_IO_IN, false, _war_devices_on_seq, &ctx);
+        _war_devices_scan_midi(&ctx);
+    } else {
+        ctx.seq = NULL;
+        call_king_terry("devices: no ALSA sequencer, MIDI list stays empty");
+    }
+
+    // audio: registry listener plus the capture-mode null sinks; the null
+    // backend never talks to a sound server
+    struct pw_context* context = NULL;
+    struct pw_core* core = NULL;
+    struct pw_registry* registry = NULL;
+    struct spa_hook registry_listener = {0};
+    struct pw_proxy* sinks[3] = {0};
+    if (env->audio_backend && strcmp(env->audio_backend->name, "pipewire") == 0) {
+        context = pw_context_new(loop, NULL, 0);
+        core = context ? pw_context_connect(context, NULL, 0) : NULL;
+        if (core) {
+            registry = pw_core_get_registry(core, PW_VERSION_REGISTRY, 0);
+            pw_registry_add_listener(registry, &registry_listener, &war_devices_registry_events, &ctx);
+            for (int i = 0; i < 3; i++) {
+                char sink[64];
+                snprintf(sink, sizeof(sink), "war_loopback%d", i + 2);
+                struct pw_properties* props = pw_properties_new(
+                    "factory.name", "support.null-audio-sink",
+                    PW_KEY_NODE_NAME, sink,
+                    PW_KEY_MEDIA_CLASS, "Audio/Sink",
+                    "audio.position", "FL,FR",
+                    "object.linger", "false",
+                    NULL);
+                sinks[i] = pw_core_create_object(core, "adapter", PW_TYPE_INTERFACE_Node,
+                                                 PW_VERSION_NODE, &props->dict, 0);
+                pw_properties_free(props);
+            }
+        } else {
+            call_king_terry("devices: cannot connect to Pipewire, no audio sources");
+        }
+    }
+
+    if (!stop) pw_main_loop_run(ctx.loop);
+
+    pthread_mutex_lock(&env->devices_mutex);
+    env->devices_loop = NULL;
+    env->devices_quit_event = NULL;
+    pthread_mutex_unlock(&env->devices_mutex);
+    for (int i = 0; i < 3; i++)
+        if (sinks[i]) pw_proxy_destroy(sinks[i]);
+    if (registry) {
+        spa_hook_remove(&registry_listener);
+        pw_proxy_destroy((struct pw_proxy*)registry);
+    }
+    if (core) pw_core_disconnect(core);
+    if (context) pw_context_destroy(context);
+    if (seq_source) pw_loop_destroy_source(loop, seq_source);
+    pw_loop_destroy_source(loop, quit);
+    if (ctx.seq) snd_seq_close(ctx.seq);
+    pw_main_loop_destroy(ctx.loop);
+    pw_deinit();
+    return NULL;
+}
+
+// after env->audio_backend is set
+static inline void war_devices_init(war_env* env) {
+    pthread_mutex_init(&env->devices_mutex, NULL);
+    atomic_store_explicit(&env->devices_gen, 0, memory_order_relaxed);
+    env->devices_seen_gen = 0;
+    env->devices_quit = 0;
+    env->devices_loop = NULL;
+    env->devices_quit_event = NULL;
+    env->devices_audio_count = 0;
+    env->devices_midi_count = 0;
+    env->devices_thread_alive = pthread_create(&env->devices_thread, NULL, _war_devices_worker, env) == 0;
+    if (!env->devices_thread_alive) call_king_terry("devices: thread failed, device lists stay empty");
+}
+
+static inline void war_devices_shutdown(war_env* env) {
+    if (!env->devices_thread_alive) return;
+    pthread_mutex_lock(&env->devices_mutex);
+    env->devices_quit = 1;
+    if (env->devices_loop && env->devices_quit_event)
+        pw_loop_signal_event(env->devices_loop, env->devices_quit_event);
+    pthread_mutex_unlock(&env->devices_mutex);
+    pthread_join(env->devices_thread, NULL);
+    env->devices_thread_alive = 0;
+    pthread_mutex_destroy(&env->devices_mutex);
+}
+
+// Main thread, once per loop iteration. dev_names[0] stays "loopback" (the
+// default sink monitor); an open selector keeps its cursor in range.
+static inline void war_devices_sync(war_env* env) {
+    uint32_t gen = atomic_load_explicit(&env->devices_gen, memory_order_acquire);
+    if (gen == env->devices_seen_gen) return;
+    env->devices_seen_gen = gen;
+    pthread_mutex_lock(&env->devices_mutex);
+    for (uint32_t i = 1; i < env->dev_count; i++) free(env->dev_names[i]);
+    env->dev_count = 1;
+    for (uint32_t i = 0; i < env->devices_audio_count && env->dev_count < WAR_DEVICES_MAX; i++)
+        env->dev_names[env->dev_count++] = strdup(env->devices_audio[i]);
+    for (uint32_t i = 0; i < env->midi_dev_count; i++) free(env->midi_dev_names[i]);
+    env->midi_dev_count = 0;
+    for (uint32_t i = 0; i < env->devices_midi_count; i++)
+        env->midi_dev_names[env->midi_dev_count++] = strdup(env->devices_midi[i]);
+    pthread_mutex_unlock(&env->devices_mutex);
+    if (env->popup_active && (env->popup_mode == 1 || env->popup_mode == 2)) {
+        uint32_t total = env->popup_mode == 1 ? env->midi_dev_count : env->dev_count;
+        if (env->popup_scroll_y + (uint32_t)env->popup_cursor_y >= total) {
+            env->popup_scroll_y = 0;
+            env->popup_cursor_y = 0;
+        }
+    }
+    if (env->dev_sel_cursor >= (int32_t)env->dev_count) env->dev_sel_cursor = 0, env->dev_sel_offset = 0;
+    if (env->midi_sel_cursor >= (int32_t)env->midi_dev_count) env->midi_sel_cursor = 0, env->midi_sel_offset = 0;
+}
+
+#endif // WAR_DEVICES_H
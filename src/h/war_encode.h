@@ -0,0 +1,177 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_encode.h — :wmp3 streamed straight into the encoder
+//
+// war_export_mix mixes notes in start order, so everything before the next
+// note's start is final. It pushes that prefix through the master chain and
+// publishes it on a war_export_stream. An encoder thread writes each
+// published stretch into ffmpeg's stdin as 32-bit float PCM, and ffmpeg
+// encodes it while the rest of the project is still mixing. Nothing but the
+// mp3 touches the disk, and an export takes about as long as the slower of
+// the mix and the encode.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_ENCODE_H
+#define WAR_ENCODE_H
+
+#include "war_data.h"
+#include "war_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static inline void war_export_stream_init(war_export_stream* s) {
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+}
+
+// producer: frames [0, ready) of mix are final
+static inline void war_export_stream_publish(war_export_stream* s, const float* mix, uint64_t ready) {
+    pthread_mutex_lock(&s->mutex);
+    s->mix = mix;
+    if (ready > s->ready) s->ready = ready;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+// producer: nonzero once the consumer has failed and mixing on is wasted
+static inline int war_export_stream_failed(war_export_stream* s) {
+    pthread_mutex_lock(&s->mutex);
+    int failed = s->failed;
+    pthread_mutex_unlock(&s->mutex);
+    return failed;
+}
+
+// producer: no more frames (failed: give up). Returns once the consumer is
+// off the mix buffer, so the caller may move or free it.
+static inline void war_export_stream_end(war_export_stream* s, int failed) {
+    pthread_mutex_lock(&s->mutex);
+    s->done = 1;
+    if (failed) s->failed = 1;
+    pthread_cond_broadcast(&s->cond);
+    while (!s->writer_done) pthread_cond_wait(&s->cond, &s->mutex);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static inline int _war_encode_write_all(int fd, const void* p, size_t n) {
+    const uint8_t* b = (const uint8_t*)p;
+    while (n) {
+        ssize_t w = write(fd, b, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        b += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+static void* _war_encode_writer(void* arg) {
+    war_encode* e = (war_encode*)arg;
+    war_export_stream* s = &e->stream;
+    war_trace_thread_name("mp3 encode");
+    // ffmpeg exiting early shows up as EPIPE; the SIGPIPE stays pending on
+    // this thread and goes away with it
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    float blk[WAR_RENDER_BLOCK * 2];
+    pthread_mutex_lock(&s->mutex);
+    for (;;) {
+        while (s->written == s->ready && !s->done && !s->failed) pthread_cond_wait(&s->cond, &s->mutex);
+        if (s->failed || s->written == s->ready) break;
+        const float* src = s->mix + s->written * 2;
+        uint64_t frames = s->ready - s->written;
+        pthread_mutex_unlock(&s->mutex);
+
+        uint64_t _tr = war_trace_begin();
+        int ok = 1;
+        for (uint64_t o = 0; ok && o < frames; o += WAR_RENDER_BLOCK) {
+            uint64_t n = frames - o < WAR_RENDER_BLOCK ? frames - o : WAR_RENDER_BLOCK;
+            for (uint64_t i = 0; i < n * 2; i++) {
+                float v = src[o * 2 + i];
+                blk[i] = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+            }
+            ok = _war_encode_write_all(e->fd, blk, sizeof(float) * n * 2);
+        }
+        war_trace_end("encode feed", _tr);
+
+        pthread_mutex_lock(&s->mutex);
+        s->written += frames;
+        if (!ok) s->failed = 1;
+    }
+    s->writer_done = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    close(e->fd); // EOF: ffmpeg flushes and exits
+    e->fd = -1;
+    return NULL;
+}
+
+// starts ffmpeg writing path and the thread feeding it; 0 when either fails
+static inline int war_encode_start(war_encode* e, const char* path) {
+    war_export_stream_init(&e->stream);
+    e->fd = -1;
+    e->pid = -1;
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) != 0) return 0;
+    char rate[16];
+    snprintf(rate, sizeof(rate), "%u", (unsigned)WAR_RENDER_RATE);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(p[0], STDIN_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        execlp("ffmpeg", "ffmpeg", "-y", "-loglevel", "error", "-f", "f32le", "-ar", rate, "-ac", "2", "-i",
+               "pipe:0", "-codec:a", "libmp3lame", "-b:a", "192k", path, (char*)NULL);
+        _exit(127);
+    }
+    close(p[0]);
+    if (pid < 0) {
+        call_king_terry("wmp3: fork failed: %s", strerror(errno));
+        close(p[1]);
+        return 0;
+    }
+    e->pid = pid;
+    e->fd = p[1];
+    if (pthread_create(&e->thread, NULL, _war_encode_writer, e) != 0) {
+        close(e->fd);
+        waitpid(pid, NULL, 0);
+        return 0;
+    }
+    return 1;
+}
+
+// waits for the feed and the encoder. mixed == 0 abandons the export.
+// Returns ffmpeg's exit status (127: not installed), -1 when the feed failed.
+static inline int war_encode_finish(war_encode* e, int mixed) {
+    if (!mixed) war_export_stream_end(&e->stream, 1);
+    pthread_join(e->thread, NULL);
+    int status = 0;
+    while (waitpid(e->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    int failed = e->stream.failed;
+    pthread_cond_destroy(&e->stream.cond);
+    pthread_mutex_destroy(&e->stream.mutex);
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0) return WEXITSTATUS(status);
+    if (!WIFEXITED(status)) return -1;
+    return failed || !mixed ? -1 : 0;
+}
+
+#endif // WAR_ENCODE_H
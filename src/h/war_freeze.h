@@ -0,0 +1,363 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_freeze.h — :freeze, one layer bounced into a single slot
+//
+// :freeze <layer> copies the layer's notes and slots into a private
+// war_render_env_new env and hands it to a thread, which mixes it with
+// war_export_mix: slot gain, pan, EQ, ADSR and every effect, reverb tails
+// included, but no master gain or limiter. war_freeze_poll installs the
+// result in a free slot of the same layer, takes the layer's notes out of
+// the grid and plays the bounce from one note a cell ahead of the first of
+// them, so playback runs one voice for the layer instead of dozens.
+// Mute notes stay in the grid and cut the bounce note the way they cut the
+// notes it replaced.
+//
+// :unfreeze <layer> puts the notes back and empties the bounce slot. Both
+// steps are undoable. A project saved while frozen stores the original
+// notes, not the bounce.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_FREEZE_H
+#define WAR_FREEZE_H
+
+#include "war_data.h"
+#include "war_keymap_functions.h"
+#include "war_render.h"
+#include "war_sample.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline void war_freeze_init(war_env* env) {
+    pthread_mutex_init(&env->freeze_mutex, NULL);
+    pthread_cond_init(&env->freeze_cond, NULL);
+    memset(env->freeze, 0, sizeof(env->freeze));
+    env->freeze_done = NULL;
+    env->freeze_running = 0;
+    atomic_init(&env->freeze_cancel, 0);
+    env->export_cancel = NULL;
+}
+
+static inline void war_freeze_job_free(war_freeze_job* job) {
+    if (!job) return;
+    war_render_env_free(job->render);
+    free(job->notes);
+    free(job->out);
+    free(job);
+}
+
+// a note :freeze takes out of the grid: on layer, not a mute note
+static inline int _war_freeze_note_on(const war_new_vulkan_note_instance* n, uint32_t layer) {
+    return !(n->flags & WAR_NEW_VULKAN_FLAGS_MUTE) && ((n->flags >> 4) & 0xF) == layer;
+}
+
+// index of layer's bounce note, -1 when it is gone (undone or deleted)
+static inline int war_freeze_bounce_note(war_env* env, uint32_t layer) {
+    war_freeze_state* fz = &env->freeze[layer - 1];
+    if (fz->state != WAR_FREEZE_FROZEN) return -1;
+    for (uint32_t i = 0; i < env->ctx_note->instance_count; i++) {
+        war_new_vulkan_note_instance* n = &env->ctx_note->instance[i];
+        if (n->tick == fz->tick && _war_freeze_note_on(n, layer)) return (int)i;
+    }
+    return -1;
+}
+
+// forgets layer's frozen state; the bounce slot goes back to how it was
+static inline void _war_freeze_forget(war_env* env, uint32_t layer) {
+    war_freeze_state* fz = &env->freeze[layer - 1];
+    war_capture_slot* s = &env->capture_slots[fz->slot];
+    if (fz->state == WAR_FREEZE_FROZEN && (!s->samples || s->samples == fz->samples)) {
+        war_slot_clear(s);
+        *s = fz->slot_was;
+    }
+    free(fz->notes);
+    fz->notes = NULL;
+    fz->note_count = 0;
+    fz->state = 0;
+    fz->gen++;
+}
+
+// the project is being replaced: frozen layers and renders in flight go
+static inline void war_freeze_reset(war_env* env) {
+    for (uint32_t l = 1; l <= 9; l++) {
+        war_freeze_state* fz = &env->freeze[l - 1];
+        uint32_t gen = fz->gen;
+        free(fz->notes);
+        memset(fz, 0, sizeof(*fz));
+        fz->gen = gen + 1;
+    }
+}
+
+// copies what rendering layer needs. NULL on OOM or when the layer has no notes.
+static inline war_freeze_job* war_freeze_snapshot(war_env* env, uint32_t layer) {
+    war_note_context* nc = env->ctx_note;
+    double gr = (double)env->ctx_wayland->gutter_rows;
+    double gc = (double)env->ctx_wayland->gutter_cols;
+    uint32_t n = 0;
+    double start = HUGE_VAL;
+    for (uint32_t i = 0; i < nc->instance_count; i++) {
+        war_new_vulkan_note_instance* note = &nc->instance[i];
+        if (!_war_freeze_note_on(note, layer)) continue;
+        n++;
+        if (note->pos[0] >= gc && note->pos[1] >= gr && note->pos[0] < start) start = note->pos[0];
+    }
+    if (!n || start == HUGE_VAL) return NULL;
+    war_freeze_job* job = calloc(1, sizeof(war_freeze_job));
+    if (!job) return NULL;
+    job->notes = malloc(sizeof(war_new_vulkan_note_instance) * n);
+    job->render = war_render_env_new(env->ctx_config, env->resample_table);
+    if (!job->notes || !job->render) {
+        war_freeze_job_free(job);
+        return NULL;
+    }
+    double bpm = env->atomics->bpm;
+    if (bpm <= 0.0) bpm = 100.0;
+    // a cell of silence ahead of the first note takes the bounce note's own
+    // anti-click fade-in; a whole cell keeps the note offsets exact
+    float start_col = (float)start - 1.0f;
+    if (start_col < (float)gc) start_col = (float)gc;
+    job->layer = layer;
+    job->owner = env;
+    job->bpm = env->atomics->bpm;
+    job->start_col = start_col;
+    war_env* r = job->render;
+    r->atomics->bpm = env->atomics->bpm;
+    r->ctx_wayland->gutter_rows = env->ctx_wayland->gutter_rows;
+    r->ctx_wayland->gutter_cols = env->ctx_wayland->gutter_cols;
+    // the render starts at the bounce note, not at the top of the song
+    for (uint32_t i = 0; i < nc->instance_count; i++) {
+        war_new_vulkan_note_instance* note = &nc->instance[i];
+        if (!_war_freeze_note_on(note, layer)) continue;
+        job->notes[job->note_count++] = *note;
+        if (note->pos[0] < gc || note->pos[1] < gr) continue;
+        war_new_vulkan_note_instance* dst = &r->ctx_note->instance[r->ctx_note->instance_count++];
+        *dst = *note;
+        dst->pos[0] = (float)((double)note->pos[0] - (double)start_col + gc);
+    }
+    job->lead = (uint64_t)(gc * (15.0 / bpm) * WAR_RENDER_RATE);
+    for (uint32_t p = 0; p < 128; p++) {
+        uint32_t idx = p * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
+        war_capture_slot* s = &r->capture_slots[idx];
+        *s = env->capture_slots[idx];
+        war_sample_buf_ref(s->buf);
+        s->root = 0;
+    }
+    return job;
+}
+
+// worker: hands the finished job back to the main thread; the last thing
+// it does, so war_freeze_poll's join returns at once
+static inline void war_freeze_done(war_freeze_job* job) {
+    war_env* env = job->owner;
+    pthread_mutex_lock(&env->freeze_mutex);
+    job->next = env->freeze_done;
+    env->freeze_done = job;
+    env->freeze_running--;
+    pthread_cond_signal(&env->freeze_cond);
+    pthread_mutex_unlock(&env->freeze_mutex);
+}
+
+// the layer's notes and slots are still the ones job rendered
+static inline int _war_freeze_unchanged(war_env* env, const war_freeze_job* job) {
+    if (env->atomics->bpm != job->bpm) return 0;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < env->ctx_note->instance_count; i++) {
+        const war_new_vulkan_note_instance* a = &env->ctx_note->instance[i];
+        if (!_war_freeze_note_on(a, job->layer)) continue;
+        if (k == job->note_count) return 0;
+        const war_new_vulkan_note_instance* b = &job->notes[k++];
+        if (a->tick != b->tick || a->flags != b->flags || a->pos[0] != b->pos[0] || a->pos[1] != b->pos[1] ||
+            a->size[0] != b->size[0])
+            return 0;
+    }
+    if (k != job->note_count) return 0;
+    for (uint32_t p = 0; p < 128; p++) {
+        uint32_t idx = p * WAR_CAPTURE_SLOT_LAYERS + (job->layer - 1);
+        const war_capture_slot* a = &env->capture_slots[idx];
+        const war_capture_slot* b = &job->render->capture_slots[idx];
+        if (a->samples != b->samples || a->count != b->count || a->gain != b->gain || a->pan != b->pan ||
+            a->eq1 != b->eq1 || a->eq2 != b->eq2 || a->attack != b->attack || a->sustain != b->sustain ||
+            a->release != b->release || a->effect_flags != b->effect_flags || a->transpose != b->transpose ||
+            memcmp(a->effect_params, b->effect_params, sizeof(a->effect_params)) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+// swaps layer's notes for the bounce in job. 0 (status_msg set) when it can't.
+static inline int _war_freeze_install(war_env* env, war_freeze_job* job) {
+    uint32_t layer = job->layer;
+    war_freeze_state* fz = &env->freeze[layer - 1];
+    war_note_context* nc = env->ctx_note;
+    uint32_t pitch = UINT32_MAX;
+    for (uint32_t p = 128; p-- > 0;) {
+        war_capture_slot* s = &env->capture_slots[p * WAR_CAPTURE_SLOT_LAYERS + (layer - 1)];
+        if (!s->samples || s->count < 2) {
+            pitch = p;
+            break;
+        }
+    }
+    if (pitch == UINT32_MAX) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: layer %u has no free slot", layer);
+        return 0;
+    }
+    uint32_t idx = pitch * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
+    war_undo_audio* audio = war_undo_audio_snapshot(env, &idx, 1);
+    if (!audio) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: out of memory");
+        return 0;
+    }
+    war_undo_save(env);
+    uint32_t audio_idx = env->undo_pos - 1;
+    war_undo_audio_free(env->undo_audio[audio_idx]);
+    env->undo_audio[audio_idx] = audio;
+
+    war_capture_slot* s = &env->capture_slots[idx];
+    fz->slot_was = *s;
+    fz->slot_was.buf = NULL;
+    fz->slot_was.samples = NULL;
+    fz->slot_was.count = 0;
+    fz->slot_was.capacity = 0;
+    fz->slot_was.root = 0;
+    uint64_t frames = job->count / 2;
+    if (!war_slot_adopt(s, job->out, job->count)) {
+        job->out = NULL;
+        *s = fz->slot_was;
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: out of memory");
+        return 0;
+    }
+    job->out = NULL;
+    // everything is in the bounce already; the gain undoes the center pan law
+    s->gain = 500000.0f * ((float)M_SQRT2 - 1.0f);
+    s->pan = 0;
+    s->eq1 = 0;
+    s->eq2 = 0;
+    s->attack = 0.0f;
+    s->sustain = 0.0f;
+    s->release = 0.0f;
+    s->effect_flags = 0;
+    memset(s->effect_params, 0, sizeof(s->effect_params));
+    s->transpose = 0;
+
+    war_new_vulkan_note_instance bounce = job->notes[0];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < nc->instance_count; i++)
+        if (!_war_freeze_note_on(&nc->instance[i], layer)) nc->instance[kept++] = nc->instance[i];
+    nc->instance_count = kept;
+    double bpm = job->bpm > 0.0f ? job->bpm : 100.0;
+    bounce.pos[0] = (float)job->start_col;
+    bounce.pos[1] = (float)((double)pitch + (double)env->ctx_wayland->gutter_rows);
+    bounce.size[0] = (float)ceil((double)frames / ((15.0 / bpm) * WAR_RENDER_RATE));
+    bounce.tick = nc->tick_counter++;
+    nc->instance[nc->instance_count++] = bounce;
+
+    fz->state = WAR_FREEZE_FROZEN;
+    fz->slot = idx;
+    fz->tick = bounce.tick;
+    fz->samples = s->samples;
+    fz->notes = job->notes;
+    fz->note_count = job->note_count;
+    job->notes = NULL;
+    snprintf(env->status_msg, sizeof(env->status_msg), "froze layer %u: %u notes -> pitch %u (%.1fs)", layer,
+             fz->note_count, pitch, (double)frames / WAR_RENDER_RATE);
+    call_king_terry("FREEZE: layer %u, %u notes -> slot %u, %lu frames", layer, fz->note_count, idx,
+                    (unsigned long)frames);
+    return 1;
+}
+
+// main thread: installs finished renders. Returns how many.
+static inline uint32_t war_freeze_poll(war_env* env) {
+    if (!env->freeze_done) return 0; // racy peek, rechecked under lock
+    pthread_mutex_lock(&env->freeze_mutex);
+    war_freeze_job* job = env->freeze_done;
+    env->freeze_done = NULL;
+    pthread_mutex_unlock(&env->freeze_mutex);
+    uint32_t installed = 0;
+    while (job) {
+        war_freeze_job* next = job->next;
+        uint32_t layer = job->layer;
+        war_freeze_state* fz = &env->freeze[layer - 1];
+        if (fz->state == WAR_FREEZE_RENDERING && fz->gen == job->gen) {
+            fz->state = 0;
+            if (!job->out)
+                snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: layer %u: %s", layer,
+                         job->error);
+            else if (!_war_freeze_unchanged(env, job))
+                snprintf(env->status_msg, sizeof(env->status_msg),
+                         "freeze: layer %u changed while rendering, :freeze %u again", layer, layer);
+            else if (env->ctx_note->instance_count - job->note_count >= env->ctx_note->max_instances)
+                snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: too many notes");
+            else
+                installed += (uint32_t)_war_freeze_install(env, job);
+        }
+        pthread_join(job->thread, NULL);
+        war_freeze_job_free(job);
+        job = next;
+    }
+    return installed;
+}
+
+// :unfreeze <layer>: the original notes back in place of the bounce
+static inline void war_unfreeze(war_env* env, uint32_t layer) {
+    war_freeze_state* fz = &env->freeze[layer - 1];
+    war_note_context* nc = env->ctx_note;
+    if (fz->state == WAR_FREEZE_RENDERING) {
+        _war_freeze_forget(env, layer);
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze of layer %u cancelled", layer);
+        return;
+    }
+    int b = war_freeze_bounce_note(env, layer);
+    if (b < 0) {
+        // never frozen, or the freeze was undone and the notes are back already
+        _war_freeze_forget(env, layer);
+        snprintf(env->status_msg, sizeof(env->status_msg), "unfreeze: layer %u is not frozen", layer);
+        return;
+    }
+    if (nc->instance_count - 1 + fz->note_count > nc->max_instances) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "unfreeze FAILED: too many notes");
+        return;
+    }
+    war_undo_audio* audio = war_undo_audio_snapshot(env, &fz->slot, 1);
+    if (!audio) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "unfreeze FAILED: out of memory");
+        return;
+    }
+    war_undo_save(env);
+    uint32_t audio_idx = env->undo_pos - 1;
+    war_undo_audio_free(env->undo_audio[audio_idx]);
+    env->undo_audio[audio_idx] = audio;
+    nc->instance[b] = nc->instance[--nc->instance_count];
+    memcpy(&nc->instance[nc->instance_count], fz->notes, sizeof(war_new_vulkan_note_instance) * fz->note_count);
+    nc->instance_count += fz->note_count;
+    uint32_t n = fz->note_count;
+    _war_freeze_forget(env, layer);
+    snprintf(env->status_msg, sizeof(env->status_msg), "unfroze layer %u: %u notes", layer, n);
+}
+
+// stops renders in flight at their next note and joins every worker, so
+// none is left to report into a torn-down env
+static inline void war_freeze_shutdown(war_env* env) {
+    for (uint32_t l = 1; l <= 9; l++) env->freeze[l - 1].gen++;
+    atomic_store_explicit(&env->freeze_cancel, 1, memory_order_relaxed);
+    pthread_mutex_lock(&env->freeze_mutex);
+    while (env->freeze_running) pthread_cond_wait(&env->freeze_cond, &env->freeze_mutex);
+    pthread_mutex_unlock(&env->freeze_mutex);
+    war_freeze_poll(env);
+    for (uint32_t l = 1; l <= 9; l++) {
+        free(env->freeze[l - 1].notes);
+        env->freeze[l - 1].notes = NULL;
+    }
+    pthread_cond_destroy(&env->freeze_cond);
+    pthread_mutex_destroy(&env->freeze_mutex);
+}
+
+#endif // WAR_FREEZE_H
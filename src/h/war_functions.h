@@ -18,7 +18,9 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <dlfcn.h>
+#include <errno.h>
 #include <float.h>
 #include <luajit-2.1/lauxlib.h>
 #include <luajit-2.1/lua.h>
@@ -29,7 +31,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 #include <xkbcommon/xkbcommon.h>
@@ -448,11 +452,10 @@ static inline void war_key() {
 
 static inline void* war_pool_alloc_new(war_pool_context* ctx_pool,
                                        war_pool_id id) {
-    for (uint32_t i = 0; i < ctx_pool->count; i++) {
-        if (ctx_pool->id[i] == id) {
-            assert(ctx_pool->pool + ctx_pool->offset[i]);
-            return ctx_pool->pool + ctx_pool->offset[i];
-        }
+    uint32_t i = id < WAR_POOL_ID_COUNT ? ctx_pool->index[id] : 0;
+    if (i) {
+        assert(ctx_pool->pool + ctx_pool->offset[i - 1]);
+        return ctx_pool->pool + ctx_pool->offset[i - 1];
     }
     call_king_terry("no pool id found");
     return NULL;
@@ -460,9 +463,8 @@ static inline void* war_pool_alloc_new(war_pool_context* ctx_pool,
 
 static inline uint64_t war_pool_size(war_pool_context* ctx_pool,
                                      war_pool_id id) {
-    for (uint32_t i = 0; i < ctx_pool->count; i++) {
-        if (ctx_pool->id[i] == id) { return ctx_pool->size[i]; }
-    }
+    uint32_t i = id < WAR_POOL_ID_COUNT ? ctx_pool->index[id] : 0;
+    if (i) { return ctx_pool->size[i - 1]; }
     call_king_terry("no pool size found");
     return 0;
 }
@@ -1290,7 +1292,224 @@ war_path_to_unique_filename(const char* path, char* out, size_t out_size) {
     out[j] = '\0';
 }
 
-static inline void war_override(uint32_t count, war_hot_id* id, war_env* env) {
+// walk DIR_CONFIG once and collect every .c as a hot source; the .so path
+// is the source path with '/' replaced by '%' so it stays unique
+static inline uint32_t war_hot_scan(const char* config_dir,
+                                    const char* override_dir,
+                                    war_hot_source** out) {
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    war_hot_source* sources = NULL;
+
+    char(*dirs)[4096] = malloc(128 * sizeof(*dirs));
+    if (!dirs) {
+        *out = NULL;
+        return 0;
+    }
+    int stack_top = 0;
+    strncpy(dirs[stack_top++], config_dir, sizeof(dirs[0]) - 1);
+    dirs[0][sizeof(dirs[0]) - 1] = '\0';
+
+    while (stack_top > 0) {
+        char current_dir[4096];
+        memcpy(current_dir, dirs[--stack_top], sizeof(current_dir));
+        DIR* directory = opendir(current_dir);
+        if (!directory) continue;
+
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 ||
+                strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            char full_path[4096];
+            snprintf(full_path,
+                     sizeof(full_path),
+                     "%s/%s",
+                     current_dir,
+                     entry->d_name);
+
+            // d_type saves a stat per entry on filesystems that report it
+            int is_dir = entry->d_type == DT_DIR;
+            int is_reg = entry->d_type == DT_REG;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat st;
+                if (stat(full_path, &st) != 0) continue;
+                is_dir = S_ISDIR(st.st_mode);
+                is_reg = S_ISREG(st.st_mode);
+            }
+
+            if (is_dir) {
+                if (stack_top < 128) {
+                    strncpy(dirs[stack_top], full_path, sizeof(dirs[0]) - 1);
+                    dirs[stack_top][sizeof(dirs[0]) - 1] = '\0';
+                    stack_top++;
+                }
+                continue;
+            }
+
+            size_t name_len = strlen(entry->d_name);
+            if (!is_reg || name_len <= 2 ||
+                strcmp(entry->d_name + name_len - 2, ".c") != 0)
+                continue;
+
+            if (count == capacity) {
+                uint32_t new_capacity = capacity ? capacity * 2 : 16;
+                war_hot_source* tmp =
+                    realloc(sources, new_capacity * sizeof(war_hot_source));
+                if (!tmp) break;
+                sources = tmp;
+                capacity = new_capacity;
+            }
+            war_hot_source* src = &sources[count++];
+            memset(src, 0, sizeof(*src));
+            snprintf(src->src_path, sizeof(src->src_path), "%s", full_path);
+
+            char unique_name[4096];
+            war_path_to_unique_filename(
+                full_path, unique_name, sizeof(unique_name));
+            snprintf(src->so_path,
+                     sizeof(src->so_path),
+                     "%s/%.4000s.so",
+                     override_dir,
+                     unique_name);
+            snprintf(src->hash_path,
+                     sizeof(src->hash_path),
+                     "%s/%.4000s.hash",
+                     override_dir,
+                     unique_name);
+        }
+        closedir(directory);
+    }
+
+    free(dirs);
+    *out = sources;
+    return count;
+}
+
+// hash source contents together with the compile template so that a
+// template change (flags, libs) also invalidates the cached .so
+static inline int war_hot_hash(war_hot_source* src, const char* template) {
+    FILE* f = fopen(src->src_path, "rb");
+    if (!f) return 0;
+
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, crypto_generichash_BYTES);
+    crypto_generichash_update(
+        &state, (const uint8_t*)template, strlen(template));
+    uint8_t buf[16384];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        crypto_generichash_update(&state, buf, n);
+    fclose(f);
+
+    uint8_t digest[crypto_generichash_BYTES];
+    crypto_generichash_final(&state, digest, sizeof(digest));
+    sodium_bin2hex(src->hash, sizeof(src->hash), digest, sizeof(digest));
+    return 1;
+}
+
+// a source is stale when its .so is missing or the stored hash differs
+static inline void war_hot_check(war_hot_source* src) {
+    src->stale = 1;
+    struct stat st_so;
+    if (stat(src->so_path, &st_so) != 0) return;
+
+    FILE* f = fopen(src->hash_path, "r");
+    if (!f) return;
+    char cached[sizeof(src->hash)] = {0};
+    size_t n = fread(cached, 1, sizeof(cached) - 1, f);
+    fclose(f);
+    cached[n] = '\0';
+    if (strcmp(cached, src->hash) == 0) src->stale = 0;
+}
+
+// fork one compiler per stale source, at most `jobs` in flight; each build
+// writes to <so>.tmp and is renamed into place so a failed or interrupted
+// compile never leaves a truncated .so behind
+static inline void
+war_hot_compile(war_hot_source* sources, uint32_t count, uint32_t jobs,
+                const char* template) {
+    if (jobs == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = ncpu > 0 ? (uint32_t)ncpu : 1;
+    }
+
+    uint32_t running = 0;
+    uint32_t next = 0;
+    while (next < count || running > 0) {
+        while (next < count && running < jobs) {
+            war_hot_source* src = &sources[next++];
+            if (!src->stale) continue;
+
+            char tmp_path[4096 + 8];
+            snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", src->so_path);
+            char cmd[8192 + 4096];
+            snprintf(cmd, sizeof(cmd), template, src->src_path, tmp_path);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+                _exit(127);
+            }
+            if (pid < 0) {
+                call_king_terry("fork failed: %s", strerror(errno));
+                src->stale = 0;
+                src->pid = 0;
+                continue;
+            }
+            src->pid = pid;
+            running++;
+        }
+        if (running == 0) break;
+
+        // only our own compilers: the process has other children (demucs,
+        // the mp3 encoder) whose callers reap them
+        int status = 0;
+        pid_t done = 0;
+        pid_t first = 0;
+        for (uint32_t i = 0; i < count && !done; i++) {
+            if (!sources[i].pid) continue;
+            if (!first) first = sources[i].pid;
+            pid_t r = waitpid(sources[i].pid, &status, WNOHANG);
+            if (r > 0) done = r;
+        }
+        if (!done) done = waitpid(first, &status, 0);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            war_hot_source* src = &sources[i];
+            if (src->pid != done) continue;
+            src->pid = 0;
+            running--;
+
+            char tmp_path[4096 + 8];
+            snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", src->so_path);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                call_king_terry("hot compile failed: %s", src->src_path);
+                unlink(tmp_path);
+                break;
+            }
+            if (rename(tmp_path, src->so_path) != 0) {
+                call_king_terry("hot rename failed: %s", src->so_path);
+                break;
+            }
+            src->stale = 0;
+            FILE* f = fopen(src->hash_path, "w");
+            if (f) {
+                fputs(src->hash, f);
+                fclose(f);
+            }
+            break;
+        }
+    }
+}
+
+// rebuilds stale override sources and rebinds the ids in id[]; returns how
+// many sources failed to hash, compile or dlopen (their ids keep defaults)
+static inline uint32_t war_override(uint32_t count, war_hot_id* id, war_env* env) {
     war_hot_context* hot = env->ctx_hot;
     war_color_context* color = env->ctx_color;
     war_pool_context* pool = env->ctx_pool;
@@ -1299,205 +1518,262 @@ static inline void war_override(uint32_t count, war_hot_id* id, war_env* env) {
     war_keymap_context* keymap = env->ctx_keymap;
 
     for (uint32_t idx = 0; idx < count; idx++) {
-        char tmp_dir[4096] = {0};
-        char override_dir[4096] = {0};
-
         if (hot->handle[id[idx]]) {
             dlclose(hot->handle[id[idx]]);
             hot->handle[id[idx]] = NULL;
-            hot->function[id[idx]] = NULL;
         }
+        hot->function[id[idx]] = NULL;
+        hot->source[id[idx]][0] = '\0';
+    }
 
-        // -----------------------------
-        // Expand directories inline
-        // -----------------------------
-        {
-            size_t j = 0;
-            for (size_t i = 0; config->DIR_CONFIG[i] && j < sizeof(tmp_dir) - 1;
-                 i++) {
-                if (config->DIR_CONFIG[i] == '$') {
-                    size_t start = i + 1, end = start;
-                    while ((config->DIR_CONFIG[end] >= 'A' &&
-                            config->DIR_CONFIG[end] <= 'Z') ||
-                           (config->DIR_CONFIG[end] >= 'a' &&
-                            config->DIR_CONFIG[end] <= 'z') ||
-                           (config->DIR_CONFIG[end] >= '0' &&
-                            config->DIR_CONFIG[end] <= '9') ||
-                           config->DIR_CONFIG[end] == '_')
-                        end++;
-                    char varname[64] = {0};
-                    size_t len = end - start;
-                    if (len >= sizeof(varname)) len = sizeof(varname) - 1;
-                    memcpy(varname, config->DIR_CONFIG + start, len);
-                    char* val = getenv(varname);
-                    if (val) {
-                        size_t vlen = strlen(val);
-                        if (j + vlen >= sizeof(tmp_dir) - 1)
-                            vlen = sizeof(tmp_dir) - 1 - j;
-                        memcpy(tmp_dir + j, val, vlen);
-                        j += vlen;
-                    }
-                    i = end - 1;
-                } else
-                    tmp_dir[j++] = config->DIR_CONFIG[i];
-            }
-            tmp_dir[j] = '\0';
+    char config_dir[4096] = {0};
+    char override_dir[4096] = {0};
+    war_expand_env(config->DIR_CONFIG, config_dir, sizeof(config_dir));
+    war_expand_env(config->DIR_OVERRIDE, override_dir, sizeof(override_dir));
+
+    // -----------------------------
+    // One scan, one hash per source, parallel rebuild of stale ones
+    // -----------------------------
+    war_hot_source* sources = NULL;
+    uint32_t source_count = war_hot_scan(config_dir, override_dir, &sources);
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < source_count; i++) {
+        if (!war_hot_hash(&sources[i], config->HOT_CONTEXT_TEMPLATE)) {
+            sources[i].so_path[0] = '\0';
+            failed++;
+            continue;
+        }
+        war_hot_check(&sources[i]);
+    }
+    war_hot_compile(sources,
+                    source_count,
+                    config->HOT_CONTEXT_JOBS,
+                    config->HOT_CONTEXT_TEMPLATE);
+
+    // -----------------------------
+    // dlopen each .so once and resolve every requested symbol from it
+    // -----------------------------
+    for (uint32_t i = 0; i < source_count; i++) {
+        war_hot_source* src = &sources[i];
+        if (!src->so_path[0]) continue;
+        if (src->stale) {
+            failed++; // war_hot_compile logged why
+            continue;
         }
 
-        {
-            size_t j = 0;
-            for (size_t i = 0;
-                 config->DIR_OVERRIDE[i] && j < sizeof(override_dir) - 1;
-                 i++) {
-                if (config->DIR_OVERRIDE[i] == '$') {
-                    size_t start = i + 1, end = start;
-                    while ((config->DIR_OVERRIDE[end] >= 'A' &&
-                            config->DIR_OVERRIDE[end] <= 'Z') ||
-                           (config->DIR_OVERRIDE[end] >= 'a' &&
-                            config->DIR_OVERRIDE[end] <= 'z') ||
-                           (config->DIR_OVERRIDE[end] >= '0' &&
-                            config->DIR_OVERRIDE[end] <= '9') ||
-                           config->DIR_OVERRIDE[end] == '_')
-                        end++;
-                    char varname[64] = {0};
-                    size_t len = end - start;
-                    if (len >= sizeof(varname)) len = sizeof(varname) - 1;
-                    memcpy(varname, config->DIR_OVERRIDE + start, len);
-                    char* val = getenv(varname);
-                    if (val) {
-                        size_t vlen = strlen(val);
-                        if (j + vlen >= sizeof(override_dir) - 1)
-                            vlen = sizeof(override_dir) - 1 - j;
-                        memcpy(override_dir + j, val, vlen);
-                        j += vlen;
-                    }
-                    i = end - 1;
-                } else
-                    override_dir[j++] = config->DIR_OVERRIDE[i];
-            }
-            override_dir[j] = '\0';
+        void* handle = dlopen(src->so_path, RTLD_NOW | RTLD_GLOBAL);
+        if (!handle) {
+            call_king_terry("dlopen failed: %s", dlerror());
+            failed++;
+            continue;
         }
 
-        // -----------------------------
-        // Iterative recursion (stack) inline
-        // -----------------------------
-        char dirs[128][4096];
-        int stack_top = 0;
-        strncpy(dirs[stack_top++], tmp_dir, sizeof(dirs[0]) - 1);
-
-        while (stack_top > 0) {
-            char* current_dir = dirs[--stack_top];
-            DIR* directory = opendir(current_dir);
-            if (!directory) continue;
-
-            struct dirent* entry;
-            while ((entry = readdir(directory)) != NULL) {
-                if (strcmp(entry->d_name, ".") == 0 ||
-                    strcmp(entry->d_name, "..") == 0)
-                    continue;
-
-                char full_path[4096];
-                snprintf(full_path,
-                         sizeof(full_path),
-                         "%s/%s",
-                         current_dir,
-                         entry->d_name);
+        uint32_t bound = 0;
+        for (uint32_t idx = 0; idx < count; idx++) {
+            dlerror();
+            void* fn = dlsym(handle, hot->name[id[idx]]);
+            if (dlerror() || !fn) continue;
+            // every id owns one reference so dlclose per id stays balanced
+            if (bound++) dlopen(src->so_path, RTLD_NOW | RTLD_GLOBAL);
+            if (hot->handle[id[idx]]) dlclose(hot->handle[id[idx]]);
+            hot->handle[id[idx]] = handle;
+            hot->function[id[idx]] = fn;
+            snprintf(hot->source[id[idx]],
+                     sizeof(hot->source[0]),
+                     "%s",
+                     src->src_path);
+        }
+        if (!bound) dlclose(handle);
+    }
+    free(sources);
 
+    // -----------------------------
+    // Call function inline
+    // -----------------------------
+    for (uint32_t idx = 0; idx < count; idx++) {
+        if (!hot->function[id[idx]]) continue;
+        switch (id[idx]) {
+        case WAR_HOT_ID_CONFIG:
+            ((void (*)(war_config_context*))hot->function[id[idx]])(config);
+            break;
+        case WAR_HOT_ID_COMMAND:
+            ((void (*)(war_command_context*,
+                       war_config_context*))hot->function[id[idx]])(command,
+                                                                    config);
+            break;
+        case WAR_HOT_ID_COLOR:
+            ((void (*)(war_color_context*))hot->function[id[idx]])(color);
+            break;
+        case WAR_HOT_ID_PLUGIN:
+            ((void (*)(war_env*))hot->function[id[idx]])(env);
+            break;
+        case WAR_HOT_ID_POOL:
+            ((void (*)(war_pool_context*,
+                       war_config_context*))hot->function[id[idx]])(pool,
+                                                                    config);
+            break;
+        case WAR_HOT_ID_KEYMAP:
+            ((void (*)(war_keymap_context*,
+                       war_config_context*))hot->function[id[idx]])(keymap,
+                                                                    config);
+            break;
+        }
+    }
+    return failed;
+}
+
+//-----------------------------------------------------------------------------
+// live reload: inotify on DIR_CONFIG, drained from the main poll loop
+//-----------------------------------------------------------------------------
+#define WAR_HOT_WATCH_MASK                                                     \
+    (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE)
+
+static inline void war_hot_watch_add(war_hot_context* hot, const char* dir) {
+    if (hot->watch_fd < 0 || hot->watch_count >= WAR_HOT_WATCH_MAX) return;
+    int wd = inotify_add_watch(hot->watch_fd, dir, WAR_HOT_WATCH_MASK);
+    if (wd < 0) {
+        call_king_terry("inotify_add_watch failed: %s (%s)",
+                        dir,
+                        strerror(errno));
+        return;
+    }
+    for (uint32_t i = 0; i < hot->watch_count; i++)
+        if (hot->watch_wd[i] == wd) return;
+    hot->watch_wd[hot->watch_count] = wd;
+    snprintf(hot->watch_dir[hot->watch_count],
+             sizeof(hot->watch_dir[0]),
+             "%s",
+             dir);
+    hot->watch_count++;
+}
+
+static inline void war_hot_watch_tree(war_hot_context* hot, const char* root) {
+    char(*dirs)[4096] = malloc(128 * sizeof(*dirs));
+    if (!dirs) return;
+    int stack_top = 0;
+    snprintf(dirs[stack_top++], sizeof(dirs[0]), "%s", root);
+    while (stack_top > 0) {
+        char current_dir[4096];
+        memcpy(current_dir, dirs[--stack_top], sizeof(current_dir));
+        war_hot_watch_add(hot, current_dir);
+        DIR* directory = opendir(current_dir);
+        if (!directory) continue;
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 ||
+                strcmp(entry->d_name, "..") == 0)
+                continue;
+            char full_path[4096];
+            snprintf(full_path,
+                     sizeof(full_path),
+                     "%s/%s",
+                     current_dir,
+                     entry->d_name);
+            int is_dir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN) {
                 struct stat st;
-                if (stat(full_path, &st) != 0) continue;
+                is_dir = stat(full_path, &st) == 0 && S_ISDIR(st.st_mode);
+            }
+            if (is_dir && stack_top < 128)
+                snprintf(dirs[stack_top++], sizeof(dirs[0]), "%s", full_path);
+        }
+        closedir(directory);
+    }
+    free(dirs);
+}
+
+static inline void war_hot_watch_init(war_hot_context* hot,
+                                      war_config_context* config) {
+    hot->watch_count = 0;
+    hot->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hot->watch_fd < 0) {
+        call_king_terry("inotify_init1 failed: %s", strerror(errno));
+        return;
+    }
+    hot->watch_dir = calloc(WAR_HOT_WATCH_MAX, sizeof(*hot->watch_dir));
+    if (!hot->watch_dir) {
+        close(hot->watch_fd);
+        hot->watch_fd = -1;
+        return;
+    }
+    char config_dir[4096] = {0};
+    war_expand_env(config->DIR_CONFIG, config_dir, sizeof(config_dir));
+    war_hot_watch_tree(hot, config_dir);
+}
+
+static inline void war_hot_watch_free(war_hot_context* hot) {
+    if (hot->watch_fd >= 0) close(hot->watch_fd);
+    hot->watch_fd = -1;
+    hot->watch_count = 0;
+    free(hot->watch_dir);
+    hot->watch_dir = NULL;
+}
 
-                if (S_ISDIR(st.st_mode)) {
-                    if (stack_top < 128)
-                        strncpy(
-                            dirs[stack_top++], full_path, sizeof(dirs[0]) - 1);
-                } else if (strlen(entry->d_name) > 2 &&
-                           strcmp(entry->d_name + strlen(entry->d_name) - 2,
-                                  ".c") == 0) {
-                    // ------------------------------------------
-                    // 3) Unique .so path inline
-                    // ------------------------------------------
-                    char unique_name[4096];
-                    size_t j = 0;
-                    for (size_t i = 0;
-                         full_path[i] && j < sizeof(unique_name) - 1;
-                         i++)
-                        unique_name[j++] =
-                            (full_path[i] == '/') ? '%' : full_path[i];
-                    unique_name[j] = '\0';
-
-                    char sopath[4096];
-                    snprintf(sopath,
-                             sizeof(sopath),
-                             "%s/%s.so",
-                             override_dir,
-                             unique_name);
-
-                    struct stat st_so;
-                    int so_exists = (stat(sopath, &st_so) == 0);
-                    int recompile = 1;
-                    if (st.st_mtime <= st_so.st_mtime) recompile = 0;
-
-                    if (recompile) {
-                        char cmd[8192];
-                        snprintf(cmd,
-                                 sizeof(cmd),
-                                 config->HOT_CONTEXT_TEMPLATE,
-                                 full_path,
-                                 sopath);
-                        int rc = system(cmd);
-                        if (rc != 0) continue;
-                    }
-
-                    void* handle = dlopen(sopath, RTLD_NOW | RTLD_GLOBAL);
-                    if (!handle) continue;
-
-                    dlerror();
-                    void* fn = dlsym(handle, hot->name[id[idx]]);
-                    char* err = dlerror();
-                    if (err) {
-                        dlclose(handle);
-                        continue;
-                    }
-
-                    hot->handle[id[idx]] = handle;
-                    hot->function[id[idx]] = fn;
+// drain pending inotify events and return the hot ids touched by changed
+// .c files: ids previously resolved from that file plus any id whose symbol
+// name now appears in it. a burst of editor events collapses to one set
+static inline uint32_t war_hot_watch_read(war_hot_context* hot,
+                                          war_hot_id* out) {
+    uint32_t mask = 0;
+    if (hot->watch_fd < 0) return 0;
+
+    uint8_t buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t len = read(hot->watch_fd, buf, sizeof(buf));
+        if (len <= 0) break;
+        for (uint8_t* p = buf; p < buf + len;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (!ev->len) continue;
+
+            const char* dir = NULL;
+            for (uint32_t i = 0; i < hot->watch_count; i++) {
+                if (hot->watch_wd[i] == ev->wd) {
+                    dir = hot->watch_dir[i];
+                    break;
                 }
             }
-            closedir(directory);
-        }
+            if (!dir) continue;
 
-        // -----------------------------
-        // Call function inline
-        // -----------------------------
-        if (hot->function[id[idx]]) {
-            switch (id[idx]) {
-            case WAR_HOT_ID_CONFIG:
-                ((void (*)(war_config_context*))hot->function[id[idx]])(config);
-                break;
-            case WAR_HOT_ID_COMMAND:
-                ((void (*)(war_command_context*,
-                           war_config_context*))hot->function[id[idx]])(command,
-                                                                        config);
-                break;
-            case WAR_HOT_ID_COLOR:
-                ((void (*)(war_color_context*))hot->function[id[idx]])(color);
-                break;
-            case WAR_HOT_ID_PLUGIN:
-                ((void (*)(war_env*))hot->function[id[idx]])(env);
-                break;
-            case WAR_HOT_ID_POOL:
-                ((void (*)(war_pool_context*,
-                           war_config_context*))hot->function[id[idx]])(pool,
-                                                                        config);
-                break;
-            case WAR_HOT_ID_KEYMAP:
-                ((void (*)(war_keymap_context*,
-                           war_config_context*))hot->function[id[idx]])(keymap,
-                                                                        config);
-                break;
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", dir, ev->name);
+
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                    war_hot_watch_tree(hot, path);
+                continue;
             }
+            size_t name_len = strlen(ev->name);
+            if (name_len <= 2 || strcmp(ev->name + name_len - 2, ".c") != 0)
+                continue;
+            if (ev->mask & IN_CREATE) continue; // wait for IN_CLOSE_WRITE
+
+            for (uint32_t i = 0; i < WAR_HOT_ID_COUNT; i++)
+                if (strcmp(hot->source[i], path) == 0) mask |= 1u << i;
+
+            FILE* f = fopen(path, "r");
+            if (!f) continue;
+            fseek(f, 0, SEEK_END);
+            long size = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            char* text = size > 0 ? malloc((size_t)size + 1) : NULL;
+            if (text) {
+                size_t n = fread(text, 1, (size_t)size, f);
+                text[n] = '\0';
+                for (uint32_t i = 0; i < WAR_HOT_ID_COUNT; i++)
+                    if (hot->name[i] && strstr(text, hot->name[i]))
+                        mask |= 1u << i;
+                free(text);
+            }
+            fclose(f);
         }
     }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < WAR_HOT_ID_COUNT; i++)
+        if (mask & (1u << i)) out[count++] = i;
+    return count;
 }
 
 #endif // WAR_FUNCTIONS_H
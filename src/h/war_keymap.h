@@ -19,6 +19,90 @@
 #include "war_data.h"
 #include "war_functions.h"
 
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WAR_KEYMAP_EDGE_EMPTY UINT64_MAX
+
+// transitions are sparse (a few hundred edges against mode x state x keysym
+// x mod cells), so they live in a small linear-probed table keyed on the
+// packed tuple instead of a dense next_state array
+static inline uint64_t war_keymap_edge_key(uint32_t mode,
+                                           uint64_t state,
+                                           uint32_t keysym,
+                                           uint32_t mod) {
+    return ((uint64_t)(mode & 0xFF) << 56) | ((state & 0xFFFF) << 40) |
+           ((uint64_t)keysym << 8) | (mod & 0xFF);
+}
+
+static inline uint32_t war_keymap_edge_slot(uint64_t key, uint32_t capacity) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+static inline uint64_t war_keymap_next(war_keymap_context* keymap,
+                                       war_config_context* config,
+                                       uint32_t mode,
+                                       uint64_t state,
+                                       uint32_t keysym,
+                                       uint32_t mod) {
+    uint64_t key = war_keymap_edge_key(mode, state, keysym, mod);
+    uint32_t mask = config->KEYMAP_EDGE_CAPACITY - 1;
+    uint32_t i = war_keymap_edge_slot(key, config->KEYMAP_EDGE_CAPACITY);
+    for (;;) {
+        uint64_t k = keymap->edge_key[i];
+        if (k == key) return keymap->edge_next[i];
+        if (k == WAR_KEYMAP_EDGE_EMPTY) return 0;
+        i = (i + 1) & mask;
+    }
+}
+
+// returns 0 when the table is full (kept below 3/4 load so probes stay short)
+static inline int war_keymap_edge_insert(war_keymap_context* keymap,
+                                         war_config_context* config,
+                                         uint64_t key,
+                                         uint32_t next_state) {
+    if (keymap->edge_count >= config->KEYMAP_EDGE_CAPACITY / 4 * 3) {
+        call_king_terry("war_keymap_set: KEYMAP_EDGE_CAPACITY reached");
+        return 0;
+    }
+    uint32_t mask = config->KEYMAP_EDGE_CAPACITY - 1;
+    uint32_t i = war_keymap_edge_slot(key, config->KEYMAP_EDGE_CAPACITY);
+    while (keymap->edge_key[i] != WAR_KEYMAP_EDGE_EMPTY) {
+        if (keymap->edge_key[i] == key) {
+            keymap->edge_next[i] = next_state;
+            return 1;
+        }
+        i = (i + 1) & mask;
+    }
+    keymap->edge_key[i] = key;
+    keymap->edge_next[i] = next_state;
+    keymap->edge_count++;
+    return 1;
+}
+
+// empty every table and reset each mode to its root state
+static inline void war_keymap_clear(war_keymap_context* keymap,
+                                    war_config_context* config) {
+    size_t states = (size_t)config->KEYMAP_MODE_CAPACITY *
+                    config->KEYMAP_STATE_CAPACITY;
+    size_t functions = states * config->KEYMAP_FUNCTION_CAPACITY;
+    memset(keymap->function_id, 0, functions * sizeof(war_function_id));
+    memset(keymap->function, 0, functions * sizeof(void*));
+    memset(keymap->function_count, 0, states * sizeof(uint8_t));
+    memset(keymap->flags, 0, states * sizeof(war_keymap_flags));
+    memset(keymap->edge_key,
+           0xFF,
+           (size_t)config->KEYMAP_EDGE_CAPACITY * sizeof(uint64_t));
+    memset(keymap->edge_next,
+           0,
+           (size_t)config->KEYMAP_EDGE_CAPACITY * sizeof(uint32_t));
+    keymap->edge_count = 0;
+    for (uint32_t i = 0; i < config->KEYMAP_MODE_CAPACITY; i++)
+        keymap->state_count[i] = 1;
+}
+
 __attribute__((noinline)) static void
 war_keymap_set(war_keymap_context* keymap,
                war_config_context* config,
@@ -73,16 +157,9 @@ war_keymap_set(war_keymap_context* keymap,
                     continue;
                 }
 
-                // -------- TRANSITION INDEX --------
-                size_t trans_idx =
-                    mode * (config->KEYMAP_STATE_CAPACITY *
-                            config->KEYMAP_KEYSYM_CAPACITY *
-                            config->KEYMAP_MOD_CAPACITY) +
-                    current_state * (config->KEYMAP_KEYSYM_CAPACITY *
-                                     config->KEYMAP_MOD_CAPACITY) +
-                    keysym * config->KEYMAP_MOD_CAPACITY + mod;
-
-                uint64_t next_state = keymap->next_state[trans_idx];
+                // -------- TRANSITION --------
+                uint64_t next_state = war_keymap_next(
+                    keymap, config, mode, current_state, keysym, mod);
 
                 if (!next_state) {
                     if (keymap->state_count[mode] <
@@ -93,7 +170,11 @@ war_keymap_set(war_keymap_context* keymap,
                             config->KEYMAP_STATE_CAPACITY - 1; // overflow
                     }
 
-                    keymap->next_state[trans_idx] = next_state;
+                    war_keymap_edge_insert(
+                        keymap,
+                        config,
+                        war_keymap_edge_key(mode, current_state, keysym, mod),
+                        (uint32_t)next_state);
                 }
 
                 // Mark prefix
@@ -1147,6 +1228,175 @@ static inline void war_keymap_default(war_keymap_context* keymap,
                    0);
 }
 
+//-----------------------------------------------------------------------------
+// default keymap cache: the FSM war_keymap_default builds only depends on
+// the binary and the keymap capacities, so it is parsed once and written
+// to DIR_CACHE/keymap.bin. function pointers are stored as offsets from
+// war_keymap_set so they survive ASLR. overrides are applied on top as usual
+//-----------------------------------------------------------------------------
+static inline void war_keymap_cache_key(war_config_context* config,
+                                        uint8_t* key) {
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, NULL, 0, 32);
+    uint32_t version = WAR_KEYMAP_CACHE_VERSION;
+    crypto_generichash_update(&state, (uint8_t*)&version, sizeof(version));
+    // any rebuild of the binary changes inode/size/mtime
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+        uint64_t id[5] = {(uint64_t)st.st_dev,
+                          (uint64_t)st.st_ino,
+                          (uint64_t)st.st_size,
+                          (uint64_t)st.st_mtim.tv_sec,
+                          (uint64_t)st.st_mtim.tv_nsec};
+        crypto_generichash_update(&state, (uint8_t*)id, sizeof(id));
+    }
+    uint32_t caps[4] = {config->KEYMAP_MODE_CAPACITY,
+                        config->KEYMAP_STATE_CAPACITY,
+                        config->KEYMAP_FUNCTION_CAPACITY,
+                        config->KEYMAP_EDGE_CAPACITY};
+    crypto_generichash_update(&state, (uint8_t*)caps, sizeof(caps));
+    crypto_generichash_final(&state, key, 32);
+}
+
+static inline void war_keymap_cache_path(war_config_context* config,
+                                         char* out,
+                                         size_t out_size) {
+    char dir[4096];
+    war_expand_env(config->DIR_CACHE, dir, sizeof(dir));
+    snprintf(out, out_size, "%s/keymap.bin", dir);
+}
+
+// returns 1 and fills keymap when the cache matches this binary and config
+static inline int war_keymap_cache_load(war_keymap_context* keymap,
+                                        war_config_context* config) {
+    char path[4096];
+    war_keymap_cache_path(config, path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(war_keymap_cache_header)) {
+        close(fd);
+        return 0;
+    }
+    uint8_t* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    size_t states = (size_t)config->KEYMAP_MODE_CAPACITY *
+                    config->KEYMAP_STATE_CAPACITY;
+    size_t functions = states * config->KEYMAP_FUNCTION_CAPACITY;
+    size_t edges = config->KEYMAP_EDGE_CAPACITY;
+    size_t expected = sizeof(war_keymap_cache_header) +
+                      functions * (sizeof(war_function_id) + sizeof(uint64_t)) +
+                      states * (sizeof(uint8_t) + sizeof(war_keymap_flags)) +
+                      edges * (sizeof(uint64_t) + sizeof(uint32_t)) +
+                      config->KEYMAP_MODE_CAPACITY * sizeof(uint32_t);
+
+    war_keymap_cache_header* header = (war_keymap_cache_header*)map;
+    uint8_t key[32];
+    war_keymap_cache_key(config, key);
+    if ((size_t)st.st_size != expected || memcmp(header->magic, "WARK", 4) ||
+        header->version != WAR_KEYMAP_CACHE_VERSION ||
+        memcmp(header->key, key, sizeof(key))) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    uintptr_t base = (uintptr_t)war_keymap_set;
+    uint8_t* p = map + sizeof(war_keymap_cache_header);
+    memcpy(keymap->function_id, p, functions * sizeof(war_function_id));
+    p += functions * sizeof(war_function_id);
+    for (size_t i = 0; i < functions; i++, p += sizeof(uint64_t)) {
+        uint64_t off;
+        memcpy(&off, p, sizeof(off));
+        keymap->function[i] =
+            off == UINT64_MAX ? NULL : (void (*)(war_env*))(base + off);
+    }
+    memcpy(keymap->function_count, p, states * sizeof(uint8_t));
+    p += states * sizeof(uint8_t);
+    memcpy(keymap->flags, p, states * sizeof(war_keymap_flags));
+    p += states * sizeof(war_keymap_flags);
+    memcpy(keymap->edge_key, p, edges * sizeof(uint64_t));
+    p += edges * sizeof(uint64_t);
+    memcpy(keymap->edge_next, p, edges * sizeof(uint32_t));
+    p += edges * sizeof(uint32_t);
+    memcpy(keymap->state_count,
+           p,
+           config->KEYMAP_MODE_CAPACITY * sizeof(uint32_t));
+    keymap->edge_count = header->edge_count;
+    keymap->version = WAR_KEYMAP_H_VERSION;
+    munmap(map, st.st_size);
+    return 1;
+}
+
+static inline void war_keymap_cache_save(war_keymap_context* keymap,
+                                         war_config_context* config) {
+    size_t states = (size_t)config->KEYMAP_MODE_CAPACITY *
+                    config->KEYMAP_STATE_CAPACITY;
+    size_t functions = states * config->KEYMAP_FUNCTION_CAPACITY;
+    size_t edges = config->KEYMAP_EDGE_CAPACITY;
+
+    // only pointers into this binary can be rebased on the next launch
+    uintptr_t base = (uintptr_t)war_keymap_set;
+    Dl_info self;
+    if (!dladdr((void*)base, &self)) return;
+    for (size_t i = 0; i < functions; i++) {
+        Dl_info info;
+        if (keymap->function[i] &&
+            (!dladdr((void*)keymap->function[i], &info) ||
+             info.dli_fbase != self.dli_fbase))
+            return;
+    }
+
+    char path[4096];
+    char tmp_path[4096 + 8];
+    war_keymap_cache_path(config, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return;
+
+    war_keymap_cache_header header = {0};
+    memcpy(header.magic, "WARK", 4);
+    header.version = WAR_KEYMAP_CACHE_VERSION;
+    war_keymap_cache_key(config, header.key);
+    header.mode_capacity = config->KEYMAP_MODE_CAPACITY;
+    header.state_capacity = config->KEYMAP_STATE_CAPACITY;
+    header.function_capacity = config->KEYMAP_FUNCTION_CAPACITY;
+    header.edge_capacity = config->KEYMAP_EDGE_CAPACITY;
+    header.edge_count = keymap->edge_count;
+
+    uint64_t* offsets = malloc(functions * sizeof(uint64_t));
+    if (!offsets) {
+        fclose(f);
+        unlink(tmp_path);
+        return;
+    }
+    for (size_t i = 0; i < functions; i++)
+        offsets[i] = keymap->function[i] ?
+                         (uint64_t)((uintptr_t)keymap->function[i] - base) :
+                         UINT64_MAX;
+
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(keymap->function_id,
+                      sizeof(war_function_id),
+                      functions,
+                      f) == functions;
+    ok = ok && fwrite(offsets, sizeof(uint64_t), functions, f) == functions;
+    ok = ok && fwrite(keymap->function_count, sizeof(uint8_t), states, f) ==
+                   states;
+    ok = ok && fwrite(keymap->flags, sizeof(war_keymap_flags), states, f) ==
+                   states;
+    ok = ok && fwrite(keymap->edge_key, sizeof(uint64_t), edges, f) == edges;
+    ok = ok && fwrite(keymap->edge_next, sizeof(uint32_t), edges, f) == edges;
+    ok = ok && fwrite(keymap->state_count,
+                      sizeof(uint32_t),
+                      config->KEYMAP_MODE_CAPACITY,
+                      f) == config->KEYMAP_MODE_CAPACITY;
+    free(offsets);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) unlink(tmp_path);
+}
+
 void war_keymap_override(war_keymap_context* keymap,
                          war_config_context* config);
 
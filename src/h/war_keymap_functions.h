@@ -14,7 +14,11 @@
 #include "war_data.h"
 #include "war_debug_macros.h"
 #include "war_functions.h"
+#include "war_sample.h"
+#include "war_spill.h"
+#include "war_resample.h"
 #include "war_stem.h"
+#include "war_autotune.h"
 
 extern void war_reconnect_capture(war_env* env, const char* target);
 extern void war_reconnect_loopback(war_env* env, const char* target);
@@ -438,6 +442,28 @@ static inline void war_record_midi(war_env* env) {
     }
 }
 
+// delay-line pool: fixed lines carved from the pool at startup, handed to voices
+// by 1-based id so the audio path never mallocs or frees
+static inline float* _war_delay_line(war_env* env, uint32_t id) {
+    return env->delay_pool + (uint64_t)(id - 1) * 2 * env->delay_pool_frames;
+}
+static inline uint32_t _war_delay_line_acquire(war_env* env) {
+    for (uint32_t i = 0; i < env->delay_pool_count; i++) {
+        if (env->delay_pool_used[i]) continue;
+        env->delay_pool_used[i] = 1;
+        memset(_war_delay_line(env, i + 1), 0, sizeof(float) * 2 * env->delay_pool_frames);
+        return i + 1;
+    }
+    return 0;
+}
+// drop every line a voice holds (lines[WAR_DELAY_LINE_KINDS])
+static inline void _war_delay_line_release(war_env* env, uint32_t* lines) {
+    for (uint32_t k = 0; k < WAR_DELAY_LINE_KINDS; k++) {
+        if (lines[k]) env->delay_pool_used[lines[k] - 1] = 0;
+        lines[k] = 0;
+    }
+}
+
 static inline int _war_preview_start_voice(war_env* env, uint32_t note, uint32_t layer) {
     if (env->midi_toggle) {
         // toggle mode: if note is sustain-playing, soft-release; if already releasing, retrigger
@@ -475,13 +501,16 @@ static inline int _war_preview_start_voice(war_env* env, uint32_t note, uint32_t
         if (env->preview_voice_active[v] && env->preview_voice_note[v] == note) {
             uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
             war_capture_slot* slot = &env->capture_slots[idx];
-            float* _sa = slot->samples; uint64_t _sc = slot->count;
+            float* _sa = slot->samples; uint64_t _sc = war_slot_play_count(slot);
             if (!_sa || _sc < 2) { env->preview_voice_active[v] = 0; return -1; }
             env->preview_voice_layer[v] = layer;
             env->preview_voice_read_pos[v] = 0;
             env->preview_voice_read_limit[v] = _sc;
             memset(env->preview_voice_effect_state[v], 0, sizeof(env->preview_voice_effect_state[v]));
             env->preview_voice_effect_state[v][14] = 1.0f;
+            _war_delay_line_release(env, env->preview_voice_delay_line[v]);
+            memset(&env->preview_voice_autotune[v], 0, sizeof(war_autotune_state));
+            memset(&env->preview_voice_limiter[v], 0, sizeof(war_limiter));
             env->preview_voice_filter_lp[v][0] = 0.0f;
             env->preview_voice_filter_lp[v][1] = 0.0f;
             env->preview_voice_env_samples[v] = 0;
@@ -515,7 +544,7 @@ static inline int _war_preview_start_voice(war_env* env, uint32_t note, uint32_t
         if (!env->preview_voice_active[v]) {
             uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
             war_capture_slot* slot = &env->capture_slots[idx];
-            float* _sa2 = slot->samples; uint64_t _sc2 = slot->count;
+            float* _sa2 = slot->samples; uint64_t _sc2 = war_slot_play_count(slot);
             if (!_sa2 || _sc2 < 2) return -1;
             uint32_t voice = v;
             env->preview_voice_note[voice] = note;
@@ -524,6 +553,9 @@ static inline int _war_preview_start_voice(war_env* env, uint32_t note, uint32_t
             env->preview_voice_read_limit[voice] = _sc2;
             memset(env->preview_voice_effect_state[voice], 0, sizeof(env->preview_voice_effect_state[voice]));
             env->preview_voice_effect_state[voice][14] = 1.0f;
+            _war_delay_line_release(env, env->preview_voice_delay_line[voice]);
+            memset(&env->preview_voice_autotune[voice], 0, sizeof(war_autotune_state));
+            memset(&env->preview_voice_limiter[voice], 0, sizeof(war_limiter));
             env->preview_voice_filter_lp[voice][0] = 0.0f;
             env->preview_voice_filter_lp[voice][1] = 0.0f;
             env->preview_voice_env_samples[voice] = 0;
@@ -1017,15 +1049,19 @@ static inline void _war_stretch_slot(war_env* env, uint32_t note, uint32_t layer
     if (!env || note > 127 || layer < 1 || layer > 9) return;
     uint32_t li = layer - 1;
     war_capture_slot* slot = &env->capture_slots[note * WAR_CAPTURE_SLOT_LAYERS + li];
-    float* src_data = slot->samples;
     uint64_t src_cnt = slot->count;
-    if (!src_data || src_cnt < 4) return;
+    if (!slot->samples || src_cnt < 4) return;
+    const float* src_data = war_slot_unpack(slot);
+    if (!src_data) return;
     uint64_t src_frames = src_cnt / 2;
     uint64_t dst_frames = (uint64_t)((double)src_frames * ratio);
     if (dst_frames < 1) dst_frames = 1;
     uint64_t dst_cnt = dst_frames * 2;
     double* wrk = malloc(dst_cnt * sizeof(double));
-    if (!wrk) return;
+    if (!wrk) {
+        war_sample_unpack_free(slot->samples, src_data);
+        return;
+    }
     double step = 1.0 / ratio;
     for (uint64_t i = 0; i < dst_frames; i++) {
         double sp = (double)i * step;
@@ -1039,13 +1075,12 @@ static inline void _war_stretch_slot(war_env* env, uint32_t note, uint32_t layer
             wrk[i*2+1] = src_data[si*2+1]*(1.0-fr) + src_data[(si+1)*2+1]*fr;
         }
     }
-    free(slot->samples);
-    slot->samples = malloc(dst_cnt * sizeof(float));
-    if (slot->samples) {
+    war_sample_unpack_free(slot->samples, src_data);
+    float* out = malloc(dst_cnt * sizeof(float));
+    if (out) {
         for (uint64_t i = 0; i < dst_cnt; i++)
-            slot->samples[i] = (float)wrk[i];
-        slot->count = dst_cnt;
-        slot->capacity = dst_cnt;
+            out[i] = (float)wrk[i];
+        war_slot_adopt(slot, out, dst_cnt);
     }
     free(wrk);
 }
@@ -1164,7 +1199,7 @@ static inline void war_toggle_playback(war_env* env) {
                         uint64_t _offset = (uint64_t)(_off_cells * _spc2 * 48000.0 * 2.0);
                         if (_offset & 1) _offset &= ~1ULL;
                         uint64_t _limit = _offset + (uint64_t)(_rem_cells * _spc2 * 48000.0 * 2.0);
-                        if (_limit > _sl->count) _limit = _sl->count;
+                        if (_limit > war_slot_play_count(_sl)) _limit = war_slot_play_count(_sl);
                         for (uint32_t _v = 0; _v < WAR_PLAY_BAR_VOICES; _v++) {
                             if (!env->play_bar_voice_active[_v]) {
                                 env->play_bar_voice_note[_v] = _pp;
@@ -1237,7 +1272,7 @@ static inline void war_playbar_goto_cursor(war_env* env) {
                     double _rc = _nw2 - _oc;
                     if (_rc > 0.01) {
                         uint64_t _lim2 = _off2 + (uint64_t)(_rc * _spc3 * 48000.0 * 2.0);
-                        if (_lim2 > _sl2->count) _lim2 = _sl2->count;
+                        if (_lim2 > war_slot_play_count(_sl2)) _lim2 = war_slot_play_count(_sl2);
                         for (uint32_t _v2 = 0; _v2 < WAR_PLAY_BAR_VOICES; _v2++) {
                             if (!env->play_bar_voice_active[_v2]) {
                                  env->play_bar_voice_note[_v2] = _pp2;
@@ -1307,6 +1342,12 @@ static inline void war_toggle_resample(war_env* env) {
     call_king_terry("RESAMPLE: %s", env->across_resample ? "OFF" : "ON");
 }
 
+static inline void war_toggle_across_root(war_env* env) {
+    env->across_root = !env->across_root;
+    snprintf(env->status_msg, sizeof(env->status_msg), "across root %s", env->across_root ? "ON" : "OFF");
+    call_king_terry("ACROSS ROOT: %s", env->across_root ? "ON" : "OFF");
+}
+
 static inline void war_toggle_crop(war_env* env) {
     if (!env || !env->ctx_cursor || !env->ctx_wayland) return;
     war_cursor_context* cur = env->ctx_cursor;
@@ -1332,19 +1373,10 @@ static inline void war_toggle_crop(war_env* env) {
         if (start < end) {
             uint64_t new_frames = end - start;
             if (new_frames > 0 && new_frames < frames) {
-                uint64_t new_count = new_frames * 2;
-                float* new_data = malloc(new_count * sizeof(float));
-                if (new_data) {
-                    memcpy(new_data, env->capture_slots[idx].samples + start * 2,
-                           new_count * sizeof(float));
-                    free(env->capture_slots[idx].samples);
-                    env->capture_slots[idx].samples = new_data;
-                    env->capture_slots[idx].count = new_count;
-                    env->capture_slots[idx].capacity = new_count;
-                    call_king_terry("CROP: applied [%llu, %llu) -> %llu frames",
-                                    (unsigned long long)start, (unsigned long long)end,
-                                    (unsigned long long)new_frames);
-                }
+                war_slot_crop(&env->capture_slots[idx], start * 2, new_frames * 2);
+                call_king_terry("CROP: applied [%llu, %llu) -> %llu frames",
+                                (unsigned long long)start, (unsigned long long)end,
+                                (unsigned long long)new_frames);
             }
         }
     }
@@ -1469,6 +1501,304 @@ static inline void _war_process_effects(war_capture_slot* slot, float* state, fl
     }
 }
 
+// Delay (state[12]=fb_lp_l, [13]=fb_lp_r). Block based: the fractional delay is
+// fixed for the block, so the inner loop is two masked reads and a lerp per channel.
+// line: planar stereo, L at [0, frames), R at [frames, 2*frames)
+static inline void _war_process_delay_block(war_capture_slot* slot, float* state, float* line, uint32_t frames, uint32_t* pos, float* blk, uint64_t floats) {
+    double time_ms = _war_effect_get_param(slot, WAR_EFFECT_DELAY, 0);
+    float fb = (float)_war_effect_get_param(slot, WAR_EFFECT_DELAY, 1);
+    float mx = (float)_war_effect_get_param(slot, WAR_EFFECT_DELAY, 2);
+    float dm = (float)_war_effect_get_param(slot, WAR_EFFECT_DELAY, 3);
+    float d = (float)(time_ms * 48.0);
+    if (d < 1.0f) d = 1.0f;
+    if (d > (float)(frames - 2)) d = (float)(frames - 2);
+    uint32_t di = (uint32_t)d, mask = frames - 1, w = *pos;
+    float fr = d - (float)di;
+    float* ll = line;
+    float* lr = line + frames;
+    float fl = state[12], frr = state[13];
+    for (uint64_t f = 0; f + 1 < floats; f += 2) {
+        uint32_t r0 = (w - di) & mask, r1 = (w - di - 1) & mask;
+        float yl = ll[r0] + fr * (ll[r1] - ll[r0]);
+        float yr = lr[r0] + fr * (lr[r1] - lr[r0]);
+        fl = yl + dm * (fl - yl);
+        frr = yr + dm * (frr - yr);
+        float xl = blk[f], xr = blk[f + 1];
+        ll[w] = xl + fb * fl;
+        lr[w] = xr + fb * frr;
+        blk[f] = xl + mx * (yl - xl);
+        blk[f + 1] = xr + mx * (yr - xr);
+        w = (w + 1) & mask;
+    }
+    state[12] = fl; state[13] = frr;
+    *pos = w;
+}
+
+// Chorus (state[21]=lfo phase). The LFO is evaluated at the block edges and the
+// delay ramps linearly between them; right channel runs a quarter cycle ahead.
+static inline void _war_process_chorus_block(war_capture_slot* slot, float* state, float* line, uint32_t frames, uint32_t* pos, float* blk, uint64_t floats) {
+    double rate = _war_effect_get_param(slot, WAR_EFFECT_CHORUS, 0);
+    double depth_ms = _war_effect_get_param(slot, WAR_EFFECT_CHORUS, 1);
+    float mx = (float)_war_effect_get_param(slot, WAR_EFFECT_CHORUS, 2);
+    double base_ms = _war_effect_get_param(slot, WAR_EFFECT_CHORUS, 3);
+    uint64_t n = floats / 2;
+    if (!n) return;
+    double ph0 = state[21], ph1 = ph0 + rate * (double)n / 48000.0;
+    ph1 -= floor(ph1);
+    double tw = 2.0 * M_PI, lim = (double)(frames - 2);
+    double dl0 = (base_ms + depth_ms * 0.5 * (1.0 + sin(tw * ph0))) * 48.0;
+    double dl1 = (base_ms + depth_ms * 0.5 * (1.0 + sin(tw * ph1))) * 48.0;
+    double dr0 = (base_ms + depth_ms * 0.5 * (1.0 + cos(tw * ph0))) * 48.0;
+    double dr1 = (base_ms + depth_ms * 0.5 * (1.0 + cos(tw * ph1))) * 48.0;
+    if (dl0 > lim) dl0 = lim;
+    if (dl1 > lim) dl1 = lim;
+    if (dr0 > lim) dr0 = lim;
+    if (dr1 > lim) dr1 = lim;
+    float sl = (float)((dl1 - dl0) / (double)n), sr = (float)((dr1 - dr0) / (double)n);
+    float dlf = (float)dl0, drf = (float)dr0;
+    uint32_t mask = frames - 1, w = *pos;
+    float* ll = line;
+    float* lr = line + frames;
+    for (uint64_t f = 0; f + 1 < floats; f += 2) {
+        float xl = blk[f], xr = blk[f + 1];
+        ll[w] = xl;
+        lr[w] = xr;
+        uint32_t il = (uint32_t)dlf, ir = (uint32_t)drf;
+        float fl = dlf - (float)il, fr = drf - (float)ir;
+        uint32_t a = (w - il) & mask, b = (w - il - 1) & mask;
+        uint32_t c = (w - ir) & mask, e = (w - ir - 1) & mask;
+        float yl = ll[a] + fl * (ll[b] - ll[a]);
+        float yr = lr[c] + fr * (lr[e] - lr[c]);
+        blk[f] = xl + mx * (yl - xl);
+        blk[f + 1] = xr + mx * (yr - xr);
+        dlf += sl; drf += sr;
+        w = (w + 1) & mask;
+    }
+    state[21] = (float)ph1;
+    *pos = w;
+}
+
+// autotune runs first, straight off the slot so PSOLA can read ahead without
+// latency. Fills blk and returns 1; returns 0 (caller copies dry audio) when the
+// effect is off or no pooled line is free for the overlap-add ring.
+static inline int _war_process_autotune(war_env* env, war_capture_slot* slot, war_autotune_state* st, uint32_t* lines, uint64_t read_pos, float* blk, uint64_t floats) {
+    if (!_war_effect_active(slot, WAR_EFFECT_AUTOTUNE)) return 0;
+    if (!war_sample_plain(slot->buf)) return 0; // analysis reads the source in place
+    if (!env->delay_pool_count || env->delay_pool_frames < WAR_AUTOTUNE_RING) return 0;
+    if (!lines[WAR_DELAY_LINE_AUTOTUNE]) {
+        lines[WAR_DELAY_LINE_AUTOTUNE] = _war_delay_line_acquire(env);
+        st->primed = 0;
+    }
+    if (!lines[WAR_DELAY_LINE_AUTOTUNE]) return 0;
+    _war_autotune_render(st, _war_effect_get_param(slot, WAR_EFFECT_AUTOTUNE, 0),
+                         _war_delay_line(env, lines[WAR_DELAY_LINE_AUTOTUNE]),
+                         slot->samples, slot->count, read_pos / 2, blk, floats, &env->autotune_budget);
+    return 1;
+}
+
+// runs the pooled-line effects over one voice block. Lines are acquired on first
+// use; a voice that cannot get one (pool exhausted) plays that effect dry.
+static inline void _war_process_line_effects(war_env* env, war_capture_slot* slot, float* state, uint32_t* lines, uint32_t* pos, float* blk, uint64_t floats) {
+    if (!env->delay_pool_count) return;
+    if (_war_effect_active(slot, WAR_EFFECT_DELAY)) {
+        if (!lines[WAR_DELAY_LINE_DELAY]) lines[WAR_DELAY_LINE_DELAY] = _war_delay_line_acquire(env);
+        if (lines[WAR_DELAY_LINE_DELAY])
+            _war_process_delay_block(slot, state, _war_delay_line(env, lines[WAR_DELAY_LINE_DELAY]),
+                                     env->delay_pool_frames, &pos[WAR_DELAY_LINE_DELAY], blk, floats);
+    }
+    if (_war_effect_active(slot, WAR_EFFECT_CHORUS)) {
+        if (!lines[WAR_DELAY_LINE_CHORUS]) lines[WAR_DELAY_LINE_CHORUS] = _war_delay_line_acquire(env);
+        if (lines[WAR_DELAY_LINE_CHORUS])
+            _war_process_chorus_block(slot, state, _war_delay_line(env, lines[WAR_DELAY_LINE_CHORUS]),
+                                      env->delay_pool_frames, &pos[WAR_DELAY_LINE_CHORUS], blk, floats);
+    }
+}
+
+// look-ahead in frames for a limiter param set, rounded up to whole sub-blocks
+static inline uint32_t _war_limiter_lookahead(const double* p) {
+    uint32_t l = (uint32_t)(p[2] * 48.0 + 0.5);
+    l = (l + WAR_LIMITER_SUB - 1) / WAR_LIMITER_SUB * WAR_LIMITER_SUB;
+    if (l < WAR_LIMITER_SUB) l = WAR_LIMITER_SUB;
+    if (l > WAR_LIMITER_LOOKAHEAD_MAX) l = WAR_LIMITER_LOOKAHEAD_MAX;
+    return l;
+}
+
+// look-ahead compressor/limiter, in place on interleaved stereo. p: thresh(dB)
+// ratio(>=100 = brickwall) lookahead(ms) release(ms) makeup(dB). Gain is computed
+// once per WAR_LIMITER_SUB frames from the peak over the look-ahead window and
+// ramped linearly across the sub-block; output is delayed by the look-ahead.
+static inline void _war_limiter_process(war_limiter* lim, const double* p, float* x, uint64_t floats) {
+    uint32_t la = _war_limiter_lookahead(p);
+    uint32_t window = la / WAR_LIMITER_SUB + 1;
+    double ratio = p[1] < 1.0 ? 1.0 : p[1];
+    double release_ms = p[3] < 1.0 ? 1.0 : p[3];
+    float slope = ratio >= 100.0 ? 1.0f : (float)(1.0 - 1.0 / ratio);
+    float rc = (float)exp(-(double)WAR_LIMITER_SUB / (release_ms * 48.0));
+    float makeup = (float)pow(10.0, p[4] / 20.0);
+    float thresh = (float)p[0];
+    if (lim->gain <= 0.0f) lim->gain = 1.0f;
+    uint64_t frames = floats / 2;
+    for (uint64_t s0 = 0; s0 < frames; s0 += WAR_LIMITER_SUB) {
+        uint64_t n = frames - s0 < WAR_LIMITER_SUB ? frames - s0 : WAR_LIMITER_SUB;
+        float* b = x + s0 * 2;
+        float pk = 0.0f;
+        for (uint64_t i = 0; i < n * 2; i++) {
+            float a = fabsf(b[i]);
+            if (a > pk) pk = a;
+        }
+        lim->peak[lim->peak_pos] = pk;
+        lim->peak_pos = (lim->peak_pos + 1) % WAR_LIMITER_PEAKS;
+        float wpk = 0.0f;
+        for (uint32_t k = 0; k < window; k++) {
+            float v = lim->peak[(lim->peak_pos + WAR_LIMITER_PEAKS - 1 - k) % WAR_LIMITER_PEAKS];
+            if (v > wpk) wpk = v;
+        }
+        float target = 0.0f;
+        if (wpk > 1e-9f) {
+            float over = 20.0f * log10f(wpk) - thresh;
+            if (over > 0.0f) target = -over * slope;
+        }
+        if (target < lim->gr_db) lim->gr_db = target;
+        else lim->gr_db = target + rc * (lim->gr_db - target);
+        float g0 = lim->gain, g1 = powf(10.0f, lim->gr_db / 20.0f);
+        float dg = (g1 - g0) / (float)n;
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t w = lim->pos;
+            uint32_t r = (w + WAR_LIMITER_LOOKAHEAD_MAX - la) % WAR_LIMITER_LOOKAHEAD_MAX;
+            float l = lim->delay[r * 2], rr = lim->delay[r * 2 + 1];
+            lim->delay[w * 2] = b[i * 2];
+            lim->delay[w * 2 + 1] = b[i * 2 + 1];
+            lim->pos = (w + 1) % WAR_LIMITER_LOOKAHEAD_MAX;
+            g0 += dg;
+            b[i * 2] = l * g0 * makeup;
+            b[i * 2 + 1] = rr * g0 * makeup;
+        }
+        lim->gain = g1;
+    }
+}
+
+// offline variant for export: flushes the look-ahead so x comes back time-aligned
+static inline void _war_limiter_process_aligned(war_limiter* lim, const double* p, float* x, uint64_t floats) {
+    float tail[WAR_LIMITER_LOOKAHEAD_MAX * 2];
+    uint64_t la = _war_limiter_lookahead(p), frames = floats / 2;
+    _war_limiter_process(lim, p, x, floats);
+    memset(tail, 0, sizeof(float) * la * 2);
+    _war_limiter_process(lim, p, tail, la * 2);
+    if (frames > la) {
+        memmove(x, x + la * 2, sizeof(float) * (frames - la) * 2);
+        memcpy(x + (frames - la) * 2, tail, sizeof(float) * la * 2);
+    } else {
+        memcpy(x, tail + (la - frames) * 2, sizeof(float) * frames * 2);
+    }
+}
+
+// WAR_EFFECT_COMPRESS2 on one voice block
+static inline void _war_process_compress2(war_capture_slot* slot, war_limiter* lim, float* blk, uint64_t floats) {
+    if (!_war_effect_active(slot, WAR_EFFECT_COMPRESS2)) return;
+    double p[WAR_EFFECT_PARAMS];
+    for (int i = 0; i < WAR_EFFECT_PARAMS; i++) p[i] = _war_effect_get_param(slot, WAR_EFFECT_COMPRESS2, i);
+    _war_limiter_process(lim, p, blk, floats);
+}
+
+// reverb send bus: FDN line lengths in frames (mutually prime, ~21-39ms)
+static const uint32_t war_reverb_line_len[WAR_REVERB_LINES] = {1031, 1327, 1523, 1871};
+
+// bus already serving slot_idx, else a freshly cleared free one. NULL when all busy.
+static inline war_reverb_bus* _war_reverb_bus_get(war_reverb_bus* bus, uint32_t count, uint32_t* active, uint32_t slot_idx) {
+    war_reverb_bus* free_bus = NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        if (bus[i].active && bus[i].slot == slot_idx) return &bus[i];
+        if (!bus[i].active && !free_bus) free_bus = &bus[i];
+    }
+    if (!free_bus) return NULL;
+    memset(free_bus->pre, 0, sizeof(free_bus->pre));
+    memset(free_bus->line, 0, sizeof(free_bus->line));
+    memset(free_bus->lp, 0, sizeof(free_bus->lp));
+    memset(free_bus->line_pos, 0, sizeof(free_bus->line_pos));
+    memset(free_bus->send, 0, sizeof(free_bus->send));
+    free_bus->pre_pos = 0;
+    free_bus->idle = 0;
+    free_bus->quiet = 0;
+    free_bus->fed = 0;
+    free_bus->slot = slot_idx;
+    free_bus->active = 1;
+    if (active) (*active)++;
+    return free_bus;
+}
+
+// runs `floats` interleaved stereo send samples through the bus FDN and adds the
+// wet return to out. Returns the peak read from any line so callers can release dead tails.
+static inline float _war_reverb_bus_process(war_reverb_bus* bus, war_capture_slot* slot, const float* in, float* out, uint64_t floats) {
+    double decay = _war_effect_get_param(slot, WAR_EFFECT_REVERB, 0);
+    double predelay_ms = _war_effect_get_param(slot, WAR_EFFECT_REVERB, 2);
+    double damping = _war_effect_get_param(slot, WAR_EFFECT_REVERB, 3);
+    if (decay < 0.0) decay = 0.0;
+    if (decay > 0.99) decay = 0.99;
+    if (damping < 0.0) damping = 0.0;
+    if (damping > 1.0) damping = 1.0;
+    uint32_t pd = (uint32_t)(predelay_ms * 0.001 * 48000.0);
+    if (pd > WAR_REVERB_PREDELAY_MAX - 1) pd = WAR_REVERB_PREDELAY_MAX - 1;
+    // per-line feedback scaled by length so every line decays at the same rate
+    float g[WAR_REVERB_LINES];
+    for (uint32_t i = 0; i < WAR_REVERB_LINES; i++)
+        g[i] = (float)pow(decay, (double)war_reverb_line_len[i] / (double)war_reverb_line_len[0]);
+    float dm = (float)damping, peak = 0.0f;
+    for (uint64_t f = 0; f + 1 < floats; f += 2) {
+        float xl = in[f], xr = in[f + 1];
+        if (pd) {
+            uint32_t rd = (bus->pre_pos + WAR_REVERB_PREDELAY_MAX - pd) % WAR_REVERB_PREDELAY_MAX;
+            bus->pre[bus->pre_pos * 2] = xl;
+            bus->pre[bus->pre_pos * 2 + 1] = xr;
+            xl = bus->pre[rd * 2];
+            xr = bus->pre[rd * 2 + 1];
+            if (++bus->pre_pos == WAR_REVERB_PREDELAY_MAX) bus->pre_pos = 0;
+        }
+        float d[WAR_REVERB_LINES];
+        for (uint32_t i = 0; i < WAR_REVERB_LINES; i++) {
+            float t = bus->line[i][bus->line_pos[i]];
+            bus->lp[i] = t + dm * (bus->lp[i] - t);
+            d[i] = bus->lp[i];
+            if (fabsf(t) > peak) peak = fabsf(t);
+        }
+        // 4x4 Hadamard feedback matrix (orthogonal, scaled by 1/2)
+        float a = d[0] + d[1], b = d[0] - d[1], c = d[2] + d[3], e = d[2] - d[3];
+        float h[WAR_REVERB_LINES] = {(a + c) * 0.5f, (b + e) * 0.5f, (a - c) * 0.5f, (b - e) * 0.5f};
+        float inj[WAR_REVERB_LINES] = {xl, xr, xl, xr};
+        for (uint32_t i = 0; i < WAR_REVERB_LINES; i++) {
+            bus->line[i][bus->line_pos[i]] = g[i] * h[i] + inj[i];
+            if (++bus->line_pos[i] == war_reverb_line_len[i]) bus->line_pos[i] = 0;
+        }
+        float ol = (d[0] + d[2]) * 0.5f, or_ = (d[1] + d[3]) * 0.5f;
+        out[f] += ol;
+        out[f + 1] += or_;
+    }
+    return peak;
+}
+
+// seconds of reverb tail after the last send (predelay + time to WAR_REVERB_SILENCE, capped)
+static inline double _war_reverb_tail_sec(war_capture_slot* slot) {
+    double decay = _war_effect_get_param(slot, WAR_EFFECT_REVERB, 0);
+    double predelay_ms = _war_effect_get_param(slot, WAR_EFFECT_REVERB, 2);
+    if (decay > 0.99) decay = 0.99;
+    double tail = predelay_ms * 0.001;
+    if (decay > 0.0)
+        tail += (double)war_reverb_line_len[0] / 48000.0 * -6.0 / log10(decay);
+    return tail > 10.0 ? 10.0 : tail;
+}
+
+// end of block: a bus nobody fed whose predelay has drained and whose lines all
+// read below WAR_REVERB_SILENCE for a full longest-line period goes back to the free list
+static inline void _war_reverb_bus_settle(war_reverb_bus* bus, uint32_t* active, float peak, uint64_t frames, double predelay_ms) {
+    if (bus->fed) { bus->idle = 0; bus->quiet = 0; bus->fed = 0; return; }
+    bus->idle += frames;
+    if (peak >= WAR_REVERB_SILENCE || bus->idle <= (uint64_t)(predelay_ms * 0.001 * 48000.0)) bus->quiet = 0;
+    else bus->quiet += frames;
+    if (bus->quiet > war_reverb_line_len[WAR_REVERB_LINES - 1]) {
+        bus->active = 0;
+        if (active && *active) (*active)--;
+    }
+}
+
 // pitches covered by visual selection (or single cursor row). out needs 128 entries.
 static inline int _war_sel_pitches(war_env* env, uint32_t* out) {
     war_cursor_context* cur = env->ctx_cursor;
@@ -1612,9 +1942,94 @@ static inline void war_compress(war_env* env) {
     }
 }
 
+// :compress2 — look-ahead compressor/limiter (WAR_EFFECT_COMPRESS2), per row or
+// on the master output with `:compress2 master ...`
+static inline void war_compress2(war_env* env) {
+    war_cursor_context* cur = env->ctx_cursor;
+    int cmdlen = (int)env->cmd_len;
+    const char* rest = cmdlen >= 10 ? env->cmd_buf + 10 : "";
+    while (*rest == ' ' || *rest == '\t') rest++;
+    double p[WAR_EFFECT_PARAMS] = {-1.0, 20.0, 2.0, 60.0, 0.0, 0.0};
+    if (strncmp(rest, "master", 6) == 0) {
+        rest += 6;
+        while (*rest == ' ' || *rest == '\t') rest++;
+        double* mp = env->master_limit_params;
+        if (strcmp(rest, "off") == 0) {
+            env->master_limit_active = 0;
+        } else if (strcmp(rest, "on") == 0 || strcmp(rest, "default") == 0) {
+            memcpy(mp, p, sizeof(p));
+            memset(&env->master_limiter, 0, sizeof(war_limiter));
+            env->master_limit_active = 1;
+        } else if (*rest && strcmp(rest, "status") != 0) {
+            sscanf(rest, " %lf %lf %lf %lf %lf", &p[0], &p[1], &p[2], &p[3], &p[4]);
+            if (p[0] > 0.0 || p[1] < 1.0 || p[2] < 0.0 || p[3] < 0.0) {
+                snprintf(env->status_msg, sizeof(env->status_msg), "compress2: bad args"); return;
+            }
+            memcpy(mp, p, sizeof(p));
+            memset(&env->master_limiter, 0, sizeof(war_limiter));
+            env->master_limit_active = 1;
+        }
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 env->master_limit_active
+                     ? "compress2 master ON: thresh=%.1f ratio=%.1f lookahead=%.1f release=%.0f makeup=%.1f"
+                     : "compress2 master OFF",
+                 mp[0], mp[1], mp[2], mp[3], mp[4]);
+        return;
+    }
+    if (!cur || !cur->instance_count) return;
+    uint32_t pitches[128];
+    int np = _war_sel_pitches(env, pitches);
+    if (np <= 0) return;
+    war_capture_slot* slot = _war_sel_slot(env, pitches[0]);
+    {
+        uint32_t cp = (uint32_t)(cur->instance[0].pos[1] - (double)env->ctx_wayland->gutter_rows);
+        if (cp <= 127) slot = _war_sel_slot(env, cp);
+    }
+    uint8_t turn_on = 0, turn_off = 0, set_params = 0;
+    if (!env->cmd_active || !*rest || strcmp(rest, "status") == 0) {
+        int a = _war_effect_active(slot, WAR_EFFECT_COMPRESS2);
+        if (a)
+            for (int i = 0; i < WAR_EFFECT_PARAMS; i++) p[i] = _war_effect_get_param(slot, WAR_EFFECT_COMPRESS2, i);
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 a ? "compress2 ON: thresh=%.1f ratio=%.1f lookahead=%.1f release=%.0f makeup=%.1f"
+                   : "compress2 OFF",
+                 p[0], p[1], p[2], p[3], p[4]);
+        return;
+    }
+    if (strcmp(rest, "on") == 0 || strcmp(rest, "default") == 0) turn_on = 1;
+    else if (strcmp(rest, "off") == 0) turn_off = 1;
+    else if (strcmp(rest, "usage") == 0) {
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "usage: :compress2 [master] [thresh(dB) ratio lookahead(ms) release(ms) makeup(dB)] | on | off | status");
+        return;
+    } else {
+        set_params = 1;
+        sscanf(rest, " %lf %lf %lf %lf %lf", &p[0], &p[1], &p[2], &p[3], &p[4]);
+        if (p[0] > 0.0 || p[1] < 1.0 || p[2] < 0.0 || p[3] < 0.0) {
+            snprintf(env->status_msg, sizeof(env->status_msg), "compress2: bad args"); return;
+        }
+    }
+    _war_mark_dirty(env);
+    for (int i = 0; i < np; i++) {
+        war_capture_slot* s = _war_sel_slot(env, pitches[i]);
+        if (turn_off) {
+            _war_effect_set_active(s, WAR_EFFECT_COMPRESS2, 0);
+        } else if (turn_on || set_params) {
+            for (int k = 0; k < 5; k++) _war_effect_set_param(s, WAR_EFFECT_COMPRESS2, k, p[k]);
+            _war_effect_set_active(s, WAR_EFFECT_COMPRESS2, 1);
+        }
+    }
+    if (turn_off)
+        snprintf(env->status_msg, sizeof(env->status_msg), np > 1 ? "compress2 OFF (%d rows)" : "compress2 OFF", np);
+    else
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "compress2 ON: thresh=%.1f ratio=%.1f lookahead=%.1f release=%.0f makeup=%.1f",
+                 p[0], p[1], p[2], p[3], p[4]);
+}
+
 // copy one effect's active bit + params from src slot to all other selected pitches
 static inline void _war_sel_copy_effect(war_env* env, const uint32_t* pitches, int np, uint32_t src_pitch, int effect_id) {
-    if (np <= 1 || effect_id <= 0 || effect_id >= WAR_EFFECT_COUNT) return;
+    if (np <= 1 || effect_id <= 0 || effect_id > WAR_EFFECT_COUNT) return;
     war_capture_slot* src = _war_sel_slot(env, src_pitch);
     int active = _war_effect_active(src, effect_id);
     double params[WAR_EFFECT_PARAMS];
@@ -1639,10 +2054,7 @@ static inline void war_clear(war_env* env) {
     _war_mark_dirty(env);
     for (int i = 0; i < np; i++) {
         war_capture_slot* slot = _war_sel_slot(env, pitches[i]);
-        free(slot->samples);
-        slot->samples = NULL;
-        slot->count = 0;
-        slot->capacity = 0;
+        war_slot_clear(slot);
         slot->gain = 0.0f;
         slot->pan = 0;
         slot->eq1 = 0;
@@ -1666,13 +2078,8 @@ static inline void war_clear_all(war_env* env) {
         for (int l = 0; l < WAR_CAPTURE_SLOT_LAYERS; l++) {
             uint32_t idx = p * WAR_CAPTURE_SLOT_LAYERS + l;
             war_capture_slot* slot = &env->capture_slots[idx];
-            if (slot->samples) {
-                free(slot->samples);
-                slot->samples = NULL;
-                cleared++;
-            }
-            slot->count = 0;
-            slot->capacity = 0;
+            if (slot->samples) cleared++;
+            war_slot_clear(slot);
             slot->gain = 0.0f;
             slot->pan = 0;
             slot->eq1 = 0;
@@ -1773,7 +2180,7 @@ static inline void war_whatson(war_env* env) {
     war_capture_slot* slot = &env->capture_slots[idx];
     static const char* names[] = {NULL,"CMP","SAT","REV","DEL","CHO","GAT","DEE","AUT","CM2"};
     char buf[128]; buf[0] = '\0'; int pos = 0;
-    for (int i = 1; i < WAR_EFFECT_COUNT; i++) {
+    for (int i = 1; i <= WAR_EFFECT_COUNT; i++) {
         if (_war_effect_active(slot, i)) {
             if (pos > 0 && pos < (int)sizeof(buf)-4) { buf[pos++] = ','; buf[pos++] = ' '; }
             if (pos < (int)sizeof(buf)-4) {
@@ -2356,7 +2763,19 @@ static inline void war_autotune(war_env* env) {
     else if (strcmp(rest, "off") == 0) turn_off = 1;
     else if (strcmp(rest, "usage") == 0) {
         snprintf(env->status_msg, sizeof(env->status_msg),
-                 "usage: :autotune [retune] | on | off | status"); return;
+                 "usage: :autotune [retune] | on | off | render | status"); return;
+    }
+    else if (strcmp(rest, "render") == 0) {
+        // bake the correction into each selected slot on the worker thread
+        int queued = 0;
+        for (int i = 0; i < np; i++) {
+            war_capture_slot* s = _war_sel_slot(env, pitches[i]);
+            double rt = _war_effect_active(s, WAR_EFFECT_AUTOTUNE) ? _war_effect_get_param(s, WAR_EFFECT_AUTOTUNE, 0) : retune_ms;
+            if (war_autotune_enqueue(env, (uint32_t)(s - env->capture_slots), rt) == 0) queued++;
+        }
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 queued ? "autotune: rendering %d slot(s)" : "autotune: no audio in selection", queued);
+        return;
     }
     else if (strcmp(rest, "status") == 0) {
         int a = _war_effect_active(slot, WAR_EFFECT_AUTOTUNE);
@@ -2405,9 +2824,10 @@ static inline void war_autotune(war_env* env) {
 static inline void _war_across_pitch_shift(war_env* env, uint32_t src_note, uint32_t layer, int32_t radius) {
     if (!env || src_note > 127 || layer < 1 || layer > 9) return;
     uint32_t li = layer - 1;
-    float* src_data = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].samples;
-    uint64_t src_cnt = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].count;
-    if (!src_data || src_cnt < 4) {
+    uint32_t sidx = src_note * WAR_CAPTURE_SLOT_LAYERS + li;
+    war_capture_slot* src = &env->capture_slots[sidx];
+    uint64_t src_cnt = src->count;
+    if (!src->samples || src_cnt < 4) {
         call_king_terry("ACROSS: no data at note=%u layer=%u", src_note, layer);
         return;
     }
@@ -2416,11 +2836,20 @@ static inline void _war_across_pitch_shift(war_env* env, uint32_t src_note, uint
     uint32_t t_start = src_note > (uint32_t)rad ? src_note - (uint32_t)rad : 0;
     uint32_t t_end = src_note + (uint32_t)rad + 1;
     if (t_end > 128) t_end = 128;
+    // root mode: neighbours share the source and resample while playing
+    uint8_t linked = env->across_root && !env->across_resample;
+    const float* src_data = linked ? src->samples : war_slot_unpack(src);
+    if (!src_data) return;
     for (uint32_t t = t_start; t < t_end; t++) {
         if (t == src_note) continue;
         int32_t semi = (int32_t)t - (int32_t)src_note;
         double ratio = pow(2.0, (double)semi / 12.0);
-        if (!env->across_resample) {
+        uint32_t tidx = t * WAR_CAPTURE_SLOT_LAYERS + li;
+        war_capture_slot* dst_slot = &env->capture_slots[tidx];
+        if (linked) {
+            war_slot_share(dst_slot, src);
+            dst_slot->root = src->root ? src->root : sidx + 1;
+        } else if (!env->across_resample) {
             // resample: changes pitch and duration
             uint64_t dst_frames = (uint64_t)((double)src_frames / ratio);
             if (dst_frames < 1) dst_frames = 1;
@@ -2439,20 +2868,7 @@ static inline void _war_across_pitch_shift(war_env* env, uint32_t src_note, uint
                     dst[i*2+1] = (float)(src_data[si*2+1]*(1.0-fr) + src_data[(si+1)*2+1]*fr);
                 }
             }
-            uint32_t tidx = t * WAR_CAPTURE_SLOT_LAYERS + li;
-            free(env->capture_slots[tidx].samples);
-            env->capture_slots[tidx].samples = dst;
-            env->capture_slots[tidx].count = dst_cnt;
-            env->capture_slots[tidx].capacity = dst_cnt;
-            env->capture_slots[tidx].gain = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].gain;
-            env->capture_slots[tidx].pan = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].pan;
-            env->capture_slots[tidx].eq1 = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].eq1;
-            env->capture_slots[tidx].eq2 = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].eq2;
-            env->capture_slots[tidx].attack = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].attack;
-            env->capture_slots[tidx].sustain = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].sustain;
-            env->capture_slots[tidx].release = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].release;
-            env->capture_slots[tidx].effect_flags = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].effect_flags;
-            memcpy(env->capture_slots[tidx].effect_params, env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+            if (!war_slot_adopt(dst_slot, dst, dst_cnt)) continue;
         } else {
             // non-resample: changes pitch, preserves duration
             uint64_t dst_frames = src_frames;
@@ -2471,23 +2887,23 @@ static inline void _war_across_pitch_shift(war_env* env, uint32_t src_note, uint
                     dst[i*2+1] = (float)(src_data[si*2+1]*(1.0-fr) + src_data[(si+1)*2+1]*fr);
                 }
             }
-            uint32_t tidx = t * WAR_CAPTURE_SLOT_LAYERS + li;
-            free(env->capture_slots[tidx].samples);
-            env->capture_slots[tidx].samples = dst;
-            env->capture_slots[tidx].count = dst_cnt;
-            env->capture_slots[tidx].capacity = dst_cnt;
-            env->capture_slots[tidx].gain = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].gain;
-            env->capture_slots[tidx].pan = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].pan;
-            env->capture_slots[tidx].eq1 = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].eq1;
-            env->capture_slots[tidx].eq2 = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].eq2;
-            env->capture_slots[tidx].attack = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].attack;
-            env->capture_slots[tidx].sustain = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].sustain;
-            env->capture_slots[tidx].release = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].release;
-            env->capture_slots[tidx].effect_flags = env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].effect_flags;
-            memcpy(env->capture_slots[tidx].effect_params, env->capture_slots[src_note * WAR_CAPTURE_SLOT_LAYERS + li].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+            if (!war_slot_adopt(dst_slot, dst, dst_cnt)) continue;
         }
-    }
-    call_king_terry("ACROSS: pitch-shifted note=%u radius=%d resample=%d", src_note, rad, env->across_resample);
+        // rendered copies are already at pitch; linked slots add the offset
+        dst_slot->transpose = src->transpose + (linked ? semi : 0);
+        dst_slot->gain = src->gain;
+        dst_slot->pan = src->pan;
+        dst_slot->eq1 = src->eq1;
+        dst_slot->eq2 = src->eq2;
+        dst_slot->attack = src->attack;
+        dst_slot->sustain = src->sustain;
+        dst_slot->release = src->release;
+        dst_slot->effect_flags = src->effect_flags;
+        memcpy(dst_slot->effect_params, src->effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+    }
+    war_sample_unpack_free(src->samples, src_data);
+    call_king_terry("ACROSS: pitch-shifted note=%u radius=%d resample=%d root=%d", src_note, rad,
+                    env->across_resample, linked);
 }
 
 static inline void war_capture_audio(war_env* env) {
@@ -2498,14 +2914,8 @@ static inline void war_capture_audio(war_env* env) {
             uint32_t note = (uint32_t)(env->ctx_cursor->instance[0].pos[1] - (double)env->ctx_wayland->gutter_rows);
             if (note > 127) note = 127;
             uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-            free(env->capture_slots[idx].samples);
-            env->capture_slots[idx].samples = env->capture_accumulator;
-            env->capture_slots[idx].count = env->capture_accumulator_count;
-            env->capture_slots[idx].capacity =
-                env->capture_accumulator_capacity;
-            env->capture_accumulator = NULL;
-            env->capture_accumulator_count = 0;
-            env->capture_accumulator_capacity = 0;
+            war_slot_set_buf(&env->capture_slots[idx], war_spill_take(env));
+            env->capture_slots[idx].root = 0;
             // ACROSS: pitch-shift within radius
             if (env->across_mode) {
                 _war_across_pitch_shift(env, note, layer, env->across_radius);
@@ -2522,10 +2932,7 @@ static inline void war_capture_audio(war_env* env) {
             uint32_t note = (uint32_t)(env->ctx_cursor->instance[0].pos[1] - (double)env->ctx_wayland->gutter_rows);
             if (note > 127) note = 127;
             uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-            free(env->capture_slots[idx].samples);
-            env->capture_slots[idx].samples = NULL;
-            env->capture_slots[idx].count = 0;
-            env->capture_slots[idx].capacity = 0;
+            war_slot_clear(&env->capture_slots[idx]);
         }
         _war_mark_dirty(env);
         env->atomics->capture = 1;
@@ -2534,10 +2941,7 @@ static inline void war_capture_audio(war_env* env) {
         int _use_mic2 = _dcname && strstr(_dcname, "monitor") == NULL && strstr(_dcname, "loopback") == NULL;
         war_producer_consumer* _dcap2 = _use_mic2 ? env->pc_capture : env->pc_loopback;
         _dcap2->i_from_a = _dcap2->i_to_wr;
-        free(env->capture_accumulator);
-        env->capture_accumulator = NULL;
-        env->capture_accumulator_count = 0;
-        env->capture_accumulator_capacity = 0;
+        war_spill_begin(env);
         call_king_terry("CAPTURE: ON at note=%u layer=%u",
                         (uint32_t)(env->ctx_cursor->instance[0].pos[1] - (double)env->ctx_wayland->gutter_rows),
                         env->ctx_cursor->layer);
@@ -2627,14 +3031,10 @@ static inline void war_capture_advance(war_env* env) {
     uint32_t note = (uint32_t)(env->ctx_cursor->instance[0].pos[1] - (double)env->ctx_wayland->gutter_rows);
     if (note > 127) note = 127;
     uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-    if (env->capture_accumulator_count > 0) {
-        free(env->capture_slots[idx].samples);
-        env->capture_slots[idx].samples = env->capture_accumulator;
-        env->capture_slots[idx].count = env->capture_accumulator_count;
-        env->capture_slots[idx].capacity = env->capture_accumulator_capacity;
-        env->capture_accumulator = NULL;
-        env->capture_accumulator_count = 0;
-        env->capture_accumulator_capacity = 0;
+    war_sample_buf* take = war_spill_take(env);
+    if (take) {
+        war_slot_set_buf(&env->capture_slots[idx], take);
+        env->capture_slots[idx].root = 0;
         if (env->across_mode)
             _war_across_pitch_shift(env, note, layer, env->across_radius);
     }
@@ -2647,15 +3047,9 @@ static inline void war_capture_advance(war_env* env) {
     note = (uint32_t)(new_row - (double)env->ctx_wayland->gutter_rows);
     if (note > 127) note = 127;
     idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-    free(env->capture_slots[idx].samples);
-    env->capture_slots[idx].samples = NULL;
-    env->capture_slots[idx].count = 0;
-    env->capture_slots[idx].capacity = 0;
-    free(env->capture_accumulator);
-    env->capture_accumulator = NULL;
-    env->capture_accumulator_count = 0;
-    env->capture_accumulator_capacity = 0;
+    war_slot_clear(&env->capture_slots[idx]);
     env->pc_loopback->i_from_a = env->pc_loopback->i_to_wr;
+    war_spill_begin(env);
     call_king_terry("CAPTURE: advanced to note=%u", note);
 }
 
@@ -2895,12 +3289,14 @@ static inline void war_place_note(war_env* env) {
 
 // mark dirty without touching the undo tree: saved state no longer reachable via undo
 static inline void _war_mark_dirty(war_env* env) {
+    env->edit_seq++;
     env->file_dirty = 1;
     env->undo_save_marker = UINT32_MAX;
 }
 
 // recompute dirty from undo position vs the position saved at last save
 static inline void _war_update_dirty(war_env* env) {
+    env->edit_seq++;
     env->file_dirty = (env->undo_pos != env->undo_save_marker) ? 1 : 0;
 }
 
@@ -2911,25 +3307,22 @@ static inline void war_undo_save(war_env* env) {
     for (uint32_t i = env->undo_pos + 1; i < env->undo_count && i < WAR_UNDO_MAX; i++) {
         free(env->undo_notes[i]);
         env->undo_notes[i] = NULL;
-        free(env->undo_audio_data[i]);
-        env->undo_audio_data[i] = NULL;
-        env->undo_audio_size[i] = 0;
+        war_undo_audio_free(env->undo_audio[i]);
+        env->undo_audio[i] = NULL;
     }
     env->undo_count = env->undo_pos + 1;
     // shift if full
     if (env->undo_count > WAR_UNDO_MAX) {
         free(env->undo_notes[0]);
-        free(env->undo_audio_data[0]);
+        war_undo_audio_free(env->undo_audio[0]);
         for (uint32_t i = 1; i < WAR_UNDO_MAX; i++) {
             env->undo_notes[i - 1] = env->undo_notes[i];
             env->undo_note_counts[i - 1] = env->undo_note_counts[i];
-            env->undo_audio_data[i - 1] = env->undo_audio_data[i];
-            env->undo_audio_size[i - 1] = env->undo_audio_size[i];
+            env->undo_audio[i - 1] = env->undo_audio[i];
         }
         env->undo_notes[WAR_UNDO_MAX - 1] = NULL;
         env->undo_note_counts[WAR_UNDO_MAX - 1] = 0;
-        env->undo_audio_data[WAR_UNDO_MAX - 1] = NULL;
-        env->undo_audio_size[WAR_UNDO_MAX - 1] = 0;
+        env->undo_audio[WAR_UNDO_MAX - 1] = NULL;
         env->undo_count--;
         env->undo_pos--;
         if (env->undo_save_marker > 0)
@@ -2946,80 +3339,32 @@ static inline void war_undo_save(war_env* env) {
     if (env->undo_notes[idx])
         memcpy(env->undo_notes[idx], note->instance, sz);
     // free stale audio data at this index
-    free(env->undo_audio_data[idx]);
-    env->undo_audio_data[idx] = NULL;
-    env->undo_audio_size[idx] = 0;
+    war_undo_audio_free(env->undo_audio[idx]);
+    env->undo_audio[idx] = NULL;
     env->undo_pos++;
     if (env->undo_pos > env->undo_count)
         env->undo_count = env->undo_pos;
+    env->edit_seq++;
     env->file_dirty = 1;
 }
 
-// save current capture_slot state for the same slots encoded in entry save_idx-1
+// save current capture_slot state for the same slots referenced by entry save_idx-1
 static inline void _war_undo_save_current_audio(war_env* env, uint32_t save_idx) {
-    uint8_t* prev = env->undo_audio_data[save_idx - 1];
-    if (!prev || env->undo_audio_size[save_idx - 1] < 4) return;
-    uint32_t n = *(uint32_t*)prev;
-    if (n == 0 || n > 256) return;
+    war_undo_audio* prev = env->undo_audio[save_idx - 1];
+    if (!prev || prev->n == 0 || prev->n > 256) return;
     uint32_t slots[256];
-    uint8_t* rp = prev + 4;
-    for (uint32_t i = 0; i < n; i++) {
-        slots[i] = *(uint32_t*)rp; rp += 4;
-        uint64_t cnt = *(uint64_t*)rp; rp += 8;
-        rp += 8; // skip capacity
-        rp += cnt * sizeof(float);
-    }
-    uint64_t total = 4;
-    for (uint32_t i = 0; i < n; i++) {
-        total += 4 + 8 + 8 + env->capture_slots[slots[i]].count * sizeof(float);
-    }
-    uint8_t* buf = malloc(total);
-    if (!buf) return;
-    uint8_t* wp = buf;
-    *(uint32_t*)wp = n; wp += 4;
-    for (uint32_t i = 0; i < n; i++) {
-        war_capture_slot* sl = &env->capture_slots[slots[i]];
-        *(uint32_t*)wp = slots[i]; wp += 4;
-        *(uint64_t*)wp = sl->count; wp += 8;
-        *(uint64_t*)wp = sl->capacity; wp += 8;
-        if (sl->samples && sl->count > 0)
-            memcpy(wp, sl->samples, sl->count * sizeof(float));
-        wp += sl->count * sizeof(float);
-    }
-    free(env->undo_audio_data[save_idx]);
-    env->undo_audio_data[save_idx] = buf;
-    env->undo_audio_size[save_idx] = total;
+    for (uint32_t i = 0; i < prev->n; i++) slots[i] = prev->slot[i].idx;
+    war_undo_audio* cur = war_undo_audio_snapshot(env, slots, prev->n);
+    if (!cur) return;
+    war_undo_audio_free(env->undo_audio[save_idx]);
+    env->undo_audio[save_idx] = cur;
 }
 
 // restore capture_slot state from undo entry restore_idx
 static inline void _war_undo_restore_audio(war_env* env, uint32_t restore_idx) {
-    uint8_t* data = env->undo_audio_data[restore_idx];
-    if (!data || env->undo_audio_size[restore_idx] < 4) return;
-    uint32_t n = *(uint32_t*)data;
-    if (n == 0 || n > 256) return;
-    uint8_t* rp = data + 4;
-    for (uint32_t i = 0; i < n; i++) {
-        uint32_t si = *(uint32_t*)rp; rp += 4;
-        uint64_t cnt = *(uint64_t*)rp; rp += 8;
-        uint64_t cap = *(uint64_t*)rp; rp += 8;
-        if (si < 128 * WAR_CAPTURE_SLOT_LAYERS) {
-            war_capture_slot* sl = &env->capture_slots[si];
-            free(sl->samples);
-            if (cnt > 0) {
-                sl->samples = malloc(cnt * sizeof(float));
-                if (sl->samples) {
-                    memcpy(sl->samples, rp, cnt * sizeof(float));
-                    sl->count = cnt;
-                    sl->capacity = cap;
-                }
-            } else {
-                sl->samples = NULL;
-                sl->count = 0;
-                sl->capacity = 0;
-            }
-        }
-        rp += cnt * sizeof(float);
-    }
+    war_undo_audio* u = env->undo_audio[restore_idx];
+    if (!u || u->n == 0) return;
+    war_undo_audio_restore(env, u);
 }
 
 static inline void war_undo(war_env* env) {
@@ -3174,14 +3519,12 @@ static inline void war_delete_note_under_cursor(war_env* env) {
     }
 }
 
-// Copy slot params without sharing owned sample pointers (prevents double-free).
+// Copy slot params only; dst comes out empty and takes no buffer reference.
 static inline void _war_slot_clone_params(war_capture_slot* dst, const war_capture_slot* src) {
     if (!dst || !src) return;
-    free(dst->samples);
+    war_slot_clear(dst);
     *dst = *src;
-    dst->samples = NULL;
-    dst->count = 0;
-    dst->capacity = 0;
+    _war_slot_null_owned(dst);
 }
 
 // Split note at column cx on row cy. Left stays on src pitch; right moves to empty pitch above.
@@ -3216,11 +3559,12 @@ static inline void _war_split_at_col(war_env* env, float cx, float cy) {
     double bpm = env->atomics->bpm;
     if (bpm <= 0.0) bpm = 100.0;
     double sec_per_cell = 15.0 / bpm;
-    uint64_t split_frames = (uint64_t)((double)left_w * sec_per_cell * 48000.0);
+    war_capture_slot* src_slot = &env->capture_slots[src_idx];
+    // played frames to source frames for a transposed slot
+    uint64_t split_frames = (uint64_t)((double)left_w * sec_per_cell * 48000.0 * war_slot_rate(src_slot));
     if (split_frames < 1) return;
     uint64_t split_samples = split_frames * 2;
     if (split_samples & 1ULL) split_samples &= ~1ULL;
-    war_capture_slot* src_slot = &env->capture_slots[src_idx];
     if (!src_slot->samples || split_samples >= src_slot->count) return;
     uint64_t right_samples = src_slot->count - split_samples;
     if (right_samples & 1ULL) right_samples &= ~1ULL;
@@ -3237,54 +3581,21 @@ static inline void _war_split_at_col(war_env* env, float cx, float cy) {
     if (dest_pitch == UINT32_MAX || mi >= 128 * WAR_CAPTURE_SLOT_LAYERS) return;
     if (env->capture_slots[mi].samples && env->capture_slots[mi].count >= 2) return;
 
-    uint64_t src_size = src_slot->count * sizeof(float);
-    uint64_t dst_cnt = env->capture_slots[mi].count;
-    uint64_t dst_size = dst_cnt * sizeof(float);
-    uint64_t audio_total = 4 + 4+8+8+src_size + 4+8+8+dst_size;
-    uint8_t* audio_data = malloc(audio_total);
-    if (!audio_data) return;
-    {
-        uint8_t* p = audio_data;
-        *(uint32_t*)p = 2; p += 4;
-        *(uint32_t*)p = src_idx; p += 4;
-        *(uint64_t*)p = src_slot->count; p += 8;
-        *(uint64_t*)p = src_slot->capacity; p += 8;
-        if (src_slot->samples && src_slot->count > 0)
-            memcpy(p, src_slot->samples, src_size);
-        p += src_size;
-        *(uint32_t*)p = mi; p += 4;
-        *(uint64_t*)p = dst_cnt; p += 8;
-        *(uint64_t*)p = env->capture_slots[mi].capacity; p += 8;
-        if (env->capture_slots[mi].samples && dst_cnt > 0)
-            memcpy(p, env->capture_slots[mi].samples, dst_size);
-    }
+    uint32_t undo_slots[2] = {src_idx, mi};
+    war_undo_audio* audio = war_undo_audio_snapshot(env, undo_slots, 2);
+    if (!audio) return;
     war_undo_save(env);
     uint32_t audio_idx = env->undo_pos - 1;
-    free(env->undo_audio_data[audio_idx]);
-    env->undo_audio_data[audio_idx] = audio_data;
-    env->undo_audio_size[audio_idx] = audio_total;
-
-    // Allocate both halves first so we never leave shared ownership
-    float* left = malloc(split_samples * sizeof(float));
-    float* right = malloc(right_samples * sizeof(float));
-    if (!left || !right) {
-        free(left); free(right);
-        return;
-    }
-    memcpy(left, src_slot->samples, split_samples * sizeof(float));
-    memcpy(right, src_slot->samples + split_samples, right_samples * sizeof(float));
-
-    // LEFT stays on original pitch
-    free(src_slot->samples);
-    src_slot->samples = left;
-    src_slot->count = split_samples;
-    src_slot->capacity = split_samples;
+    war_undo_audio_free(env->undo_audio[audio_idx]);
+    env->undo_audio[audio_idx] = audio;
 
-    // RIGHT goes to empty pitch above (params copied, no shared buffers)
+    // RIGHT goes to empty pitch above: params copied, a view of the same buffer
     _war_slot_clone_params(&env->capture_slots[mi], src_slot);
-    env->capture_slots[mi].samples = right;
-    env->capture_slots[mi].count = right_samples;
-    env->capture_slots[mi].capacity = right_samples;
+    war_slot_share(&env->capture_slots[mi], src_slot);
+    war_slot_crop(&env->capture_slots[mi], split_samples, right_samples);
+
+    // LEFT stays on original pitch
+    war_slot_crop(src_slot, 0, split_samples);
 
     // Notes: original shortened to left; new note for right at dest pitch
     note->instance[best].size[0] = left_w;
@@ -3325,6 +3636,72 @@ static inline void war_split_at_playback(war_env* env) {
     _war_split_at_col(env, cx, cy);
 }
 
+// :pack <f32|f16|s16> [mono|stereo] — re-store the selected rows' audio in a
+// compact format; without a channel word, rows whose sides match go mono.
+// Linked rows follow their root and are packed with it.
+static inline void war_pack(war_env* env) {
+    war_cursor_context* cur = env->ctx_cursor;
+    if (!cur || !cur->instance_count) return;
+    const char* rest = env->cmd_len >= 5 ? env->cmd_buf + 5 : "";
+    while (*rest == ' ' || *rest == '\t') rest++;
+    uint8_t format;
+    if (strncmp(rest, "f32", 3) == 0) format = WAR_SAMPLE_F32;
+    else if (strncmp(rest, "f16", 3) == 0) format = WAR_SAMPLE_F16;
+    else if (strncmp(rest, "s16", 3) == 0) format = WAR_SAMPLE_S16;
+    else {
+        snprintf(env->status_msg, sizeof(env->status_msg), "usage: :pack <f32|f16|s16> [mono|stereo]");
+        return;
+    }
+    rest += 3;
+    while (*rest == ' ' || *rest == '\t') rest++;
+    uint8_t channels = 0;
+    if (strcmp(rest, "mono") == 0) channels = 1;
+    else if (strcmp(rest, "stereo") == 0) channels = 2;
+    else if (*rest) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "usage: :pack <f32|f16|s16> [mono|stereo]");
+        return;
+    }
+    uint32_t pitches[128];
+    int np = _war_sel_pitches(env, pitches);
+    if (np <= 0) return;
+    uint32_t slots[128];
+    uint32_t n = 0;
+    for (int i = 0; i < np; i++) {
+        war_capture_slot* s = _war_sel_slot(env, pitches[i]);
+        if (s->samples && s->count >= 2 && !s->root) slots[n++] = (uint32_t)(s - env->capture_slots);
+    }
+    if (!n) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "pack: nothing to pack");
+        return;
+    }
+    war_undo_audio* audio = war_undo_audio_snapshot(env, slots, n);
+    if (!audio) return;
+    war_undo_save(env);
+    uint32_t audio_idx = env->undo_pos - 1;
+    war_undo_audio_free(env->undo_audio[audio_idx]);
+    env->undo_audio[audio_idx] = audio;
+
+    uint64_t before = 0, after = 0;
+    uint32_t packed = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        war_capture_slot* s = &env->capture_slots[slots[i]];
+        uint64_t frames = s->count / 2;
+        uint64_t was = frames * war_sample_frame_bytes(s->buf->format, s->buf->channels);
+        const float* x = war_slot_unpack(s);
+        if (!x) continue;
+        uint8_t ch = channels ? channels : war_sample_dual_mono(x, s->count) ? 1 : 2;
+        war_sample_buf* b = war_sample_buf_pack(x, s->count, format, ch);
+        war_sample_unpack_free(s->samples, x);
+        if (!b) continue;
+        war_slot_set_buf(s, b);
+        before += was;
+        after += frames * war_sample_frame_bytes(format, ch);
+        packed++;
+    }
+    snprintf(env->status_msg, sizeof(env->status_msg), "pack %s: %u rows, %.1f -> %.1f MB",
+             war_sample_format_name(format), packed, (double)before / 1048576.0, (double)after / 1048576.0);
+}
+
 static inline void war_wave_view(war_env* env) {
     war_cursor_context* cur = env->ctx_cursor;
     if (!cur->instance_count) return;
@@ -0,0 +1,231 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_load.h — project audio read in parallel, installed as it arrives
+//
+// war_load_project walks the project file once and reads only the small
+// fields: bpm, the notes, and each slot's settings and the offset of its
+// audio. The notes show up and the slots get their settings straight away.
+// Blocks of WAR_PAGE_MAP_MIN bytes or more are mapped (war_page.h). The
+// rest are queued with war_load_queue.
+//
+// war_load_start hands the queue to a pool of up to WAR_LOAD_THREADS_MAX
+// threads. Each takes the next block off a shared counter and preads it
+// whole, WAR_LOAD_CHUNK bytes per call, into a fresh buffer, so the disk
+// sees many large requests in flight instead of one small read at a time.
+// war_load_poll runs from the main loop and installs finished blocks into
+// their slots. A slot that has been given other audio in the meantime keeps
+// it. Exports and saves call war_load_finish first, so they always see the
+// whole project.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_LOAD_H
+#define WAR_LOAD_H
+
+#include "war_data.h"
+#include "war_functions.h"
+#include "war_sample.h"
+#include "war_trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static inline void war_load_init(war_env* env) {
+    pthread_mutex_init(&env->load_mutex, NULL);
+    env->load_fd = -1;
+    env->load_jobs = NULL;
+    env->load_job_count = 0;
+    env->load_job_cap = 0;
+    env->load_done = NULL;
+    env->load_done_len = 0;
+    env->load_installed = 0;
+    env->load_thread_count = 0;
+    atomic_init(&env->load_next, 0);
+    atomic_init(&env->load_cancel, 0);
+    atomic_init(&env->load_worker_seq, 0);
+}
+
+// queues count floats stored as format/channels at byte off for slot idx;
+// 0 on OOM
+static inline int war_load_queue(war_env* env, uint32_t idx, uint64_t off, uint64_t bytes, uint64_t count,
+                                 uint8_t format, uint8_t channels) {
+    if (env->load_job_count == env->load_job_cap) {
+        uint32_t cap = env->load_job_cap ? env->load_job_cap * 2 : 64;
+        war_load_job* jobs = realloc(env->load_jobs, sizeof(war_load_job) * cap);
+        if (!jobs) return 0;
+        env->load_jobs = jobs;
+        env->load_job_cap = cap;
+    }
+    war_load_job* job = &env->load_jobs[env->load_job_count++];
+    job->idx = idx;
+    job->off = off;
+    job->bytes = bytes;
+    job->count = count;
+    job->format = format;
+    job->channels = channels;
+    job->buf = NULL;
+    return 1;
+}
+
+static inline int _war_load_pread(int fd, uint8_t* p, uint64_t bytes, uint64_t off) {
+    while (bytes) {
+        size_t n = bytes < WAR_LOAD_CHUNK ? (size_t)bytes : WAR_LOAD_CHUNK;
+        ssize_t r = pread(fd, p, n, (off_t)off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        p += r;
+        off += (uint64_t)r;
+        bytes -= (uint64_t)r;
+    }
+    return 1;
+}
+
+// trace keeps the pointer, so the names live here
+#if WAR_LOAD_THREADS_MAX != 8
+#error "war_load_worker_names needs one name per load thread"
+#endif
+static const char* const war_load_worker_names[WAR_LOAD_THREADS_MAX] = {
+    "load worker 0", "load worker 1", "load worker 2", "load worker 3",
+    "load worker 4", "load worker 5", "load worker 6", "load worker 7",
+};
+
+static void* _war_load_worker(void* arg) {
+    war_env* env = (war_env*)arg;
+    uint32_t n = atomic_fetch_add_explicit(&env->load_worker_seq, 1, memory_order_relaxed);
+    war_trace_thread_name(war_load_worker_names[n % WAR_LOAD_THREADS_MAX]);
+    for (;;) {
+        if (atomic_load_explicit(&env->load_cancel, memory_order_relaxed)) break;
+        uint32_t j = atomic_fetch_add(&env->load_next, 1);
+        if (j >= env->load_job_count) break;
+        war_load_job* job = &env->load_jobs[j];
+        uint64_t _tr = war_trace_begin();
+        float* data = malloc(job->bytes);
+        if (data && _war_load_pread(env->load_fd, (uint8_t*)data, job->bytes, job->off)) {
+            job->buf = war_sample_buf_wrap(data, job->count);
+            if (job->buf) {
+                job->buf->format = job->format;
+                job->buf->channels = job->channels;
+            }
+        } else {
+            free(data);
+        }
+        war_trace_end("load block", _tr);
+        // a failed block still counts, so the load completes
+        pthread_mutex_lock(&env->load_mutex);
+        env->load_done[env->load_done_len++] = j;
+        pthread_mutex_unlock(&env->load_mutex);
+    }
+    return NULL;
+}
+
+static inline void _war_load_join(war_env* env) {
+    for (uint32_t i = 0; i < env->load_thread_count; i++) pthread_join(env->load_threads[i], NULL);
+    env->load_thread_count = 0;
+}
+
+static inline void _war_load_reset(war_env* env) {
+    if (env->load_fd >= 0) close(env->load_fd);
+    env->load_fd = -1;
+    free(env->load_jobs);
+    free(env->load_done);
+    env->load_jobs = NULL;
+    env->load_done = NULL;
+    env->load_job_count = 0;
+    env->load_job_cap = 0;
+    env->load_done_len = 0;
+    env->load_installed = 0;
+    atomic_store(&env->load_next, 0);
+    atomic_store(&env->load_cancel, 0);
+}
+
+// drops a load in progress (and anything queued for the next one)
+static inline void war_load_cancel(war_env* env) {
+    atomic_store(&env->load_cancel, 1);
+    _war_load_join(env);
+    for (uint32_t i = 0; i < env->load_job_count; i++) war_sample_buf_unref(env->load_jobs[i].buf);
+    _war_load_reset(env);
+}
+
+static inline void war_load_shutdown(war_env* env) {
+    war_load_cancel(env);
+    pthread_mutex_destroy(&env->load_mutex);
+}
+
+// starts reading the queued blocks from fd, which the load now owns
+static inline void war_load_start(war_env* env, int fd) {
+    env->load_fd = fd;
+    env->load_start_us = war_get_monotonic_time_us();
+    env->load_threads_used = 1;
+    atomic_store(&env->load_worker_seq, 0);
+    env->load_done = env->load_job_count ? malloc(sizeof(uint32_t) * env->load_job_count) : NULL;
+    if (!env->load_done) {
+        war_load_cancel(env);
+        return;
+    }
+    if (fd < 0) {
+        // nothing to read with: every block comes back empty
+        for (uint32_t i = 0; i < env->load_job_count; i++) env->load_done[i] = i;
+        env->load_done_len = env->load_job_count;
+        return;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t want = cpus < 1 ? 1 : cpus > WAR_LOAD_THREADS_MAX ? WAR_LOAD_THREADS_MAX : (uint32_t)cpus;
+    if (want > env->load_job_count) want = env->load_job_count;
+    for (uint32_t i = 0; i < want; i++) {
+        if (pthread_create(&env->load_threads[env->load_thread_count], NULL, _war_load_worker, env) != 0) break;
+        env->load_thread_count++;
+    }
+    if (env->load_thread_count) env->load_threads_used = env->load_thread_count;
+    if (!env->load_thread_count) _war_load_worker(env); // no threads: read them here
+}
+
+// main thread: installs the blocks that have arrived. Returns how many.
+static inline uint32_t war_load_poll(war_env* env) {
+    if (!env->load_jobs || !env->load_done) return 0;
+    pthread_mutex_lock(&env->load_mutex);
+    uint32_t n = env->load_done_len;
+    pthread_mutex_unlock(&env->load_mutex);
+    uint32_t installed = 0;
+    for (; env->load_installed < n; env->load_installed++) {
+        war_load_job* job = &env->load_jobs[env->load_done[env->load_installed]];
+        war_capture_slot* s = &env->capture_slots[job->idx];
+        if (job->buf && !s->buf) {
+            war_slot_set_buf(s, job->buf);
+            installed++;
+        } else {
+            if (!job->buf) fprintf(stderr, "LOAD: slot %u: could not read its audio\n", job->idx);
+            war_sample_buf_unref(job->buf);
+        }
+        job->buf = NULL;
+    }
+    if (env->load_installed < env->load_job_count) return installed;
+    // all in: the workers are past their last block
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < env->load_job_count; i++) bytes += env->load_jobs[i].bytes;
+    double sec = (double)(war_get_monotonic_time_us() - env->load_start_us) / 1e6;
+    fprintf(stderr, "LOAD: read %u slot blocks (%.1f MB) in %.2fs on %u threads\n", env->load_job_count,
+            (double)bytes / 1e6, sec, env->load_threads_used);
+    _war_load_join(env);
+    _war_load_reset(env);
+    snprintf(env->status_msg, sizeof(env->status_msg), "%s", env->load_status);
+    return installed;
+}
+
+// main thread: waits for the rest of the project's audio and installs it
+static inline void war_load_finish(war_env* env) {
+    if (!env->load_jobs) return;
+    _war_load_join(env);
+    war_load_poll(env);
+}
+
+#endif // WAR_LOAD_H
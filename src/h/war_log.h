@@ -0,0 +1,350 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_log.h — real-time safe logging ring
+//
+// war_log_info() and friends may be called from any thread, including the
+// Pipewire process callbacks. A call copies a fixed-size binary record (time,
+// call site, printf arguments) into a lock-free ring and returns; nothing is
+// formatted and no syscall is made on the caller's thread. A background
+// drainer formats the records and writes them to stderr. When the ring is
+// full the record is dropped and counted.
+//
+// Levels below WAR_LOG_LEVEL compile to nothing. %s arguments are copied into
+// the record (WAR_LOG_STR bytes total, truncated), %n is not supported.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_LOG_H
+#define WAR_LOG_H
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define WAR_LOG_LEVEL_DEBUG 0
+#define WAR_LOG_LEVEL_INFO  1
+#define WAR_LOG_LEVEL_WARN  2
+#define WAR_LOG_LEVEL_ERROR 3
+
+#ifndef WAR_LOG_LEVEL
+#ifdef DEBUG
+#define WAR_LOG_LEVEL WAR_LOG_LEVEL_DEBUG
+#else
+#define WAR_LOG_LEVEL WAR_LOG_LEVEL_INFO
+#endif
+#endif
+
+#define WAR_LOG_RECORDS 1024 // power of two
+#define WAR_LOG_ARGS    8
+#define WAR_LOG_STR     48
+#define WAR_LOG_LINE    512
+#define WAR_LOG_IDLE_NS 5000000L
+
+typedef struct war_log_record {
+    _Atomic uint32_t seq; // ring sequence minus slot index, so zeroed = free
+    uint8_t level;
+    uint8_t argc;
+    uint16_t str_len;
+    uint32_t line;    // call site
+    const char* func; // call site
+    const char* fmt;  // string literal, formatted by the drainer
+    uint64_t ns;      // CLOCK_MONOTONIC
+    uint64_t arg[WAR_LOG_ARGS];
+    char str[WAR_LOG_STR];
+} war_log_record;
+
+typedef struct war_log_ring {
+    _Atomic uint32_t head;
+    uint32_t tail; // drainer only
+    _Atomic uint32_t dropped;
+    uint32_t dropped_reported;
+    _Atomic int stop;
+    int thread_alive;
+    pthread_t thread;
+    war_log_record rec[WAR_LOG_RECORDS];
+} war_log_ring;
+
+static war_log_ring war_log_ring_global;
+
+static inline uint64_t _war_log_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// walks one conversion spec starting after '%'. Returns the conversion char
+// and sets *len to the length modifier ('H' hh, 'h', 'l', 'q' ll, 'z', 'j',
+// 't', 'L' or 0) and *stars to the number of '*' width/precision args.
+static inline char _war_log_spec(const char** p, char* len, int* stars) {
+    const char* s = *p;
+    *len = 0;
+    *stars = 0;
+    while (*s && strchr("-+ #0", *s)) s++;
+    if (*s == '*') { (*stars)++; s++; }
+    while (*s >= '0' && *s <= '9') s++;
+    if (*s == '.') {
+        s++;
+        if (*s == '*') { (*stars)++; s++; }
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    if (*s == 'h') { s++; *len = 'h'; if (*s == 'h') { s++; *len = 'H'; } }
+    else if (*s == 'l') { s++; *len = 'l'; if (*s == 'l') { s++; *len = 'q'; } }
+    else if (*s && strchr("zjtL", *s)) *len = *s++;
+    char c = *s;
+    if (c) s++;
+    *p = s;
+    return c;
+}
+
+// lock-free multi-producer push (bounded MPMC sequence ring, single consumer)
+__attribute__((format(printf, 4, 5)))
+static inline void war_log_push(uint8_t level, const char* func, uint32_t line, const char* fmt, ...) {
+    war_log_ring* r = &war_log_ring_global;
+    uint32_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    war_log_record* rec;
+    for (;;) {
+        rec = &r->rec[pos & (WAR_LOG_RECORDS - 1)];
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire) + (pos & (WAR_LOG_RECORDS - 1));
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+    rec->level = level;
+    rec->func = func;
+    rec->line = line;
+    rec->fmt = fmt;
+    rec->ns = _war_log_now_ns();
+    rec->argc = 0;
+    rec->str_len = 0;
+    va_list ap;
+    va_start(ap, fmt);
+    for (const char* p = fmt; *p;) {
+        if (*p++ != '%') continue;
+        if (*p == '%') { p++; continue; }
+        char len;
+        int stars;
+        char c = _war_log_spec(&p, &len, &stars);
+        if (!c) break;
+        if (rec->argc + stars + 1 > WAR_LOG_ARGS) break;
+        for (int i = 0; i < stars; i++) rec->arg[rec->argc++] = (uint64_t)(int64_t)va_arg(ap, int);
+        uint64_t v = 0;
+        switch (c) {
+        case 'd': case 'i': {
+            int64_t x;
+            if (len == 'l') x = va_arg(ap, long);
+            else if (len == 'q') x = va_arg(ap, long long);
+            else if (len == 'z') x = (int64_t)va_arg(ap, size_t);
+            else if (len == 'j') x = va_arg(ap, intmax_t);
+            else if (len == 't') x = va_arg(ap, ptrdiff_t);
+            else x = va_arg(ap, int);
+            if (len == 'h') x = (short)x;
+            else if (len == 'H') x = (signed char)x;
+            v = (uint64_t)x;
+        } break;
+        case 'u': case 'x': case 'X': case 'o': {
+            if (len == 'l') v = va_arg(ap, unsigned long);
+            else if (len == 'q') v = va_arg(ap, unsigned long long);
+            else if (len == 'z') v = va_arg(ap, size_t);
+            else if (len == 'j') v = (uint64_t)va_arg(ap, uintmax_t);
+            else if (len == 't') v = (uint64_t)va_arg(ap, ptrdiff_t);
+            else v = va_arg(ap, unsigned int);
+            if (len == 'h') v = (unsigned short)v;
+            else if (len == 'H') v = (unsigned char)v;
+        } break;
+        case 'c':
+            v = (uint64_t)va_arg(ap, int);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double d = len == 'L' ? (double)va_arg(ap, long double) : va_arg(ap, double);
+            memcpy(&v, &d, sizeof(d));
+        } break;
+        case 's': {
+            const char* s = va_arg(ap, const char*);
+            if (!s) s = "(null)";
+            uint32_t off = rec->str_len;
+            uint32_t room = WAR_LOG_STR - off;
+            uint32_t n = 0;
+            if (room > 1) {
+                while (s[n] && n < room - 1) n++;
+                memcpy(rec->str + off, s, n);
+                rec->str[off + n] = '\0';
+                rec->str_len = (uint16_t)(off + n + 1);
+            }
+            v = room > 1 ? off : WAR_LOG_STR; // WAR_LOG_STR: out of room
+        } break;
+        case 'p':
+            v = (uint64_t)(uintptr_t)va_arg(ap, void*);
+            break;
+        default:
+            v = 0;
+            break;
+        }
+        rec->arg[rec->argc++] = v;
+    }
+    va_end(ap);
+    atomic_store_explicit(&rec->seq, pos + 1 - (pos & (WAR_LOG_RECORDS - 1)), memory_order_release);
+}
+
+// formats one record into out (drainer thread)
+static inline int _war_log_format(const war_log_record* rec, char* out, int size) {
+    static const char* tag[] = {"DEBUG: ", "", "WARN: ", "ERROR: "};
+    int n = snprintf(out, size, "- [%10.6f] %s", (double)rec->ns / 1e9,
+                     rec->level <= WAR_LOG_LEVEL_ERROR ? tag[rec->level] : "");
+    uint32_t a = 0;
+    for (const char* p = rec->fmt; *p && n < size - 1;) {
+        if (*p != '%') { out[n++] = *p++; continue; }
+        const char* start = p++;
+        if (*p == '%') { out[n++] = '%'; p++; continue; }
+        char len;
+        int stars;
+        char c = _war_log_spec(&p, &len, &stars);
+        if (!c) break;
+        if (a + stars + 1 > rec->argc) {
+            int k = (int)(p - start);
+            if (k > size - 1 - n) k = size - 1 - n;
+            memcpy(out + n, start, k);
+            n += k;
+            continue;
+        }
+        // rebuild the spec with '*' expanded and the length normalised to ll
+        char spec[64];
+        int sn = 0;
+        for (const char* q = start; q < p - 1 && sn < 40; q++) {
+            if (*q == '*') sn += snprintf(spec + sn, sizeof(spec) - sn, "%d", (int)(int64_t)rec->arg[a++]);
+            else if (!strchr("hlzjtL", *q)) spec[sn++] = *q;
+        }
+        uint64_t v = rec->arg[a++];
+        int w = 0;
+        switch (c) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            spec[sn++] = 'l';
+            spec[sn++] = 'l';
+            spec[sn++] = c;
+            spec[sn] = '\0';
+            if (c == 'd' || c == 'i') w = snprintf(out + n, size - n, spec, (long long)(int64_t)v);
+            else w = snprintf(out + n, size - n, spec, (unsigned long long)v);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double d;
+            memcpy(&d, &v, sizeof(d));
+            spec[sn++] = c;
+            spec[sn] = '\0';
+            w = snprintf(out + n, size - n, spec, d);
+        } break;
+        case 's':
+            spec[sn++] = 's';
+            spec[sn] = '\0';
+            w = snprintf(out + n, size - n, spec, v < WAR_LOG_STR ? rec->str + v : "...");
+            break;
+        case 'c':
+            spec[sn++] = 'c';
+            spec[sn] = '\0';
+            w = snprintf(out + n, size - n, spec, (int)v);
+            break;
+        case 'p':
+            spec[sn++] = 'p';
+            spec[sn] = '\0';
+            w = snprintf(out + n, size - n, spec, (void*)(uintptr_t)v);
+            break;
+        default:
+            break;
+        }
+        if (w > 0) n += w;
+        if (n > size - 1) n = size - 1;
+    }
+    out[n++] = '\n';
+    return n;
+}
+
+// drains every published record to stderr, returns the number written
+static inline uint32_t war_log_drain(void) {
+    war_log_ring* r = &war_log_ring_global;
+    char line[WAR_LOG_LINE];
+    uint32_t count = 0;
+    for (;;) {
+        uint32_t slot = r->tail & (WAR_LOG_RECORDS - 1);
+        war_log_record* rec = &r->rec[slot];
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire) + slot;
+        if (seq != r->tail + 1) break;
+        int n = _war_log_format(rec, line, (int)sizeof(line) - 1);
+        fwrite(line, 1, (size_t)n, stderr);
+        atomic_store_explicit(&rec->seq, r->tail + WAR_LOG_RECORDS - slot, memory_order_release);
+        r->tail++;
+        count++;
+    }
+    uint32_t dropped = atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    if (dropped != r->dropped_reported) {
+        fprintf(stderr, "- log: %u records dropped (ring full)\n", dropped - r->dropped_reported);
+        r->dropped_reported = dropped;
+    }
+    if (count) fflush(stderr);
+    return count;
+}
+
+static inline void* _war_log_drainer(void* arg) {
+    (void)arg;
+    struct timespec idle = {0, WAR_LOG_IDLE_NS};
+    while (!atomic_load_explicit(&war_log_ring_global.stop, memory_order_acquire)) {
+        if (!war_log_drain()) nanosleep(&idle, NULL);
+    }
+    war_log_drain();
+    return NULL;
+}
+
+// records pushed before init are kept and written once the drainer starts
+static inline void war_log_init(void) {
+    war_log_ring* r = &war_log_ring_global;
+    if (r->thread_alive) return;
+    atomic_store(&r->stop, 0);
+    if (pthread_create(&r->thread, NULL, _war_log_drainer, NULL) == 0) r->thread_alive = 1;
+    else fprintf(stderr, "- log: drainer thread failed, logging synchronously on drain\n");
+}
+
+static inline void war_log_shutdown(void) {
+    war_log_ring* r = &war_log_ring_global;
+    if (!r->thread_alive) {
+        war_log_drain();
+        return;
+    }
+    atomic_store_explicit(&r->stop, 1, memory_order_release);
+    pthread_join(r->thread, NULL);
+    r->thread_alive = 0;
+}
+
+#define WAR_LOG_AT(level, fmt, ...) war_log_push((level), __func__, __LINE__, "" fmt, ##__VA_ARGS__)
+
+#if WAR_LOG_LEVEL <= WAR_LOG_LEVEL_DEBUG
+#define war_log_debug(fmt, ...) WAR_LOG_AT(WAR_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define war_log_debug(fmt, ...) ((void)0)
+#endif
+#if WAR_LOG_LEVEL <= WAR_LOG_LEVEL_INFO
+#define war_log_info(fmt, ...) WAR_LOG_AT(WAR_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define war_log_info(fmt, ...) ((void)0)
+#endif
+#if WAR_LOG_LEVEL <= WAR_LOG_LEVEL_WARN
+#define war_log_warn(fmt, ...) WAR_LOG_AT(WAR_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define war_log_warn(fmt, ...) ((void)0)
+#endif
+#define war_log_error(fmt, ...) WAR_LOG_AT(WAR_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#endif // WAR_LOG_H
@@ -0,0 +1,463 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_mix.h — voice mixer and per-note export render
+//
+// The main loop produces audio one WAR_MIX_CHUNK_FLOATS chunk at a time:
+// war_mix_voices() runs every live preview and playbar voice through
+// autotune, the per-sample effects, the delay lines, COMPRESS2, EQ and ADSR
+// into the chunk and returns the reverb buses, war_mix_master() applies master
+// gain and the master limiter, and war_mix_advance() moves the voices on.
+// war_export_note() renders one note of a wwav export through the same chain.
+// Transposed slots are read through war_resample.h in both, and skip autotune
+// (its analysis runs on the untransposed source). Packed slots (war_sample.h
+// formats) are decoded a block at a time and play autotune dry; the export
+// unpacks them once per note and keeps it.
+// Nothing here touches Wayland, Vulkan or Pipewire, so bench/war_bench.c
+// drives it against a calloc'd env.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_MIX_H
+#define WAR_MIX_H
+
+#include "war_data.h"
+#include "war_keymap_functions.h"
+#include "war_resample.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAR_MIX_CHUNK_FLOATS 64 // 32 stereo frames
+// minimum anti-click fade (~5.3ms @ 48kHz), in stereo float samples
+#define WAR_CLICK_FADE_FLOATS (256ULL * 2ULL)
+
+// EQ1/EQ2 sweepable one-pole pass filters, state in es[15..20]
+static inline void _war_process_eq(war_capture_slot* slot, float* _es, float* l, float* r) {
+    float _s_l = *l, _s_r = *r;
+    if (slot->eq1) {
+        float _ae1 = (float)fabsf((float)slot->eq1);
+        float _fc1 = slot->eq1 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae1 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae1 / 1000.0f);
+        float _at1 = 1.0f - expf(-2.0f * (float)M_PI * _fc1 / 48000.0f); if (_at1 > 1.0f) _at1 = 1.0f;
+        _es[15] += 0.2f * (_at1 - _es[15]);
+        float _lp1l = _es[16] + _es[15] * (_s_l - _es[16]); _es[16] = _lp1l;
+        float _lp1r = _es[17] + _es[15] * (_s_r - _es[17]); _es[17] = _lp1r;
+        float _hp1l = _s_l - _lp1l, _hp1r = _s_r - _lp1r;
+        float _t1 = (float)slot->eq1 / 1000.0f; if(_t1<0)_t1=-_t1; if(_t1>1)_t1=1;
+        if (slot->eq1 <= 0) { _s_l = _s_l * (1-_t1) + _lp1l * _t1; _s_r = _s_r * (1-_t1) + _lp1r * _t1; }
+        else { _s_l = _s_l * (1-_t1) + _hp1l * _t1; _s_r = _s_r * (1-_t1) + _hp1r * _t1; }
+    } else { _es[15] = 0; _es[16] = _s_l; _es[17] = _s_r; }
+    if (slot->eq2) {
+        float _ae2 = (float)fabsf((float)slot->eq2);
+        float _fc2 = slot->eq2 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae2 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae2 / 1000.0f);
+        float _at2 = 1.0f - expf(-2.0f * (float)M_PI * _fc2 / 48000.0f); if (_at2 > 1.0f) _at2 = 1.0f;
+        _es[18] += 0.2f * (_at2 - _es[18]);
+        float _lp2l = _es[19] + _es[18] * (_s_l - _es[19]); _es[19] = _lp2l;
+        float _lp2r = _es[20] + _es[18] * (_s_r - _es[20]); _es[20] = _lp2r;
+        float _hp2l = _s_l - _lp2l, _hp2r = _s_r - _lp2r;
+        float _t2 = (float)slot->eq2 / 1000.0f; if(_t2<0)_t2=-_t2; if(_t2>1)_t2=1;
+        if (slot->eq2 <= 0) { _s_l = _s_l * (1-_t2) + _lp2l * _t2; _s_r = _s_r * (1-_t2) + _lp2r * _t2; }
+        else { _s_l = _s_l * (1-_t2) + _hp2l * _t2; _s_r = _s_r * (1-_t2) + _hp2r * _t2; }
+    } else { _es[18] = 0; _es[19] = _s_l; _es[20] = _s_r; }
+    *l = _s_l;
+    *r = _s_r;
+}
+
+// mixes one chunk of every live voice into mix (WAR_MIX_CHUNK_FLOATS, zeroed
+// here); voice_batch receives the floats each voice consumed. Returns nonzero
+// while any voice or reverb tail is still sounding.
+static inline int war_mix_voices(war_env* env, float* mix, uint64_t* voice_batch) {
+    int any_active = 0;
+    memset(mix, 0, sizeof(float) * WAR_MIX_CHUNK_FLOATS);
+    // mix preview voices
+    for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) {
+        voice_batch[v] = 0;
+        if (!env->preview_voice_active[v]) continue;
+        uint32_t note = env->preview_voice_note[v];
+        if (note > 127) note = 127;
+        uint32_t layer = env->preview_voice_layer[v];
+        if (layer < 1 || layer > 9) {
+            env->preview_voice_active[v] = 0;
+            continue;
+        }
+        if (!(env->layer_visible & (1 << (layer - 1)))) {
+            env->preview_voice_active[v] = 0;
+            continue;
+        }
+        uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
+        war_capture_slot* slot = &env->capture_slots[idx];
+        float* _aud = slot->samples;
+        uint64_t _aud_count = war_slot_play_count(slot);
+        if (!_aud || _aud_count < 2) {
+            env->preview_voice_active[v] = 0;
+            continue;
+        }
+        uint64_t read_pos = env->preview_voice_read_pos[v];
+        uint64_t slot_avail = _aud_count;
+        uint64_t read_limit = env->preview_voice_read_limit[v];
+        if (read_limit > 0 && read_limit < slot_avail)
+            slot_avail = read_limit;
+        if (read_pos >= slot_avail) {
+            if (env->loop_mode) {
+                env->preview_voice_read_pos[v] = 0;
+                read_pos = 0;
+            } else {
+                env->preview_voice_active[v] = 0;
+                continue;
+            }
+        }
+        uint64_t avail = slot_avail - read_pos;
+        if (avail < 2) {
+            if (env->loop_mode) {
+                env->preview_voice_read_pos[v] = 0;
+                read_pos = 0;
+                avail = slot_avail;
+            } else {
+                env->preview_voice_active[v] = 0;
+                continue;
+            }
+        }
+        uint64_t batch = avail < WAR_MIX_CHUNK_FLOATS ?
+                             (avail & ~1ULL) :
+                             WAR_MIX_CHUNK_FLOATS;
+        voice_batch[v] = batch;
+        float _gm = (slot->gain + 500000.0f) / 500000.0f;
+        float _pp = (float)(slot->pan + 1000) / 2000.0f;
+        float _pl = sinf((1.0f - _pp) * (float)(M_PI / 2.0));
+        float _pr = sinf(_pp * (float)(M_PI / 2.0));
+        war_reverb_bus* _rb = NULL;
+        float _rmix = 0.0f;
+        if (_war_effect_active(slot, WAR_EFFECT_REVERB)) {
+            _rb = _war_reverb_bus_get(env->reverb_bus, WAR_REVERB_BUSES, &env->reverb_bus_active, idx);
+            _rmix = (float)_war_effect_get_param(slot, WAR_EFFECT_REVERB, 1);
+            if (_rb) _rb->fed = 1;
+        }
+        float _blk[WAR_MIX_CHUNK_FLOATS];
+        if (slot->transpose)
+            war_resample_slot(env, slot, read_pos, _blk, batch);
+        else if (!_war_process_autotune(env, slot, &env->preview_voice_autotune[v],
+                                        env->preview_voice_delay_line[v], read_pos, _blk, batch))
+            war_slot_read(slot, read_pos, _blk, batch);
+        for (uint64_t f = 0; f < batch; f += 2)
+            _war_process_effects(slot, env->preview_voice_effect_state[v], &_blk[f], &_blk[f + 1]);
+        _war_process_line_effects(env, slot, env->preview_voice_effect_state[v],
+                                  env->preview_voice_delay_line[v], env->preview_voice_delay_pos[v], _blk, batch);
+        _war_process_compress2(slot, &env->preview_voice_limiter[v], _blk, batch);
+        for (uint64_t f = 0; f < batch; f += 2) {
+            float _s_l = _blk[f];
+            float _s_r = _blk[f + 1];
+            _war_process_eq(slot, env->preview_voice_effect_state[v], &_s_l, &_s_r);
+            float _mix_l = _s_l, _mix_r = _s_r;
+            float _a_g = _gm;
+            // stereo float units (2 samples/frame); enforce min anti-click fade
+            float _atk_samples = slot->attack / 1000.0f * 48000.0f * 2.0f;
+            float _sus_level = (slot->sustain + 1000.0f) / 1000.0f;
+            float _rel_samples = slot->release / 1000.0f * 48000.0f * 2.0f;
+            if (_atk_samples < (float)WAR_CLICK_FADE_FLOATS) _atk_samples = (float)WAR_CLICK_FADE_FLOATS;
+            if (_rel_samples < (float)WAR_CLICK_FADE_FLOATS) _rel_samples = (float)WAR_CLICK_FADE_FLOATS;
+            int64_t _rem_preview = (int64_t)(slot_avail - read_pos) - (int64_t)f;
+            float _env = _sus_level;
+            if (_atk_samples > 0.0f) {
+                uint64_t _elapsed = env->preview_voice_env_samples[v] + (uint64_t)f;
+                if (_elapsed < (uint64_t)_atk_samples)
+                    _env = (float)_elapsed / _atk_samples * _sus_level;
+            }
+            // scale current env (don't jump to full sustain mid-attack)
+            if (_rem_preview < (int64_t)_rel_samples) {
+                if (_rem_preview <= 0) _env = 0.0f;
+                else _env *= (float)_rem_preview / _rel_samples;
+            }
+            _a_g *= _env * env->preview_voice_gain[v];
+            mix[f]   += _mix_l * _a_g * _pl;
+            mix[f+1] += _mix_r * _a_g * _pr;
+            if (_rb) {
+                _rb->send[f]   += _mix_l * _a_g * _pl * _rmix;
+                _rb->send[f+1] += _mix_r * _a_g * _pr * _rmix;
+            }
+            }
+            any_active = 1;
+        }
+        // mix playbar voices
+    if (env->play_bar_playing) {
+        for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) {
+            uint32_t vi = WAR_PREVIEW_VOICES + v;
+            voice_batch[vi] = 0;
+            if (env->play_bar_voice_active[v] != 1) continue;
+            uint32_t note = env->play_bar_voice_note[v];
+            if (note > 127) note = 127;
+            uint32_t layer = env->play_bar_voice_layer[v];
+            if (layer < 1 || layer > 9) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            if (!(env->layer_visible & (1 << (layer - 1)))) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            if (env->play_bar_mute_mask & (1 << (layer - 1))) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
+            war_capture_slot* slot = &env->capture_slots[idx];
+            float* _aud2 = slot->samples;
+            uint64_t _aud2_count = war_slot_play_count(slot);
+            uint64_t read_pos = env->play_bar_voice_read_pos[v];
+            uint64_t read_limit = env->play_bar_voice_read_limit[v];
+            if (read_pos >= read_limit) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            uint64_t slot_avail = _aud2_count;
+            if (!_aud2 || slot_avail == 0) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            if (read_pos >= slot_avail) {
+                env->play_bar_voice_active[v] = 0;
+                continue;
+            }
+            uint64_t remain = read_limit - read_pos;
+            if (remain < slot_avail && remain < WAR_MIX_CHUNK_FLOATS) {
+                if (remain < 2) {
+                    env->play_bar_voice_active[v] = 0;
+                    continue;
+                }
+            }
+            uint64_t batch = WAR_MIX_CHUNK_FLOATS;
+            if (batch > remain) batch = remain & ~1ULL;
+            // don't cross slot boundary within a batch
+            uint64_t slot_offset = read_pos;
+            uint64_t to_slot_end = slot_avail - slot_offset;
+            if (batch > to_slot_end) batch = to_slot_end & ~1ULL;
+            voice_batch[vi] = batch;
+            if (batch == 0) { env->play_bar_voice_active[v] = 0; continue; }
+            float _gm = (slot->gain + 500000.0f) / 500000.0f;
+            float _pp2 = (float)(slot->pan + 1000) / 2000.0f;
+            float _pl2 = sinf((1.0f - _pp2) * (float)(M_PI / 2.0));
+            float _pr2 = sinf(_pp2 * (float)(M_PI / 2.0));
+            war_reverb_bus* _rb2 = NULL;
+            float _rmix2 = 0.0f;
+            if (_war_effect_active(slot, WAR_EFFECT_REVERB)) {
+                _rb2 = _war_reverb_bus_get(env->reverb_bus, WAR_REVERB_BUSES, &env->reverb_bus_active, idx);
+                _rmix2 = (float)_war_effect_get_param(slot, WAR_EFFECT_REVERB, 1);
+                if (_rb2) _rb2->fed = 1;
+            }
+            float _blk2[WAR_MIX_CHUNK_FLOATS];
+            if (slot->transpose)
+                war_resample_slot(env, slot, slot_offset, _blk2, batch);
+            else if (!_war_process_autotune(env, slot, &env->play_bar_voice_autotune[v],
+                                            env->play_bar_voice_delay_line[v], slot_offset, _blk2, batch))
+                war_slot_read(slot, slot_offset, _blk2, batch);
+            for (uint64_t f = 0; f < batch; f += 2)
+                _war_process_effects(slot, env->play_bar_voice_effect_state[v], &_blk2[f], &_blk2[f + 1]);
+            _war_process_line_effects(env, slot, env->play_bar_voice_effect_state[v],
+                                      env->play_bar_voice_delay_line[v], env->play_bar_voice_delay_pos[v], _blk2, batch);
+            _war_process_compress2(slot, &env->play_bar_voice_limiter[v], _blk2, batch);
+            for (uint64_t f = 0; f < batch; f += 2) {
+                float _s_l = _blk2[f];
+                float _s_r = _blk2[f + 1];
+                _war_process_eq(slot, env->play_bar_voice_effect_state[v], &_s_l, &_s_r);
+                float _mix_l = _s_l, _mix_r = _s_r;
+                float _a_g2 = _gm;
+                float _atk_s = slot->attack / 1000.0f * 48000.0f * 2.0f;
+                float _sus_l = (slot->sustain + 1000.0f) / 1000.0f;
+                float _rel_s = slot->release / 1000.0f * 48000.0f * 2.0f;
+                if (_atk_s < (float)WAR_CLICK_FADE_FLOATS) _atk_s = (float)WAR_CLICK_FADE_FLOATS;
+                if (_rel_s < (float)WAR_CLICK_FADE_FLOATS) _rel_s = (float)WAR_CLICK_FADE_FLOATS;
+                int64_t _rem_playbar = (int64_t)remain - (int64_t)f;
+                float _env2 = _sus_l;
+                if (_atk_s > 0.0f) {
+                    uint64_t _elapsed2 = env->play_bar_voice_env_samples[v] + (uint64_t)f;
+                    if (_elapsed2 < (uint64_t)_atk_s)
+                        _env2 = (float)_elapsed2 / _atk_s * _sus_l;
+                }
+                if (_rem_playbar < (int64_t)_rel_s) {
+                    if (_rem_playbar <= 0) _env2 = 0.0f;
+                    else _env2 *= (float)_rem_playbar / _rel_s;
+                }
+                _a_g2 *= _env2;
+                mix[f]   += _mix_l * _a_g2 * _pl2;
+                mix[f+1] += _mix_r * _a_g2 * _pr2;
+                if (_rb2) {
+                    _rb2->send[f]   += _mix_l * _a_g2 * _pl2 * _rmix2;
+                    _rb2->send[f+1] += _mix_r * _a_g2 * _pr2 * _rmix2;
+                }
+            }
+            any_active = 1;
+        }
+    }
+    // reverb return: one FDN per active bus, tails keep ringing after voices end
+    if (env->reverb_bus_active) {
+        for (uint32_t b = 0; b < WAR_REVERB_BUSES; b++) {
+            war_reverb_bus* _rb = &env->reverb_bus[b];
+            if (!_rb->active) continue;
+            war_capture_slot* _rs = &env->capture_slots[_rb->slot];
+            float _pk = _war_reverb_bus_process(_rb, _rs, _rb->send, mix, WAR_MIX_CHUNK_FLOATS);
+            memset(_rb->send, 0, sizeof(_rb->send));
+            _war_reverb_bus_settle(_rb, &env->reverb_bus_active, _pk, WAR_MIX_CHUNK_FLOATS / 2,
+                                   _war_effect_get_param(_rs, WAR_EFFECT_REVERB, 2));
+        }
+        if (env->reverb_bus_active) any_active = 1;
+    }
+    return any_active;
+}
+
+static inline void war_mix_master(war_env* env, float* mix) {
+    if (env->master_gain != 0.0f) {
+        float _mg_live = (env->master_gain + 500000.0f) / 500000.0f;
+        for (int _mf = 0; _mf < WAR_MIX_CHUNK_FLOATS; _mf++)
+            mix[_mf] *= _mg_live;
+    }
+    if (env->master_limit_active)
+        _war_limiter_process(&env->master_limiter, env->master_limit_params, mix, WAR_MIX_CHUNK_FLOATS);
+}
+
+static inline void war_mix_advance(war_env* env, const uint64_t* voice_batch) {
+    // advance preview read positions
+    for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) {
+        env->preview_voice_read_pos[v] += voice_batch[v];
+        if (env->preview_voice_active[v])
+            env->preview_voice_env_samples[v] += voice_batch[v];
+    }
+    // advance playbar read positions
+    if (env->play_bar_playing) {
+        for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) {
+            env->play_bar_voice_read_pos[v] += voice_batch[WAR_PREVIEW_VOICES + v];
+            if (env->play_bar_voice_active[v] == 1)
+                env->play_bar_voice_env_samples[v] += voice_batch[WAR_PREVIEW_VOICES + v];
+        }
+    }
+}
+
+// renders _nf frames of note slot idx (sounding _src_frames in total) into out,
+// and into _send scaled by _rmix when the slot feeds a reverb bus; both start at
+// the note's first frame. _xline is scratch for :delay/:chorus, WAR_DELAY_LINE_KINDS
+// lines of 2 * delay_pool_frames floats, or NULL. Returns 0 when out of memory.
+static inline int war_export_note(war_env* env, uint32_t idx, uint64_t _nf, uint64_t _src_frames,
+                                  float* out, float* _send, float _rmix, float* _xline) {
+    const float* _s = NULL; // plain floats, unpacked on first use
+    uint64_t _sc = env->capture_slots[idx].count;
+    float _sg = (env->capture_slots[idx].gain + 500000.0f) / 500000.0f;
+    int _sp = env->capture_slots[idx].pan;
+    float _pe = (float)(_sp + 1000) / 2000.0f;
+    float _ple = sinf((1.0f - _pe) * (float)(M_PI / 2.0));
+    float _pre = sinf(_pe * (float)(M_PI / 2.0));
+    float _exp_lp0 = 0.0f, _exp_lp1 = 0.0f;
+    int _eq_val = env->capture_slots[idx].eq1;
+    // ADSR envelope (min ~5ms anti-click fade)
+    uint64_t _min_fade = 256;
+    uint64_t _atk_f = env->capture_slots[idx].attack > 0 ? (uint64_t)(env->capture_slots[idx].attack / 1000.0f * 48000.0f) : _min_fade;
+    if (_atk_f < _min_fade) _atk_f = _min_fade;
+    float _sus_lvl = (env->capture_slots[idx].sustain + 1000.0f) / 1000.0f;
+    uint64_t _rel_f = env->capture_slots[idx].release > 0 ? (uint64_t)(env->capture_slots[idx].release / 1000.0f * 48000.0f) : _min_fade;
+    if (_rel_f < _min_fade) _rel_f = _min_fade;
+    if (_sus_lvl < 0.0f) _sus_lvl = 0.0f;
+    if (_sus_lvl > 2.0f) _sus_lvl = 2.0f;
+    if (_atk_f > _src_frames / 2) _atk_f = _src_frames / 2;
+    if (_rel_f > _src_frames / 2) _rel_f = _src_frames / 2;
+    float _exp_eff[32] = {0}; // matches playback: all state starts zeroed
+    float _exp_alpha = 0.0f;
+    // autotune (or the transposed read) leads the chain like playback, rendered
+    // once for the note
+    float* _at = NULL;
+    if (env->capture_slots[idx].transpose) {
+        _at = war_resample_render(env, &env->capture_slots[idx], _nf * 2);
+        if (!_at) return 0;
+    } else {
+        _s = war_slot_unpack(&env->capture_slots[idx]);
+        if (!_s) return 0;
+        if (_war_effect_active(&env->capture_slots[idx], WAR_EFFECT_AUTOTUNE))
+            _at = war_autotune_render_copy(_s, _sc, _src_frames * 2,
+                                           _war_effect_get_param(&env->capture_slots[idx], WAR_EFFECT_AUTOTUNE, 0));
+    }
+    uint32_t _xpos[WAR_DELAY_LINE_KINDS] = {0};
+    uint8_t _xdelay = _war_effect_active(&env->capture_slots[idx], WAR_EFFECT_DELAY);
+    uint8_t _xchorus = _war_effect_active(&env->capture_slots[idx], WAR_EFFECT_CHORUS);
+    uint64_t _xline_floats = (uint64_t)2 * env->delay_pool_frames;
+    if (_xline && (_xdelay || _xchorus)) memset(_xline, 0, sizeof(float) * _xline_floats * WAR_DELAY_LINE_KINDS);
+    // note renders through the effect chain first so COMPRESS2 can see ahead
+    float* _nb = _nf ? malloc(sizeof(float) * _nf * 2) : NULL;
+    if (!_nb) {
+        free(_at);
+        war_sample_unpack_free(env->capture_slots[idx].samples, _s);
+        return 0;
+    }
+    for (uint64_t f = 0; f < _nf; f++) {
+        float _sl = _at ? _at[f * 2 + 0] : _s[f * 2 + 0];
+        float _sr = _at ? _at[f * 2 + 1] : _s[f * 2 + 1];
+        if (f == 0) { _exp_lp0 = _sl; _exp_lp1 = _sr; }
+        // PASS filter (one-pole, same as playback)
+        float _ae = (float)fabsf((float)_eq_val);
+        float _fc;
+        if (_eq_val <= 0)
+            _fc = 20000.0f * expf(logf(20.0f / 20000.0f) * _ae / 1000.0f);
+        else
+            _fc = 20.0f * expf(logf(20000.0f / 20.0f) * _ae / 1000.0f);
+        float _alpha_target = 1.0f - expf(-2.0f * (float)M_PI * _fc / 48000.0f);
+        if (_alpha_target > 1.0f) _alpha_target = 1.0f;
+        _exp_alpha += 0.2f * (_alpha_target - _exp_alpha);
+        float _lpt = _exp_lp0 + _exp_alpha * (_sl - _exp_lp0);
+        float _lpt2 = _exp_lp1 + _exp_alpha * (_sr - _exp_lp1);
+        float _hp0 = _sl - _lpt, _hp1 = _sr - _lpt2;
+        _exp_lp0 = _lpt; _exp_lp1 = _lpt2;
+        if (_eq_val <= 0) {
+            float _t = (float)(-_eq_val) / 1000.0f;
+            _sl = _sl * (1.0f - _t) + _lpt * _t;
+            _sr = _sr * (1.0f - _t) + _lpt2 * _t;
+        } else {
+            float _t = (float)_eq_val / 1000.0f;
+            _sl = _sl * (1.0f - _t) + _hp0 * _t;
+            _sr = _sr * (1.0f - _t) + _hp1 * _t;
+        }
+        // apply real-time effects (no-op when no effects active)
+        _war_process_effects(&env->capture_slots[idx], _exp_eff, &_sl, &_sr);
+        if (_xline && (_xdelay || _xchorus)) {
+            float _xf[2] = {_sl, _sr};
+            if (_xdelay)
+                _war_process_delay_block(&env->capture_slots[idx], _exp_eff, _xline, env->delay_pool_frames,
+                                         &_xpos[WAR_DELAY_LINE_DELAY], _xf, 2);
+            if (_xchorus)
+                _war_process_chorus_block(&env->capture_slots[idx], _exp_eff, _xline + _xline_floats,
+                                          env->delay_pool_frames, &_xpos[WAR_DELAY_LINE_CHORUS], _xf, 2);
+            _sl = _xf[0]; _sr = _xf[1];
+        }
+        _nb[f * 2 + 0] = _sl;
+        _nb[f * 2 + 1] = _sr;
+    }
+    if (_war_effect_active(&env->capture_slots[idx], WAR_EFFECT_COMPRESS2)) {
+        war_limiter* _xlim = calloc(1, sizeof(war_limiter));
+        double _c2[WAR_EFFECT_PARAMS];
+        for (int p = 0; p < WAR_EFFECT_PARAMS; p++)
+            _c2[p] = _war_effect_get_param(&env->capture_slots[idx], WAR_EFFECT_COMPRESS2, p);
+        if (_xlim) _war_limiter_process_aligned(_xlim, _c2, _nb, _nf * 2);
+        free(_xlim);
+    }
+    for (uint64_t f = 0; f < _nf; f++) {
+        float _sl = _nb[f * 2 + 0];
+        float _sr = _nb[f * 2 + 1];
+        // apply ADSR envelope
+        float _env = _sus_lvl;
+        uint64_t _rel_start = _src_frames > _rel_f ? _src_frames - _rel_f : 0;
+        if (f < _atk_f && _atk_f > 0) _env = (float)(f + 1) / (float)_atk_f * _sus_lvl;
+        if (f >= _rel_start && _rel_f > 0) _env = _sus_lvl * (float)(_src_frames - f) / (float)_rel_f;
+        if (_env < 0.0f) _env = 0.0f;
+        out[f * 2 + 0] += _sl * _sg * _ple * _env;
+        out[f * 2 + 1] += _sr * _sg * _pre * _env;
+        if (_send) {
+            _send[f * 2 + 0] += _sl * _sg * _ple * _env * _rmix;
+            _send[f * 2 + 1] += _sr * _sg * _pre * _env * _rmix;
+        }
+    }
+    free(_nb);
+    free(_at);
+    war_sample_unpack_free(env->capture_slots[idx].samples, _s);
+    return 1;
+}
+
+#endif // WAR_MIX_H
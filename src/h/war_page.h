@@ -0,0 +1,134 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_page.h — file-backed slot audio paged in ahead of the playbar
+//
+// war_load_project maps sample blocks of WAR_PAGE_MAP_MIN bytes or more
+// straight from the project file instead of reading them onto the heap, and
+// capture takes are mappings of their spill file (war_spill.h). Nothing is
+// read until it is needed.
+//
+// war_page_scan runs from the main loop every WAR_PAGE_SCAN_US. It asks the
+// kernel for the next WAR_PAGE_LOOKAHEAD_SEC of every sounding voice and of
+// every note the playbar reaches within that window (MADV_WILLNEED), and
+// drops the pages of mapped buffers idle for WAR_PAGE_IDLE_US
+// (MADV_DONTNEED). Resident memory follows what is playing; a dropped page is
+// read back from the file on the next touch.
+//
+// Projects are saved to a temporary file and renamed over the old one, so a
+// save never truncates a file that slots still map.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_PAGE_H
+#define WAR_PAGE_H
+
+#include "war_data.h"
+#include "war_functions.h"
+#include "war_resample.h"
+#include "war_sample.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// maps count stereo floats stored as format/channels at byte offset off of
+// fd (file_size bytes long); NULL when the range is past the end of the file
+// or the mapping fails
+static inline war_sample_buf* war_page_map_file(int fd, uint64_t file_size, uint64_t off, uint64_t count,
+                                                uint8_t format, uint8_t channels) {
+    uint64_t bytes = count / 2 * war_sample_frame_bytes(format, channels);
+    if (!bytes || off > file_size || bytes > file_size - off) return NULL;
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t base_off = off & ~(page - 1);
+    uint64_t len = off - base_off + bytes;
+    void* base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t)base_off);
+    if (base == MAP_FAILED) return NULL;
+    war_sample_buf* b = war_sample_buf_map(base, len, (float*)((uint8_t*)base + (off - base_off)), count);
+    if (!b) {
+        munmap(base, len);
+        return NULL;
+    }
+    b->format = format;
+    b->channels = channels;
+    return b;
+}
+
+// prefetches bytes of b starting at from (clipped to the buffer)
+static inline void war_page_touch(war_sample_buf* b, const void* from, uint64_t bytes, uint64_t now) {
+    if (!b || !b->map_bytes) return;
+    b->touch_us = now;
+    b->resident = 1;
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uintptr_t lo = (uintptr_t)from, hi = lo + (uintptr_t)bytes;
+    uintptr_t end = (uintptr_t)b->map_base + b->map_bytes;
+    if (lo < (uintptr_t)b->map_base) lo = (uintptr_t)b->map_base;
+    if (hi > end) hi = end;
+    if (lo >= hi) return;
+    lo &= ~(uintptr_t)(page - 1);
+    madvise((void*)lo, hi - lo, MADV_WILLNEED);
+}
+
+// the next WAR_PAGE_LOOKAHEAD_SEC of a slot played from play_pos floats
+static inline void _war_page_ahead(war_capture_slot* s, uint64_t play_pos, uint64_t now) {
+    if (!s->buf || !s->buf->map_bytes || !s->samples) return;
+    double rate = war_slot_rate(s);
+    uint64_t from = (uint64_t)((double)(play_pos / 2) * rate);
+    if (from >= s->count / 2) return;
+    uint64_t frames = (uint64_t)(WAR_PAGE_LOOKAHEAD_SEC * 48000.0 * rate) + WAR_RESAMPLE_TAPS;
+    uint32_t fb = war_sample_frame_bytes(s->buf->format, s->buf->channels);
+    war_page_touch(s->buf, (const uint8_t*)s->samples + from * fb, frames * fb, now);
+}
+
+static inline war_capture_slot* _war_page_slot(war_env* env, uint32_t note, uint32_t layer) {
+    if (note > 127 || layer < 1 || layer > 9) return NULL;
+    return &env->capture_slots[note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1)];
+}
+
+// main thread: prefetch what is about to play, drop what has gone quiet.
+// ccp/spc are the playbar column and seconds per column while it plays.
+static inline void war_page_scan(war_env* env, double ccp, double spc) {
+    uint64_t now = war_get_monotonic_time_us();
+    if (now - env->page_scan_us < WAR_PAGE_SCAN_US) return;
+    env->page_scan_us = now;
+    for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) {
+        if (!env->preview_voice_active[v]) continue;
+        war_capture_slot* s = _war_page_slot(env, env->preview_voice_note[v], env->preview_voice_layer[v]);
+        if (s) _war_page_ahead(s, env->preview_voice_read_pos[v], now);
+    }
+    if (env->play_bar_playing) {
+        for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) {
+            if (env->play_bar_voice_active[v] != 1) continue;
+            war_capture_slot* s = _war_page_slot(env, env->play_bar_voice_note[v], env->play_bar_voice_layer[v]);
+            if (s) _war_page_ahead(s, env->play_bar_voice_read_pos[v], now);
+        }
+        if (env->ctx_note && spc > 0.0) {
+            double until = ccp + WAR_PAGE_LOOKAHEAD_SEC / spc;
+            for (uint32_t i = 0; i < env->ctx_note->instance_count; i++) {
+                double ns = env->ctx_note->instance[i].pos[0];
+                if (ns < ccp || ns >= until) continue;
+                if (env->ctx_note->instance[i].flags & WAR_NEW_VULKAN_FLAGS_MUTE) continue;
+                uint32_t note = (uint32_t)(env->ctx_note->instance[i].pos[1] - (double)env->ctx_wayland->gutter_rows);
+                uint32_t layer = (env->ctx_note->instance[i].flags >> 4) & 0xF;
+                war_capture_slot* s = _war_page_slot(env, note, layer < 1 || layer > 9 ? 1 : layer);
+                if (s) _war_page_ahead(s, 0, now);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
+        war_sample_buf* b = env->capture_slots[i].buf;
+        if (!b || !b->map_bytes || !b->resident) continue;
+        if (!b->touch_us) {
+            b->touch_us = now; // first seen: start the idle clock
+            continue;
+        }
+        if (now - b->touch_us < WAR_PAGE_IDLE_US) continue;
+        madvise(b->map_base, b->map_bytes, MADV_DONTNEED);
+        b->resident = 0;
+    }
+}
+
+#endif // WAR_PAGE_H
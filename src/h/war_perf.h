@@ -0,0 +1,233 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_perf.h — audio/render telemetry behind :perf
+//
+// The Pipewire callbacks, the mixer and the frame renderer update relaxed
+// atomic counters and log-linear histograms in env->perf; nothing here takes
+// a lock or makes a syscall beyond clock_gettime. The main thread reads the
+// numbers for the :perf overlay and for the periodic war_perf.log dump.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_PERF_H
+#define WAR_PERF_H
+
+#include "war_data.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define WAR_PERF_LOG_PATH "war_perf.log"
+
+static inline uint64_t war_perf_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t _war_perf_bucket(uint64_t ns) {
+    if (ns < (1u << WAR_PERF_HIST_SUB_BITS)) return (uint32_t)ns;
+    uint32_t msb = 63u - (uint32_t)__builtin_clzll(ns);
+    uint32_t sub = (uint32_t)(ns >> (msb - WAR_PERF_HIST_SUB_BITS)) & ((1u << WAR_PERF_HIST_SUB_BITS) - 1);
+    uint32_t b = ((msb - WAR_PERF_HIST_SUB_BITS + 1) << WAR_PERF_HIST_SUB_BITS) + sub;
+    return b < WAR_PERF_HIST_BUCKETS ? b : WAR_PERF_HIST_BUCKETS - 1;
+}
+
+// lowest ns value that lands in bucket b
+static inline uint64_t _war_perf_bucket_floor(uint32_t b) {
+    if (b < (1u << WAR_PERF_HIST_SUB_BITS)) return b;
+    uint32_t msb = (b >> WAR_PERF_HIST_SUB_BITS) + WAR_PERF_HIST_SUB_BITS - 1;
+    uint64_t sub = b & ((1u << WAR_PERF_HIST_SUB_BITS) - 1);
+    return (1ull << msb) | (sub << (msb - WAR_PERF_HIST_SUB_BITS));
+}
+
+static inline void war_perf_hist_add(war_perf_hist* h, uint64_t ns) {
+    atomic_fetch_add_explicit(&h->bucket[_war_perf_bucket(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    uint64_t m = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (ns > m && !atomic_compare_exchange_weak_explicit(&h->max_ns, &m, ns, memory_order_relaxed,
+                                                            memory_order_relaxed)) {}
+}
+
+// q in [0,1]; returns the midpoint of the bucket holding that quantile
+static inline uint64_t war_perf_hist_quantile(war_perf_hist* h, double q) {
+    uint64_t n = atomic_load_explicit(&h->count, memory_order_relaxed);
+    if (!n) return 0;
+    uint64_t want = (uint64_t)(q * (double)n);
+    if (want >= n) want = n - 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < WAR_PERF_HIST_BUCKETS; b++) {
+        seen += atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        if (seen > want) {
+            uint64_t lo = _war_perf_bucket_floor(b);
+            uint64_t hi = b + 1 < WAR_PERF_HIST_BUCKETS ? _war_perf_bucket_floor(b + 1) : lo;
+            uint64_t mid = lo + (hi - lo) / 2;
+            uint64_t m = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+            return mid < m ? mid : m;
+        }
+    }
+    return atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+}
+
+static inline void _war_perf_hist_reset(war_perf_hist* h) {
+    for (uint32_t b = 0; b < WAR_PERF_HIST_BUCKETS; b++)
+        atomic_store_explicit(&h->bucket[b], 0, memory_order_relaxed);
+    atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->max_ns, 0, memory_order_relaxed);
+}
+
+// racing updates during a reset may survive it; the numbers are indicative
+static inline void war_perf_reset(war_perf* p) {
+    atomic_store_explicit(&p->play_callbacks, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->play_underruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->play_short, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->capture_callbacks, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->capture_overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->play_fill_min, UINT32_MAX, memory_order_relaxed);
+    atomic_store_explicit(&p->capture_fill_max, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->voices_max, 0, memory_order_relaxed);
+    _war_perf_hist_reset(&p->mix);
+    _war_perf_hist_reset(&p->frame);
+    _war_perf_hist_reset(&p->play_period);
+    p->reset_ns = war_perf_now_ns();
+}
+
+static inline uint32_t _war_perf_ring_used(uint32_t write_index, uint32_t read_index, uint64_t size) {
+    return (uint32_t)((size + write_index - read_index) & (size - 1));
+}
+
+// audio thread: fill is pc_play bytes queued before this callback drained it
+static inline void war_perf_play_callback(war_perf* p, uint32_t fill, uint32_t written, uint32_t max) {
+    uint64_t now = war_perf_now_ns();
+    if (p->play_last_ns) war_perf_hist_add(&p->play_period, now - p->play_last_ns);
+    p->play_last_ns = now;
+    atomic_fetch_add_explicit(&p->play_callbacks, 1, memory_order_relaxed);
+    atomic_store_explicit(&p->play_fill, fill, memory_order_relaxed);
+    if (!atomic_load_explicit(&p->producing, memory_order_relaxed)) return;
+    if (fill < atomic_load_explicit(&p->play_fill_min, memory_order_relaxed))
+        atomic_store_explicit(&p->play_fill_min, fill, memory_order_relaxed);
+    if (written == 0) atomic_fetch_add_explicit(&p->play_underruns, 1, memory_order_relaxed);
+    else if (written < max) atomic_fetch_add_explicit(&p->play_short, 1, memory_order_relaxed);
+}
+
+// audio thread: fill is pc_capture bytes queued after this callback's write
+static inline void war_perf_capture_callback(war_perf* p, uint32_t fill, uint8_t stored) {
+    atomic_fetch_add_explicit(&p->capture_callbacks, 1, memory_order_relaxed);
+    atomic_store_explicit(&p->capture_fill, fill, memory_order_relaxed);
+    if (fill > atomic_load_explicit(&p->capture_fill_max, memory_order_relaxed))
+        atomic_store_explicit(&p->capture_fill_max, fill, memory_order_relaxed);
+    if (!stored) atomic_fetch_add_explicit(&p->capture_overruns, 1, memory_order_relaxed);
+}
+
+// mixer: one chunk of frames took ns with voices active
+static inline void war_perf_mix_chunk(war_perf* p, uint64_t ns, uint32_t frames, uint32_t voices) {
+    war_perf_hist_add(&p->mix, ns);
+    p->chunk_frames = frames;
+    atomic_store_explicit(&p->voices, voices, memory_order_relaxed);
+    if (voices > atomic_load_explicit(&p->voices_max, memory_order_relaxed))
+        atomic_store_explicit(&p->voices_max, voices, memory_order_relaxed);
+}
+
+// formats the overlay/dump text, WAR_PERF_HUD_LINES lines of < WAR_PERF_HUD_COLS
+static inline uint32_t war_perf_format(war_perf* p, char lines[][WAR_PERF_HUD_COLS]) {
+    uint32_t n = 0;
+    double budget_us = (double)p->chunk_frames * 1e6 / 48000.0;
+    uint32_t fmin = atomic_load_explicit(&p->play_fill_min, memory_order_relaxed);
+    double up = (double)(war_perf_now_ns() - p->reset_ns) / 1e9;
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "PERF %.0fs  (:perf reset|dump|log)", up);
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "xrun %llu short %llu cap lost %llu",
+             (unsigned long long)atomic_load_explicit(&p->play_underruns, memory_order_relaxed),
+             (unsigned long long)atomic_load_explicit(&p->play_short, memory_order_relaxed),
+             (unsigned long long)atomic_load_explicit(&p->capture_overruns, memory_order_relaxed));
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "play ring %uB min %uB",
+             atomic_load_explicit(&p->play_fill, memory_order_relaxed), fmin == UINT32_MAX ? 0 : fmin);
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "cap ring %uB max %uB",
+             atomic_load_explicit(&p->capture_fill, memory_order_relaxed),
+             atomic_load_explicit(&p->capture_fill_max, memory_order_relaxed));
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "voices %u max %u",
+             atomic_load_explicit(&p->voices, memory_order_relaxed),
+             atomic_load_explicit(&p->voices_max, memory_order_relaxed));
+    double m50 = (double)war_perf_hist_quantile(&p->mix, 0.5) / 1e3;
+    double m99 = (double)war_perf_hist_quantile(&p->mix, 0.99) / 1e3;
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "mix us p50 %.1f p99 %.1f (%.0f%%)", m50, m99,
+             budget_us > 0.0 ? 100.0 * m99 / budget_us : 0.0);
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "mix us max %.1f of %.0f budget",
+             (double)atomic_load_explicit(&p->mix.max_ns, memory_order_relaxed) / 1e3, budget_us);
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "frame ms p50 %.2f p99 %.2f max %.1f",
+             (double)war_perf_hist_quantile(&p->frame, 0.5) / 1e6,
+             (double)war_perf_hist_quantile(&p->frame, 0.99) / 1e6,
+             (double)atomic_load_explicit(&p->frame.max_ns, memory_order_relaxed) / 1e6);
+    snprintf(lines[n++], WAR_PERF_HUD_COLS, "pw period ms p50 %.2f p99 %.2f",
+             (double)war_perf_hist_quantile(&p->play_period, 0.5) / 1e6,
+             (double)war_perf_hist_quantile(&p->play_period, 0.99) / 1e6);
+    return n;
+}
+
+static inline int war_perf_dump(war_perf* p, const char* path) {
+    FILE* f = fopen(path, "a");
+    if (!f) return 0;
+    char lines[WAR_PERF_HUD_LINES][WAR_PERF_HUD_COLS];
+    uint32_t n = war_perf_format(p, lines);
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(f, "[%s]\n", stamp);
+    for (uint32_t i = 0; i < n; i++) fprintf(f, "  %s\n", lines[i]);
+    fclose(f);
+    return 1;
+}
+
+// main loop: appends to WAR_PERF_LOG_PATH every perf_dump_sec
+static inline void war_perf_tick(war_env* env) {
+    if (env->perf_dump_sec <= 0.0) return;
+    uint64_t now = war_perf_now_ns();
+    if (now < env->perf_dump_next_ns) return;
+    if (env->perf_dump_next_ns) war_perf_dump(&env->perf, WAR_PERF_LOG_PATH);
+    env->perf_dump_next_ns = now + (uint64_t)(env->perf_dump_sec * 1e9);
+}
+
+// :perf [reset | dump [file] | log <sec>|off]  — bare :perf toggles the overlay
+static inline void war_perf_cmd(war_env* env) {
+    const char* rest = env->cmd_len > 5 ? env->cmd_buf + 5 : "";
+    while (*rest == ' ' || *rest == '\t') rest++;
+    if (!*rest) {
+        env->perf_hud = !env->perf_hud;
+        snprintf(env->status_msg, sizeof(env->status_msg), "perf %s", env->perf_hud ? "ON" : "OFF");
+    } else if (strcmp(rest, "reset") == 0) {
+        war_perf_reset(&env->perf);
+        snprintf(env->status_msg, sizeof(env->status_msg), "perf reset");
+    } else if (strncmp(rest, "dump", 4) == 0) {
+        const char* path = rest + 4;
+        while (*path == ' ') path++;
+        if (!*path) path = WAR_PERF_LOG_PATH;
+        if (war_perf_dump(&env->perf, path))
+            snprintf(env->status_msg, sizeof(env->status_msg), "perf: wrote %.100s", path);
+        else
+            snprintf(env->status_msg, sizeof(env->status_msg), "perf: cannot open %.90s", path);
+    } else if (strncmp(rest, "log", 3) == 0) {
+        const char* a = rest + 3;
+        while (*a == ' ') a++;
+        double sec = 0.0;
+        if (strcmp(a, "off") != 0) sscanf(a, "%lf", &sec);
+        env->perf_dump_sec = sec > 0.0 ? sec : 0.0;
+        env->perf_dump_next_ns = 0;
+        if (env->perf_dump_sec > 0.0)
+            snprintf(env->status_msg, sizeof(env->status_msg), "perf: log to %s every %.1fs",
+                     WAR_PERF_LOG_PATH, env->perf_dump_sec);
+        else
+            snprintf(env->status_msg, sizeof(env->status_msg), "perf: log OFF");
+    } else {
+        snprintf(env->status_msg, sizeof(env->status_msg), "usage: :perf [reset | dump [file] | log <sec>|off]");
+    }
+}
+
+#endif // WAR_PERF_H
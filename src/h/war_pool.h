@@ -19,33 +19,120 @@
 #include "war_debug_macros.h"
 #include "war_functions.h"
 
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 static inline void war_pool_set(war_pool_context* pool,
                                 war_config_context* config,
                                 war_pool_id id,
                                 uint64_t size,
                                 uint64_t alignment) {
+    if (id >= WAR_POOL_ID_COUNT) {
+        call_king_terry("pool id out of range: %u", id);
+        return;
+    }
+    // ids are a dense enum, index[id] holds entry + 1 (0 = unset)
+    uint32_t existing = pool->index[id];
+    if (existing) {
+        // round up size to alignment for real memory usage
+        pool->size[existing - 1] = (size + alignment - 1) & ~(alignment - 1);
+        pool->alignment[existing - 1] = alignment;
+        return;
+    }
     if (pool->count >= (uint32_t)config->POOL_MAX_ALLOCATIONS) {
         call_king_terry("MAX ALLOCATIONS REACHED");
         return;
     }
-    uint64_t offset = 0;
-    for (uint32_t i = 0; i < pool->count; i++) {
-        offset = (offset + pool->alignment[i] - 1) & ~(pool->alignment[i] - 1);
-        if (pool->id[i] == id) {
-            // round up size to alignment for real memory usage
-            pool->size[i] = (size + alignment - 1) & ~(alignment - 1);
-            pool->alignment[i] = alignment;
-            return;
-        }
-        offset += pool->size[i];
-    }
-    offset = (offset + alignment - 1) & ~(alignment - 1);
     pool->id[pool->count] = id;
     pool->size[pool->count] =
         (size + alignment - 1) & ~(alignment - 1); // rounded up
     pool->alignment[pool->count] = alignment;
-    pool->offset[pool->count] = offset;
+    pool->offset[pool->count] = 0; // assigned by war_pool_layout
     pool->count++;
+    pool->index[id] = pool->count;
+}
+
+// single pass over the registered entries once every war_pool_set (default
+// and override) has run; debug builds leave a PROT_NONE page after each
+// entry so overruns fault instead of silently corrupting the neighbour
+static inline void war_pool_layout(war_pool_context* pool,
+                                   war_config_context* config) {
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t guard = 0;
+#ifdef DEBUG
+    if (config->POOL_GUARD) guard = page;
+#endif
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < pool->count; i++) {
+        offset = (offset + pool->alignment[i] - 1) & ~(pool->alignment[i] - 1);
+        pool->offset[i] = offset;
+        offset += pool->size[i];
+        if (guard) offset = ((offset + page - 1) & ~(page - 1)) + guard;
+    }
+    pool->guard_size = guard;
+    pool->total_size = (offset + page - 1) & ~(page - 1);
+}
+
+// back the whole pool with one anonymous mapping. POOL_HUGEPAGES: 0 = off,
+// 1 = transparent huge pages via madvise, 2 = MAP_HUGETLB with fallback.
+// POOL_PREFAULT (off by default) touches every page up front so the first
+// frame does not take the page faults for the large instance arrays, at the
+// cost of startup time and resident memory for pages that may never be used
+static inline int war_pool_map(war_pool_context* pool,
+                               war_config_context* config) {
+    pool->pool = MAP_FAILED;
+    if (config->POOL_HUGEPAGES == 2) {
+        uint64_t huge = 2ULL * 1024 * 1024;
+        uint64_t size = (pool->total_size + huge - 1) & ~(huge - 1);
+        pool->pool = mmap(NULL,
+                          size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                          -1,
+                          0);
+        if (pool->pool != MAP_FAILED)
+            pool->total_size = size;
+        else
+            call_king_terry("MAP_HUGETLB failed, falling back: %s",
+                            strerror(errno));
+    }
+    if (pool->pool == MAP_FAILED) {
+        pool->pool = mmap(NULL,
+                          pool->total_size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1,
+                          0);
+        if (pool->pool == MAP_FAILED) return 0;
+        if (config->POOL_HUGEPAGES)
+            madvise(pool->pool, pool->total_size, MADV_HUGEPAGE);
+    }
+    // anonymous memory is already zeroed, touching it only faults it in
+    if (config->POOL_PREFAULT) {
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        for (uint64_t off = 0; off < pool->total_size; off += page)
+            ((volatile uint8_t*)pool->pool)[off] = 0;
+    }
+    if (pool->guard_size) {
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        for (uint32_t i = 0; i < pool->count; i++) {
+            uint64_t end = pool->offset[i] + pool->size[i];
+            end = (end + page - 1) & ~(page - 1);
+            mprotect(pool->pool + end, pool->guard_size, PROT_NONE);
+        }
+    }
+    return 1;
+}
+
+// frames per pooled delay line: A_DELAY_MAX_MS at 48kHz plus an interpolation
+// guard, rounded up to a power of two so reads wrap with a mask
+static inline uint32_t war_delay_pool_frames(war_config_context* config) {
+    uint32_t need = (uint32_t)(config->A_DELAY_MAX_MS * 48.0) + 2;
+    uint32_t frames = 64;
+    while (frames < need) frames <<= 1;
+    return frames;
 }
 
 static inline void war_pool_default(war_pool_context* pool,
@@ -114,6 +201,27 @@ static inline void war_pool_default(war_pool_context* pool,
                  WAR_POOL_ID_AUDIO_CAPTURE_LAST_READ_TIME,
                  sizeof(uint64_t) * (1),
                  32);
+    war_pool_set(pool,
+                 config,
+                 WAR_POOL_ID_AUDIO_DELAY_POOL,
+                 sizeof(float) * 2 * war_delay_pool_frames(config) *
+                     (config->A_DELAY_LINES),
+                 64);
+    war_pool_set(pool,
+                 config,
+                 WAR_POOL_ID_AUDIO_DELAY_POOL_USED,
+                 sizeof(uint8_t) * (config->A_DELAY_LINES),
+                 32);
+    war_pool_set(pool,
+                 config,
+                 WAR_POOL_ID_AUDIO_RESAMPLE_TABLE,
+                 sizeof(float) * WAR_RESAMPLE_TABLE_FLOATS,
+                 64);
+    war_pool_set(pool,
+                 config,
+                 WAR_POOL_ID_AUDIO_SPILL_BLOCKS,
+                 sizeof(float) * WAR_SPILL_BLOCKS * WAR_SPILL_BLOCK_FLOATS,
+                 64);
     //-------------------------------------------------------------------------
     // MAIN
     //-------------------------------------------------------------------------
@@ -1078,13 +1186,6 @@ static inline void war_pool_default(war_pool_context* pool,
                  WAR_POOL_ID_MAIN_CTX_FSM_IS_PREFIX,
                  sizeof(uint8_t) * (config->WR_STATES * config->WR_MODE_COUNT),
                  32);
-    war_pool_set(pool,
-                 config,
-                 WAR_POOL_ID_MAIN_CTX_FSM_NEXT_STATE,
-                 sizeof(uint64_t) *
-                     (config->WR_STATES * config->WR_KEYSYM_COUNT *
-                      config->WR_MOD_COUNT),
-                 32);
     war_pool_set(pool,
                  config,
                  WAR_POOL_ID_MAIN_CTX_FSM_CWD,
@@ -1394,11 +1495,13 @@ static inline void war_pool_default(war_pool_context* pool,
                  32);
     war_pool_set(pool,
                  config,
-                 WAR_POOL_ID_KEYMAP_CONTEXT_NEXT_STATE,
-                 sizeof(uint64_t) * config->KEYMAP_MODE_CAPACITY *
-                     config->KEYMAP_STATE_CAPACITY *
-                     config->KEYMAP_MOD_CAPACITY *
-                     config->KEYMAP_KEYSYM_CAPACITY,
+                 WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_KEY,
+                 sizeof(uint64_t) * config->KEYMAP_EDGE_CAPACITY,
+                 32);
+    war_pool_set(pool,
+                 config,
+                 WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_NEXT,
+                 sizeof(uint32_t) * config->KEYMAP_EDGE_CAPACITY,
                  32);
     war_pool_set(pool,
                  config,
@@ -0,0 +1,148 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_render.h — offline renders to disk and headless batch mode
+//
+// war_export_mix (war_main.c) mixes a project at WAR_RENDER_RATE.
+// war_render_write converts the mix to the requested rate and sample format
+// WAR_RENDER_BLOCK frames at a time and writes it as a WAV or as headerless
+// PCM. Other rates go through the slot resampler's sinc table.
+//
+//     war --render a.warp [b.warp ...] [-o file|dir] [--format wav|raw]
+//         [--bits 16|24|32] [--rate hz] [--threads n]
+//
+// renders without a window, an audio device or the pool. Each worker owns a
+// war_render_env_new env and takes projects off a shared counter, so a batch
+// spreads across cores. The exit status is nonzero when any project failed.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_RENDER_H
+#define WAR_RENDER_H
+
+#include "war_audio.h"
+#include "war_data.h"
+#include "war_load.h"
+#include "war_pool.h"
+#include "war_resample.h"
+#include "war_sample.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// writes frames of 48kHz stereo mix to path at rate as bits-wide samples
+// (WAV unless raw). table == NULL resamples linearly. 0 on failure, nothing
+// left behind.
+static inline int war_render_write(const float* table, const float* mix, uint64_t frames, const char* path,
+                                   uint32_t rate, uint32_t bits, int raw) {
+    if (!rate || (bits != 16 && bits != 24 && bits != 32)) return 0;
+    double step = (double)WAR_RENDER_RATE / rate;
+    uint64_t out_frames = rate == WAR_RENDER_RATE ? frames : (uint64_t)((double)frames / step);
+    uint32_t bps = bits / 8;
+    uint64_t data_bytes = out_frames * 2 * bps;
+    if (!raw && data_bytes > 0xFFFFFFFFull - 36) {
+        call_king_terry("render: %s is past the 4GB WAV limit, use --format raw", path);
+        return 0;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    if (!raw) war_wav_write_header(f, rate, (uint16_t)bits, (uint32_t)data_bytes);
+    float blk[WAR_RENDER_BLOCK * 2];
+    uint8_t pcm[WAR_RENDER_BLOCK * 2 * 4];
+    for (uint64_t o = 0; o < out_frames; o += WAR_RENDER_BLOCK) {
+        uint64_t n = out_frames - o < WAR_RENDER_BLOCK ? out_frames - o : WAR_RENDER_BLOCK;
+        const float* src = mix + o * 2;
+        if (rate != WAR_RENDER_RATE) {
+            war_resample_block(table, mix, frames * 2, (double)o * step, step, blk, n * 2);
+            src = blk;
+        }
+        for (uint64_t i = 0; i < n * 2; i++) {
+            float s = src[i];
+            if (bits == 32) {
+                memcpy(pcm + i * 4, &s, 4);
+                continue;
+            }
+            if (s < -1.0f) s = -1.0f;
+            if (s > 1.0f) s = 1.0f;
+            if (bits == 16) {
+                int16_t v = (int16_t)(s * 32767.0f);
+                memcpy(pcm + i * 2, &v, 2);
+            } else {
+                int32_t v = (int32_t)lrintf(s * 8388607.0f);
+                pcm[i * 3] = (uint8_t)v;
+                pcm[i * 3 + 1] = (uint8_t)(v >> 8);
+                pcm[i * 3 + 2] = (uint8_t)(v >> 16);
+            }
+        }
+        fwrite(pcm, bps, n * 2, f);
+    }
+    int bad = ferror(f);
+    if (fclose(f) != 0) bad = 1;
+    if (bad) remove(path);
+    return !bad;
+}
+
+// where a batch writes project: -o as given for a single project, else
+// <dir>/<name>.wav (or .raw) with dir = -o or the project's own directory
+static inline void war_render_out_path(const war_render_batch* batch, const char* project, char* out, size_t size) {
+    const char* ext = batch->raw ? "raw" : "wav";
+    struct stat st;
+    if (batch->out && batch->count == 1 && !(stat(batch->out, &st) == 0 && S_ISDIR(st.st_mode))) {
+        snprintf(out, size, "%s", batch->out);
+        return;
+    }
+    const char* slash = strrchr(project, '/');
+    const char* name = slash ? slash + 1 : project;
+    size_t len = strlen(name);
+    if (len > 5 && strcmp(name + len - 5, ".warp") == 0) len -= 5;
+    if (batch->out)
+        snprintf(out, size, "%s/%.*s.%s", batch->out, (int)len, name, ext);
+    else
+        snprintf(out, size, "%.*s%.*s.%s", (int)(name - project), project, (int)len, name, ext);
+}
+
+static inline void war_render_env_free(war_env* env) {
+    if (!env) return;
+    war_load_shutdown(env);
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) war_slot_clear(&env->capture_slots[i]);
+    if (env->ctx_note) free(env->ctx_note->instance);
+    free(env->ctx_note);
+    free(env->ctx_wayland);
+    free(env->atomics);
+    free(env);
+}
+
+// an env holding only what war_load_project and war_export_mix read; table is
+// shared between workers
+static inline war_env* war_render_env_new(war_config_context* config, float* table) {
+    war_env* env = calloc(1, sizeof(war_env));
+    if (!env) return NULL;
+    war_load_init(env);
+    uint32_t max = (uint32_t)config->NEW_VULKAN_NOTE_INSTANCE_MAX;
+    env->ctx_config = config;
+    env->ctx_note = calloc(1, sizeof(war_note_context));
+    env->ctx_wayland = calloc(1, sizeof(war_wayland_context));
+    env->atomics = calloc(1, sizeof(war_atomics));
+    if (env->ctx_note) env->ctx_note->instance = calloc(max, sizeof(war_new_vulkan_note_instance));
+    if (!env->ctx_note || !env->ctx_note->instance || !env->ctx_wayland || !env->atomics) {
+        war_render_env_free(env);
+        return NULL;
+    }
+    env->ctx_note->max_instances = max;
+    // the grid origin main() sets up for the window
+    env->ctx_wayland->gutter_rows = 4;
+    env->ctx_wayland->gutter_cols = 4;
+    env->layer_visible = 0x1FF;
+    env->delay_pool_frames = war_delay_pool_frames(config);
+    env->resample_table = table;
+    return env;
+}
+
+#endif // WAR_RENDER_H
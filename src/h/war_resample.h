@@ -0,0 +1,208 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_resample.h — transposed slot playback
+//
+// A slot with a nonzero transpose keeps the source audio and plays its view
+// at 2^(transpose/12) frames per output frame. The mixer and war_export_note
+// read it through war_resample_block, a WAR_RESAMPLE_TAPS-tap polyphase
+// windowed sinc. Rows hold each tap twice (LRLR), so one SSE multiply covers
+// two stereo frames; other targets run the same loop in scalar.
+//
+// :across in root mode (:acrossroot) shares the source buffer with every
+// neighbour and sets root/transpose instead of rendering 2 x radius copies.
+// war_resample_sync points linked slots at their root's current view, so an
+// edit to the source reaches the whole keyboard without a re-render.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_RESAMPLE_H
+#define WAR_RESAMPLE_H
+
+#include "war_data.h"
+#include "war_sample.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Blackman-windowed sinc rows for every cutoff and phase, each row normalised
+// to unity DC gain. Row p of cutoff c is the kernel for output positions
+// p / WAR_RESAMPLE_PHASES of a frame past the centre tap.
+static inline void war_resample_table_init(float* table) {
+    const double half = WAR_RESAMPLE_TAPS / 2;
+    for (uint32_t c = 0; c < WAR_RESAMPLE_CUTOFFS; c++) {
+        double fc = pow(2.0, -(double)c / 12.0);
+        for (uint32_t p = 0; p <= WAR_RESAMPLE_PHASES; p++) {
+            double frac = (double)p / WAR_RESAMPLE_PHASES;
+            double k[WAR_RESAMPLE_TAPS];
+            double sum = 0.0;
+            for (uint32_t j = 0; j < WAR_RESAMPLE_TAPS; j++) {
+                double x = (double)j - half + 1.0 - frac;
+                double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2.0 * M_PI * x / half);
+                double a = M_PI * fc * x;
+                k[j] = fc * (fabs(a) < 1e-9 ? 1.0 : sin(a) / a) * w;
+                sum += k[j];
+            }
+            float* row = table + ((uint64_t)c * (WAR_RESAMPLE_PHASES + 1) + p) * WAR_RESAMPLE_ROW;
+            for (uint32_t j = 0; j < WAR_RESAMPLE_TAPS; j++)
+                row[j * 2] = row[j * 2 + 1] = (float)(k[j] / sum);
+        }
+    }
+}
+
+static inline double war_slot_rate(const war_capture_slot* s) {
+    return s->transpose ? pow(2.0, (double)s->transpose / 12.0) : 1.0;
+}
+
+// floats the slot sounds for: its count, stretched or squeezed by the rate
+static inline uint64_t war_slot_play_count(const war_capture_slot* s) {
+    if (!s->transpose || s->count < 2) return s->count;
+    uint64_t frames = s->count / 2;
+    return ((uint64_t)((double)(frames - 1) / war_slot_rate(s)) + 1) * 2;
+}
+
+// renders floats/2 stereo frames of src (count floats) starting at frame pos,
+// advancing rate frames per output frame. Taps past either end read silence.
+// table == NULL falls back to linear interpolation.
+static inline void war_resample_block(const float* table, const float* src, uint64_t count,
+                                      double pos, double rate, float* out, uint64_t floats) {
+    int64_t frames = (int64_t)(count / 2);
+    if (!table) {
+        for (uint64_t f = 0; f < floats; f += 2) {
+            double p = pos + (double)(f / 2) * rate;
+            int64_t i = (int64_t)p;
+            float fr = (float)(p - (double)i);
+            if (i + 1 < frames) {
+                out[f] = src[i * 2] + fr * (src[i * 2 + 2] - src[i * 2]);
+                out[f + 1] = src[i * 2 + 1] + fr * (src[i * 2 + 3] - src[i * 2 + 1]);
+            } else if (i < frames) {
+                out[f] = src[i * 2];
+                out[f + 1] = src[i * 2 + 1];
+            } else {
+                out[f] = out[f + 1] = 0.0f;
+            }
+        }
+        return;
+    }
+    uint32_t c = 0;
+    if (rate > 1.0) {
+        double semis = 12.0 * log2(rate) + 0.5;
+        c = semis >= WAR_RESAMPLE_CUTOFFS - 1 ? WAR_RESAMPLE_CUTOFFS - 1 : (uint32_t)semis;
+    }
+    const float* kt = table + (uint64_t)c * (WAR_RESAMPLE_PHASES + 1) * WAR_RESAMPLE_ROW;
+    for (uint64_t f = 0; f < floats; f += 2) {
+        double p = pos + (double)(f / 2) * rate;
+        int64_t i = (int64_t)p;
+        double ph = (p - (double)i) * WAR_RESAMPLE_PHASES;
+        uint32_t pi = (uint32_t)ph;
+        if (pi >= WAR_RESAMPLE_PHASES) pi = WAR_RESAMPLE_PHASES - 1;
+        float pf = (float)(ph - (double)pi);
+        const float* k0 = kt + (uint64_t)pi * WAR_RESAMPLE_ROW;
+        const float* k1 = k0 + WAR_RESAMPLE_ROW;
+        int64_t first = i - WAR_RESAMPLE_TAPS / 2 + 1;
+        if (first >= 0 && first + WAR_RESAMPLE_TAPS <= frames) {
+            const float* s = src + first * 2;
+#if defined(__SSE2__)
+            __m128 acc = _mm_setzero_ps();
+            __m128 vf = _mm_set1_ps(pf);
+            for (uint32_t j = 0; j < WAR_RESAMPLE_ROW; j += 4) {
+                __m128 a = _mm_load_ps(k0 + j);
+                __m128 k = _mm_add_ps(a, _mm_mul_ps(vf, _mm_sub_ps(_mm_load_ps(k1 + j), a)));
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + j), k));
+            }
+            // acc = L0+L2.. R0+R2.. L1+L3.. R1+R3..
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            float lr[4];
+            _mm_storeu_ps(lr, acc);
+            out[f] = lr[0];
+            out[f + 1] = lr[1];
+#else
+            float l = 0.0f, r = 0.0f;
+            for (uint32_t j = 0; j < WAR_RESAMPLE_ROW; j += 2) {
+                float k = k0[j] + pf * (k1[j] - k0[j]);
+                l += s[j] * k;
+                r += s[j + 1] * k;
+            }
+            out[f] = l;
+            out[f + 1] = r;
+#endif
+        } else {
+            float l = 0.0f, r = 0.0f;
+            for (uint32_t j = 0; j < WAR_RESAMPLE_TAPS; j++) {
+                int64_t si = first + (int64_t)j;
+                if (si < 0 || si >= frames) continue;
+                float k = k0[j * 2] + pf * (k1[j * 2] - k0[j * 2]);
+                l += src[si * 2] * k;
+                r += src[si * 2 + 1] * k;
+            }
+            out[f] = l;
+            out[f + 1] = r;
+        }
+    }
+}
+
+// floats of a transposed slot starting play_pos floats into its playback.
+// Packed slots decode just the source frames the taps reach.
+static inline void war_resample_slot(war_env* env, const war_capture_slot* s, uint64_t play_pos,
+                                     float* out, uint64_t floats) {
+    double rate = war_slot_rate(s);
+    double pos = (double)(play_pos / 2) * rate;
+    if (war_sample_plain(s->buf)) {
+        war_resample_block(env->resample_table, s->samples, s->count, pos, rate, out, floats);
+        return;
+    }
+    int64_t frames = (int64_t)(s->count / 2);
+    int64_t lo = (int64_t)pos - WAR_RESAMPLE_TAPS / 2;
+    int64_t hi = (int64_t)(pos + (double)(floats / 2) * rate) + WAR_RESAMPLE_TAPS / 2 + 1;
+    if (lo < 0) lo = 0;
+    if (hi > frames) hi = frames;
+    if (lo >= hi) {
+        memset(out, 0, sizeof(float) * floats);
+        return;
+    }
+    float stack[WAR_RESAMPLE_WINDOW];
+    uint64_t n = (uint64_t)(hi - lo) * 2;
+    float* win = n <= WAR_RESAMPLE_WINDOW ? stack : malloc(sizeof(float) * n);
+    if (!win) {
+        memset(out, 0, sizeof(float) * floats);
+        return;
+    }
+    war_slot_read(s, (uint64_t)lo * 2, win, n);
+    war_resample_block(env->resample_table, win, n, pos - (double)lo, rate, out, floats);
+    if (win != stack) free(win);
+}
+
+// malloc'd render of a slot's first floats of playback (floats even)
+static inline float* war_resample_render(war_env* env, const war_capture_slot* s, uint64_t floats) {
+    float* out = floats ? malloc(sizeof(float) * floats) : NULL;
+    if (out) war_resample_slot(env, s, 0, out, floats);
+    return out;
+}
+
+// main thread: re-point linked slots whose root has new audio (or a new view)
+static inline void war_resample_sync(war_env* env) {
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
+        war_capture_slot* s = &env->capture_slots[i];
+        if (!s->root) continue;
+        uint32_t r = s->root - 1;
+        if (r >= 128 * WAR_CAPTURE_SLOT_LAYERS || r == i) {
+            s->root = 0;
+            continue;
+        }
+        war_capture_slot* root = &env->capture_slots[r];
+        if (!root->buf) continue; // root emptied: keep playing the last audio
+        if (s->buf == root->buf && s->samples == root->samples && s->count == root->count) continue;
+        war_slot_set_view(s, war_sample_buf_ref(root->buf), war_slot_offset(root), root->count);
+    }
+}
+
+#endif // WAR_RESAMPLE_H
@@ -0,0 +1,386 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_sample.h — reference-counted immutable sample buffers
+//
+// A war_sample_buf never changes after it is built. A capture slot holds one
+// reference and exposes a view of it via samples/count, which may start past
+// buf->data (crop and split only move the view). Copying a slot, taking an
+// undo snapshot or handing audio to a worker thread costs one atomic
+// increment. An edit builds a new buffer and swaps it in with
+// war_slot_set_buf. Buffers are freed when the last reference goes, so a
+// worker can keep reading its snapshot while the main thread replaces the
+// slot underneath it. Capture takes and large project blocks are read-only
+// file mappings (war_spill.h, war_page.h) and are unmapped instead.
+//
+// Slots themselves are only written on the main thread; workers hand their
+// results back through a queue, as autotune and stem extraction do.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_SAMPLE_H
+#define WAR_SAMPLE_H
+
+#include "war_data.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// takes ownership of malloc'd data; NULL (and data freed) when empty or OOM
+static inline war_sample_buf* war_sample_buf_wrap(float* data, uint64_t count) {
+    if (!data || count == 0) {
+        free(data);
+        return NULL;
+    }
+    war_sample_buf* b = malloc(sizeof(war_sample_buf));
+    if (!b) {
+        free(data);
+        return NULL;
+    }
+    atomic_init(&b->refs, 1);
+    b->count = count;
+    b->data = data;
+    b->format = WAR_SAMPLE_F32;
+    b->channels = 2;
+    b->map_base = NULL;
+    b->map_bytes = 0;
+    b->touch_us = 0;
+    b->resident = 1;
+    return b;
+}
+
+// wraps count floats at data inside a read-only mapping of bytes at base;
+// unmapped with the last reference. NULL on OOM, the caller still owns the
+// mapping.
+static inline war_sample_buf* war_sample_buf_map(void* base, uint64_t bytes, float* data, uint64_t count) {
+    war_sample_buf* b = malloc(sizeof(war_sample_buf));
+    if (!b) return NULL;
+    atomic_init(&b->refs, 1);
+    b->count = count;
+    b->data = data;
+    b->format = WAR_SAMPLE_F32;
+    b->channels = 2;
+    b->map_base = base;
+    b->map_bytes = bytes;
+    b->touch_us = 0;
+    b->resident = 1;
+    return b;
+}
+
+static inline war_sample_buf* war_sample_buf_copy(const float* data, uint64_t count) {
+    if (!data || count == 0) return NULL;
+    float* p = malloc(sizeof(float) * count);
+    if (!p) return NULL;
+    memcpy(p, data, sizeof(float) * count);
+    return war_sample_buf_wrap(p, count);
+}
+
+static inline war_sample_buf* war_sample_buf_ref(war_sample_buf* b) {
+    if (b) atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+    return b;
+}
+
+static inline void war_sample_buf_unref(war_sample_buf* b) {
+    if (!b) return;
+    if (atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1) {
+        if (b->map_bytes)
+            munmap(b->map_base, b->map_bytes);
+        else
+            free(b->data);
+        free(b);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// storage formats: F32/F16/S16, stereo or mono. A plain buffer (F32 stereo)
+// is read in place; anything else goes through war_sample_decode, which the
+// mixer calls per block and the offline edits through war_sample_unpack.
+//-----------------------------------------------------------------------------
+
+static inline int war_sample_plain(const war_sample_buf* b) {
+    return !b || (b->format == WAR_SAMPLE_F32 && b->channels == 2);
+}
+
+static inline uint32_t war_sample_frame_bytes(uint8_t format, uint8_t channels) {
+    return (format == WAR_SAMPLE_F32 ? 4u : 2u) * channels;
+}
+
+static inline const char* war_sample_format_name(uint8_t format) {
+    switch (format) {
+    case WAR_SAMPLE_F16: return "f16";
+    case WAR_SAMPLE_S16: return "s16";
+    default: return "f32";
+    }
+}
+
+static inline float war_half_to_float(uint16_t h) {
+    union { uint32_t u; float f; } o, magic = {(254 - 15) << 23};
+    uint32_t em = h & 0x7fff;
+    o.u = em << 13;
+    o.f *= magic.f; // rebias the exponent, denormals included
+    if (em > 0x7bff) o.u |= 255u << 23;
+    o.u |= (uint32_t)(h & 0x8000) << 16;
+    return o.f;
+}
+
+// round to nearest even; overflow goes to infinity
+static inline uint16_t war_float_to_half(float x) {
+    union { uint32_t u; float f; } f = {0}, denorm = {((127 - 15) + (23 - 10) + 1) << 23};
+    f.f = x;
+    uint32_t sign = f.u & 0x80000000u;
+    uint16_t o;
+    f.u ^= sign;
+    if (f.u >= (127u + 16) << 23) {
+        o = f.u > 0x7f800000u ? 0x7e00 : 0x7c00;
+    } else if (f.u < 113u << 23) {
+        f.f += denorm.f;
+        o = (uint16_t)(f.u - denorm.u);
+    } else {
+        uint32_t odd = (f.u >> 13) & 1;
+        f.u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+        o = (uint16_t)(f.u >> 13);
+    }
+    return o | (uint16_t)(sign >> 16);
+}
+
+// n samples of one format into floats
+static inline void _war_sample_decode_run(const uint8_t* src, uint8_t format, float* out, uint64_t n) {
+    uint64_t i = 0;
+    if (format == WAR_SAMPLE_F32) {
+        memcpy(out, src, sizeof(float) * n);
+        return;
+    }
+    const uint16_t* h = (const uint16_t*)src;
+#if defined(__SSE2__)
+    if (format == WAR_SAMPLE_S16) {
+        const __m128 k = _mm_set1_ps(1.0f / 32768.0f);
+        for (; i + 8 <= n; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(h + i));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+        }
+    } else {
+        // war_half_to_float four lanes at a time
+        const __m128i nosign = _mm_set1_epi32(0x7fff);
+        const __m128i infnan = _mm_set1_epi32(0x7bff);
+        const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+        const __m128 expmax = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(h + i));
+            __m128i w[2] = {_mm_unpacklo_epi16(x, zero), _mm_unpackhi_epi16(x, zero)};
+            for (int j = 0; j < 2; j++) {
+                __m128i em = _mm_and_si128(w[j], nosign);
+                __m128i sign = _mm_slli_epi32(_mm_xor_si128(w[j], em), 16);
+                __m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(em, 13)), magic);
+                __m128 inf = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(em, infnan)), expmax);
+                _mm_storeu_ps(out + i + j * 4, _mm_or_ps(f, _mm_or_ps(_mm_castsi128_ps(sign), inf)));
+            }
+        }
+    }
+#endif
+    if (format == WAR_SAMPLE_S16)
+        for (; i < n; i++) out[i] = (float)(int16_t)h[i] * (1.0f / 32768.0f);
+    else
+        for (; i < n; i++) out[i] = war_half_to_float(h[i]);
+}
+
+// floats (even) of interleaved stereo starting pos floats into the view that
+// starts at view; mono storage is spread to both sides
+static inline void war_sample_decode(const war_sample_buf* b, const float* view, uint64_t pos, float* out,
+                                     uint64_t floats) {
+    if (war_sample_plain(b)) {
+        memcpy(out, view + pos, sizeof(float) * floats);
+        return;
+    }
+    const uint8_t* src = (const uint8_t*)view + pos / 2 * war_sample_frame_bytes(b->format, b->channels);
+    if (b->channels == 2) {
+        _war_sample_decode_run(src, b->format, out, floats);
+        return;
+    }
+    // mono: decode into the back half, then spread forward; each read lands
+    // at or ahead of the writes before it
+    uint64_t frames = floats / 2;
+    _war_sample_decode_run(src, b->format, out + frames, frames);
+    for (uint64_t i = 0; i < frames; i++) {
+        float v = out[frames + i];
+        out[i * 2] = v;
+        out[i * 2 + 1] = v;
+    }
+}
+
+// the view as plain floats: the view itself when the buffer is plain, else a
+// malloc'd decode (NULL on OOM). Release with war_sample_unpack_free.
+static inline const float* war_sample_unpack(const war_sample_buf* b, const float* view, uint64_t count) {
+    if (war_sample_plain(b) || !view) return view;
+    float* p = count ? malloc(sizeof(float) * count) : NULL;
+    if (p) war_sample_decode(b, view, 0, p, count);
+    return p;
+}
+
+static inline void war_sample_unpack_free(const float* view, const float* p) {
+    if (p != view) free((void*)p);
+}
+
+// new buffer holding count plain floats as format/channels; mono averages the
+// sides. NULL on OOM.
+static inline war_sample_buf* war_sample_buf_pack(const float* x, uint64_t count, uint8_t format,
+                                                  uint8_t channels) {
+    uint64_t frames = count / 2;
+    if (!x || !frames) return NULL;
+    uint8_t* p = malloc((size_t)frames * war_sample_frame_bytes(format, channels));
+    if (!p) return NULL;
+    float* pf = (float*)p;
+    uint16_t* ph = (uint16_t*)p;
+    for (uint64_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            float v = channels == 2 ? x[i * 2 + c] : 0.5f * (x[i * 2] + x[i * 2 + 1]);
+            uint64_t o = i * channels + c;
+            if (format == WAR_SAMPLE_F32) {
+                pf[o] = v;
+            } else if (format == WAR_SAMPLE_F16) {
+                ph[o] = war_float_to_half(v);
+            } else {
+                float q = v * 32768.0f;
+                q = q < -32768.0f ? -32768.0f : q > 32767.0f ? 32767.0f : q;
+                ph[o] = (uint16_t)(int16_t)lrintf(q);
+            }
+        }
+    }
+    war_sample_buf* b = war_sample_buf_wrap(pf, frames * 2);
+    if (b) {
+        b->format = format;
+        b->channels = channels;
+    }
+    return b;
+}
+
+// both sides equal: mono storage loses nothing
+static inline int war_sample_dual_mono(const float* x, uint64_t count) {
+    for (uint64_t i = 0; i + 1 < count; i += 2)
+        if (x[i] != x[i + 1]) return 0;
+    return count >= 2;
+}
+
+// stereo floats between buf->data and the slot's view
+static inline uint64_t war_slot_offset(const war_capture_slot* s) {
+    if (!s->buf) return 0;
+    if (war_sample_plain(s->buf)) return (uint64_t)(s->samples - s->buf->data);
+    uint64_t bytes = (uint64_t)((const uint8_t*)s->samples - (const uint8_t*)s->buf->data);
+    return bytes / war_sample_frame_bytes(s->buf->format, s->buf->channels) * 2;
+}
+
+// count floats of the slot's view from pos, decoded
+static inline void war_slot_read(const war_capture_slot* s, uint64_t pos, float* out, uint64_t floats) {
+    war_sample_decode(s->buf, s->samples, pos, out, floats);
+}
+
+static inline const float* war_slot_unpack(const war_capture_slot* s) {
+    return war_sample_unpack(s->buf, s->samples, s->count);
+}
+
+// installs [offset, offset + count) of b, taking over the caller's reference;
+// b == NULL empties the slot. The old buffer loses the slot's reference.
+static inline void war_slot_set_view(war_capture_slot* s, war_sample_buf* b, uint64_t offset, uint64_t count) {
+    war_sample_buf* old = s->buf;
+    if (b && (offset > b->count || count > b->count - offset)) count = offset < b->count ? b->count - offset : 0;
+    if (b && count == 0) {
+        war_sample_buf_unref(b);
+        b = NULL;
+    }
+    s->buf = b;
+    if (b && !war_sample_plain(b))
+        s->samples = (float*)((uint8_t*)b->data + offset / 2 * war_sample_frame_bytes(b->format, b->channels));
+    else
+        s->samples = b ? b->data + offset : NULL;
+    s->count = b ? count : 0;
+    s->capacity = s->count;
+    war_sample_buf_unref(old);
+}
+
+static inline void war_slot_set_buf(war_capture_slot* s, war_sample_buf* b) {
+    war_slot_set_view(s, b, 0, b ? b->count : 0);
+}
+
+// wraps freshly malloc'd audio; returns 0 (data freed, slot emptied) on OOM.
+// The slot now owns its audio and stops following a root.
+static inline int war_slot_adopt(war_capture_slot* s, float* data, uint64_t count) {
+    war_sample_buf* b = war_sample_buf_wrap(data, count);
+    war_slot_set_buf(s, b);
+    s->root = 0;
+    return b != NULL;
+}
+
+static inline void war_slot_clear(war_capture_slot* s) {
+    war_slot_set_buf(s, NULL);
+    s->transpose = 0;
+    s->root = 0;
+}
+
+// dst plays the same audio as src, sharing its buffer
+static inline void war_slot_share(war_capture_slot* dst, const war_capture_slot* src) {
+    war_slot_set_view(dst, war_sample_buf_ref(src->buf), war_slot_offset(src), src->count);
+}
+
+// narrows the view to [start, start + count) floats of the current view; a
+// cropped slot stops following its root
+static inline void war_slot_crop(war_capture_slot* s, uint64_t start, uint64_t count) {
+    war_slot_set_view(s, war_sample_buf_ref(s->buf), war_slot_offset(s) + start, count);
+    s->root = 0;
+}
+
+// Drop ownership without unref (after move of whole slot to another index).
+static inline void _war_slot_null_owned(war_capture_slot* s) {
+    if (!s) return;
+    s->buf = NULL;
+    s->samples = NULL;
+    s->count = 0;
+    s->capacity = 0;
+}
+
+//-----------------------------------------------------------------------------
+// undo snapshots: references to the slots' views, no sample copies
+//-----------------------------------------------------------------------------
+
+static inline war_undo_audio* war_undo_audio_snapshot(war_env* env, const uint32_t* slots, uint32_t n) {
+    war_undo_audio* u = malloc(sizeof(war_undo_audio) + sizeof(war_undo_slot) * n);
+    if (!u) return NULL;
+    u->n = n;
+    for (uint32_t i = 0; i < n; i++) {
+        war_capture_slot* sl = &env->capture_slots[slots[i]];
+        u->slot[i].idx = slots[i];
+        u->slot[i].buf = war_sample_buf_ref(sl->buf);
+        u->slot[i].offset = war_slot_offset(sl);
+        u->slot[i].count = sl->count;
+    }
+    return u;
+}
+
+static inline void war_undo_audio_restore(war_env* env, const war_undo_audio* u) {
+    for (uint32_t i = 0; i < u->n; i++) {
+        const war_undo_slot* us = &u->slot[i];
+        if (us->idx >= 128 * WAR_CAPTURE_SLOT_LAYERS) continue;
+        war_slot_set_view(&env->capture_slots[us->idx], war_sample_buf_ref(us->buf), us->offset, us->count);
+    }
+}
+
+static inline void war_undo_audio_free(war_undo_audio* u) {
+    if (!u) return;
+    for (uint32_t i = 0; i < u->n; i++) war_sample_buf_unref(u->slot[i].buf);
+    free(u);
+}
+
+#endif // WAR_SAMPLE_H
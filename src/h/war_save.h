@@ -0,0 +1,360 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_save.h — project saves off the main thread
+//
+// :w takes a snapshot on the main thread: a copy of the note array and of
+// every non-empty slot, each slot copy holding a reference to its sample
+// buffer (war_sample.h). However large the audio, that is a memcpy and one
+// atomic increment per slot, so input and the mixer never wait on the disk.
+// A worker writes the snapshot to <path>.tmp through a WAR_SAVE_IO_BUFFER
+// stdio buffer and renames it over the project; war_save_poll reports the
+// result in the status bar. The project counts as saved from the snapshot
+// on; edits made while the file is written dirty it again as usual, and a
+// failed write marks it dirty.
+//
+// Autosave snapshots the same way every A_AUTOSAVE_SEC while the project has
+// unsaved changes, into <project>.autosave next to it, skipping a tick when
+// nothing was edited since the last one.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_SAVE_H
+#define WAR_SAVE_H
+
+#include "war_data.h"
+#include "war_freeze.h"
+#include "war_functions.h"
+#include "war_load.h"
+#include "war_sample.h"
+#include "war_trace.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static inline void war_save_job_free(war_save_job* job) {
+    if (!job) return;
+    for (uint32_t i = 0; i < job->slot_count; i++) war_sample_buf_unref(job->slots[i].slot.buf);
+    free(job->slots);
+    free(job->notes);
+    free(job);
+}
+
+// main thread: everything war_save_write needs, detached from env. NULL on OOM.
+static inline war_save_job* war_save_snapshot(war_env* env, const char* path, uint8_t autosave) {
+    war_save_job* job = calloc(1, sizeof(war_save_job));
+    if (!job) return NULL;
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    job->autosave = autosave;
+    job->bpm = env->atomics->bpm;
+    if (job->bpm <= 0.0f) job->bpm = 100.0f;
+    // frozen layers are stored as their notes, without the bounce (war_freeze.h)
+    int bounce[9];
+    uint32_t count = env->ctx_note ? env->ctx_note->instance_count : 0;
+    for (uint32_t l = 1; l <= 9; l++) {
+        bounce[l - 1] = env->ctx_note ? war_freeze_bounce_note(env, l) : -1;
+        if (bounce[l - 1] >= 0) count += env->freeze[l - 1].note_count - 1;
+    }
+    if (count) {
+        job->notes = malloc(sizeof(war_new_vulkan_note_instance) * count);
+        if (!job->notes) {
+            free(job);
+            return NULL;
+        }
+        for (uint32_t i = 0; i < env->ctx_note->instance_count; i++) {
+            uint32_t l = 0;
+            while (l < 9 && bounce[l] != (int)i) l++;
+            if (l == 9) job->notes[job->note_count++] = env->ctx_note->instance[i];
+        }
+        for (uint32_t l = 0; l < 9; l++) {
+            if (bounce[l] < 0) continue;
+            memcpy(job->notes + job->note_count, env->freeze[l].notes,
+                   sizeof(war_new_vulkan_note_instance) * env->freeze[l].note_count);
+            job->note_count += env->freeze[l].note_count;
+        }
+    }
+    uint8_t skip[128 * WAR_CAPTURE_SLOT_LAYERS] = {0};
+    for (uint32_t l = 0; l < 9; l++)
+        if (bounce[l] >= 0 && env->capture_slots[env->freeze[l].slot].samples == env->freeze[l].samples)
+            skip[env->freeze[l].slot] = 1;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++)
+        if (env->capture_slots[i].samples && env->capture_slots[i].count > 0 && !skip[i]) n++;
+    job->slots = n ? malloc(sizeof(war_save_slot) * n) : NULL;
+    if (n && !job->slots) {
+        war_save_job_free(job);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
+        war_capture_slot* s = &env->capture_slots[i];
+        if (!s->samples || s->count == 0 || skip[i]) continue;
+        war_save_slot* d = &job->slots[job->slot_count++];
+        d->idx = i;
+        d->slot = *s;
+        war_sample_buf_ref(d->slot.buf);
+        // a slot still showing its root's audio is stored as the link alone
+        d->count = s->count;
+        if (s->root && s->root <= 128 * WAR_CAPTURE_SLOT_LAYERS &&
+            env->capture_slots[s->root - 1].samples == s->samples && env->capture_slots[s->root - 1].count == s->count)
+            d->count = 0;
+    }
+    return job;
+}
+
+// fsyncs the directory holding path so a rename into it survives a crash
+static inline void _war_save_sync_dir(const char* path) {
+    char dir[1024];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        dir[0] = '.';
+        dir[1] = '\0';
+    } else if (slash == path) {
+        dir[0] = '/';
+        dir[1] = '\0';
+    } else {
+        size_t len = (size_t)(slash - path);
+        if (len >= sizeof(dir)) return;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// writes job as a version 7 project via <path>.tmp; 0 on failure, nothing
+// left behind. The data is on disk before the rename, so a crash leaves the
+// old project or the new one, never a short file under the project's name.
+// The old file is only replaced by the rename: loaded slots may still map it
+// (war_page.h).
+static inline int war_save_write(const war_save_job* job) {
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return 0;
+    char* io = malloc(WAR_SAVE_IO_BUFFER);
+    if (io) setvbuf(f, io, _IOFBF, WAR_SAVE_IO_BUFFER);
+    fwrite("WARP", 1, 4, f);
+    uint32_t version = 7;
+    fwrite(&version, 4, 1, f);
+    fwrite(&job->bpm, 4, 1, f);
+    fwrite(&job->note_count, 4, 1, f);
+    for (uint32_t i = 0; i < job->note_count; i++) {
+        fwrite(&job->notes[i].pos, sizeof(float), 3, f);
+        fwrite(&job->notes[i].size, sizeof(float), 2, f);
+        fwrite(&job->notes[i].color, sizeof(float), 4, f);
+        fwrite(&job->notes[i].flags, sizeof(war_vulkan_flags), 1, f);
+        fwrite(&job->notes[i].tick, sizeof(uint64_t), 1, f);
+    }
+    fwrite(&job->slot_count, 4, 1, f);
+    for (uint32_t i = 0; i < job->slot_count; i++) {
+        const war_save_slot* d = &job->slots[i];
+        const war_capture_slot* s = &d->slot;
+        fwrite(&d->idx, 4, 1, f);
+        fwrite(&d->count, sizeof(uint64_t), 1, f);
+        fwrite(&s->attack, sizeof(float), 1, f);
+        fwrite(&s->sustain, sizeof(float), 1, f);
+        fwrite(&s->release, sizeof(float), 1, f);
+        fwrite(&s->eq1, sizeof(int), 1, f);
+        fwrite(&s->eq2, sizeof(int), 1, f);
+        fwrite(&s->gain, sizeof(float), 1, f);
+        fwrite(&s->pan, sizeof(int), 1, f);
+        fwrite(&s->effect_flags, sizeof(uint64_t), 1, f);
+        fwrite(s->effect_params, sizeof(double), WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS, f);
+        fwrite(&s->transpose, sizeof(int32_t), 1, f);
+        fwrite(&s->root, sizeof(uint32_t), 1, f);
+        // version 7: the view is stored in the slot's own format
+        uint8_t fmt[2] = {s->buf ? s->buf->format : WAR_SAMPLE_F32, s->buf ? s->buf->channels : 2};
+        fwrite(fmt, 1, 2, f);
+        // large blocks bypass the buffer and go to the kernel in one write
+        fwrite(s->samples, war_sample_frame_bytes(fmt[0], fmt[1]), d->count / 2, f);
+    }
+    int bad = ferror(f);
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) bad = 1;
+    if (fclose(f) != 0) bad = 1;
+    free(io);
+    if (bad || rename(tmp_path, job->path) != 0) {
+        remove(tmp_path);
+        return 0;
+    }
+    _war_save_sync_dir(job->path);
+    return 1;
+}
+
+static void* _war_save_worker(void* arg) {
+    war_env* env = (war_env*)arg;
+    war_trace_thread_name("save worker");
+    for (;;) {
+        pthread_mutex_lock(&env->save_mutex);
+        if (env->save_queue_len == 0) {
+            env->save_thread_alive = 0;
+            pthread_mutex_unlock(&env->save_mutex);
+            break;
+        }
+        war_save_job* job = env->save_queue[0];
+        for (uint32_t i = 1; i < env->save_queue_len; i++) env->save_queue[i - 1] = env->save_queue[i];
+        env->save_queue_len--;
+        pthread_mutex_unlock(&env->save_mutex);
+
+        uint64_t _tr = war_trace_begin();
+        job->ok = (uint8_t)war_save_write(job);
+        war_trace_end("project save", _tr);
+        pthread_mutex_lock(&env->save_mutex);
+        int keep = env->save_done_len < WAR_SAVE_QUEUE_MAX;
+        if (keep) env->save_done[env->save_done_len++] = job;
+        pthread_mutex_unlock(&env->save_mutex);
+        if (!keep) war_save_job_free(job);
+    }
+    return NULL;
+}
+
+static inline void war_save_init(war_env* env) {
+    pthread_mutex_init(&env->save_mutex, NULL);
+    env->save_thread_alive = 0;
+    env->save_queue_len = 0;
+    env->save_done_len = 0;
+    env->autosave_us = 0;
+    env->autosave_seq = 0;
+}
+
+// waits for queued saves to reach the disk (results stay for war_save_poll)
+static inline void war_save_flush(war_env* env) {
+    for (;;) {
+        pthread_mutex_lock(&env->save_mutex);
+        int alive = env->save_thread_alive;
+        pthread_mutex_unlock(&env->save_mutex);
+        if (!alive) break;
+        usleep(10000);
+    }
+}
+
+// lets queued saves finish: quitting right after :w must not lose it
+static inline void war_save_shutdown(war_env* env) {
+    war_save_flush(env);
+    for (uint32_t i = 0; i < env->save_done_len; i++) {
+        if (!env->save_done[i]->ok) fprintf(stderr, "SAVE: failed to write %s\n", env->save_done[i]->path);
+        war_save_job_free(env->save_done[i]);
+    }
+    env->save_done_len = 0;
+    pthread_mutex_destroy(&env->save_mutex);
+}
+
+// main thread: snapshot env and queue it for path. A queued, not yet started
+// save of the same path is superseded. Returns 0 when queued.
+static inline int war_save_start(war_env* env, const char* path, uint8_t autosave) {
+    const char* tail = strlen(path) > 75 ? path + strlen(path) - 75 : path;
+    war_load_finish(env); // audio still being read belongs in the snapshot
+    war_save_job* job = war_save_snapshot(env, path, autosave);
+    if (!job) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "save FAILED: out of memory");
+        return -1;
+    }
+    war_save_job* old = NULL;
+    pthread_mutex_lock(&env->save_mutex);
+    for (uint32_t i = 0; i < env->save_queue_len; i++) {
+        if (strcmp(env->save_queue[i]->path, job->path) != 0) continue;
+        old = env->save_queue[i];
+        env->save_queue[i] = job;
+        break;
+    }
+    if (!old && env->save_queue_len >= WAR_SAVE_QUEUE_MAX) {
+        pthread_mutex_unlock(&env->save_mutex);
+        war_save_job_free(job);
+        snprintf(env->status_msg, sizeof(env->status_msg), "save FAILED: busy: %s", tail);
+        return -1;
+    }
+    if (!old) env->save_queue[env->save_queue_len++] = job;
+    int spawn = !env->save_thread_alive;
+    if (spawn) env->save_thread_alive = 1;
+    pthread_mutex_unlock(&env->save_mutex);
+    war_save_job_free(old);
+    if (spawn) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        int rc = pthread_create(&env->save_thread, &attr, _war_save_worker, env);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            // no worker: write it here rather than not at all
+            pthread_mutex_lock(&env->save_mutex);
+            env->save_thread_alive = 0;
+            env->save_queue_len--;
+            pthread_mutex_unlock(&env->save_mutex);
+            job->ok = (uint8_t)war_save_write(job);
+            pthread_mutex_lock(&env->save_mutex);
+            if (env->save_done_len < WAR_SAVE_QUEUE_MAX) env->save_done[env->save_done_len++] = job;
+            else war_save_job_free(job);
+            pthread_mutex_unlock(&env->save_mutex);
+        }
+    }
+    if (!autosave) {
+        env->undo_save_marker = env->undo_pos;
+        env->file_dirty = 0;
+        snprintf(env->status_msg, sizeof(env->status_msg), "saving %s", tail);
+    }
+    return 0;
+}
+
+// main thread: report finished saves. Returns how many finished.
+static inline uint32_t war_save_poll(war_env* env) {
+    if (!env->save_done_len) return 0; // racy peek, rechecked under lock
+    war_save_job* done[WAR_SAVE_QUEUE_MAX];
+    pthread_mutex_lock(&env->save_mutex);
+    uint32_t n = env->save_done_len;
+    memcpy(done, env->save_done, sizeof(war_save_job*) * n);
+    env->save_done_len = 0;
+    pthread_mutex_unlock(&env->save_mutex);
+    for (uint32_t i = 0; i < n; i++) {
+        war_save_job* job = done[i];
+        const char* tail = strlen(job->path) > 75 ? job->path + strlen(job->path) - 75 : job->path;
+        if (!job->ok) {
+            snprintf(env->status_msg, sizeof(env->status_msg), "save FAILED: %s", tail);
+            fprintf(stderr, "SAVE: failed to write %s\n", job->path);
+            if (!job->autosave) {
+                env->file_dirty = 1;
+                env->undo_save_marker = UINT32_MAX;
+            } else {
+                env->autosave_seq = UINT64_MAX; // retry on the next tick
+            }
+        } else if (job->autosave) {
+            snprintf(env->status_msg, sizeof(env->status_msg), "autosaved %s", tail);
+            fprintf(stderr, "SAVE: autosaved %s\n", job->path);
+        } else {
+            snprintf(env->status_msg, sizeof(env->status_msg), "%s saved (%u notes, %u slots)", tail,
+                     job->note_count, job->slot_count);
+            fprintf(stderr, "SAVE: wrote %s (%u notes, %u slots)\n", job->path, job->note_count, job->slot_count);
+        }
+        war_save_job_free(job);
+    }
+    return n;
+}
+
+// main thread, every loop: autosave a project that has been dirty for
+// autosave_sec, then again every autosave_sec while it stays dirty and has
+// changed since the last autosave
+static inline void war_autosave_tick(war_env* env) {
+    if (env->autosave_sec <= 0.0 || !env->current_project_path[0]) return;
+    uint64_t now = war_get_monotonic_time_us();
+    if (!env->file_dirty || !env->autosave_us) {
+        env->autosave_us = now;
+        return;
+    }
+    if (now - env->autosave_us < (uint64_t)(env->autosave_sec * 1000000.0)) return;
+    env->autosave_us = now;
+    if (env->edit_seq == env->autosave_seq) return; // that autosave is still current
+    env->autosave_seq = env->edit_seq;
+    char path[1040];
+    snprintf(path, sizeof(path), "%s.autosave", env->current_project_path);
+    war_save_start(env, path, 1);
+}
+
+#endif // WAR_SAVE_H
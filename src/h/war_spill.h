@@ -0,0 +1,255 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_spill.h — capture takes streamed to disk
+//
+// While capture is on, the main loop drains pc_capture/pc_loopback into the
+// current WAR_SPILL_BLOCK_FLOATS block of a pool-allocated set. Full blocks
+// go to a writer thread, which appends them to an unlinked file in DIR_CACHE
+// (preallocated WAR_SPILL_GROW at a time) and hands the block back. The
+// drain never allocates, and a take of any length costs WAR_SPILL_BLOCKS
+// blocks of memory.
+//
+// war_spill_take waits for the last blocks to land, maps the file read-only
+// and returns it as a war_sample_buf, so the slot reads the take straight
+// from the page cache. If the writer falls behind and every block is queued,
+// new audio is dropped and counted instead of growing memory. The take keeps
+// its length: the dropped stretch is left as a hole, which reads as silence.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_SPILL_H
+#define WAR_SPILL_H
+
+#include "war_data.h"
+#include "war_functions.h"
+#include "war_log.h"
+#include "war_sample.h"
+#include "war_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void* _war_spill_writer(void* arg) {
+    war_env* env = (war_env*)arg;
+    war_trace_thread_name("capture spill");
+    pthread_mutex_lock(&env->spill_mutex);
+    for (;;) {
+        while (!env->spill_queue_len && !env->spill_quit)
+            pthread_cond_wait(&env->spill_wake, &env->spill_mutex);
+        if (!env->spill_queue_len) break;
+        war_spill_job job = env->spill_queue[env->spill_queue_head];
+        env->spill_writing = 1;
+        int fd = env->spill_fd;
+        uint64_t have = env->spill_file_bytes;
+        pthread_mutex_unlock(&env->spill_mutex);
+
+        uint64_t _tr = war_trace_begin();
+        uint64_t bytes = (uint64_t)job.floats * sizeof(float);
+        int ok = 1;
+        if (job.offset + bytes > have) {
+            uint64_t grow = have + WAR_SPILL_GROW;
+            while (grow < job.offset + bytes) grow += WAR_SPILL_GROW;
+            // fallocate keeps the take contiguous on disk; tmpfs and some
+            // filesystems refuse it, a sparse extend still works there
+            if (posix_fallocate(fd, (off_t)have, (off_t)(grow - have)) != 0 && ftruncate(fd, (off_t)grow) != 0)
+                ok = 0;
+            else
+                have = grow;
+        }
+        const uint8_t* p = (const uint8_t*)(env->spill_blocks + (uint64_t)job.block * WAR_SPILL_BLOCK_FLOATS);
+        uint64_t done = 0;
+        while (ok && done < bytes) {
+            ssize_t w = pwrite(fd, p + done, bytes - done, (off_t)(job.offset + done));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) ok = 0;
+            else done += (uint64_t)w;
+        }
+        war_trace_end("spill write", _tr);
+
+        pthread_mutex_lock(&env->spill_mutex);
+        env->spill_file_bytes = have;
+        if (!ok) env->spill_failed = 1;
+        env->spill_queue_head = (env->spill_queue_head + 1) % WAR_SPILL_BLOCKS;
+        env->spill_queue_len--;
+        env->spill_free[env->spill_free_len++] = job.block;
+        env->spill_writing = 0;
+        if (!env->spill_queue_len) pthread_cond_broadcast(&env->spill_idle);
+    }
+    env->spill_thread_alive = 0;
+    pthread_mutex_unlock(&env->spill_mutex);
+    return NULL;
+}
+
+// call after the pool is allocated
+static inline void war_spill_init(war_env* env) {
+    pthread_mutex_init(&env->spill_mutex, NULL);
+    pthread_cond_init(&env->spill_wake, NULL);
+    pthread_cond_init(&env->spill_idle, NULL);
+    env->spill_fd = -1;
+    env->spill_quit = 0;
+    env->spill_writing = 0;
+    env->spill_failed = 0;
+    env->spill_file_bytes = 0;
+    env->spill_queue_head = 0;
+    env->spill_queue_len = 0;
+    env->spill_fill = UINT32_MAX;
+    env->spill_fill_floats = 0;
+    env->spill_count = 0;
+    env->spill_dropped = 0;
+    env->spill_free_len = 0;
+    if (env->spill_blocks)
+        for (uint32_t i = 0; i < WAR_SPILL_BLOCKS; i++) env->spill_free[env->spill_free_len++] = WAR_SPILL_BLOCKS - 1 - i;
+    env->spill_thread_alive = env->spill_blocks && pthread_create(&env->spill_thread, NULL, _war_spill_writer, env) == 0;
+    if (!env->spill_thread_alive) war_log_error("spill: no writer, capture is disabled");
+}
+
+// caller holds spill_mutex
+static inline void _war_spill_wait_idle(war_env* env) {
+    while (env->spill_queue_len && env->spill_thread_alive)
+        pthread_cond_wait(&env->spill_idle, &env->spill_mutex);
+}
+
+// drops the current take, if any
+static inline void war_spill_reset(war_env* env) {
+    pthread_mutex_lock(&env->spill_mutex);
+    _war_spill_wait_idle(env);
+    if (env->spill_fill != UINT32_MAX) env->spill_free[env->spill_free_len++] = env->spill_fill;
+    env->spill_fill = UINT32_MAX;
+    env->spill_fill_floats = 0;
+    if (env->spill_fd >= 0) close(env->spill_fd);
+    env->spill_fd = -1;
+    env->spill_file_bytes = 0;
+    env->spill_count = 0;
+    env->spill_dropped = 0;
+    env->spill_failed = 0;
+    pthread_mutex_unlock(&env->spill_mutex);
+}
+
+static inline int _war_spill_open(war_env* env) {
+    char dir[4096], path[4096 + 32];
+    war_expand_env(env->ctx_config->DIR_CACHE, dir, sizeof(dir));
+    int fd;
+#ifdef O_TMPFILE
+    fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) return fd;
+#endif
+    snprintf(path, sizeof(path), "%s/capture-XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd >= 0) unlink(path);
+    return fd;
+}
+
+// starts a new take; 0 when no spill file could be created
+static inline int war_spill_begin(war_env* env) {
+    war_spill_reset(env);
+    if (!env->spill_thread_alive) return 0;
+    int fd = _war_spill_open(env);
+    if (fd < 0) {
+        war_log_error("spill: cannot create capture file in %s: %s", env->ctx_config->DIR_CACHE, strerror(errno));
+        return 0;
+    }
+    pthread_mutex_lock(&env->spill_mutex);
+    env->spill_fd = fd;
+    pthread_mutex_unlock(&env->spill_mutex);
+    return 1;
+}
+
+// caller holds spill_mutex
+static inline void _war_spill_submit(war_env* env) {
+    if (env->spill_fill == UINT32_MAX || !env->spill_fill_floats) return;
+    war_spill_job* job = &env->spill_queue[(env->spill_queue_head + env->spill_queue_len) % WAR_SPILL_BLOCKS];
+    job->block = env->spill_fill;
+    job->floats = env->spill_fill_floats;
+    job->offset = (env->spill_count - env->spill_fill_floats) * sizeof(float);
+    env->spill_queue_len++;
+    env->spill_fill = UINT32_MAX;
+    env->spill_fill_floats = 0;
+    pthread_cond_signal(&env->spill_wake);
+}
+
+// main thread: appends interleaved floats to the take
+static inline void war_spill_write(war_env* env, const float* in, uint64_t n) {
+    if (env->spill_fd < 0) return;
+    pthread_mutex_lock(&env->spill_mutex);
+    while (n) {
+        if (env->spill_fill == UINT32_MAX) {
+            if (!env->spill_free_len) {
+                // later blocks land after the gap, so the timeline holds
+                env->spill_dropped += n;
+                env->spill_count += n;
+                break;
+            }
+            env->spill_fill = env->spill_free[--env->spill_free_len];
+        }
+        uint64_t room = WAR_SPILL_BLOCK_FLOATS - env->spill_fill_floats;
+        uint64_t c = n < room ? n : room;
+        memcpy(env->spill_blocks + (uint64_t)env->spill_fill * WAR_SPILL_BLOCK_FLOATS + env->spill_fill_floats, in,
+               sizeof(float) * c);
+        env->spill_fill_floats += (uint32_t)c;
+        env->spill_count += c;
+        in += c;
+        n -= c;
+        if (env->spill_fill_floats == WAR_SPILL_BLOCK_FLOATS) _war_spill_submit(env);
+    }
+    pthread_mutex_unlock(&env->spill_mutex);
+}
+
+// main thread: ends the take and returns it mapped (NULL when empty or on a
+// write error). Waits for at most WAR_SPILL_BLOCKS blocks to be written.
+static inline war_sample_buf* war_spill_take(war_env* env) {
+    pthread_mutex_lock(&env->spill_mutex);
+    _war_spill_submit(env);
+    _war_spill_wait_idle(env);
+    int fd = env->spill_fd;
+    uint64_t count = env->spill_count & ~1ull;
+    uint64_t dropped = env->spill_dropped;
+    int failed = env->spill_failed || env->spill_queue_len;
+    env->spill_fd = -1;
+    env->spill_file_bytes = 0;
+    env->spill_count = 0;
+    env->spill_dropped = 0;
+    env->spill_failed = 0;
+    pthread_mutex_unlock(&env->spill_mutex);
+    if (fd < 0) return NULL;
+    if (dropped) war_log_warn("spill: writer fell behind, dropped %llu floats", (unsigned long long)dropped);
+    war_sample_buf* b = NULL;
+    uint64_t bytes = count * sizeof(float);
+    if (failed) {
+        war_log_error("spill: write failed, take discarded");
+    } else if (count && ftruncate(fd, (off_t)bytes) == 0) {
+        void* p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            b = war_sample_buf_map(p, bytes, (float*)p, count);
+            if (!b) munmap(p, bytes);
+        }
+    }
+    close(fd);
+    return b;
+}
+
+// stops the writer and drops any take in progress
+static inline void war_spill_shutdown(war_env* env) {
+    war_spill_reset(env);
+    pthread_mutex_lock(&env->spill_mutex);
+    int alive = env->spill_thread_alive;
+    env->spill_quit = 1;
+    pthread_cond_signal(&env->spill_wake);
+    pthread_mutex_unlock(&env->spill_mutex);
+    if (alive) pthread_join(env->spill_thread, NULL);
+    pthread_cond_destroy(&env->spill_idle);
+    pthread_cond_destroy(&env->spill_wake);
+    pthread_mutex_destroy(&env->spill_mutex);
+}
+
+#endif // WAR_SPILL_H
@@ -10,13 +10,17 @@
 // Each extraction job splits a source slot with Demucs (4 stems) and writes
 // the requested stem into the next free capture slot above the source pitch
 // (same layer), like the split logic. Extracted slots are normal capture
-// slots, so they save/load like any other audio.
+// slots, so they save/load like any other audio. A job reads a reference to
+// the source audio taken at enqueue; the result is installed by
+// war_stem_poll on the main thread.
 //-----------------------------------------------------------------------------
 
 #ifndef WAR_STEM_H
 #define WAR_STEM_H
 
 #include "war_data.h"
+#include "war_sample.h"
+#include "war_trace.h"
 
 #include <errno.h>
 #include <math.h>
@@ -28,14 +32,6 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-// Drop ownership without free (after move of whole slot to another index).
-static inline void _war_slot_null_owned(war_capture_slot* s) {
-    if (!s) return;
-    s->samples = NULL;
-    s->count = 0;
-    s->capacity = 0;
-}
-
 static inline const char* _war_stem_name(uint8_t mode) {
     switch (mode) {
     case WAR_STEM_VOCALS: return "vocals";
@@ -236,14 +232,12 @@ static inline int _war_stem_run_demucs(const char* in_wav, const char* out_dir)
     return 0;
 }
 
-// Run the whole extraction for one job: split src slot with demucs and write
-// the requested stem into the next free slot above (same layer).
-static inline int _war_stem_extract_job(war_env* env, uint32_t src_idx, uint8_t kind) {
-    if (!env || src_idx >= 128 * WAR_CAPTURE_SLOT_LAYERS) return -1;
-    uint32_t src_pitch = src_idx / WAR_CAPTURE_SLOT_LAYERS;
-    uint32_t src_layer = src_idx % WAR_CAPTURE_SLOT_LAYERS + 1;
-    war_capture_slot* slot = &env->capture_slots[src_idx];
-    if (!slot->samples || slot->count < 2) {
+// Run the whole extraction for one job: split the snapshot with demucs and
+// queue the requested stem for war_stem_poll to install above the source.
+static inline int _war_stem_extract_job(war_env* env, const war_stem_job* job) {
+    uint32_t src_idx = job->src_idx;
+    uint8_t kind = job->kind;
+    if (!job->in || job->count < 2) {
         pthread_mutex_lock(&env->stem_mutex);
         env->stem_last_ok = 0;
         env->stem_last_kind = kind;
@@ -265,7 +259,10 @@ static inline int _war_stem_extract_job(war_env* env, uint32_t src_idx, uint8_t
         return -1;
     }
 
-    if (_war_stem_write_wav_f32(in_wav, slot->samples, slot->count, 48000) != 0) {
+    const float* in = war_sample_unpack(job->src, job->in, job->count);
+    int wrote = in ? _war_stem_write_wav_f32(in_wav, in, job->count, 48000) : -1;
+    war_sample_unpack_free(job->in, in);
+    if (wrote != 0) {
         snprintf(env->status_msg, sizeof(env->status_msg), "stem: write wav failed");
         return -1;
     }
@@ -285,7 +282,7 @@ static inline int _war_stem_extract_job(war_env* env, uint32_t src_idx, uint8_t
         return -1;
     }
 
-    uint64_t target = slot->count;
+    uint64_t target = job->count;
     uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
     float* v0 = _war_stem_load_wav_f32(p_voc, &c0, target);
     float* v1 = _war_stem_load_wav_f32(p_dru, &c1, target);
@@ -325,55 +322,6 @@ static inline int _war_stem_extract_job(war_env* env, uint32_t src_idx, uint8_t
         snprintf(env->status_msg, sizeof(env->status_msg), "stem: bad kind");
         return -1;
     }
-
-    // find next free slot above (same layer, like split)
-    pthread_mutex_lock(&env->stem_mutex);
-    uint32_t dst_idx = UINT32_MAX;
-    for (uint32_t p = src_pitch + 1; p < 128; p++) {
-        uint32_t mi = p * WAR_CAPTURE_SLOT_LAYERS + (src_layer - 1);
-        if (!env->capture_slots[mi].samples || env->capture_slots[mi].count < 2) {
-            dst_idx = mi;
-            break;
-        }
-    }
-    if (dst_idx == UINT32_MAX) {
-        env->stem_last_ok = 0;
-        env->stem_last_kind = kind;
-        env->stem_last_src = src_idx;
-        env->stem_last_dst = UINT32_MAX;
-        pthread_mutex_unlock(&env->stem_mutex);
-        free(v0); free(v1); free(v2); free(v3); free(inst);
-        snprintf(env->status_msg, sizeof(env->status_msg),
-                 "stem: no free slot above pitch %u", src_pitch);
-        return -1;
-    }
-
-    // install into dest: params copied from source; samples written before
-    // count so concurrent readers see an empty slot, never a dangling one
-    war_capture_slot* dst = &env->capture_slots[dst_idx];
-    free(dst->samples);
-    dst->samples = NULL;
-    dst->count = 0;
-    dst->capacity = 0;
-    dst->gain = slot->gain;
-    dst->pan = slot->pan;
-    dst->eq1 = slot->eq1;
-    dst->eq2 = slot->eq2;
-    dst->attack = slot->attack;
-    dst->sustain = slot->sustain;
-    dst->release = slot->release;
-    dst->effect_flags = slot->effect_flags;
-    memcpy(dst->effect_params, slot->effect_params,
-           sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
-    dst->samples = chosen;
-    dst->count = chosen_count;
-    dst->capacity = chosen_count;
-    env->stem_last_ok = 1;
-    env->stem_last_kind = kind;
-    env->stem_last_src = src_idx;
-    env->stem_last_dst = dst_idx;
-    pthread_mutex_unlock(&env->stem_mutex);
-
     if (chosen != v0) free(v0);
     if (chosen != v1) free(v1);
     if (chosen != v2) free(v2);
@@ -383,21 +331,44 @@ static inline int _war_stem_extract_job(war_env* env, uint32_t src_idx, uint8_t
     char rm[300];
     snprintf(rm, sizeof(rm), "rm -rf '%s'", tmpdir);
     system(rm);
-    snprintf(env->status_msg, sizeof(env->status_msg),
-             "stem: %s -> pitch %u", _war_stem_name(kind), dst_idx / WAR_CAPTURE_SLOT_LAYERS);
+
+    war_sample_buf* buf = war_sample_buf_wrap(chosen, chosen_count);
+    if (!buf) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "stem: oom");
+        return -1;
+    }
+    pthread_mutex_lock(&env->stem_mutex);
+    int queued = env->stem_ready_len < WAR_STEM_QUEUE_MAX;
+    if (queued) {
+        war_stem_result* r = &env->stem_ready[env->stem_ready_len++];
+        r->src_idx = src_idx;
+        r->kind = kind;
+        r->buf = buf;
+    }
+    pthread_mutex_unlock(&env->stem_mutex);
+    if (!queued) {
+        war_sample_buf_unref(buf);
+        return -1;
+    }
     return 0;
 }
 
+// drops queued jobs and their snapshot references (stem_mutex held)
+static inline void _war_stem_drop_queue(war_env* env) {
+    for (uint32_t i = 0; i < env->stem_queue_len; i++)
+        war_sample_buf_unref(env->stem_queue[i].src);
+    env->stem_queue_len = 0;
+}
+
 static void* _war_stem_worker(void* arg) {
     war_env* env = (war_env*)arg;
+    war_trace_thread_name("stem worker");
     for (;;) {
         war_stem_job job;
-        job.src_idx = UINT32_MAX;
-        job.kind = WAR_STEM_OFF;
         uint32_t done = 0, total = 0;
         pthread_mutex_lock(&env->stem_mutex);
         if (env->stem_cancel) {
-            env->stem_queue_len = 0;
+            _war_stem_drop_queue(env);
             env->stem_worker_busy = 0;
             env->stem_thread_alive = 0;
             env->stem_cancel = 0;
@@ -422,7 +393,10 @@ static void* _war_stem_worker(void* arg) {
 
         snprintf(env->status_msg, sizeof(env->status_msg),
                  "stem: %s %u/%u…", _war_stem_name(job.kind), done + 1, total);
-        int rc = _war_stem_extract_job(env, job.src_idx, job.kind);
+        uint64_t _tr = war_trace_begin();
+        int rc = _war_stem_extract_job(env, &job);
+        war_trace_end("stem job", _tr);
+        war_sample_buf_unref(job.src);
 
         pthread_mutex_lock(&env->stem_mutex);
         env->stem_done_count++;
@@ -475,6 +449,7 @@ static inline void war_stem_init(war_env* env) {
     env->stem_worker_busy = 0;
     env->stem_cancel = 0;
     env->stem_queue_len = 0;
+    env->stem_ready_len = 0;
     env->stem_done_count = 0;
     env->stem_total_count = 0;
     env->stem_last_ok = 0;
@@ -487,7 +462,7 @@ static inline void war_stem_shutdown(war_env* env) {
     if (!env) return;
     pthread_mutex_lock(&env->stem_mutex);
     env->stem_cancel = 1;
-    env->stem_queue_len = 0;
+    _war_stem_drop_queue(env);
     pthread_mutex_unlock(&env->stem_mutex);
     // detached worker exits on cancel/empty; brief wait
     for (int i = 0; i < 50; i++) {
@@ -497,9 +472,68 @@ static inline void war_stem_shutdown(war_env* env) {
         if (!alive) break;
         usleep(100000);
     }
+    for (uint32_t i = 0; i < env->stem_ready_len; i++)
+        war_sample_buf_unref(env->stem_ready[i].buf);
+    env->stem_ready_len = 0;
     pthread_mutex_destroy(&env->stem_mutex);
 }
 
+// main thread: install extracted stems into the next free slot above their
+// source (same layer, like split), params copied from the source. Returns the
+// installed count.
+static inline uint32_t war_stem_poll(war_env* env) {
+    if (!env->stem_ready_len) return 0; // racy peek, rechecked under lock
+    war_stem_result ready[WAR_STEM_QUEUE_MAX];
+    pthread_mutex_lock(&env->stem_mutex);
+    uint32_t n = env->stem_ready_len;
+    memcpy(ready, env->stem_ready, sizeof(war_stem_result) * n);
+    env->stem_ready_len = 0;
+    pthread_mutex_unlock(&env->stem_mutex);
+    uint32_t installed = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t src_idx = ready[i].src_idx;
+        uint32_t src_pitch = src_idx / WAR_CAPTURE_SLOT_LAYERS;
+        uint32_t li = src_idx % WAR_CAPTURE_SLOT_LAYERS;
+        uint32_t dst_idx = UINT32_MAX;
+        for (uint32_t p = src_pitch + 1; p < 128; p++) {
+            uint32_t mi = p * WAR_CAPTURE_SLOT_LAYERS + li;
+            if (!env->capture_slots[mi].samples || env->capture_slots[mi].count < 2) {
+                dst_idx = mi;
+                break;
+            }
+        }
+        pthread_mutex_lock(&env->stem_mutex);
+        env->stem_last_ok = dst_idx != UINT32_MAX;
+        env->stem_last_kind = ready[i].kind;
+        env->stem_last_src = src_idx;
+        env->stem_last_dst = dst_idx;
+        pthread_mutex_unlock(&env->stem_mutex);
+        if (dst_idx == UINT32_MAX) {
+            war_sample_buf_unref(ready[i].buf);
+            snprintf(env->status_msg, sizeof(env->status_msg),
+                     "stem: no free slot above pitch %u", src_pitch);
+            continue;
+        }
+        war_capture_slot* slot = &env->capture_slots[src_idx];
+        war_capture_slot* dst = &env->capture_slots[dst_idx];
+        dst->gain = slot->gain;
+        dst->pan = slot->pan;
+        dst->eq1 = slot->eq1;
+        dst->eq2 = slot->eq2;
+        dst->attack = slot->attack;
+        dst->sustain = slot->sustain;
+        dst->release = slot->release;
+        dst->effect_flags = slot->effect_flags;
+        memcpy(dst->effect_params, slot->effect_params,
+               sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+        war_slot_set_buf(dst, ready[i].buf);
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "stem: %s -> pitch %u", _war_stem_name(ready[i].kind), dst_idx / WAR_CAPTURE_SLOT_LAYERS);
+        installed++;
+    }
+    return installed;
+}
+
 static inline void war_stem_enqueue(war_env* env, uint32_t src_idx, uint8_t kind) {
     if (!env || src_idx >= 128 * WAR_CAPTURE_SLOT_LAYERS) return;
     if (kind < WAR_STEM_VOCALS || kind > WAR_STEM_INSTRUMENTAL) return;
@@ -516,9 +550,13 @@ static inline void war_stem_enqueue(war_env* env, uint32_t src_idx, uint8_t kind
         return;
     }
     int start_counts = (!env->stem_worker_busy && env->stem_queue_len == 0);
-    env->stem_queue[env->stem_queue_len].src_idx = src_idx;
-    env->stem_queue[env->stem_queue_len].kind = kind;
-    env->stem_queue_len++;
+    war_capture_slot* slot = &env->capture_slots[src_idx];
+    war_stem_job* job = &env->stem_queue[env->stem_queue_len++];
+    job->src_idx = src_idx;
+    job->kind = kind;
+    job->src = war_sample_buf_ref(slot->buf);
+    job->in = slot->samples;
+    job->count = slot->count;
     if (start_counts) {
         env->stem_done_count = 0;
         env->stem_total_count = 1;
@@ -597,7 +635,7 @@ static inline void war_stem_cancel(war_env* env) {
     if (!env) return;
     pthread_mutex_lock(&env->stem_mutex);
     env->stem_cancel = 1;
-    env->stem_queue_len = 0;
+    _war_stem_drop_queue(env);
     pthread_mutex_unlock(&env->stem_mutex);
     snprintf(env->status_msg, sizeof(env->status_msg), "stem: cancelled");
 }
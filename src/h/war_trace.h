@@ -0,0 +1,249 @@
+//-----------------------------------------------------------------------------
+//
+// See LICENSE
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// src/h/war_trace.h — timeline tracing (:trace start / :trace stop [file])
+//
+// Scoped markers record complete events into per-thread rings:
+//
+//     uint64_t t = war_trace_begin();
+//     ...
+//     war_trace_end("mix", t);
+//
+// war_trace_begin() returns 0 while tracing is off and war_trace_end() then
+// does nothing, so markers cost one relaxed load when idle. Each thread owns
+// one ring (single writer, no locks, no allocation on the recording thread)
+// claimed on its first event and held in a thread-local slot; rings keep the
+// newest WAR_TRACE_EVENTS events. A thread that exits hands its ring back,
+// and the next thread of the same name picks it up, so per-batch workers
+// don't use up rings. Threads beyond WAR_TRACE_THREADS go untraced and are
+// counted. :trace stop writes Chrome trace JSON, which chrome://tracing and
+// the Perfetto UI both open.
+//-----------------------------------------------------------------------------
+
+#ifndef WAR_TRACE_H
+#define WAR_TRACE_H
+
+#include "war_data.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WAR_TRACE_THREADS 32 // main, audio, I/O workers, load pool, renders
+#define WAR_TRACE_EVENTS  32768 // per thread, power of two
+#define WAR_TRACE_PATH    "war_trace.json"
+
+typedef struct war_trace_event {
+    const char* name; // string literal
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+} war_trace_event;
+
+typedef struct war_trace_ring {
+    _Atomic uint32_t head; // events written, newest at head - 1
+    _Atomic int owned;     // a live thread writes here
+    _Atomic(const char*) thread_name; // read by threads looking for a ring
+    war_trace_event* event;
+} war_trace_ring;
+
+typedef struct war_trace_state {
+    _Atomic int enabled;
+    _Atomic uint32_t dropped; // threads that found every ring taken
+    _Atomic uint32_t gen;     // :trace start count; a dropped thread retries on the next
+    uint64_t start_ns;
+    pthread_key_t exit_key; // releases a thread's ring when it exits
+    war_trace_ring ring[WAR_TRACE_THREADS];
+} war_trace_state;
+
+static war_trace_state war_trace_global;
+static pthread_once_t war_trace_once = PTHREAD_ONCE_INIT;
+static __thread int war_trace_tid = -1; // -2: no ring was free
+static __thread uint32_t war_trace_drop_gen;
+static __thread const char* war_trace_tname = NULL;
+
+static inline uint64_t _war_trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// names the calling thread in the trace; call once at thread start
+static inline void war_trace_thread_name(const char* name) {
+    war_trace_tname = name;
+    if (war_trace_tid >= 0)
+        atomic_store_explicit(&war_trace_global.ring[war_trace_tid].thread_name, name, memory_order_relaxed);
+}
+
+static void _war_trace_thread_exit(void* ring) {
+    atomic_store_explicit(&((war_trace_ring*)ring)->owned, 0, memory_order_release);
+}
+
+static void _war_trace_key_init(void) {
+    pthread_key_create(&war_trace_global.exit_key, _war_trace_thread_exit);
+}
+
+static inline int _war_trace_try_claim(war_trace_ring* r) {
+    int expect = 0;
+    return atomic_compare_exchange_strong_explicit(&r->owned, &expect, 1, memory_order_acquire,
+                                                   memory_order_relaxed);
+}
+
+// first event on this thread: a free ring last used under the same name, else
+// a fresh one, else any free one
+static inline void _war_trace_claim(war_trace_state* s) {
+    const char* name = war_trace_tname;
+    int id = -1;
+    for (uint32_t pass = 0; pass < 3 && id < 0; pass++) {
+        for (uint32_t i = 0; i < WAR_TRACE_THREADS && id < 0; i++) {
+            war_trace_ring* r = &s->ring[i];
+            const char* other = atomic_load_explicit(&r->thread_name, memory_order_relaxed);
+            if (atomic_load_explicit(&r->owned, memory_order_relaxed)) continue;
+            if (pass == 0 && !(name && other && strcmp(name, other) == 0)) continue;
+            if (pass == 1 && other) continue;
+            if (_war_trace_try_claim(r)) id = (int)i;
+        }
+    }
+    if (id < 0) {
+        atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+        war_trace_tid = -2;
+        war_trace_drop_gen = atomic_load_explicit(&s->gen, memory_order_relaxed);
+        return;
+    }
+    war_trace_tid = id;
+    atomic_store_explicit(&s->ring[id].thread_name, name, memory_order_relaxed);
+    pthread_setspecific(s->exit_key, &s->ring[id]);
+}
+
+static inline uint64_t war_trace_begin(void) {
+    if (!atomic_load_explicit(&war_trace_global.enabled, memory_order_relaxed)) return 0;
+    return _war_trace_now_ns();
+}
+
+static inline void war_trace_end(const char* name, uint64_t t0) {
+    if (!t0 || !atomic_load_explicit(&war_trace_global.enabled, memory_order_acquire)) return;
+    war_trace_state* s = &war_trace_global;
+    if (war_trace_tid == -1 ||
+        (war_trace_tid == -2 && war_trace_drop_gen != atomic_load_explicit(&s->gen, memory_order_relaxed)))
+        _war_trace_claim(s);
+    if (war_trace_tid < 0) return;
+    war_trace_ring* r = &s->ring[war_trace_tid];
+    if (!r->event) return;
+    uint32_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    war_trace_event* e = &r->event[h & (WAR_TRACE_EVENTS - 1)];
+    e->name = name;
+    e->ts_ns = t0;
+    e->dur_ns = _war_trace_now_ns() - t0;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+// main thread. Rings are allocated on the first start and kept until
+// war_trace_free() so a thread finishing an event after stop never sees them go.
+static inline int war_trace_start(void) {
+    war_trace_state* s = &war_trace_global;
+    atomic_store_explicit(&s->enabled, 0, memory_order_release);
+    pthread_once(&war_trace_once, _war_trace_key_init);
+    atomic_store_explicit(&s->dropped, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->gen, 1, memory_order_relaxed);
+    for (uint32_t i = 0; i < WAR_TRACE_THREADS; i++) {
+        if (!s->ring[i].event) s->ring[i].event = calloc(WAR_TRACE_EVENTS, sizeof(war_trace_event));
+        if (!s->ring[i].event) return 0;
+        atomic_store_explicit(&s->ring[i].head, 0, memory_order_relaxed);
+    }
+    s->start_ns = _war_trace_now_ns();
+    atomic_store_explicit(&s->enabled, 1, memory_order_release);
+    return 1;
+}
+
+// threads that went untraced since :trace start for lack of a ring
+static inline uint32_t war_trace_dropped(void) {
+    return atomic_load_explicit(&war_trace_global.dropped, memory_order_relaxed);
+}
+
+static inline int war_trace_active(void) {
+    return atomic_load_explicit(&war_trace_global.enabled, memory_order_relaxed);
+}
+
+// stops recording and writes Chrome trace JSON; returns events written or -1
+static inline int64_t war_trace_stop(const char* path) {
+    war_trace_state* s = &war_trace_global;
+    atomic_store_explicit(&s->enabled, 0, memory_order_release);
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    int64_t total = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"WAR\"}}");
+    for (uint32_t t = 0; t < WAR_TRACE_THREADS; t++) {
+        war_trace_ring* r = &s->ring[t];
+        if (!r->event || !atomic_load_explicit(&r->head, memory_order_acquire)) continue;
+        const char* tname = atomic_load_explicit(&r->thread_name, memory_order_relaxed);
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                t + 1, tname ? tname : "thread");
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        uint32_t count = head < WAR_TRACE_EVENTS ? head : WAR_TRACE_EVENTS;
+        for (uint32_t i = head - count; i != head; i++) {
+            war_trace_event* e = &r->event[i & (WAR_TRACE_EVENTS - 1)];
+            if (e->ts_ns < s->start_ns) continue;
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    e->name, t + 1, (double)(e->ts_ns - s->start_ns) / 1e3, (double)e->dur_ns / 1e3);
+            total++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return total;
+}
+
+// shutdown, after every traced thread has been joined
+static inline void war_trace_free(void) {
+    war_trace_state* s = &war_trace_global;
+    atomic_store_explicit(&s->enabled, 0, memory_order_release);
+    for (uint32_t i = 0; i < WAR_TRACE_THREADS; i++) {
+        free(s->ring[i].event);
+        s->ring[i].event = NULL;
+    }
+}
+
+// :trace start | stop [file] | status
+static inline void war_trace_cmd(war_env* env) {
+    const char* rest = env->cmd_len > 6 ? env->cmd_buf + 6 : "";
+    while (*rest == ' ' || *rest == '\t') rest++;
+    if (strcmp(rest, "start") == 0) {
+        if (war_trace_start())
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: recording");
+        else
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: out of memory");
+    } else if (strncmp(rest, "stop", 4) == 0) {
+        const char* path = rest + 4;
+        while (*path == ' ') path++;
+        if (!*path) path = WAR_TRACE_PATH;
+        if (!war_trace_active()) {
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: not recording");
+            return;
+        }
+        int64_t n = war_trace_stop(path);
+        uint32_t dropped = war_trace_dropped();
+        if (dropped) call_king_terry("trace: %u threads found no free ring (WAR_TRACE_THREADS %u)", dropped,
+                                     (unsigned)WAR_TRACE_THREADS);
+        if (n < 0)
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: cannot open %.90s", path);
+        else if (dropped)
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: %lld events -> %.80s, %u threads untraced",
+                     (long long)n, path, dropped);
+        else
+            snprintf(env->status_msg, sizeof(env->status_msg), "trace: %lld events -> %.90s", (long long)n, path);
+    } else if (!*rest || strcmp(rest, "status") == 0) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "trace: %s", war_trace_active() ? "recording" : "off");
+    } else {
+        snprintf(env->status_msg, sizeof(env->status_msg), "usage: :trace start | stop [file] | status");
+    }
+}
+
+#endif // WAR_TRACE_H
@@ -15,6 +15,9 @@
 #include "war_debug_macros.h"
 #include "war_embed_shaders.h"
 #include "war_functions.h"
+#include "war_perf.h"
+#include "war_sample.h"
+#include "war_trace.h"
 
 #include <assert.h>
 #include <dirent.h>
@@ -933,7 +936,7 @@ static inline void war_font_init(war_font_context* font,
                                  FT_Face face,
                                  double cell_px_w,
                                  double cell_px_h) {
-    font->instance_count = 2048;
+    font->instance_count = WAR_FONT_INSTANCES;
     font->cmd_instance_count = 0;
 
     // load '*' at the display size to get display metrics
@@ -1365,8 +1368,8 @@ static inline void war_font_render_cmd(VkCommandBuffer cmd,
 
     font->cmd_instance_count = count;
     war_vulkan_text_instance* inst = font->instance_mapped;
-    // use offset 1024 to avoid overlap with status bar labels
-    uint32_t _cmd_base = 1024;
+    // past the status bar labels (WAR_FONT_CMD_BASE)
+    uint32_t _cmd_base = WAR_FONT_CMD_BASE;
 
     // position: middle of the 3 gutter rows, 3 cells left of gutter edge
     float gutter_row = ctx_wayland->panning[1] + 1.0f;
@@ -2078,6 +2081,8 @@ static inline void war_line_render(VkCommandBuffer cmd,
 
 static inline void war_render_frame(war_wayland_context* ctx_wayland,
                                     war_vulkan_context* ctx_vk, war_color_context* ctx_color) {
+    uint64_t _perf_t0 = war_perf_now_ns();
+    uint64_t _tr = war_trace_begin();
     VkCommandBuffer cmd;
     vkAllocateCommandBuffers(ctx_vk->device, &ctx_vk->cbai, &cmd);
     VkCommandBufferBeginInfo cbbi = {
@@ -2531,8 +2536,9 @@ static inline void war_render_frame(war_wayland_context* ctx_wayland,
         uint32_t wp = ctx_wayland->env->wave_view_pitch;
         uint32_t wl = ctx_wayland->env->wave_view_layer;
         uint32_t widx = wp * WAR_CAPTURE_SLOT_LAYERS + (wl - 1);
-        float* ws = ctx_wayland->env->capture_slots[widx].samples;
-        uint64_t wcnt = ctx_wayland->env->capture_slots[widx].count;
+        const war_capture_slot* wslot = &ctx_wayland->env->capture_slots[widx];
+        float* ws = wslot->samples;
+        uint64_t wcnt = wslot->count;
         if (ws && wcnt >= 4) {
             double wrows = (double)ctx_wayland->height / (wch * wz) - ctx_wayland->gutter_rows;
             if (wrows < 2) wrows = 2;
@@ -2556,10 +2562,16 @@ static inline void war_render_frame(war_wayland_context* ctx_wayland,
                 uint64_t fe = fs + wstep;
                 if (fe > wframes) fe = wframes;
                 float pp = 0.0f, pn = 0.0f;
-                for (uint64_t f = fs; f < fe; f++) {
-                    float m = (ws[f*2] + ws[f*2+1]) * 0.5f;
-                    if (m > pp) pp = m;
-                    if (m < pn) pn = m;
+                // decoded in runs so packed slots read like plain ones
+                float wblk[512];
+                for (uint64_t f = fs; f < fe; f += 256) {
+                    uint64_t wn = fe - f < 256 ? fe - f : 256;
+                    war_slot_read(wslot, f * 2, wblk, wn * 2);
+                    for (uint64_t k = 0; k < wn; k++) {
+                        float m = (wblk[k*2] + wblk[k*2+1]) * 0.5f;
+                        if (m > pp) pp = m;
+                        if (m < pn) pn = m;
+                    }
                 }
                 double bx = wx0 + (double)b / 4.0;
                 if (pp > 0.0001f) {
@@ -2718,6 +2730,75 @@ static inline void war_render_frame(war_wayland_context* ctx_wayland,
             }
         }
     }
+    // :perf overlay (top right, WAR_PERF_HUD_COLS x WAR_PERF_HUD_LINES)
+    if (ctx_wayland->env->perf_hud && ctx_wayland->env->ctx_font) {
+        war_cursor_context* _pcur = ctx_wayland->env->ctx_cursor;
+        war_font_context* _pf = ctx_wayland->env->ctx_font;
+        double _pcw = _pcur->cell_width;
+        double _pch = _pcur->cell_height;
+        float _pz = ctx_wayland->zoom;
+        float _psw = (float)ctx_wayland->width;
+        float _psh = (float)ctx_wayland->height;
+        float _ptotal_x = _psw / ((float)_pcw * _pz);
+        float _ptotal_y = _psh / ((float)_pch * _pz);
+        char _plines[WAR_PERF_HUD_LINES][WAR_PERF_HUD_COLS];
+        uint32_t _pn = war_perf_format(&ctx_wayland->env->perf, _plines);
+        float _pbg_x = _ptotal_x - (float)WAR_PERF_HUD_COLS - 1.0f;
+        float _pbg_y = _ptotal_y - (float)_pn - 1.0f;
+        if (_pbg_x < (float)ctx_wayland->gutter_cols) _pbg_x = (float)ctx_wayland->gutter_cols;
+        if (_pbg_y < (float)ctx_wayland->gutter_rows) _pbg_y = (float)ctx_wayland->gutter_rows;
+        VkViewport _pvp = {0, 0, _psw, _psh, 0, 1};
+        VkRect2D _psc = {{0, 0}, {(uint32_t)_psw, (uint32_t)_psh}};
+        vkCmdSetViewport(cmd, 0, 1, &_pvp);
+        vkCmdSetScissor(cmd, 0, 1, &_psc);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pcur->pipeline);
+        float _ppc[] = {(float)_pcw, (float)_pch, 0, 0, _pz, 0, _psw, _psh, 0, 0};
+        vkCmdPushConstants(cmd, _pcur->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(_ppc), _ppc);
+        VkBuffer _pbufs[] = {_pcur->quad_vbo, _pcur->instance_vbo};
+        VkDeviceSize _poffs[] = {0, 0};
+        vkCmdBindVertexBuffers(cmd, 0, 2, _pbufs, _poffs);
+        war_vulkan_cursor_instance _pbg = {0};
+        _pbg.pos[0] = _pbg_x;
+        _pbg.pos[1] = _pbg_y;
+        _pbg.size[0] = (float)WAR_PERF_HUD_COLS;
+        _pbg.size[1] = (float)_pn;
+        _pbg.color[0] = 0.08f; _pbg.color[1] = 0.08f; _pbg.color[2] = 0.08f; _pbg.color[3] = 0.85f;
+#define PERF_BG_OFFSET 904
+        memcpy((char*)_pcur->instance_mapped + sizeof(war_vulkan_cursor_instance) * PERF_BG_OFFSET, &_pbg, sizeof(_pbg));
+        vkCmdDraw(cmd, 4, 1, 0, PERF_BG_OFFSET);
+#undef PERF_BG_OFFSET
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pf->pipeline);
+        vkCmdPushConstants(cmd, _pf->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(_ppc), _ppc);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pf->pipeline_layout, 0, 1, &_pf->desc_set, 0, NULL);
+        VkBuffer _pfbuf[] = {_pf->quad_vbo, _pf->instance_vbo};
+        vkCmdBindVertexBuffers(cmd, 0, 2, _pfbuf, _poffs);
+        war_vulkan_text_instance* _pdst = (war_vulkan_text_instance*)_pf->instance_mapped;
+        uint32_t _pwritten = WAR_FONT_PERF_BASE;
+        for (uint32_t _pr = 0; _pr < _pn; _pr++) {
+            uint32_t _plen = (uint32_t)strlen(_plines[_pr]);
+            for (uint32_t _pi = 0; _pi < _plen; _pi++) {
+                unsigned char _pc = (unsigned char)_plines[_pr][_pi];
+                if (_pc < 32 || _pc > 126) _pc = '?';
+                war_vulkan_text_instance* _pti = &_pdst[_pwritten + _pi];
+                _pti->pos[0] = _pbg_x + 1.0f + (float)_pi;
+                _pti->pos[1] = _pbg_y + (float)(_pn - 1 - _pr);
+                _pti->pos[2] = 0;
+                _pti->size[0] = 1.0f; _pti->size[1] = 1.0f;
+                _pti->uv[0] = _pf->glyph_uv[_pc][0]; _pti->uv[1] = _pf->glyph_uv[_pc][1];
+                _pti->uv[2] = _pf->glyph_uv[_pc][2]; _pti->uv[3] = _pf->glyph_uv[_pc][3];
+                _pti->glyph_scale[0] = _pf->glyph_norm_width[_pc]; _pti->glyph_scale[1] = _pf->glyph_norm_height[_pc];
+                _pti->ascent = _pf->glyph_norm_ascent[_pc]; _pti->descent = _pf->glyph_norm_descent[_pc];
+                _pti->baseline = _pf->glyph_norm_baseline[_pc];
+                // header and the xrun line in amber, the rest grey
+                float _pbright = _pr <= 1 ? 1.0f : 0.75f;
+                _pti->color[0] = _pbright; _pti->color[1] = _pr <= 1 ? 0.8f : 0.75f;
+                _pti->color[2] = _pr <= 1 ? 0.3f : 0.75f; _pti->color[3] = 1.0f;
+                _pti->flags = 0;
+            }
+            if (_plen) vkCmdDraw(cmd, 4, _plen, 0, _pwritten);
+            _pwritten += _plen;
+        }
+    }
     if (ctx_wayland->env->ctx_font) {
         war_font_render_cmd(cmd,
                             ctx_wayland->env->ctx_font,
@@ -3408,6 +3489,8 @@ static inline void war_render_frame(war_wayland_context* ctx_wayland,
     vkQueueSubmit(ctx_vk->queue, 1, &si, VK_NULL_HANDLE);
     vkQueueWaitIdle(ctx_vk->queue);
     vkFreeCommandBuffers(ctx_vk->device, ctx_vk->cmd_pool, 1, &cmd);
+    war_perf_hist_add(&ctx_wayland->env->perf.frame, war_perf_now_ns() - _perf_t0);
+    war_trace_end("render frame", _tr);
 }
 
 static inline void war_render_init_frame(war_wayland_context* ctx_wayland,
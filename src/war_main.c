@@ -15,17 +15,30 @@
 #include "../vendor/libsodium-1.0.21/include/sodium.h"
 #include "../vendor/wayland/generated/linux-dmabuf-v1-client-protocol.h"
 #include "../vendor/wayland/generated/xdg-shell-client-protocol.h"
+#include "h/war_audio.h"
 #include "h/war_build_keymap_functions.h"
 #include "h/war_color.h"
 #include "h/war_command.h"
 #include "h/war_config.h"
 #include "h/war_data.h"
 #include "h/war_debug_macros.h"
+#include "h/war_devices.h"
+#include "h/war_encode.h"
+#include "h/war_freeze.h"
 #include "h/war_functions.h"
 #include "h/war_keymap.h"
 #include "h/war_keymap_functions.h"
+#include "h/war_load.h"
+#include "h/war_log.h"
 #include "h/war_main.h"
+#include "h/war_mix.h"
+#include "h/war_page.h"
+#include "h/war_perf.h"
 #include "h/war_pool.h"
+#include "h/war_render.h"
+#include "h/war_save.h"
+#include "h/war_spill.h"
+#include "h/war_trace.h"
 #include "h/war_vulkan.h"
 #include "h/war_wayland.h"
 #include "h/war_embed_font.h"
@@ -306,17 +319,45 @@ static void war_keyboard_leave(void* data,
     (void)serial;
     (void)surface;
 }
-static void war_export_wav(war_env* env, const char* filename) {
+static int _war_export_order_cmp(const void* a, const void* b) {
+    const uint64_t* x = (const uint64_t*)a;
+    const uint64_t* y = (const uint64_t*)b;
+    if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+    return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
+// master chain over frames [from, to) of the export mix: reverb returns,
+// master gain, limiter. Runs in order, each frame once.
+static void _war_export_master(war_env* env, float* mix, float** rsend, war_reverb_bus** rbus, const uint32_t* rlist,
+                               uint32_t rn, war_limiter* lim, uint64_t from, uint64_t to) {
+    if (to <= from) return;
+    float* x = mix + from * 2;
+    uint64_t floats = (to - from) * 2;
+    for (uint32_t r = 0; r < rn; r++)
+        _war_reverb_bus_process(rbus[rlist[r]], &env->capture_slots[rlist[r]], rsend[rlist[r]] + from * 2, x, floats);
+    if (env->master_gain != 0.0f) {
+        float _mgm = (env->master_gain + 500000.0f) / 500000.0f;
+        for (uint64_t i = 0; i < floats; i++) x[i] *= _mgm;
+    }
+    if (lim) _war_limiter_process(lim, env->master_limit_params, x, floats);
+}
+
+// offline mixdown of every visible note at 48kHz: malloc'd interleaved stereo,
+// *frames_out frames. NULL (status_msg set) when there is nothing to render.
+// With a stream, finished frames are published as the mix goes.
+static float* war_export_mix(war_env* env, uint64_t* frames_out, double* sec_out, war_export_stream* stream) {
+    war_load_finish(env);
     if (!env->ctx_note || !env->ctx_note->instance_count) {
         snprintf(env->status_msg, sizeof(env->status_msg), "wwav FAILED: no notes");
         fprintf(stderr, "EXPORT: no notes to export\n");
-        return;
+        return NULL;
     }
     double bpm = env->atomics->bpm;
     if (bpm <= 0.0) bpm = 100.0;
     double sec_per_cell = 15.0 / bpm;
-    uint32_t sr = 48000;
+    uint32_t sr = WAR_RENDER_RATE;
     uint32_t num_notes = env->ctx_note->instance_count;
+    war_resample_sync(env);
 
     // compute total length: end of last note
     double total_sec = 0;
@@ -333,7 +374,7 @@ static void war_export_wav(war_env* env, const char* filename) {
         for (uint32_t l = 0; l < WAR_CAPTURE_SLOT_LAYERS; l++) {
             uint32_t idx = _pitch * WAR_CAPTURE_SLOT_LAYERS + l;
             if (env->capture_slots[idx].samples && env->capture_slots[idx].count > 0) {
-                double d = (double)env->capture_slots[idx].count / (double)(sr * 2);
+                double d = (double)war_slot_play_count(&env->capture_slots[idx]) / (double)(sr * 2);
                 if (d > sample_sec) sample_sec = d;
                 break;
             }
@@ -341,25 +382,57 @@ static void war_export_wav(war_env* env, const char* filename) {
         if (dur_sec < sample_sec) sample_sec = dur_sec;
         double start = (double)env->ctx_note->instance[i].pos[0] * sec_per_cell;
         double end = start + sample_sec;
+        // reverb tails ring past the last note
+        uint32_t _tl = (env->ctx_note->instance[i].flags >> 4) & 0xF;
+        if (_tl >= 1 && _tl <= 9) {
+            war_capture_slot* _ts = &env->capture_slots[_pitch * WAR_CAPTURE_SLOT_LAYERS + (_tl - 1)];
+            if (_war_effect_active(_ts, WAR_EFFECT_REVERB)) end += _war_reverb_tail_sec(_ts);
+        }
         if (end > total_sec) total_sec = end;
     }
     if (total_sec <= 0) {
         snprintf(env->status_msg, sizeof(env->status_msg), "wwav FAILED: no audio data");
         fprintf(stderr, "EXPORT: no audio data found for any note\n");
-        return;
+        return NULL;
     }
 
     uint64_t total_frames = (uint64_t)(total_sec * sr) + 1;
     uint64_t total_floats = total_frames * 2;
-    float* mix = calloc(total_floats, sizeof(float));
-    if (!mix) {
+    // master look-ahead limiter: the mix runs la frames behind and is read
+    // back la frames late, so it gets la frames of room at the end
+    war_limiter* _mlim = env->master_limit_active ? calloc(1, sizeof(war_limiter)) : NULL;
+    uint64_t la = _mlim ? _war_limiter_lookahead(env->master_limit_params) : 0;
+    float* mix = calloc(total_floats + la * 2, sizeof(float));
+    // notes in start order: everything before the next start is final
+    uint64_t (*order)[2] = malloc(sizeof(*order) * num_notes);
+    if (!mix || !order) {
+        free(mix);
+        free(order);
+        free(_mlim);
         snprintf(env->status_msg, sizeof(env->status_msg), "wwav FAILED: out of memory");
         fprintf(stderr, "EXPORT: out of memory\n");
-        return;
+        return NULL;
     }
+    for (uint32_t i = 0; i < num_notes; i++) {
+        double _p = (double)env->ctx_note->instance[i].pos[0] * sec_per_cell * sr;
+        order[i][0] = _p > 0.0 ? (uint64_t)_p : 0;
+        order[i][1] = i;
+    }
+    qsort(order, num_notes, sizeof(*order), _war_export_order_cmp);
+    // reverb sends, one buffer and one bus per reverb slot, returned by the master chain
+    float* _rsend[128 * WAR_CAPTURE_SLOT_LAYERS] = {0};
+    war_reverb_bus* _rbus[128 * WAR_CAPTURE_SLOT_LAYERS] = {0};
+    uint32_t _rlist[128 * WAR_CAPTURE_SLOT_LAYERS];
+    uint32_t _rn = 0;
+    // private :delay/:chorus lines (live voices keep the shared pool)
+    float* _xline = NULL;
+    uint64_t _xline_floats = (uint64_t)2 * env->delay_pool_frames;
+    uint64_t _done = 0; // frames through the master chain
+    int _aborted = 0;
 
     // mix each note
-    for (uint32_t i = 0; i < num_notes; i++) {
+    for (uint32_t k = 0; k < num_notes; k++) {
+        uint32_t i = (uint32_t)order[k][1];
         double _ex2 = env->ctx_note->instance[i].pos[0];
         double _ey2 = env->ctx_note->instance[i].pos[1];
         if (_ex2 < (double)env->ctx_wayland->gutter_cols ||
@@ -372,217 +445,207 @@ static void war_export_wav(war_env* env, const char* filename) {
         if (!(env->layer_visible & (1 << (_nlayer - 1)))) continue;
         uint32_t idx = pitch * WAR_CAPTURE_SLOT_LAYERS + (_nlayer - 1);
         if (!env->capture_slots[idx].samples || env->capture_slots[idx].count < 2) continue;
+        if (env->export_cancel && atomic_load_explicit(env->export_cancel, memory_order_relaxed)) {
+            snprintf(env->status_msg, sizeof(env->status_msg), "wwav FAILED: cancelled");
+            _aborted = 1;
+            break;
+        }
         float* _s = env->capture_slots[idx].samples;
-        uint64_t _sc = env->capture_slots[idx].count;
+        uint64_t _sc = war_slot_play_count(&env->capture_slots[idx]);
         if (!_s || _sc < 2) continue;
-        float _sg = (env->capture_slots[idx].gain + 500000.0f) / 500000.0f;
-        int _sp = env->capture_slots[idx].pan;
-        float _pe = (float)(_sp + 1000) / 2000.0f;
-        float _ple = sinf((1.0f - _pe) * (float)(M_PI / 2.0));
-        float _pre = sinf(_pe * (float)(M_PI / 2.0));
         double _start_sec = (double)env->ctx_note->instance[i].pos[0] * sec_per_cell;
         uint64_t _start_frame = (uint64_t)(_start_sec * sr);
         double _dur_sec = env->ctx_note->instance[i].size[0] * sec_per_cell;
         uint64_t _dur_frames = (uint64_t)(_dur_sec * sr);
         uint64_t _src_frames = _sc / 2;
         if (_dur_frames < _src_frames) _src_frames = _dur_frames;
-        float _exp_lp0 = 0.0f, _exp_lp1 = 0.0f;
-        int _eq_val = env->capture_slots[idx].eq1;
-        // ADSR envelope (min ~5ms anti-click fade)
-        uint64_t _min_fade = 256;
-        uint64_t _atk_f = env->capture_slots[idx].attack > 0 ? (uint64_t)(env->capture_slots[idx].attack / 1000.0f * 48000.0f) : _min_fade;
-        if (_atk_f < _min_fade) _atk_f = _min_fade;
-        float _sus_lvl = (env->capture_slots[idx].sustain + 1000.0f) / 1000.0f;
-        uint64_t _rel_f = env->capture_slots[idx].release > 0 ? (uint64_t)(env->capture_slots[idx].release / 1000.0f * 48000.0f) : _min_fade;
-        if (_rel_f < _min_fade) _rel_f = _min_fade;
-        if (_sus_lvl < 0.0f) _sus_lvl = 0.0f;
-        if (_sus_lvl > 2.0f) _sus_lvl = 2.0f;
-        if (_atk_f > _src_frames / 2) _atk_f = _src_frames / 2;
-        if (_rel_f > _src_frames / 2) _rel_f = _src_frames / 2;
-        float _exp_eff[32] = {0}; // matches playback: all state starts zeroed
-        float _exp_alpha = 0.0f;
-        for (uint64_t f = 0; f < _src_frames && _start_frame + f < total_frames; f++) {
-            float _sl = _s[f * 2 + 0];
-            float _sr = _s[f * 2 + 1];
-            if (f == 0) { _exp_lp0 = _sl; _exp_lp1 = _sr; }
-            // PASS filter (one-pole, same as playback)
-            float _ae = (float)fabsf((float)_eq_val);
-            float _fc;
-            if (_eq_val <= 0)
-                _fc = 20000.0f * expf(logf(20.0f / 20000.0f) * _ae / 1000.0f);
-            else
-                _fc = 20.0f * expf(logf(20000.0f / 20.0f) * _ae / 1000.0f);
-            float _alpha_target = 1.0f - expf(-2.0f * (float)M_PI * _fc / 48000.0f);
-            if (_alpha_target > 1.0f) _alpha_target = 1.0f;
-            _exp_alpha += 0.2f * (_alpha_target - _exp_alpha);
-            float _lpt = _exp_lp0 + _exp_alpha * (_sl - _exp_lp0);
-            float _lpt2 = _exp_lp1 + _exp_alpha * (_sr - _exp_lp1);
-            float _hp0 = _sl - _lpt, _hp1 = _sr - _lpt2;
-            _exp_lp0 = _lpt; _exp_lp1 = _lpt2;
-            if (_eq_val <= 0) {
-                float _t = (float)(-_eq_val) / 1000.0f;
-                _sl = _sl * (1.0f - _t) + _lpt * _t;
-                _sr = _sr * (1.0f - _t) + _lpt2 * _t;
-            } else {
-                float _t = (float)_eq_val / 1000.0f;
-                _sl = _sl * (1.0f - _t) + _hp0 * _t;
-                _sr = _sr * (1.0f - _t) + _hp1 * _t;
+        // hand on what this note can no longer reach, in whole limiter sub-blocks
+        uint64_t _final = (_start_frame < total_frames ? _start_frame : total_frames) / WAR_LIMITER_SUB * WAR_LIMITER_SUB;
+        if (stream && _final > _done + WAR_RENDER_BLOCK) {
+            _war_export_master(env, mix, _rsend, _rbus, _rlist, _rn, _mlim, _done, _final);
+            _done = _final;
+            if (_done > la) war_export_stream_publish(stream, mix + la * 2, _done - la);
+            if (war_export_stream_failed(stream)) {
+                _aborted = 1;
+                break;
             }
-            // apply real-time effects (no-op when no effects active)
-            _war_process_effects(&env->capture_slots[idx], _exp_eff, &_sl, &_sr);
-            // apply ADSR envelope
-            float _env = _sus_lvl;
-            uint64_t _rel_start = _src_frames > _rel_f ? _src_frames - _rel_f : 0;
-            if (f < _atk_f && _atk_f > 0) _env = (float)(f + 1) / (float)_atk_f * _sus_lvl;
-            if (f >= _rel_start && _rel_f > 0) _env = _sus_lvl * (float)(_src_frames - f) / (float)_rel_f;
-            if (_env < 0.0f) _env = 0.0f;
-            mix[(_start_frame + f) * 2 + 0] += _sl * _sg * _ple * _env;
-            mix[(_start_frame + f) * 2 + 1] += _sr * _sg * _pre * _env;
         }
+        if ((_war_effect_active(&env->capture_slots[idx], WAR_EFFECT_DELAY) ||
+             _war_effect_active(&env->capture_slots[idx], WAR_EFFECT_CHORUS)) && _xline_floats && !_xline)
+            _xline = malloc(sizeof(float) * _xline_floats * WAR_DELAY_LINE_KINDS);
+        float* _send = NULL;
+        float _rmix = 0.0f;
+        if (_war_effect_active(&env->capture_slots[idx], WAR_EFFECT_REVERB)) {
+            if (!_rsend[idx]) {
+                _rsend[idx] = calloc(total_floats, sizeof(float));
+                _rbus[idx] = _rsend[idx] ? calloc(1, sizeof(war_reverb_bus)) : NULL;
+                if (_rbus[idx]) {
+                    _war_reverb_bus_get(_rbus[idx], 1, NULL, idx);
+                    _rlist[_rn++] = idx;
+                } else {
+                    free(_rsend[idx]);
+                    _rsend[idx] = NULL;
+                    call_king_terry("EXPORT: no memory for reverb send, slot %u dry", idx);
+                }
+            }
+            _send = _rsend[idx];
+            _rmix = (float)_war_effect_get_param(&env->capture_slots[idx], WAR_EFFECT_REVERB, 1);
+        }
+        uint64_t _nf = _start_frame < total_frames ? total_frames - _start_frame : 0;
+        if (_nf > _src_frames) _nf = _src_frames;
+        if (!_nf) continue;
+        war_export_note(env, idx, _nf, _src_frames, mix + _start_frame * 2,
+                        _send ? _send + _start_frame * 2 : NULL, _rmix, _xline);
     }
 
-    // apply master gain
-    if (env->master_gain != 0.0f) {
-        float _mgm = (env->master_gain + 500000.0f) / 500000.0f;
-        for (uint64_t i = 0; i < total_floats; i++)
-            mix[i] *= _mgm;
+    if (!_aborted) {
+        _war_export_master(env, mix, _rsend, _rbus, _rlist, _rn, _mlim, _done, total_frames);
+        // flush the limiter's look-ahead through the room at the end
+        if (_mlim) _war_limiter_process(_mlim, env->master_limit_params, mix + total_floats, la * 2);
+    }
+    for (uint32_t r = 0; r < _rn; r++) {
+        free(_rsend[_rlist[r]]);
+        free(_rbus[_rlist[r]]);
     }
+    free(_xline);
+    free(_mlim);
+    free(order);
+    if (stream) {
+        if (!_aborted) war_export_stream_publish(stream, mix + la * 2, total_frames);
+        war_export_stream_end(stream, _aborted);
+    }
+    if (_aborted) {
+        free(mix);
+        return NULL;
+    }
+    if (la) memmove(mix, mix + la * 2, sizeof(float) * total_floats);
 
-    // normalize to prevent clipping (scale by peak)
-    // master gain already applied above — write 16-bit PCM
+    *frames_out = total_frames;
+    *sec_out = total_sec;
+    return mix;
+}
+
+static void war_export_wav(war_env* env, const char* filename) {
+    uint64_t total_frames;
+    double total_sec;
+    float* mix = war_export_mix(env, &total_frames, &total_sec, NULL);
+    if (!mix) return;
+    // 16-bit PCM at the mix rate, no normalization — matches playback
     char path[1024];
     snprintf(path, sizeof(path), "%s", filename);
-    FILE* f = fopen(path, "wb");
-    if (!f) {
+    int ok = war_render_write(NULL, mix, total_frames, path, WAR_RENDER_RATE, 16, 0);
+    free(mix);
+    if (!ok) {
         snprintf(env->status_msg, sizeof(env->status_msg), "wwav FAILED: %s",
                  strlen(path) > 85 ? path + strlen(path) - 85 : path);
-        fprintf(stderr, "EXPORT: failed to open %s\n", path);
-        free(mix);
+        fprintf(stderr, "EXPORT: failed to write %s\n", path);
         return;
     }
-
-    uint32_t data_bytes = (uint32_t)(total_frames * 2 * 2); // 16-bit stereo
-    uint32_t chunk_size = 36 + data_bytes;
-    // RIFF
-    fwrite("RIFF", 1, 4, f);
-    fwrite(&chunk_size, 4, 1, f);
-    fwrite("WAVE", 1, 4, f);
-    // fmt
-    uint32_t fmt_size = 16;
-    uint16_t audio_fmt = 1; // PCM
-    uint16_t channels = 2;
-    uint32_t sample_rate = sr;
-    uint32_t byte_rate = sr * 2 * 2; // 16-bit * 2 channels
-    uint16_t block_align = 2 * 2;
-    uint16_t bits = 16;
-    fwrite("fmt ", 1, 4, f);
-    fwrite(&fmt_size, 4, 1, f);
-    fwrite(&audio_fmt, 2, 1, f);
-    fwrite(&channels, 2, 1, f);
-    fwrite(&sample_rate, 4, 1, f);
-    fwrite(&byte_rate, 4, 1, f);
-    fwrite(&block_align, 2, 1, f);
-    fwrite(&bits, 2, 1, f);
-    // data
-    fwrite("data", 1, 4, f);
-    fwrite(&data_bytes, 4, 1, f);
-
-    // write 16-bit PCM samples (no normalization — matches playback)
-    for (uint64_t i = 0; i < total_floats; i++) {
-        float s = mix[i];
-        if (s < -1.0f) s = -1.0f;
-        if (s > 1.0f) s = 1.0f;
-        int16_t sample = (int16_t)(s * 32767.0f);
-        fwrite(&sample, 2, 1, f);
-    }
-
-    fclose(f);
-    free(mix);
     snprintf(env->status_msg, sizeof(env->status_msg), "%s written (%.1fs)",
              strlen(path) > 80 ? path + strlen(path) - 80 : path, total_sec);
     fprintf(stderr, "EXPORT: wrote %s (%u frames, %.2f sec)\n",
             path, (unsigned)total_frames, total_sec);
 }
 
-static void war_save_project(war_env* env, const char* filename) {
-    char path[1024];
-    snprintf(path, sizeof(path), "%s", filename);
-    FILE* f = fopen(path, "wb");
-    if (!f) {
-        snprintf(env->status_msg, sizeof(env->status_msg), "save FAILED: %s",
-                 strlen(path) > 85 ? path + strlen(path) - 85 : path);
-        fprintf(stderr, "SAVE: failed to open %s\n", path);
+static void war_export_mp3(war_env* env, const char* filename) {
+    // ffmpeg encodes from a pipe while the mix is still running (war_encode.h)
+    war_encode enc;
+    if (!war_encode_start(&enc, filename)) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "wmp3 FAILED: could not start ffmpeg");
+        fprintf(stderr, "MP3: could not start the encoder for %s\n", filename);
         return;
     }
-    fwrite("WARP", 1, 4, f);
-    uint32_t version = 5;
-    fwrite(&version, 4, 1, f);
-    float bpm = env->atomics->bpm;
-    if (bpm <= 0.0f) bpm = 100.0f;
-    fwrite(&bpm, 4, 1, f);
-    uint32_t note_count = env->ctx_note ? env->ctx_note->instance_count : 0;
-    fwrite(&note_count, 4, 1, f);
-    for (uint32_t i = 0; i < note_count; i++) {
-        fwrite(&env->ctx_note->instance[i].pos, sizeof(float), 3, f);
-        fwrite(&env->ctx_note->instance[i].size, sizeof(float), 2, f);
-        fwrite(&env->ctx_note->instance[i].color, sizeof(float), 4, f);
-        fwrite(&env->ctx_note->instance[i].flags, sizeof(war_vulkan_flags), 1, f);
-        fwrite(&env->ctx_note->instance[i].tick, sizeof(uint64_t), 1, f);
+    uint64_t total_frames;
+    double total_sec;
+    float* mix = war_export_mix(env, &total_frames, &total_sec, &enc.stream);
+    // no mix and no encoder failure: war_export_mix set status_msg
+    int quiet = !mix && !war_export_stream_failed(&enc.stream);
+    int ret = war_encode_finish(&enc, mix != NULL);
+    free(mix);
+    if (quiet) {
+        remove(filename);
+        return;
     }
-    // count non-empty capture slots
-    uint32_t slot_count = 0;
-    for (int i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
-        if (env->capture_slots[i].samples && env->capture_slots[i].count > 0)
-            slot_count++;
+    if (ret == 0) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "%s written (mp3)",
+                 strlen(filename) > 90 ? filename + strlen(filename) - 90 : filename);
+        fprintf(stderr, "MP3: wrote %s (%.1fs)\n", filename, total_sec);
+    } else {
+        remove(filename);
+        snprintf(env->status_msg, sizeof(env->status_msg), "wmp3 FAILED: %s",
+                 ret == 127 ? "ffmpeg error (install ffmpeg)" : "ffmpeg error");
+        fprintf(stderr, "MP3: ffmpeg encode failed for %s (%d)\n", filename, ret);
     }
-    fwrite(&slot_count, 4, 1, f);
-    for (int i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
-        if (env->capture_slots[i].samples && env->capture_slots[i].count > 0) {
-            uint32_t idx = (uint32_t)i;
-            fwrite(&idx, 4, 1, f);
-            fwrite(&env->capture_slots[i].count, sizeof(uint64_t), 1, f);
-            fwrite(&env->capture_slots[i].attack, sizeof(float), 1, f);
-            fwrite(&env->capture_slots[i].sustain, sizeof(float), 1, f);
-            fwrite(&env->capture_slots[i].release, sizeof(float), 1, f);
-            fwrite(&env->capture_slots[i].eq1, sizeof(int), 1, f);
-            fwrite(&env->capture_slots[i].eq2, sizeof(int), 1, f);
-            fwrite(&env->capture_slots[i].gain, sizeof(float), 1, f);
-            fwrite(&env->capture_slots[i].pan, sizeof(int), 1, f);
-            fwrite(&env->capture_slots[i].effect_flags, sizeof(uint64_t), 1, f);
-            fwrite(env->capture_slots[i].effect_params, sizeof(double), WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS, f);
-            fwrite(env->capture_slots[i].samples, sizeof(float),
-                   env->capture_slots[i].count, f);
+}
+
+// :freeze render: the layer's private env mixed down, cropped to the bounce note
+static void* war_freeze_worker(void* arg) {
+    war_freeze_job* job = (war_freeze_job*)arg;
+    war_trace_thread_name("freeze");
+    uint64_t _tr = war_trace_begin();
+    uint64_t frames = 0;
+    double sec = 0.0;
+    float* mix = war_export_mix(job->render, &frames, &sec, NULL);
+    war_trace_end("freeze render", _tr);
+    if (!mix) {
+        const char* why = strstr(job->render->status_msg, "FAILED: ");
+        snprintf(job->error, sizeof(job->error), "%s", why ? why + 8 : "render failed");
+    } else if (frames <= job->lead) {
+        free(mix);
+        snprintf(job->error, sizeof(job->error), "no audio data");
+    } else {
+        // silence at the end takes the bounce note's anti-click fade-out
+        uint64_t tail = WAR_CLICK_FADE_FLOATS;
+        job->count = (frames - job->lead) * 2;
+        memmove(mix, mix + job->lead * 2, sizeof(float) * job->count);
+        float* out = realloc(mix, sizeof(float) * (job->count + tail));
+        if (out) {
+            memset(out + job->count, 0, sizeof(float) * tail);
+            job->count += tail;
+            mix = out;
         }
+        job->out = mix;
     }
-    fclose(f);
-    env->undo_save_marker = env->undo_pos;
-    env->file_dirty = 0;
-    snprintf(env->status_msg, sizeof(env->status_msg), "%s saved (%u notes, %u slots)",
-             strlen(path) > 75 ? path + strlen(path) - 75 : path, note_count, slot_count);
-    fprintf(stderr, "SAVE: wrote %s (%u notes, %u slots)\n",
-            path, note_count, slot_count);
+    war_freeze_done(job);
+    return NULL;
 }
 
-static void war_export_mp3(war_env* env, const char* filename) {
-    // write WAV to a temp file, then convert with ffmpeg
-    char wav_path[1080];
-    snprintf(wav_path, sizeof(wav_path), "/tmp/war_export_%u.wav", (unsigned)war_get_monotonic_time_us());
-    war_export_wav(env, wav_path);
-    // check if the WAV was written (war_export_wav sets status_msg on failure)
-    if (env->status_msg[0] == 'w' && strstr(env->status_msg, "FAILED")) return;
-    char cmd[2060];
-    snprintf(cmd, sizeof(cmd), "ffmpeg -y -i \"%s\" -codec:a libmp3lame -b:a 192k \"%s\" 2>/dev/null",
-             wav_path, filename);
-    int ret = system(cmd);
-    remove(wav_path);
-    if (ret == 0) {
-        snprintf(env->status_msg, sizeof(env->status_msg), "%s written (mp3)",
-                 strlen(filename) > 90 ? filename + strlen(filename) - 90 : filename);
-        fprintf(stderr, "MP3: wrote %s\n", filename);
-    } else {
-        snprintf(env->status_msg, sizeof(env->status_msg), "wmp3 FAILED: ffmpeg error (install ffmpeg)");
-        fprintf(stderr, "MP3: ffmpeg conversion failed for %s\n", filename);
+// :freeze <layer>: renders the layer on a thread, war_freeze_poll swaps it in
+static void war_freeze_start(war_env* env, uint32_t layer) {
+    war_freeze_state* fz = &env->freeze[layer - 1];
+    if (fz->state == WAR_FREEZE_RENDERING) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze: layer %u is already rendering", layer);
+        return;
+    }
+    if (war_freeze_bounce_note(env, layer) >= 0) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze: layer %u is frozen, :unfreeze %u first", layer,
+                 layer);
+        return;
+    }
+    // a freeze since undone
+    if (fz->state) _war_freeze_forget(env, layer);
+    war_load_finish(env);
+    war_freeze_job* job = war_freeze_snapshot(env, layer);
+    if (!job) {
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: layer %u: no notes or out of memory",
+                 layer);
+        return;
+    }
+    job->gen = fz->gen;
+    job->render->export_cancel = &env->freeze_cancel;
+    pthread_mutex_lock(&env->freeze_mutex);
+    env->freeze_running++;
+    pthread_mutex_unlock(&env->freeze_mutex);
+    if (pthread_create(&job->thread, NULL, war_freeze_worker, job) != 0) {
+        pthread_mutex_lock(&env->freeze_mutex);
+        env->freeze_running--;
+        pthread_mutex_unlock(&env->freeze_mutex);
+        war_freeze_job_free(job);
+        snprintf(env->status_msg, sizeof(env->status_msg), "freeze FAILED: could not start a thread");
+        return;
     }
+    fz->state = WAR_FREEZE_RENDERING;
+    snprintf(env->status_msg, sizeof(env->status_msg), "freezing layer %u (%u notes)...", layer, job->note_count);
 }
 
 static void war_load_project(war_env* env, const char* filename) {
@@ -607,16 +670,14 @@ static void war_load_project(war_env* env, const char* filename) {
     float bpm;
     fread(&bpm, 4, 1, f);
     if (bpm > 0.0f) env->atomics->bpm = bpm;
+    // audio still arriving from the last load would land in this project
+    war_load_cancel(env);
+    war_freeze_reset(env);
     // clear existing notes
     if (env->ctx_note) env->ctx_note->instance_count = 0;
     // clear existing capture slots
     for (int i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
-        if (env->capture_slots[i].samples) {
-            free(env->capture_slots[i].samples);
-            env->capture_slots[i].samples = NULL;
-            env->capture_slots[i].count = 0;
-            env->capture_slots[i].capacity = 0;
-        }
+        war_slot_clear(&env->capture_slots[i]);
         env->capture_slots[i].effect_flags = 0;
     }
     uint32_t note_count;
@@ -637,6 +698,9 @@ static void war_load_project(war_env* env, const char* filename) {
     }
     uint32_t slot_count;
     fread(&slot_count, 4, 1, f);
+    // large sample blocks are mapped from the file, paged in as they play
+    struct stat _st;
+    uint64_t _file_size = fstat(fileno(f), &_st) == 0 ? (uint64_t)_st.st_size : 0;
     for (uint32_t s = 0; s < slot_count; s++) {
         uint32_t idx;
         fread(&idx, 4, 1, f);
@@ -663,7 +727,8 @@ static void war_load_project(war_env* env, const char* filename) {
             fread(&_gain, sizeof(float), 1, f);
             fread(&_pan, sizeof(int), 1, f);
         }
-        if (idx < 128 * WAR_CAPTURE_SLOT_LAYERS && cnt > 0) {
+        // version 6 stores linked slots with cnt 0, resolved after the loop
+        if (idx < 128 * WAR_CAPTURE_SLOT_LAYERS && (cnt > 0 || version >= 6)) {
             uint64_t _ef = 0;
             double _ep[WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS];
             memset(_ep, 0, sizeof(_ep));
@@ -671,12 +736,30 @@ static void war_load_project(war_env* env, const char* filename) {
                 fread(&_ef, sizeof(uint64_t), 1, f);
                 fread(_ep, sizeof(double), WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS, f);
             }
-            float* samples = malloc(cnt * sizeof(float));
-            if (samples) {
-                fread(samples, sizeof(float), cnt, f);
-                env->capture_slots[idx].samples = samples;
-                env->capture_slots[idx].count = cnt;
-                env->capture_slots[idx].capacity = cnt;
+            int32_t _tr = 0;
+            uint32_t _root = 0;
+            if (version >= 6) {
+                fread(&_tr, sizeof(int32_t), 1, f);
+                fread(&_root, sizeof(uint32_t), 1, f);
+            }
+            uint8_t fmt[2] = {WAR_SAMPLE_F32, 2};
+            if (version >= 7) fread(fmt, 1, 2, f);
+            if (fmt[0] > WAR_SAMPLE_S16 || fmt[1] < 1 || fmt[1] > 2) {
+                fprintf(stderr, "LOAD: slot %u has unknown sample format %u/%u\n", idx, fmt[0], fmt[1]);
+                break;
+            }
+            uint64_t bytes = version >= 7 ? cnt / 2 * war_sample_frame_bytes(fmt[0], fmt[1]) : cnt * sizeof(float);
+            // big blocks are mapped, the rest read by the load pool (war_load.h)
+            uint64_t _off = (uint64_t)ftello(f);
+            war_sample_buf* mapped = NULL;
+            if (bytes >= WAR_PAGE_MAP_MIN) mapped = war_page_map_file(fileno(f), _file_size, _off, cnt, fmt[0], fmt[1]);
+            int queued = bytes && !mapped && _off <= _file_size && bytes <= _file_size - _off &&
+                         war_load_queue(env, idx, _off, bytes, cnt / 2 * 2, fmt[0], fmt[1]);
+            fseeko(f, (off_t)bytes, SEEK_CUR);
+            if (mapped || queued || !cnt) {
+                if (mapped) war_slot_set_buf(&env->capture_slots[idx], mapped);
+                env->capture_slots[idx].transpose = _tr;
+                env->capture_slots[idx].root = _root;
                 env->capture_slots[idx].attack = (_sa == 100.0f) ? 0.0f : _sa;
                 env->capture_slots[idx].sustain = (_ss == 100.0f) ? 0.0f : _ss;
                 env->capture_slots[idx].release = (_sr == 100.0f) ? 0.0f : _sr;
@@ -685,23 +768,34 @@ static void war_load_project(war_env* env, const char* filename) {
                 env->capture_slots[idx].pan = _pan;
                 env->capture_slots[idx].effect_flags = _ef;
                 memcpy(env->capture_slots[idx].effect_params, _ep, sizeof(_ep));
-            } else {
-                fseek(f, cnt * sizeof(float), SEEK_CUR);
             }
         } else {
-            fseek(f, cnt * sizeof(float), SEEK_CUR);
             if (version >= 4)
                 fseek(f, sizeof(uint64_t) + sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS, SEEK_CUR);
+            if (version >= 6)
+                fseek(f, sizeof(int32_t) + sizeof(uint32_t), SEEK_CUR);
+            uint8_t fmt[2] = {WAR_SAMPLE_F32, 2};
+            if (version >= 7) fread(fmt, 1, 2, f);
+            fseeko(f, (off_t)(version >= 7 ? cnt / 2 * war_sample_frame_bytes(fmt[0], fmt[1]) : cnt * sizeof(float)),
+                   SEEK_CUR);
         }
     }
+    uint32_t pending = env->load_job_count;
+    war_load_start(env, pending ? dup(fileno(f)) : -1);
     fclose(f);
+    war_resample_sync(env);
     env->undo_save_marker = env->undo_pos;
     env->file_dirty = 0;
     if (env->master_gain < -500000.0f) env->master_gain = 0.0f;
-    snprintf(env->status_msg, sizeof(env->status_msg), "%s loaded (%u notes, %u slots)",
+    snprintf(env->load_status, sizeof(env->load_status), "%s loaded (%u notes, %u slots)",
              strlen(path) > 75 ? path + strlen(path) - 75 : path, note_count, slot_count);
-    fprintf(stderr, "LOAD: loaded %s (%u notes, %u slots, bpm=%.1f)\n",
-            path, note_count, slot_count, bpm);
+    if (pending)
+        snprintf(env->status_msg, sizeof(env->status_msg), "loading %s (%u notes, %u slots)",
+                 strlen(path) > 75 ? path + strlen(path) - 75 : path, note_count, slot_count);
+    else
+        snprintf(env->status_msg, sizeof(env->status_msg), "%s", env->load_status);
+    fprintf(stderr, "LOAD: loaded %s (%u notes, %u slots, bpm=%.1f)%s\n",
+            path, note_count, slot_count, bpm, pending ? ", reading audio" : "");
 }
 
 static void war_write_inst(war_env* env, const char* filename) {
@@ -731,9 +825,19 @@ static void war_write_inst(war_env* env, const char* filename) {
     for (uint32_t p = 0; p < 128; p++) {
         war_capture_slot* s = &env->capture_slots[p * WAR_CAPTURE_SLOT_LAYERS + li];
         if (s->samples && s->count > 0) {
+            // instruments carry no slot params: transposed slots are written rendered
+            uint64_t cnt = war_slot_play_count(s);
+            float* rendered = s->transpose ? war_resample_render(env, s, cnt) : NULL;
+            if (s->transpose && !rendered) cnt = s->count;
+            const float* plain = rendered ? rendered : war_slot_unpack(s);
+            if (!plain) cnt = 0;
             fwrite(&p, 4, 1, f);
-            fwrite(&s->count, sizeof(uint64_t), 1, f);
-            fwrite(s->samples, sizeof(float), s->count, f);
+            fwrite(&cnt, sizeof(uint64_t), 1, f);
+            if (plain) fwrite(plain, sizeof(float), cnt, f);
+            if (rendered)
+                free(rendered);
+            else
+                war_sample_unpack_free(s->samples, plain);
         }
     }
     fclose(f);
@@ -767,9 +871,7 @@ static void war_load_inst(war_env* env, const char* filename) {
     // clear existing slots for this layer
     for (uint32_t p = 0; p < 128; p++) {
         war_capture_slot* s = &env->capture_slots[p * WAR_CAPTURE_SLOT_LAYERS + li];
-        if (s->samples) { free(s->samples); s->samples = NULL; }
-        s->count = 0;
-        s->capacity = 0;
+        war_slot_clear(s);
         s->attack = 0.0f;
         s->sustain = 0.0f;
         s->release = 0.0f;
@@ -788,9 +890,15 @@ static void war_load_inst(war_env* env, const char* filename) {
             float* samples = malloc(cnt * sizeof(float));
             if (samples) {
                 fread(samples, sizeof(float), cnt, f);
-                env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].samples = samples;
-                env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].count = cnt;
-                env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].capacity = cnt;
+                // instruments are often mono sources: keep one side when both match
+                war_sample_buf* mono =
+                    war_sample_dual_mono(samples, cnt) ? war_sample_buf_pack(samples, cnt, WAR_SAMPLE_F32, 1) : NULL;
+                if (mono) {
+                    free(samples);
+                    war_slot_set_buf(&env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li], mono);
+                } else {
+                    war_slot_adopt(&env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li], samples, cnt);
+                }
                 env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].attack = 0.0f;
                 env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].sustain = 0.0f;
                 env->capture_slots[pitch * WAR_CAPTURE_SLOT_LAYERS + li].release = 0.0f;
@@ -934,36 +1042,13 @@ static void _war_midi_disconnect(war_env* env) {
 static void _war_midi_connect(war_env* env, const char* dev_name) {
     _war_midi_disconnect(env);
     if (!dev_name || !dev_name[0]) return;
-    int client_id = -1;
-    FILE* fp = popen("aconnect -i 2>/dev/null", "r");
-    if (fp) {
-        char buf[256];
-        while (fgets(buf, sizeof(buf), fp)) {
-            if (strstr(buf, dev_name) && strstr(buf, "client")) {
-                if (sscanf(buf, "client %d", &client_id) == 1) break;
-            }
-        }
-        pclose(fp);
-    }
-    // fallback: try aconnect -o too
-    if (client_id < 0) {
-        fp = popen("aconnect -o 2>/dev/null", "r");
-        if (fp) {
-            char buf[256];
-            while (fgets(buf, sizeof(buf), fp)) {
-                if (strstr(buf, dev_name) && strstr(buf, "client")) {
-                    if (sscanf(buf, "client %d", &client_id) == 1) break;
-                }
-            }
-            pclose(fp);
-        }
-    }
-    if (client_id < 0) { fprintf(stderr, "MIDI: '%s' not found in aconnect\n", dev_name); return; }
-    call_king_terry("MIDI: found client %d for '%s'", client_id, dev_name);
     snd_seq_t* _seq = NULL;
     if (snd_seq_open(&_seq, "default", SND_SEQ_OPEN_INPUT, 0) < 0) {
         fprintf(stderr, "MIDI: failed to open sequencer\n"); return;
     }
+    int client_id = war_devices_seq_find_client(_seq, dev_name);
+    if (client_id < 0) { fprintf(stderr, "MIDI: '%s' not found\n", dev_name); snd_seq_close(_seq); return; }
+    call_king_terry("MIDI: found client %d for '%s'", client_id, dev_name);
     env->midi_seq = (void*)_seq;
     snd_seq_set_client_name(_seq, "WAR");
     int port = snd_seq_create_simple_port(_seq, "input",
@@ -987,8 +1072,6 @@ static void _war_midi_connect(war_env* env, const char* dev_name) {
         snd_seq_nonblock(_seq, 1);
     }
 }
-// minimum anti-click fade (~5.3ms @ 48kHz), in stereo float samples
-#define WAR_CLICK_FADE_FLOATS (256ULL * 2ULL)
 static uint64_t _war_release_floats(war_env* env, uint32_t slot_idx) {
     float frames = env->capture_slots[slot_idx].release / 1000.0f * 48000.0f;
     if (frames < 256.0f) frames = 256.0f;
@@ -1044,6 +1127,77 @@ static void _war_process_midi(war_env* env) {
     }
 }
 
+static void _war_hot_reload(war_env* env, uint32_t count, war_hot_id* id) {
+    war_config_context* config = env->ctx_config;
+    war_hot_id live[WAR_HOT_ID_COUNT];
+    uint32_t live_count = 0;
+    int restart = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        switch (id[i]) {
+        case WAR_HOT_ID_CONFIG:
+        case WAR_HOT_ID_POOL:
+            // config and pool size the mmap'd pool, applying them live would
+            // invalidate every context. The handle stays open: ctx_config's
+            // DIR_* and HOT_CONTEXT_TEMPLATE strings live in that image, and
+            // every later reload reads them. A .so shared with a live id
+            // keeps its old image until restart for the same reason.
+            restart = 1;
+            break;
+        case WAR_HOT_ID_COLOR:
+            war_color_default(env->ctx_color);
+            live[live_count++] = id[i];
+            break;
+        case WAR_HOT_ID_KEYMAP: {
+            war_keymap_context* keymap = env->ctx_keymap;
+            if (!war_keymap_cache_load(keymap, config)) {
+                war_keymap_clear(keymap, config);
+                war_keymap_default(keymap, config);
+            }
+            env->ctx_wayland->keymap_state = 0;
+            live[live_count++] = id[i];
+            break;
+        }
+        case WAR_HOT_ID_COMMAND: {
+            war_command_context* command = env->ctx_command;
+            war_pool_context* pool = env->ctx_pool;
+            memset(command->function_id, 0,
+                   war_pool_size(pool, WAR_POOL_ID_COMMAND_CONTEXT_FUNCTION_ID));
+            memset(command->function, 0,
+                   war_pool_size(pool, WAR_POOL_ID_COMMAND_CONTEXT_FUNCTION));
+            memset(command->function_count, 0,
+                   war_pool_size(pool, WAR_POOL_ID_COMMAND_CONTEXT_FUNCTION_COUNT));
+            memset(command->flags, 0,
+                   war_pool_size(pool, WAR_POOL_ID_COMMAND_CONTEXT_FLAGS));
+            memset(command->next_state, 0,
+                   war_pool_size(pool, WAR_POOL_ID_COMMAND_CONTEXT_NEXT_STATE));
+            command->state_count = 1;
+            war_command_default(command, config);
+            live[live_count++] = id[i];
+            break;
+        }
+        case WAR_HOT_ID_PLUGIN:
+            env->ctx_hook->count = 0;
+            live[live_count++] = id[i];
+            break;
+        }
+    }
+    // runs on the main thread between frames, the audio thread never calls
+    // into override code so it keeps running through the swap. With only
+    // config/pool changed nothing is bound, but the build still runs so a
+    // broken override shows now rather than at the next start.
+    if (!live_count && !restart) return;
+    uint32_t failed = war_override(live_count, live, env);
+    if (failed)
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "override reload FAILED: %u source%s did not build (see log)",
+                 failed, failed == 1 ? "" : "s");
+    else if (restart)
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "override rebuilt (config/pool apply on restart)");
+    else
+        snprintf(env->status_msg, sizeof(env->status_msg),
+                 "override reloaded");
+}
 static uint32_t war_current_mods(war_wayland_context* ctx_wayland) {
     uint32_t mod = 0;
     {
@@ -1167,7 +1321,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
             return;
         }
         if (raw_sym == XKB_KEY_Return || raw_sym == XKB_KEY_KP_Enter) {
-            env->cmd_buf[env->cmd_len < 256 ? env->cmd_len : 255] = '\0';
+            env->cmd_buf[env->cmd_len < WAR_CMD_MAX ? env->cmd_len : WAR_CMD_MAX - 1] = '\0';
             // chord inversions: match ":chordnamei<N>" pattern, handle before if-else
             if (env->cmd_len >= 4 && env->cmd_buf[0] == ':') {
                 char* i_pos = strchr(env->cmd_buf + 1, 'i');
@@ -1232,6 +1386,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                 const char* name = env->cmd_buf + 5;
                 while (*name == ' ') name++;
                 if (name[0]) {
+                    war_save_flush(env); // a :w still writing name
                     war_load_project(env, name);
                     snprintf(env->current_project_path, sizeof(env->current_project_path), "%s", name);
                 } else
@@ -1266,25 +1421,19 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         uint32_t src = (uint32_t)pitch * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                         uint32_t dst = ((uint32_t)pitch + (uint32_t)n) * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                         if (env->capture_slots[src].samples && env->capture_slots[src].count > 0) {
-                            uint64_t cnt = env->capture_slots[src].count;
-                            float* copy = malloc(cnt * sizeof(float));
-                            if (copy) {
-                                memcpy(copy, env->capture_slots[src].samples, cnt * sizeof(float));
-                                free(env->capture_slots[dst].samples);
-                                env->capture_slots[dst].samples = copy;
-                                env->capture_slots[dst].count = cnt;
-                                env->capture_slots[dst].capacity = cnt;
-                                env->capture_slots[dst].gain = env->capture_slots[src].gain;
-                                env->capture_slots[dst].pan = env->capture_slots[src].pan;
-                                env->capture_slots[dst].eq1 = env->capture_slots[src].eq1;
-                                env->capture_slots[dst].eq2 = env->capture_slots[src].eq2;
-                                env->capture_slots[dst].attack = env->capture_slots[src].attack;
-                                env->capture_slots[dst].sustain = env->capture_slots[src].sustain;
-                                env->capture_slots[dst].release = env->capture_slots[src].release;
-                                env->capture_slots[dst].effect_flags = env->capture_slots[src].effect_flags;
-                                memcpy(env->capture_slots[dst].effect_params, env->capture_slots[src].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
-                                snprintf(env->status_msg, sizeof(env->status_msg), "cpu: pitch %d -> %u", pitch, pitch + n);
-                            }
+                            war_slot_share(&env->capture_slots[dst], &env->capture_slots[src]);
+                            env->capture_slots[dst].gain = env->capture_slots[src].gain;
+                            env->capture_slots[dst].pan = env->capture_slots[src].pan;
+                            env->capture_slots[dst].eq1 = env->capture_slots[src].eq1;
+                            env->capture_slots[dst].eq2 = env->capture_slots[src].eq2;
+                            env->capture_slots[dst].attack = env->capture_slots[src].attack;
+                            env->capture_slots[dst].sustain = env->capture_slots[src].sustain;
+                            env->capture_slots[dst].release = env->capture_slots[src].release;
+                            env->capture_slots[dst].effect_flags = env->capture_slots[src].effect_flags;
+                            env->capture_slots[dst].transpose = env->capture_slots[src].transpose;
+                            env->capture_slots[dst].root = env->capture_slots[src].root;
+                            memcpy(env->capture_slots[dst].effect_params, env->capture_slots[src].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+                            snprintf(env->status_msg, sizeof(env->status_msg), "cpu: pitch %d -> %u", pitch, pitch + n);
                         } else {
                             snprintf(env->status_msg, sizeof(env->status_msg), "cpu FAILED: no capture at pitch %d", pitch);
                         }
@@ -1304,25 +1453,19 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         uint32_t src = (uint32_t)pitch * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                         uint32_t dst = ((uint32_t)pitch - (uint32_t)n) * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                         if (env->capture_slots[src].samples && env->capture_slots[src].count > 0) {
-                            uint64_t cnt = env->capture_slots[src].count;
-                            float* copy = malloc(cnt * sizeof(float));
-                            if (copy) {
-                                memcpy(copy, env->capture_slots[src].samples, cnt * sizeof(float));
-                                free(env->capture_slots[dst].samples);
-                                env->capture_slots[dst].samples = copy;
-                                env->capture_slots[dst].count = cnt;
-                                env->capture_slots[dst].capacity = cnt;
-                                env->capture_slots[dst].gain = env->capture_slots[src].gain;
-                                env->capture_slots[dst].pan = env->capture_slots[src].pan;
-                                env->capture_slots[dst].eq1 = env->capture_slots[src].eq1;
-                                env->capture_slots[dst].eq2 = env->capture_slots[src].eq2;
-                                env->capture_slots[dst].attack = env->capture_slots[src].attack;
-                                env->capture_slots[dst].sustain = env->capture_slots[src].sustain;
-                                env->capture_slots[dst].release = env->capture_slots[src].release;
-                                env->capture_slots[dst].effect_flags = env->capture_slots[src].effect_flags;
-                                memcpy(env->capture_slots[dst].effect_params, env->capture_slots[src].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
-                                snprintf(env->status_msg, sizeof(env->status_msg), "cpd: pitch %d -> %u", pitch, pitch - n);
-                            }
+                            war_slot_share(&env->capture_slots[dst], &env->capture_slots[src]);
+                            env->capture_slots[dst].gain = env->capture_slots[src].gain;
+                            env->capture_slots[dst].pan = env->capture_slots[src].pan;
+                            env->capture_slots[dst].eq1 = env->capture_slots[src].eq1;
+                            env->capture_slots[dst].eq2 = env->capture_slots[src].eq2;
+                            env->capture_slots[dst].attack = env->capture_slots[src].attack;
+                            env->capture_slots[dst].sustain = env->capture_slots[src].sustain;
+                            env->capture_slots[dst].release = env->capture_slots[src].release;
+                            env->capture_slots[dst].effect_flags = env->capture_slots[src].effect_flags;
+                            env->capture_slots[dst].transpose = env->capture_slots[src].transpose;
+                            env->capture_slots[dst].root = env->capture_slots[src].root;
+                            memcpy(env->capture_slots[dst].effect_params, env->capture_slots[src].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+                            snprintf(env->status_msg, sizeof(env->status_msg), "cpd: pitch %d -> %u", pitch, pitch - n);
                         } else {
                             snprintf(env->status_msg, sizeof(env->status_msg), "cpd FAILED: no capture at pitch %d", pitch);
                         }
@@ -1344,7 +1487,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         snprintf(env->status_msg, sizeof(env->status_msg), "mv FAILED: same layer");
                         fprintf(stderr, "MV: source and destination are the same layer\n");
                     } else if (env->capture_slots[src_idx].samples && env->capture_slots[src_idx].count > 0) {
-                        free(env->capture_slots[dst_idx].samples);
+                        war_slot_clear(&env->capture_slots[dst_idx]);
                         env->capture_slots[dst_idx] = env->capture_slots[src_idx];
                         _war_slot_null_owned(&env->capture_slots[src_idx]);
                         snprintf(env->status_msg, sizeof(env->status_msg), "mv: pitch %u layer %d -> %d", pitch, cur_layer, to_layer);
@@ -1370,26 +1513,20 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         snprintf(env->status_msg, sizeof(env->status_msg), "cp FAILED: same layer");
                         fprintf(stderr, "CP: source and destination are the same layer\n");
                     } else if (env->capture_slots[_src_idx].samples && env->capture_slots[_src_idx].count > 0) {
-                        uint64_t _cnt = env->capture_slots[_src_idx].count;
-                        float* _copy = malloc(_cnt * sizeof(float));
-                        if (_copy) {
-                            memcpy(_copy, env->capture_slots[_src_idx].samples, _cnt * sizeof(float));
-                            free(env->capture_slots[_dst_idx].samples);
-                            env->capture_slots[_dst_idx].samples = _copy;
-                            env->capture_slots[_dst_idx].count = _cnt;
-                            env->capture_slots[_dst_idx].capacity = _cnt;
-                            env->capture_slots[_dst_idx].gain = env->capture_slots[_src_idx].gain;
-                            env->capture_slots[_dst_idx].pan = env->capture_slots[_src_idx].pan;
-                              env->capture_slots[_dst_idx].eq1 = env->capture_slots[_src_idx].eq1;
-                              env->capture_slots[_dst_idx].eq2 = env->capture_slots[_src_idx].eq2;
-                             env->capture_slots[_dst_idx].attack = env->capture_slots[_src_idx].attack;
-                             env->capture_slots[_dst_idx].sustain = env->capture_slots[_src_idx].sustain;
-                             env->capture_slots[_dst_idx].release = env->capture_slots[_src_idx].release;
-                             env->capture_slots[_dst_idx].effect_flags = env->capture_slots[_src_idx].effect_flags;
-                             memcpy(env->capture_slots[_dst_idx].effect_params, env->capture_slots[_src_idx].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
-                            snprintf(env->status_msg, sizeof(env->status_msg), "cp: pitch %u layer %d -> %d", _pitch, _cur_layer, _to_layer);
-                            fprintf(stderr, "CP: copied pitch=%u from layer %d to layer %d\n", _pitch, _cur_layer, _to_layer);
-                        }
+                        war_slot_share(&env->capture_slots[_dst_idx], &env->capture_slots[_src_idx]);
+                        env->capture_slots[_dst_idx].gain = env->capture_slots[_src_idx].gain;
+                        env->capture_slots[_dst_idx].pan = env->capture_slots[_src_idx].pan;
+                        env->capture_slots[_dst_idx].eq1 = env->capture_slots[_src_idx].eq1;
+                        env->capture_slots[_dst_idx].eq2 = env->capture_slots[_src_idx].eq2;
+                        env->capture_slots[_dst_idx].attack = env->capture_slots[_src_idx].attack;
+                        env->capture_slots[_dst_idx].sustain = env->capture_slots[_src_idx].sustain;
+                        env->capture_slots[_dst_idx].release = env->capture_slots[_src_idx].release;
+                        env->capture_slots[_dst_idx].effect_flags = env->capture_slots[_src_idx].effect_flags;
+                        env->capture_slots[_dst_idx].transpose = env->capture_slots[_src_idx].transpose;
+                        env->capture_slots[_dst_idx].root = env->capture_slots[_src_idx].root;
+                        memcpy(env->capture_slots[_dst_idx].effect_params, env->capture_slots[_src_idx].effect_params, sizeof(double) * WAR_EFFECT_COUNT * WAR_EFFECT_PARAMS);
+                        snprintf(env->status_msg, sizeof(env->status_msg), "cp: pitch %u layer %d -> %d", _pitch, _cur_layer, _to_layer);
+                        fprintf(stderr, "CP: copied pitch=%u from layer %d to layer %d\n", _pitch, _cur_layer, _to_layer);
                     } else {
                         snprintf(env->status_msg, sizeof(env->status_msg), "cp FAILED: no capture at pitch %u", _pitch);
                         fprintf(stderr, "CP: no capture at pitch=%u layer=%d\n", _pitch, _cur_layer);
@@ -1397,6 +1534,8 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                 } else {
                     fprintf(stderr, "CP: usage :cp <layer>\n");
                 }
+             } else if (env->cmd_len == 11 && strncmp(env->cmd_buf, ":acrossroot", 11) == 0) {
+                war_toggle_across_root(env);
              } else if (env->cmd_len >= 7 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 'a' && env->cmd_buf[2] == 'c' && env->cmd_buf[3] == 'r' && env->cmd_buf[4] == 'o' && env->cmd_buf[5] == 's' && env->cmd_buf[6] == 's') {
                 int radius = 0;
                 if (sscanf(env->cmd_buf + 7, " %d", &radius) == 1 && radius >= 0) {
@@ -1423,7 +1562,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         uint32_t dst_pitch = pitch + (uint32_t)n;
                         uint32_t dst_idx = dst_pitch * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                          if (env->capture_slots[src_idx].samples && env->capture_slots[src_idx].count > 0) {
-                             free(env->capture_slots[dst_idx].samples);
+                             war_slot_clear(&env->capture_slots[dst_idx]);
                              env->capture_slots[dst_idx] = env->capture_slots[src_idx];
                              _war_slot_null_owned(&env->capture_slots[src_idx]);
                              snprintf(env->status_msg, sizeof(env->status_msg), "mvu: pitch %u -> %u", pitch, dst_pitch);
@@ -1483,7 +1622,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                         uint32_t dst_pitch = pitch - (uint32_t)n;
                         uint32_t dst_idx = dst_pitch * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
                          if (env->capture_slots[src_idx].samples && env->capture_slots[src_idx].count > 0) {
-                             free(env->capture_slots[dst_idx].samples);
+                             war_slot_clear(&env->capture_slots[dst_idx]);
                              env->capture_slots[dst_idx] = env->capture_slots[src_idx];
                              _war_slot_null_owned(&env->capture_slots[src_idx]);
                              snprintf(env->status_msg, sizeof(env->status_msg), "mvd: pitch %u -> %u", pitch, dst_pitch);
@@ -1515,6 +1654,27 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                     name = env->cmd_buf + 6;
                 if (!name || !name[0]) name = "output.mp3";
                 war_export_mp3(env, name);
+            } else if (env->cmd_len >= 6 && strncmp(env->cmd_buf, ":trace", 6) == 0 && (env->cmd_len == 6 || env->cmd_buf[6] == ' ')) {
+                war_trace_cmd(env);
+            } else if (env->cmd_len >= 5 && strncmp(env->cmd_buf, ":perf", 5) == 0 && (env->cmd_len == 5 || env->cmd_buf[5] == ' ')) {
+                war_perf_cmd(env);
+            } else if (env->cmd_len >= 5 && strncmp(env->cmd_buf, ":pack", 5) == 0 && (env->cmd_len == 5 || env->cmd_buf[5] == ' ')) {
+                war_pack(env);
+            } else if ((env->cmd_len >= 7 && strncmp(env->cmd_buf, ":freeze", 7) == 0 && (env->cmd_len == 7 || env->cmd_buf[7] == ' ')) ||
+                       (env->cmd_len >= 9 && strncmp(env->cmd_buf, ":unfreeze", 9) == 0 && (env->cmd_len == 9 || env->cmd_buf[9] == ' '))) {
+                int _unfreeze = env->cmd_buf[1] == 'u';
+                int _fl = (int)env->ctx_cursor->layer;
+                if (_fl < 1 || _fl > 9) _fl = 1;
+                const char* _fa = env->cmd_buf + (_unfreeze ? 9 : 7);
+                if (sscanf(_fa, " %d", &_fl) != 1 && _fa[strspn(_fa, " ")]) _fl = 0;
+                if (_fl < 1 || _fl > 9)
+                    snprintf(env->status_msg, sizeof(env->status_msg), "usage: :%s <layer 1-9>", _unfreeze ? "unfreeze" : "freeze");
+                else if (_unfreeze)
+                    war_unfreeze(env, (uint32_t)_fl);
+                else
+                    war_freeze_start(env, (uint32_t)_fl);
+            } else if (env->cmd_len >= 10 && strncmp(env->cmd_buf, ":compress2", 10) == 0) {
+                war_compress2(env);
             } else if (env->cmd_len >= 9 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 'c' && env->cmd_buf[2] == 'o' && env->cmd_buf[3] == 'm' && env->cmd_buf[4] == 'p' && env->cmd_buf[5] == 'r' && env->cmd_buf[6] == 'e' && env->cmd_buf[7] == 's' && env->cmd_buf[8] == 's') {
                 war_compress(env);
             } else if (env->cmd_len >= 9 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 's' && env->cmd_buf[2] == 'a' && env->cmd_buf[3] == 't' && env->cmd_buf[4] == 'u' && env->cmd_buf[5] == 'r' && env->cmd_buf[6] == 'a' && env->cmd_buf[7] == 't' && env->cmd_buf[8] == 'e') {
@@ -1541,6 +1701,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                 war_offall(env);
             } else if (env->cmd_len >= 9 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 'c' && env->cmd_buf[2] == 'l' && env->cmd_buf[3] == 'e' && env->cmd_buf[4] == 'a' && env->cmd_buf[5] == 'r' && env->cmd_buf[6] == 'a' && env->cmd_buf[7] == 'l' && env->cmd_buf[8] == 'l') {
                 war_clear_all(env);
+                war_freeze_reset(env);
             } else if (env->cmd_len >= 6 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 'c' && env->cmd_buf[2] == 'l' && env->cmd_buf[3] == 'e' && env->cmd_buf[4] == 'a' && env->cmd_buf[5] == 'r') {
                 war_clear(env);
             } else if (env->cmd_len >= 2 && env->cmd_buf[0] == ':' && env->cmd_buf[1] == 'q') {
@@ -1592,10 +1753,10 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
                 if (env->cmd_len > 2 && env->cmd_buf[2] == ' ')
                     name = env->cmd_buf + 3;
                 if (name && name[0]) {
-                    war_save_project(env, name);
+                    war_save_start(env, name, 0);
                     snprintf(env->current_project_path, sizeof(env->current_project_path), "%s", name);
                 } else if (env->current_project_path[0]) {
-                    war_save_project(env, env->current_project_path);
+                    war_save_start(env, env->current_project_path, 0);
                 } else {
                     fprintf(stderr, "SAVE: usage :w <name>\n");
                 }
@@ -1683,7 +1844,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
         int n = xkb_keysym_to_utf8(raw_sym, utf8, sizeof(utf8));
         if (n > 1 && utf8[0] >= 32 && utf8[0] <= 126) {
             env->cmd_tab_count = 0; // reset tab completion
-            if (env->cmd_len < 255) {
+            if (env->cmd_len < WAR_CMD_MAX - 1) {
                 env->cmd_buf[env->cmd_len++] = utf8[0];
                 env->cmd_buf[env->cmd_len] = '\0';
             }
@@ -1860,30 +2021,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
     // open device selector (Alt+O) — during active capture
     if (raw_sym == XKB_KEY_o && (mod & MOD_ALT) && !env->cmd_active && env->atomics->capture) {
         if (env->popup_active && env->popup_mode == 2) { env->popup_active = 0; cur->prefix = 0; return; }
-        // refresh device list
-        for (uint32_t _sri = 1; _sri < env->dev_count; _sri++)
-            free(env->dev_names[_sri]);
-        env->dev_count = 1;
-        {
-            char buf[256];
-            FILE* pw_fp = popen("pactl list sources short 2>/dev/null | cut -f2", "r");
-            if (pw_fp) {
-                while (fgets(buf, sizeof(buf), pw_fp) && env->dev_count < 128) {
-                    size_t len = strlen(buf);
-                    if (len > 0 && buf[len-1] == '\n') buf[len-1] = '\0';
-                    if (len > 1 && env->dev_count < 128) {
-                        int _dup = 0;
-                        for (uint32_t _di2 = 0; _di2 < env->dev_count; _di2++)
-                            if (env->dev_names[_di2] && strcmp(env->dev_names[_di2], buf) == 0) { _dup = 1; break; }
-                        if (!_dup) {
-                            env->dev_names[env->dev_count] = strdup(buf);
-                            env->dev_count++;
-                        }
-                    }
-                }
-                pclose(pw_fp);
-            }
-        }
+        // list is kept current by the devices thread (war_devices_sync)
         if (env->dev_count > 0 && env->dev_names) {
             env->popup_active = 1;
             env->popup_mode = 2;
@@ -1900,23 +2038,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
     // open MIDI device selector (Alt+O) — in MIDI mode without capture
     if (raw_sym == XKB_KEY_o && (mod & MOD_ALT) && !env->cmd_active && mode == WAR_MODE_ID_MIDI && !env->atomics->capture) {
         if (env->popup_active && env->popup_mode == 1) { env->popup_active = 0; cur->prefix = 0; return; }
-        // refresh MIDI device list
-        for (uint32_t _mi = 0; _mi < env->midi_dev_count; _mi++)
-            free(env->midi_dev_names[_mi]);
-        env->midi_dev_count = 0;
-        {
-            char _mbuf[256];
-            FILE* _mf = popen("aconnect -i 2>/dev/null | grep '^client' | cut -d: -f2 | cut '-d[' -f1 | tr -d \"'\" | sed 's/^[[:space:]]*//;s/[[:space:]]*$//'", "r");
-            if (_mf) {
-                while (fgets(_mbuf, sizeof(_mbuf), _mf) && env->midi_dev_count < 128) {
-                    size_t _ml = strlen(_mbuf);
-                    if (_ml > 0 && _mbuf[_ml-1] == '\n') _mbuf[_ml-1] = '\0';
-                    if (_ml > 1 && env->midi_dev_count < 128)
-                        env->midi_dev_names[env->midi_dev_count++] = strdup(_mbuf);
-                }
-                pclose(_mf);
-            }
-        }
+        // list is kept current by the devices thread (war_devices_sync)
         if (env->midi_dev_count > 0 && env->midi_dev_names) {
             env->popup_active = 1;
             env->popup_mode = 1;
@@ -1952,6 +2074,7 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
     if (raw_sym == XKB_KEY_Escape) {
         if (env->atomics->capture) {
             env->atomics->capture = 0;
+            war_spill_reset(env);
             cur->prefix = 0;
             return;
         }
@@ -2254,25 +2377,13 @@ static void war_handle_key(war_wayland_context* ctx_wayland, uint32_t key,
     uint64_t next = 0;
     // try from stored prefix state first (for multi-key sequences like gg)
     if (ctx_wayland->keymap_state) {
-        size_t prefix_idx =
-            mode * (size_t)config->KEYMAP_STATE_CAPACITY *
-                config->KEYMAP_KEYSYM_CAPACITY * config->KEYMAP_MOD_CAPACITY +
-            ctx_wayland->keymap_state * (size_t)config->KEYMAP_KEYSYM_CAPACITY *
-                config->KEYMAP_MOD_CAPACITY +
-            (size_t)keysym * config->KEYMAP_MOD_CAPACITY + mod;
-        next = keymap->next_state[prefix_idx];
+        next = war_keymap_next(
+            keymap, config, mode, ctx_wayland->keymap_state, keysym, mod);
     }
     // if no transition from prefix state, fall back to root
-    size_t trans_idx;
     if (!next) {
         ctx_wayland->keymap_state = 0;
-        trans_idx = mode * (size_t)config->KEYMAP_STATE_CAPACITY *
-                        config->KEYMAP_KEYSYM_CAPACITY *
-                        config->KEYMAP_MOD_CAPACITY +
-                    0 * (size_t)config->KEYMAP_KEYSYM_CAPACITY *
-                        config->KEYMAP_MOD_CAPACITY +
-                    (size_t)keysym * config->KEYMAP_MOD_CAPACITY + mod;
-        next = keymap->next_state[trans_idx];
+        next = war_keymap_next(keymap, config, mode, 0, keysym, mod);
     }
     if (!next) {
         if (!is_digit) cur->prefix = 0;
@@ -2545,17 +2656,22 @@ static int capture_cb_count = 0;
 static void on_pw_capture_process(void* userdata) {
     war_env* env = (war_env*)userdata;
     struct pw_buffer* b;
+    uint64_t _tr = war_trace_begin();
     if (!(b = pw_stream_dequeue_buffer(env->ctx_pw->capture_stream))) return;
     struct spa_buffer* spa = b->buffer;
     void* src = spa->datas[0].data;
     uint32_t n_bytes = spa->datas[0].chunk->size;
     if (src && n_bytes > 0) {
         if (++capture_cb_count <= 5)
-            call_king_terry("CAPTURE: %u bytes from mic", n_bytes);
-        war_pc_to_wr(env->pc_capture, 0, n_bytes, src);
+            war_log_info("CAPTURE: %u bytes from mic", n_bytes);
+        uint8_t _stored = war_pc_to_wr(env->pc_capture, 0, n_bytes, src);
         env->atomics->capture_frames++;
+        war_perf_capture_callback(&env->perf,
+                                  _war_perf_ring_used(env->pc_capture->i_to_wr, env->pc_capture->i_from_a, env->pc_capture->size),
+                                  _stored);
     }
     pw_stream_queue_buffer(env->ctx_pw->capture_stream, b);
+    war_trace_end("pw capture", _tr);
 }
 
 static int loopback_cb_count = 0;
@@ -2569,7 +2685,7 @@ static void on_pw_loopback_process(void* userdata) {
     uint32_t n_bytes = spa->datas[0].chunk->size;
     if (src && n_bytes > 0 && env->atomics->capture_loopback) {
         if (++loopback_cb_count <= 5)
-            call_king_terry("LOOPBACK: %u bytes from sink", n_bytes);
+            war_log_info("LOOPBACK: %u bytes from sink", n_bytes);
         war_pc_to_wr(env->pc_loopback, 0, n_bytes, src);
         env->atomics->loopback_frames++;
     }
@@ -2579,12 +2695,14 @@ static void on_pw_loopback_process(void* userdata) {
 static void on_pw_play_process(void* userdata) {
     war_env* env = (war_env*)userdata;
     struct pw_buffer* b;
+    uint64_t _tr = war_trace_begin();
     if (!(b = pw_stream_dequeue_buffer(env->ctx_pw->play_stream))) return;
     struct spa_buffer* spa = b->buffer;
     void* dst = spa->datas[0].data;
     uint32_t max = spa->datas[0].maxsize;
     uint32_t written = 0;
     uint32_t hdr, sz;
+    uint32_t fill = _war_perf_ring_used(env->pc_play->i_to_a, env->pc_play->i_from_wr, env->pc_play->size);
     while (written < max &&
            war_pc_from_wr(env->pc_play, &hdr, &sz, (uint8_t*)dst + written) &&
            sz <= max - written) {
@@ -2600,7 +2718,9 @@ static void on_pw_play_process(void* userdata) {
         spa->datas[0].chunk->size = max;
         spa->datas[0].chunk->stride = 8;
     }
+    war_perf_play_callback(&env->perf, fill, written, max);
     pw_stream_queue_buffer(env->ctx_pw->play_stream, b);
+    war_trace_end("pw play", _tr);
 }
 
 // Dedicated audio thread: runs Pipewire main loop at SCHED_FIFO.
@@ -2610,6 +2730,7 @@ void* war_pipewire(void* args) {
     // attempt real-time scheduling
     struct sched_param sp = {.sched_priority = 80};
     pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    war_trace_thread_name("pipewire");
 
     pw_init(NULL, NULL);
 
@@ -2754,10 +2875,156 @@ void* war_pipewire(void* args) {
     return NULL;
 }
 
+void war_pipewire_stop(war_env* env) {
+    if (env->ctx_pw && env->ctx_pw->main_loop)
+        pw_main_loop_quit(env->ctx_pw->main_loop);
+}
+
+static void* war_render_worker(void* arg) {
+    war_render_batch* batch = (war_render_batch*)arg;
+    war_trace_thread_name("render");
+    war_env* env = war_render_env_new(batch->config, batch->table);
+    for (;;) {
+        uint32_t i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count) break;
+        const char* project = batch->projects[i];
+        if (!env) {
+            fprintf(stderr, "RENDER: %s: out of memory\n", project);
+            atomic_fetch_add(&batch->failed, 1);
+            continue;
+        }
+        char out[1280];
+        war_render_out_path(batch, project, out, sizeof(out));
+        uint64_t t0 = war_get_monotonic_time_us();
+        env->status_msg[0] = '\0';
+        war_load_project(env, project);
+        uint64_t frames = 0;
+        double sec = 0.0;
+        float* mix = strstr(env->status_msg, "FAILED") ? NULL : war_export_mix(env, &frames, &sec, NULL);
+        int ok = mix && war_render_write(batch->table, mix, frames, out, batch->rate, batch->bits, batch->raw);
+        free(mix);
+        if (ok) {
+            fprintf(stderr, "RENDER: %s -> %s (%.1fs of audio in %.2fs)\n", project, out, sec,
+                    (double)(war_get_monotonic_time_us() - t0) / 1e6);
+        } else {
+            fprintf(stderr, "RENDER: %s failed: %s\n", project,
+                    mix || !env->status_msg[0] ? "cannot write output" : env->status_msg);
+            atomic_fetch_add(&batch->failed, 1);
+        }
+    }
+    war_render_env_free(env);
+    return NULL;
+}
+
+// war --render <project.warp>... [-o file|dir] [--format wav|raw]
+//     [--bits 16|24|32] [--rate hz] [--threads n]
+static int war_render_cli(int argc, char** argv) {
+    war_render_batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.rate = WAR_RENDER_RATE;
+    batch.bits = 16;
+    batch.projects = calloc((size_t)argc, sizeof(char*));
+    uint32_t threads = 0;
+    int bad = !batch.projects;
+    for (int i = 1; i < argc && !bad; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--render") == 0) {
+            continue;
+        } else if (strcmp(a, "-o") == 0 && v) {
+            batch.out = v;
+        } else if (strcmp(a, "--format") == 0 && v) {
+            bad = strcmp(v, "wav") != 0 && strcmp(v, "raw") != 0;
+            batch.raw = strcmp(v, "raw") == 0;
+        } else if (strcmp(a, "--bits") == 0 && v) {
+            batch.bits = (uint32_t)atoi(v);
+            bad = batch.bits != 16 && batch.bits != 24 && batch.bits != 32;
+        } else if (strcmp(a, "--rate") == 0 && v) {
+            batch.rate = (uint32_t)atoi(v);
+            bad = batch.rate < 8000 || batch.rate > 384000;
+        } else if (strcmp(a, "--threads") == 0 && v) {
+            threads = (uint32_t)atoi(v);
+            bad = threads < 1;
+        } else if (a[0] != '-') {
+            batch.projects[batch.count++] = argv[i];
+            continue;
+        } else {
+            bad = 1;
+        }
+        i++;
+    }
+    if (bad || !batch.count) {
+        fprintf(stderr, "usage: war --render <project.warp>... [-o file|dir] [--format wav|raw] "
+                        "[--bits 16|24|32] [--rate hz] [--threads n]\n");
+        free(batch.projects);
+        return 2;
+    }
+    if (batch.out && batch.count > 1) war_mkdir(batch.out, 0755);
+    if (!threads) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (uint32_t)n : 1;
+    }
+    if (threads > batch.count) threads = batch.count;
+    // user overrides are not loaded: renders come out the same on every machine
+    batch.config = calloc(1, sizeof(war_config_context));
+    batch.table = aligned_alloc(64, sizeof(float) * WAR_RESAMPLE_TABLE_FLOATS);
+    if (!batch.config || !batch.table) {
+        fprintf(stderr, "RENDER: out of memory\n");
+        free(batch.config);
+        free(batch.table);
+        free(batch.projects);
+        return 1;
+    }
+    war_config_default(batch.config);
+    war_resample_table_init(batch.table);
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, 0);
+    uint64_t t0 = war_get_monotonic_time_us();
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    uint32_t started = 0;
+    while (tids && started < threads && pthread_create(&tids[started], NULL, war_render_worker, &batch) == 0)
+        started++;
+    if (!started) war_render_worker(&batch); // no threads: render on this one
+    for (uint32_t t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    uint32_t failed = atomic_load(&batch.failed);
+    fprintf(stderr, "RENDER: %u of %u projects in %.2fs on %u threads\n", batch.count - failed, batch.count,
+            (double)(war_get_monotonic_time_us() - t0) / 1e6, started ? started : 1);
+    free(tids);
+    free(batch.table);
+    free(batch.config);
+    free(batch.projects);
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char** argv) {
-    (void)argc;
-    (void)argv;
     CALL_KING_TERRY("war");
+    war_log_init();
+    // headless batch render: no window, no audio device
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--render") == 0) return war_render_cli(argc, argv);
+    // audio backend: --audio pipewire|null, --audio-out <file.wav>,
+    // --audio-in <file.wav>; WAR_AUDIO, WAR_AUDIO_OUT and WAR_AUDIO_IN in the
+    // environment do the same
+    const char* audio_name = getenv("WAR_AUDIO");
+    const char* audio_out = getenv("WAR_AUDIO_OUT");
+    const char* audio_in = getenv("WAR_AUDIO_IN");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc)
+            audio_name = argv[++i];
+        else if (strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc)
+            audio_out = argv[++i];
+        else if (strcmp(argv[i], "--audio-in") == 0 && i + 1 < argc)
+            audio_in = argv[++i];
+        else
+            call_king_terry("ignoring argument %s", argv[i]);
+    }
+    // a file to play into or capture from means no sound server
+    if (!audio_name) audio_name = (audio_out || audio_in) ? "null" : "pipewire";
+    const war_audio_backend* audio_backend = war_audio_backend_find(audio_name);
+    if (!audio_backend) {
+        call_king_terry("unknown audio backend %s (pipewire, null)", audio_name);
+        exit(1);
+    }
     //--------------------------------------------------------------------
     // KEY CHECK
     //--------------------------------------------------------------------
@@ -2776,22 +3043,14 @@ int main(int argc, char** argv) {
         calloc(tmp_ctx_config->POOL_MAX_ALLOCATIONS, sizeof(uint32_t));
     tmp_ctx_pool->id =
         calloc(tmp_ctx_config->POOL_MAX_ALLOCATIONS, sizeof(war_pool_id));
+    tmp_ctx_pool->index = calloc(WAR_POOL_ID_COUNT, sizeof(uint32_t));
     war_pool_default(tmp_ctx_pool, tmp_ctx_config);
-    for (uint32_t i = 0; i < tmp_ctx_pool->count; i++) {
-        tmp_ctx_pool->total_size += tmp_ctx_pool->size[i];
-    }
-    tmp_ctx_pool->pool = mmap(NULL,
-                              tmp_ctx_pool->total_size,
-                              PROT_READ | PROT_WRITE,
-                              MAP_PRIVATE | MAP_ANONYMOUS,
-                              -1,
-                              0);
-    if (tmp_ctx_pool->pool == MAP_FAILED) {
+    war_pool_layout(tmp_ctx_pool, tmp_ctx_config);
+    if (!war_pool_map(tmp_ctx_pool, tmp_ctx_config)) {
         call_king_terry("tmp pool map failed, total_size: %llu",
                         (unsigned long long)tmp_ctx_pool->total_size);
         exit(1);
     }
-    memset(tmp_ctx_pool->pool, 0, tmp_ctx_pool->total_size);
     war_hot_context* tmp_ctx_hot =
         war_pool_alloc_new(tmp_ctx_pool, WAR_POOL_ID_HOT_CONTEXT);
     tmp_ctx_hot->function =
@@ -2830,26 +3089,18 @@ int main(int argc, char** argv) {
         calloc(tmp_ctx_config->POOL_MAX_ALLOCATIONS, sizeof(uint32_t));
     ctx_pool->id =
         calloc(tmp_ctx_config->POOL_MAX_ALLOCATIONS, sizeof(war_pool_id));
+    ctx_pool->index = calloc(WAR_POOL_ID_COUNT, sizeof(uint32_t));
     war_pool_default(ctx_pool, tmp_ctx_config);
     tmp_ctx_hot->fn_id[0] = WAR_HOT_ID_POOL;
     tmp_ctx_hot->fn_count = 1;
     tmp_env->ctx_pool = ctx_pool;
     war_override(tmp_ctx_hot->fn_count, tmp_ctx_hot->fn_id, tmp_env);
-    for (uint32_t i = 0; i < ctx_pool->count; i++) {
-        ctx_pool->total_size += ctx_pool->size[i];
-    }
-    ctx_pool->pool = mmap(NULL,
-                          ctx_pool->total_size,
-                          PROT_READ | PROT_WRITE,
-                          MAP_PRIVATE | MAP_ANONYMOUS,
-                          -1,
-                          0);
-    if (ctx_pool->pool == MAP_FAILED) {
+    war_pool_layout(ctx_pool, tmp_ctx_config);
+    if (!war_pool_map(ctx_pool, tmp_ctx_config)) {
         call_king_terry("pool map failed, total_size: %llu",
                         (unsigned long long)ctx_pool->total_size);
         exit(1);
     }
-    memset(ctx_pool->pool, 0, ctx_pool->total_size);
     war_config_context* ctx_config =
         war_pool_alloc_new(ctx_pool, WAR_POOL_ID_CONFIG_CONTEXT);
     memcpy((uint8_t*)ctx_config,
@@ -2873,6 +3124,7 @@ int main(int argc, char** argv) {
     memcpy((uint8_t*)ctx_hot->name,
            (uint8_t*)tmp_ctx_hot->name,
            war_pool_size(ctx_pool, WAR_POOL_ID_HOT_CONTEXT_NAME));
+    memcpy(ctx_hot->source, tmp_ctx_hot->source, sizeof(ctx_hot->source));
     free(tmp_ctx_config);
     tmp_ctx_config = NULL;
     tmp_env = NULL;
@@ -2880,6 +3132,7 @@ int main(int argc, char** argv) {
     free(tmp_ctx_pool->offset);
     free(tmp_ctx_pool->alignment);
     free(tmp_ctx_pool->id);
+    free(tmp_ctx_pool->index);
     if (munmap(tmp_ctx_pool->pool, tmp_ctx_pool->total_size) == -1) {
         call_king_terry("munmap failed");
     }
@@ -2901,14 +3154,17 @@ int main(int argc, char** argv) {
         war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_FUNCTION_COUNT);
     ctx_keymap->flags =
         war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_FLAGS);
-    ctx_keymap->next_state =
-        war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_NEXT_STATE);
+    ctx_keymap->edge_key =
+        war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_KEY);
+    ctx_keymap->edge_next =
+        war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_EDGE_NEXT);
     ctx_keymap->state_count =
         war_pool_alloc_new(ctx_pool, WAR_POOL_ID_KEYMAP_CONTEXT_STATE_COUNT);
-    for (uint32_t i = 0; i < ctx_config->KEYMAP_MODE_CAPACITY; i++) {
-        ctx_keymap->state_count[i] = 1;
+    if (!war_keymap_cache_load(ctx_keymap, ctx_config)) {
+        war_keymap_clear(ctx_keymap, ctx_config);
+        war_keymap_default(ctx_keymap, ctx_config);
+        war_keymap_cache_save(ctx_keymap, ctx_config);
     }
-    war_keymap_default(ctx_keymap, ctx_config);
     war_command_context* ctx_command =
         war_pool_alloc_new(ctx_pool, WAR_POOL_ID_COMMAND_CONTEXT);
     ctx_command->function_id =
@@ -2948,10 +3204,10 @@ int main(int argc, char** argv) {
     env->current_project_path[0] = '\0';
     env->file_dirty = 0;
     env->undo_save_marker = 0;
+    env->edit_seq = 0;
     env->undo_note_counts = calloc(WAR_UNDO_MAX, sizeof(uint32_t));
     env->undo_notes = calloc(WAR_UNDO_MAX, sizeof(war_new_vulkan_note_instance*));
-    env->undo_audio_data = calloc(WAR_UNDO_MAX, sizeof(uint8_t*));
-    env->undo_audio_size = calloc(WAR_UNDO_MAX, sizeof(uint64_t));
+    env->undo_audio = calloc(WAR_UNDO_MAX, sizeof(war_undo_audio*));
     env->across_radius = 16;
     env->across_resample = 0;
     ctx_hot->fn_id[0] = WAR_HOT_ID_COLOR;
@@ -2960,7 +3216,15 @@ int main(int argc, char** argv) {
     ctx_hot->fn_id[3] = WAR_HOT_ID_PLUGIN;
     ctx_hot->fn_count = 4;
     war_override(ctx_hot->fn_count, ctx_hot->fn_id, env);
+    war_hot_watch_init(ctx_hot, ctx_config);
     war_stem_init(env);
+    war_autotune_init(env);
+    war_save_init(env);
+    war_freeze_init(env);
+    war_load_init(env);
+    env->autosave_sec = ctx_config->A_AUTOSAVE_SEC;
+    war_perf_reset(&env->perf);
+    env->perf_dump_sec = ctx_config->A_PERF_DUMP_SEC;
     // set ADSR defaults after override (plugins may reset pool)
     for (int i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
         env->capture_slots[i].attack = 0.0f;
@@ -3146,63 +3410,36 @@ int main(int argc, char** argv) {
     // pipewire context (struct allocated from pool, sub-fields filled in
     // war_pipewire thread)
     env->ctx_pw = war_pool_alloc_new(ctx_pool, WAR_POOL_ID_AUDIO_CTX_PW);
+    // delay-line pool for :delay/:chorus (voices borrow lines, nothing is
+    // allocated on the audio path)
+    env->delay_pool = war_pool_alloc_new(ctx_pool, WAR_POOL_ID_AUDIO_DELAY_POOL);
+    env->delay_pool_used =
+        war_pool_alloc_new(ctx_pool, WAR_POOL_ID_AUDIO_DELAY_POOL_USED);
+    env->delay_pool_count = (uint32_t)ctx_config->A_DELAY_LINES;
+    env->delay_pool_frames = war_delay_pool_frames(ctx_config);
+    // sinc kernels for transposed slots (war_resample.h)
+    env->resample_table = war_pool_alloc_new(ctx_pool, WAR_POOL_ID_AUDIO_RESAMPLE_TABLE);
+    if (env->resample_table) war_resample_table_init(env->resample_table);
+    // capture blocks in flight to the spill writer (war_spill.h)
+    env->spill_blocks = war_pool_alloc_new(ctx_pool, WAR_POOL_ID_AUDIO_SPILL_BLOCKS);
+    war_spill_init(env);
+    env->page_scan_us = 0;
 
     // spawn dedicated audio thread (war_pipewire runs pw_main_loop_run
-    // internally)
+    // internally, war_audio_null its own clock)
+    env->audio_backend = audio_backend;
+    if (audio_out) snprintf(env->audio_out_path, sizeof(env->audio_out_path), "%s", audio_out);
+    if (audio_in) snprintf(env->audio_in_path, sizeof(env->audio_in_path), "%s", audio_in);
     pthread_t pw_thread;
-    WASSERT(pthread_create(&pw_thread, NULL, war_pipewire, env) == 0);
+    WASSERT(pthread_create(&pw_thread, NULL, env->audio_backend->run, env) == 0);
 
-    // enumerate audio sources for device selector HUD
+    // device selector HUD lists, filled by war_devices_sync
     env->dev_count = 1;
-    env->dev_names = calloc(128, sizeof(char*));
+    env->dev_names = calloc(WAR_DEVICES_MAX, sizeof(char*));
     env->dev_names[0] = strdup("loopback");
-    // clean up any stale virtual loopback sinks from previous run
-    system("pactl list-modules 2>/dev/null | grep 'war_loopback' | grep -o '[0-9]*' | while read m; do pactl unload-module $m 2>/dev/null; done");
-    {
-        char buf[256];
-        FILE* pw_fp = popen("pactl list sources short 2>/dev/null | cut -f2", "r");
-        if (pw_fp) {
-            while (fgets(buf, sizeof(buf), pw_fp) && env->dev_count < 128) {
-                size_t len = strlen(buf);
-                if (len > 0 && buf[len-1] == '\n') buf[len-1] = '\0';
-                if (len > 1 && env->dev_count < 128) {
-                    // deduplicate: skip if name already in list
-                    int _dup = 0;
-                    for (uint32_t _di = 0; _di < env->dev_count; _di++)
-                        if (env->dev_names[_di] && strcmp(env->dev_names[_di], buf) == 0) { _dup = 1; break; }
-                    if (!_dup) {
-                        env->dev_names[env->dev_count] = strdup(buf);
-                        env->dev_count++;
-                    }
-                }
-            }
-            pclose(pw_fp);
-        }
-    }
-    // create additional virtual loopback sinks for capture modes
-    system("pactl unload-module $(pactl list-modules | grep 'war_loopback' | grep -o 'Module #[0-9]*' | cut -d# -f2) 2>/dev/null");
-    for (int _li = 0; _li < 4; _li++) env->loopback_modules[_li] = 0;
-    for (int _li = 2; _li <= 4; _li++) {
-        char _lb[256];
-        snprintf(_lb, sizeof(_lb), "war_loopback%d", _li);
-        if (env->dev_count < 128) {
-            char _nname[64];
-            snprintf(_nname, sizeof(_nname), "%s.monitor", _lb);
-            env->dev_names[env->dev_count++] = strdup(_nname);
-        }
-        char _cmd[256];
-        snprintf(_cmd, sizeof(_cmd), "pactl load-module module-null-sink sink_name=%s", _lb);
-        FILE* _fp = popen(_cmd, "r");
-        if (_fp) {
-            if (fgets(_cmd, sizeof(_cmd), _fp))
-                env->loopback_modules[_li - 2] = (uint32_t)atol(_cmd);
-            pclose(_fp);
-        }
-    }
-
     // MIDI device init
     env->midi_dev_count = 0;
-    env->midi_dev_names = calloc(128, sizeof(char*));
+    env->midi_dev_names = calloc(WAR_DEVICES_MAX, sizeof(char*));
     env->midi_dev_node = NULL;
     env->midi_seq = NULL;
     env->midi_seq_port = -1;
@@ -3233,20 +3470,9 @@ int main(int argc, char** argv) {
         }
     }
 
-    // enumerate MIDI devices for Alt+O selector
-    {
-        char _mbuf[256];
-        FILE* _mf = popen("aconnect -i 2>/dev/null | grep '^client' | cut -d: -f2 | cut '-d[' -f1 | tr -d \"'\" | sed 's/^[[:space:]]*//;s/[[:space:]]*$//'", "r");
-        if (_mf) {
-            while (fgets(_mbuf, sizeof(_mbuf), _mf) && env->midi_dev_count < 128) {
-                size_t _ml = strlen(_mbuf);
-                if (_ml > 0 && _mbuf[_ml-1] == '\n') _mbuf[_ml-1] = '\0';
-                if (_ml > 1 && env->midi_dev_count < 128)
-                    env->midi_dev_names[env->midi_dev_count++] = strdup(_mbuf);
-            }
-            pclose(_mf);
-        }
-    }
+    // audio sources, MIDI ports and the war_loopback2..4 sinks are found and
+    // created off the startup path; the lists fill in via war_devices_sync
+    war_devices_init(env);
 
     // auto-connect to persisted MIDI device
     if (env->midi_dev_node) {
@@ -3261,9 +3487,6 @@ int main(int argc, char** argv) {
         env->capture_slots[_gi].eq1 = 0;
         env->capture_slots[_gi].eq2 = 0;
     }
-    env->capture_accumulator = NULL;
-    env->capture_accumulator_count = 0;
-    env->capture_accumulator_capacity = 0;
 
     //-------------------------------------------------------------------------
     // PIANO GUTTER INIT
@@ -3378,13 +3601,16 @@ int main(int argc, char** argv) {
     // MAIN LOOP
     //-------------------------------------------------------------------------
     int wayland_fd = wl_display_get_fd(ctx_wayland->display);
-    struct pollfd pfds[4] = {
+    struct pollfd pfds[5] = {
         {.fd = wayland_fd, .events = POLLIN},
         {.fd = ctx_wayland->repeat_timer_fd, .events = POLLIN},
         {.fd = ctx_wayland->audio_timer_fd, .events = POLLIN},
         {.fd = -1, .events = POLLIN},
+        {.fd = ctx_hot->watch_fd, .events = POLLIN},
     };
+    war_trace_thread_name("main");
     while (ctx_wayland->running) {
+        uint64_t _tr = war_trace_begin();
         // update MIDI sequencer FD
         int midi_fd = -1;
         if (env->midi_seq) {
@@ -3395,14 +3621,23 @@ int main(int argc, char** argv) {
         pfds[3].fd = midi_fd;
         wl_display_flush(ctx_wayland->display);
         if (wl_display_prepare_read(ctx_wayland->display) == 0) {
-            poll(pfds, 4, 100);
+            poll(pfds, 5, 100);
             if (pfds[0].revents & POLLIN)
                 wl_display_read_events(ctx_wayland->display);
             else
                 wl_display_cancel_read(ctx_wayland->display);
         }
         wl_display_dispatch_pending(ctx_wayland->display);
+        war_trace_end("wayland poll/dispatch", _tr);
+        // override sources changed: rebuild and swap between frames
+        if (pfds[4].revents & POLLIN) {
+            war_hot_id _hids[WAR_HOT_ID_COUNT];
+            uint32_t _hn = war_hot_watch_read(ctx_hot, _hids);
+            if (_hn) _war_hot_reload(env, _hn, _hids);
+        }
+        war_devices_sync(env);
         // drain timerfd (periodic, no re-arm needed)
+        _tr = war_trace_begin();
         struct pollfd tfd = {.fd = ctx_wayland->repeat_timer_fd,
                              .events = POLLIN};
         if (poll(&tfd, 1, 0) > 0) {
@@ -3544,10 +3779,12 @@ int main(int argc, char** argv) {
                     }
                     war_keymap_context* keymap = env->ctx_keymap;
                     war_config_context* config = env->ctx_config;
-                    size_t ti = (size_t)ctx_wayland->repeat_sym *
-                                    config->KEYMAP_MOD_CAPACITY +
-                                ctx_wayland->repeat_mod;
-                    uint64_t next = keymap->next_state[ti];
+                    uint64_t next = war_keymap_next(keymap,
+                                                    config,
+                                                    WAR_MODE_ID_ROLL,
+                                                    0,
+                                                    ctx_wayland->repeat_sym,
+                                                    ctx_wayland->repeat_mod);
                     if (next) {
                         uint8_t cnt = keymap->function_count[next];
                         size_t fb =
@@ -3570,35 +3807,20 @@ int main(int argc, char** argv) {
             // save expiration count for playbar advancement below
             ctx_wayland->audio_timer_exp = _ax;
         }
-        // drain loopback (system audio) ring buffer into accumulator
+        war_trace_end("timerfd drain", _tr);
+        // drain loopback (system audio) ring buffer into the capture spill
+        _tr = war_trace_begin();
         if (env->atomics->capture) {
             uint32_t hdr, sz;
-            uint8_t buf[65536];
+            float buf[65536 / sizeof(float)];
             const char* _dname = env->dev_nodes[env->capture_mode - 1];
             int _use_mic = _dname && strstr(_dname, "monitor") == NULL && strstr(_dname, "loopback") == NULL;
             war_producer_consumer* _dcap = _use_mic ? env->pc_capture : env->pc_loopback;
-            while (war_pc_from_a(_dcap, &hdr, &sz, buf) && sz > 0) {
-                uint32_t n_floats = sz / sizeof(float);
-                uint64_t needed = env->capture_accumulator_count + n_floats;
-                if (needed > env->capture_accumulator_capacity) {
-                    uint64_t new_cap =
-                        env->capture_accumulator_capacity ?
-                            env->capture_accumulator_capacity * 2 :
-                            4096;
-                    while (new_cap < needed) new_cap *= 2;
-                    float* tmp = realloc(env->capture_accumulator,
-                                         new_cap * sizeof(float));
-                    if (!tmp) break;
-                    env->capture_accumulator = tmp;
-                    env->capture_accumulator_capacity = new_cap;
-                }
-                memcpy(env->capture_accumulator +
-                           env->capture_accumulator_count,
-                       buf,
-                       sz);
-                env->capture_accumulator_count += n_floats;
-            }
+            // blocks go to the spill writer, nothing is allocated here
+            while (war_pc_from_a(_dcap, &hdr, &sz, buf) && sz > 0)
+                war_spill_write(env, buf, sz / sizeof(float));
         }
+        war_trace_end("capture drain", _tr);
         // playback bar advancement (runs even without frame callbacks)
         // MOVED BEFORE mixing loop so playbar rendering uses current playhead
         double _pb_ccp = 0.0, _pb_spc = 0.0;
@@ -3620,15 +3842,26 @@ int main(int argc, char** argv) {
             _pb_ccp = (double)ctx_wayland->gutter_cols + env->play_bar_position_seconds / _pb_spc;
         }
         // process MIDI events before audio mixing so new notes start in current frame
+        _tr = war_trace_begin();
         _war_process_midi(env);
+        war_trace_end("midi", _tr);
+        if (war_autotune_poll(env)) _war_mark_dirty(env);
+        if (war_stem_poll(env)) _war_mark_dirty(env);
+        war_save_poll(env);
+        war_load_poll(env);
+        war_freeze_poll(env);
+        war_autosave_tick(env);
+        war_resample_sync(env);
+        war_perf_tick(env);
         // unified audio mixing: preview (MIDI) voices + playbar voices
         // NOTE: playhead advancement is NOW ABOVE, so voices activated here
         // are picked up by the mixing loop in the SAME iteration
         {
-            enum { PW_CHUNK_FLOATS = 64 };
+            enum { PW_CHUNK_FLOATS = WAR_MIX_CHUNK_FLOATS };
             enum { _TOTAL_VOICES = WAR_PREVIEW_VOICES + WAR_PLAY_BAR_VOICES };
             uint64_t voice_batch[_TOTAL_VOICES];
             // activate playbar voices: scan notes at the current playhead position
+            _tr = war_trace_begin();
             if (env->play_bar_playing && env->ctx_note) {
                 uint32_t _nc = env->ctx_note->instance_count;
                 // compute mute mask from mute notes
@@ -3673,7 +3906,7 @@ int main(int argc, char** argv) {
                             if (_off2 & 1) _off2 &= ~1ULL;
                         }
                         if (_off2 >= _mf) continue;
-                        if (_sl->count > 0 && _off2 >= _sl->count)
+                        if (_sl->count > 0 && _off2 >= war_slot_play_count(_sl))
                             continue;
                         for (uint32_t _v = 0; _v < WAR_PLAY_BAR_VOICES; _v++) {
                             if (env->play_bar_voice_active[_v] == 0) {
@@ -3690,7 +3923,7 @@ int main(int argc, char** argv) {
                                 env->play_bar_voice_tick[_v] = _tik;
                                 env->play_bar_voice_read_pos[_v] = _off2;
                                 {
-                                    float* _pa = _sl->samples; uint64_t _pc = _sl->count;
+                                    float* _pa = _sl->samples; uint64_t _pc = war_slot_play_count(_sl);
                                     env->play_bar_voice_read_limit[_v] = _mf;
                                     if (_pc > 0 && env->play_bar_voice_read_limit[_v] > _pc)
                                         env->play_bar_voice_read_limit[_v] = _pc;
@@ -3701,8 +3934,9 @@ int main(int argc, char** argv) {
                                 env->play_bar_voice_filter_lp[_v][3] = 0.0f;
                                 env->play_bar_voice_filter_lp[_v][4] = 0.0f;
                                 memset(env->play_bar_voice_effect_state[_v], 0, sizeof(env->play_bar_voice_effect_state[_v]));
-                                if (env->play_bar_voice_delay_line[_v]) { free(env->play_bar_voice_delay_line[_v]); env->play_bar_voice_delay_line[_v] = NULL; }
-                                env->play_bar_voice_delay_len[_v] = 0;
+                                _war_delay_line_release(env, env->play_bar_voice_delay_line[_v]);
+                                memset(&env->play_bar_voice_autotune[_v], 0, sizeof(war_autotune_state));
+                                memset(&env->play_bar_voice_limiter[_v], 0, sizeof(war_limiter));
                                 env->play_bar_voice_env_samples[_v] = 0;
                                 env->play_bar_voice_active[_v] = 1;
                                 break;
@@ -3711,6 +3945,14 @@ int main(int argc, char** argv) {
                     }
                 }
             }
+            war_trace_end("playbar scan", _tr);
+            war_page_scan(env, _pb_ccp, _pb_spc);
+            _tr = war_trace_begin();
+            // hand pooled delay lines of finished voices back
+            for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++)
+                if (!env->preview_voice_active[v]) _war_delay_line_release(env, env->preview_voice_delay_line[v]);
+            for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++)
+                if (env->play_bar_voice_active[v] != 1) _war_delay_line_release(env, env->play_bar_voice_delay_line[v]);
             int any_active = 0;
             for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++)
                 if (env->preview_voice_active[v]) { any_active = 1; break; }
@@ -3718,6 +3960,7 @@ int main(int argc, char** argv) {
                 for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++)
                     if (env->play_bar_voice_active[v] == 1) { any_active = 1; break; }
             }
+            if (!any_active && env->reverb_bus_active) any_active = 1;
             // compute adaptive chunk limit: produce enough audio to cover
             // the wall-clock time since the last frame so the ring buffer never
             // drains. Include preview voices (spacebar), not just playbar/MIDI —
@@ -3730,257 +3973,25 @@ int main(int argc, char** argv) {
                 if (_max_chunks > 48) _max_chunks = 48; // cap at ~32ms worth
             }
             uint32_t _pb_chunks = 0;
+            atomic_store_explicit(&env->perf.producing, any_active || env->play_bar_playing || env->midi_seq,
+                                  memory_order_relaxed);
             while ((any_active || env->play_bar_playing || env->midi_seq) && _pb_chunks < _max_chunks) {
+                uint64_t _perf_t0 = war_perf_now_ns();
                 float mix[PW_CHUNK_FLOATS];
-                memset(mix, 0, sizeof(mix));
-                any_active = 0;
-                // mix preview voices
-                for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) {
-                    voice_batch[v] = 0;
-                    if (!env->preview_voice_active[v]) continue;
-                    uint32_t note = env->preview_voice_note[v];
-                    if (note > 127) note = 127;
-                    uint32_t layer = env->preview_voice_layer[v];
-                    if (layer < 1 || layer > 9) {
-                        env->preview_voice_active[v] = 0;
-                        continue;
-                    }
-                    if (!(env->layer_visible & (1 << (layer - 1)))) {
-                        env->preview_voice_active[v] = 0;
-                        continue;
-                    }
-                    uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-                    war_capture_slot* slot = &env->capture_slots[idx];
-                    float* _aud = slot->samples;
-                    uint64_t _aud_count = slot->count;
-                    if (!_aud || _aud_count < 2) {
-                        env->preview_voice_active[v] = 0;
-                        continue;
-                    }
-                    uint64_t read_pos = env->preview_voice_read_pos[v];
-                    uint64_t slot_avail = _aud_count;
-                    uint64_t read_limit = env->preview_voice_read_limit[v];
-                    if (read_limit > 0 && read_limit < slot_avail)
-                        slot_avail = read_limit;
-                    if (read_pos >= slot_avail) {
-                        if (env->loop_mode) {
-                            env->preview_voice_read_pos[v] = 0;
-                            read_pos = 0;
-                        } else {
-                            env->preview_voice_active[v] = 0;
-                            continue;
-                        }
-                    }
-                    uint64_t avail = slot_avail - read_pos;
-                    if (avail < 2) {
-                        if (env->loop_mode) {
-                            env->preview_voice_read_pos[v] = 0;
-                            read_pos = 0;
-                            avail = slot_avail;
-                        } else {
-                            env->preview_voice_active[v] = 0;
-                            continue;
-                        }
-                    }
-                    uint64_t batch = avail < PW_CHUNK_FLOATS ?
-                                         (avail & ~1ULL) :
-                                         PW_CHUNK_FLOATS;
-                    voice_batch[v] = batch;
-                    float _gm = (slot->gain + 500000.0f) / 500000.0f;
-                    float _pp = (float)(slot->pan + 1000) / 2000.0f;
-                    float _pl = sinf((1.0f - _pp) * (float)(M_PI / 2.0));
-                    float _pr = sinf(_pp * (float)(M_PI / 2.0));
-                    for (uint64_t f = 0; f < batch; f += 2) {
-                        float _s_l = _aud[read_pos + f];
-                        float _s_r = _aud[read_pos + f + 1];
-                        _war_process_effects(slot, env->preview_voice_effect_state[v], &_s_l, &_s_r);
-                        { float* _es = env->preview_voice_effect_state[v];
-                        if (slot->eq1) {
-                            float _ae1 = (float)fabsf((float)slot->eq1);
-                            float _fc1 = slot->eq1 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae1 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae1 / 1000.0f);
-                            float _at1 = 1.0f - expf(-2.0f * (float)M_PI * _fc1 / 48000.0f); if (_at1 > 1.0f) _at1 = 1.0f;
-                            _es[15] += 0.2f * (_at1 - _es[15]);
-                            float _lp1l = _es[16] + _es[15] * (_s_l - _es[16]); _es[16] = _lp1l;
-                            float _lp1r = _es[17] + _es[15] * (_s_r - _es[17]); _es[17] = _lp1r;
-                            float _hp1l = _s_l - _lp1l, _hp1r = _s_r - _lp1r;
-                            float _t1 = (float)slot->eq1 / 1000.0f; if(_t1<0)_t1=-_t1; if(_t1>1)_t1=1;
-                            if (slot->eq1 <= 0) { _s_l = _s_l * (1-_t1) + _lp1l * _t1; _s_r = _s_r * (1-_t1) + _lp1r * _t1; }
-                            else { _s_l = _s_l * (1-_t1) + _hp1l * _t1; _s_r = _s_r * (1-_t1) + _hp1r * _t1; }
-                        } else { _es[15] = 0; _es[16] = _s_l; _es[17] = _s_r; }
-                        if (slot->eq2) {
-                            float _ae2 = (float)fabsf((float)slot->eq2);
-                            float _fc2 = slot->eq2 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae2 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae2 / 1000.0f);
-                            float _at2 = 1.0f - expf(-2.0f * (float)M_PI * _fc2 / 48000.0f); if (_at2 > 1.0f) _at2 = 1.0f;
-                            _es[18] += 0.2f * (_at2 - _es[18]);
-                            float _lp2l = _es[19] + _es[18] * (_s_l - _es[19]); _es[19] = _lp2l;
-                            float _lp2r = _es[20] + _es[18] * (_s_r - _es[20]); _es[20] = _lp2r;
-                            float _hp2l = _s_l - _lp2l, _hp2r = _s_r - _lp2r;
-                            float _t2 = (float)slot->eq2 / 1000.0f; if(_t2<0)_t2=-_t2; if(_t2>1)_t2=1;
-                            if (slot->eq2 <= 0) { _s_l = _s_l * (1-_t2) + _lp2l * _t2; _s_r = _s_r * (1-_t2) + _lp2r * _t2; }
-                            else { _s_l = _s_l * (1-_t2) + _hp2l * _t2; _s_r = _s_r * (1-_t2) + _hp2r * _t2; }
-                        } else { _es[18] = 0; _es[19] = _s_l; _es[20] = _s_r; } }
-                        float _mix_l = _s_l, _mix_r = _s_r;
-                    float _a_g = _gm;
-                    // stereo float units (2 samples/frame); enforce min anti-click fade
-                    float _atk_samples = slot->attack / 1000.0f * 48000.0f * 2.0f;
-                    float _sus_level = (slot->sustain + 1000.0f) / 1000.0f;
-                    float _rel_samples = slot->release / 1000.0f * 48000.0f * 2.0f;
-                    if (_atk_samples < (float)WAR_CLICK_FADE_FLOATS) _atk_samples = (float)WAR_CLICK_FADE_FLOATS;
-                    if (_rel_samples < (float)WAR_CLICK_FADE_FLOATS) _rel_samples = (float)WAR_CLICK_FADE_FLOATS;
-                    int64_t _rem_preview = (int64_t)(slot_avail - read_pos) - (int64_t)f;
-                    float _env = _sus_level;
-                    if (_atk_samples > 0.0f) {
-                        uint64_t _elapsed = env->preview_voice_env_samples[v] + (uint64_t)f;
-                        if (_elapsed < (uint64_t)_atk_samples)
-                            _env = (float)_elapsed / _atk_samples * _sus_level;
-                    }
-                    // scale current env (don't jump to full sustain mid-attack)
-                    if (_rem_preview < (int64_t)_rel_samples) {
-                        if (_rem_preview <= 0) _env = 0.0f;
-                        else _env *= (float)_rem_preview / _rel_samples;
-                    }
-                    _a_g *= _env * env->preview_voice_gain[v];
-                    mix[f]   += _mix_l * _a_g * _pl;
-                    mix[f+1] += _mix_r * _a_g * _pr;
-                    }
-                    any_active = 1;
-                }
-                // mix playbar voices
-                if (env->play_bar_playing) {
-                    for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) {
-                        uint32_t vi = WAR_PREVIEW_VOICES + v;
-                        voice_batch[vi] = 0;
-                        if (env->play_bar_voice_active[v] != 1) continue;
-                        uint32_t note = env->play_bar_voice_note[v];
-                        if (note > 127) note = 127;
-                        uint32_t layer = env->play_bar_voice_layer[v];
-                        if (layer < 1 || layer > 9) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        if (!(env->layer_visible & (1 << (layer - 1)))) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        if (env->play_bar_mute_mask & (1 << (layer - 1))) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        uint32_t idx = note * WAR_CAPTURE_SLOT_LAYERS + (layer - 1);
-                        war_capture_slot* slot = &env->capture_slots[idx];
-                        float* _aud2 = slot->samples;
-                        uint64_t _aud2_count = slot->count;
-                        uint64_t read_pos = env->play_bar_voice_read_pos[v];
-                        uint64_t read_limit = env->play_bar_voice_read_limit[v];
-                        if (read_pos >= read_limit) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        uint64_t slot_avail = _aud2_count;
-                        if (!_aud2 || slot_avail == 0) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        if (read_pos >= slot_avail) {
-                            env->play_bar_voice_active[v] = 0;
-                            continue;
-                        }
-                        uint64_t remain = read_limit - read_pos;
-                        if (remain < slot_avail && remain < PW_CHUNK_FLOATS) {
-                            if (remain < 2) {
-                                env->play_bar_voice_active[v] = 0;
-                                continue;
-                            }
-                        }
-                        uint64_t batch = PW_CHUNK_FLOATS;
-                        if (batch > remain) batch = remain & ~1ULL;
-                        // don't cross slot boundary within a batch
-                        uint64_t slot_offset = read_pos;
-                        uint64_t to_slot_end = slot_avail - slot_offset;
-                        if (batch > to_slot_end) batch = to_slot_end & ~1ULL;
-                        voice_batch[vi] = batch;
-                        if (batch == 0) { env->play_bar_voice_active[v] = 0; continue; }
-                        float _gm = (slot->gain + 500000.0f) / 500000.0f;
-                        float _pp2 = (float)(slot->pan + 1000) / 2000.0f;
-                        float _pl2 = sinf((1.0f - _pp2) * (float)(M_PI / 2.0));
-                        float _pr2 = sinf(_pp2 * (float)(M_PI / 2.0));
-                        for (uint64_t f = 0; f < batch; f += 2) {
-                            float _s_l = _aud2[slot_offset + f];
-                            float _s_r = _aud2[slot_offset + f + 1];
-                            _war_process_effects(slot, env->play_bar_voice_effect_state[v], &_s_l, &_s_r);
-                            { float* _es = env->play_bar_voice_effect_state[v];
-                            if (slot->eq1) {
-                                float _ae1 = (float)fabsf((float)slot->eq1);
-                                float _fc1 = slot->eq1 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae1 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae1 / 1000.0f);
-                                float _at1 = 1.0f - expf(-2.0f * (float)M_PI * _fc1 / 48000.0f); if (_at1 > 1.0f) _at1 = 1.0f;
-                                _es[15] += 0.2f * (_at1 - _es[15]);
-                                float _lp1l = _es[16] + _es[15] * (_s_l - _es[16]); _es[16] = _lp1l;
-                                float _lp1r = _es[17] + _es[15] * (_s_r - _es[17]); _es[17] = _lp1r;
-                                float _hp1l = _s_l - _lp1l, _hp1r = _s_r - _lp1r;
-                                float _t1 = (float)slot->eq1 / 1000.0f; if(_t1<0)_t1=-_t1; if(_t1>1)_t1=1;
-                                if (slot->eq1 <= 0) { _s_l = _s_l * (1-_t1) + _lp1l * _t1; _s_r = _s_r * (1-_t1) + _lp1r * _t1; }
-                                else { _s_l = _s_l * (1-_t1) + _hp1l * _t1; _s_r = _s_r * (1-_t1) + _hp1r * _t1; }
-                            } else { _es[15] = 0; _es[16] = _s_l; _es[17] = _s_r; }
-                            if (slot->eq2) {
-                                float _ae2 = (float)fabsf((float)slot->eq2);
-                                float _fc2 = slot->eq2 <= 0 ? 20000.0f * expf(logf(20.0f/20000.0f) * _ae2 / 1000.0f) : 20.0f * expf(logf(20000.0f/20.0f) * _ae2 / 1000.0f);
-                                float _at2 = 1.0f - expf(-2.0f * (float)M_PI * _fc2 / 48000.0f); if (_at2 > 1.0f) _at2 = 1.0f;
-                                _es[18] += 0.2f * (_at2 - _es[18]);
-                                float _lp2l = _es[19] + _es[18] * (_s_l - _es[19]); _es[19] = _lp2l;
-                                float _lp2r = _es[20] + _es[18] * (_s_r - _es[20]); _es[20] = _lp2r;
-                                float _hp2l = _s_l - _lp2l, _hp2r = _s_r - _lp2r;
-                                float _t2 = (float)slot->eq2 / 1000.0f; if(_t2<0)_t2=-_t2; if(_t2>1)_t2=1;
-                                if (slot->eq2 <= 0) { _s_l = _s_l * (1-_t2) + _lp2l * _t2; _s_r = _s_r * (1-_t2) + _lp2r * _t2; }
-                                else { _s_l = _s_l * (1-_t2) + _hp2l * _t2; _s_r = _s_r * (1-_t2) + _hp2r * _t2; }
-                            } else { _es[18] = 0; _es[19] = _s_l; _es[20] = _s_r; } }
-                            float _mix_l = _s_l, _mix_r = _s_r;
-                            float _a_g2 = _gm;
-                            float _atk_s = slot->attack / 1000.0f * 48000.0f * 2.0f;
-                            float _sus_l = (slot->sustain + 1000.0f) / 1000.0f;
-                            float _rel_s = slot->release / 1000.0f * 48000.0f * 2.0f;
-                            if (_atk_s < (float)WAR_CLICK_FADE_FLOATS) _atk_s = (float)WAR_CLICK_FADE_FLOATS;
-                            if (_rel_s < (float)WAR_CLICK_FADE_FLOATS) _rel_s = (float)WAR_CLICK_FADE_FLOATS;
-                            int64_t _rem_playbar = (int64_t)remain - (int64_t)f;
-                            float _env2 = _sus_l;
-                            if (_atk_s > 0.0f) {
-                                uint64_t _elapsed2 = env->play_bar_voice_env_samples[v] + (uint64_t)f;
-                                if (_elapsed2 < (uint64_t)_atk_s)
-                                    _env2 = (float)_elapsed2 / _atk_s * _sus_l;
-                            }
-                            if (_rem_playbar < (int64_t)_rel_s) {
-                                if (_rem_playbar <= 0) _env2 = 0.0f;
-                                else _env2 *= (float)_rem_playbar / _rel_s;
-                            }
-                            _a_g2 *= _env2;
-                            mix[f]   += _mix_l * _a_g2 * _pl2;
-                            mix[f+1] += _mix_r * _a_g2 * _pr2;
-                        }
-                        any_active = 1;
-                    }
-                }
+                env->autotune_budget = (uint32_t)ctx_config->A_AUTOTUNE_BUDGET;
+                any_active = war_mix_voices(env, mix, voice_batch);
                 if (!any_active && !env->play_bar_playing && !env->midi_seq) break;
-                if (env->master_gain != 0.0f) {
-                    float _mg_live = (env->master_gain + 500000.0f) / 500000.0f;
-                    for (int _mf = 0; _mf < PW_CHUNK_FLOATS; _mf++)
-                        mix[_mf] *= _mg_live;
-                }
+                war_mix_master(env, mix);
                 if (!war_pc_to_a(env->pc_play, 0, PW_CHUNK_FLOATS * 4, mix))
                     break;
                 _pb_chunks++;
-                // advance preview read positions
-                for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) {
-                    env->preview_voice_read_pos[v] += voice_batch[v];
-                    if (env->preview_voice_active[v])
-                        env->preview_voice_env_samples[v] += voice_batch[v];
-                }
-                // advance playbar read positions
-                if (env->play_bar_playing) {
-                    for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) {
-                        env->play_bar_voice_read_pos[v] += voice_batch[WAR_PREVIEW_VOICES + v];
-                        if (env->play_bar_voice_active[v] == 1)
-                            env->play_bar_voice_env_samples[v] += voice_batch[WAR_PREVIEW_VOICES + v];
-                    }
+                {
+                    uint32_t _perf_voices = 0;
+                    for (uint32_t v = 0; v < WAR_PREVIEW_VOICES; v++) _perf_voices += env->preview_voice_active[v] != 0;
+                    for (uint32_t v = 0; v < WAR_PLAY_BAR_VOICES; v++) _perf_voices += env->play_bar_voice_active[v] == 1;
+                    war_perf_mix_chunk(&env->perf, war_perf_now_ns() - _perf_t0, PW_CHUNK_FLOATS / 2, _perf_voices);
                 }
+                war_mix_advance(env, voice_batch);
                 // continuously update note widths during recording
                 if (env->recording_active) {
                     uint64_t now_us = war_get_monotonic_time_us();
@@ -3999,6 +4010,7 @@ int main(int argc, char** argv) {
                 }
             }
         }
+        war_trace_end("mix", _tr);
         // playbar visual position update and loop detection
         if (env->play_bar_playing) {
             env->ctx_line->instance[0].pos[0] = (float)_pb_ccp;
@@ -4049,9 +4061,10 @@ int main(int argc, char** argv) {
     //-------------------------------------------------------------------------
     // signal audio thread to stop and quit its main loop
     if (env->atomics) env->atomics->capture = 0;
-    if (env->ctx_pw && env->ctx_pw->main_loop)
-        pw_main_loop_quit(env->ctx_pw->main_loop);
+    env->audio_backend->stop(env);
     pthread_join(pw_thread, NULL);
+    // audio thread is gone: flush what it logged
+    war_log_shutdown();
     // free ring buffer memory
     if (env->pc_capture) {
         free(env->pc_capture->to_wr);
@@ -4069,23 +4082,19 @@ int main(int argc, char** argv) {
         free(env->pc_play);
     }
     _war_midi_disconnect(env);
+    war_hot_watch_free(ctx_hot);
     free(env->atomics);
-    // free capture slots and accumulator
+    // free capture slots and the capture spill
+    war_devices_shutdown(env);
     war_stem_shutdown(env);
-    for (uint32_t i = 0; i < WAR_PREVIEW_VOICES; i++) {
-        free(env->preview_voice_delay_line[i]);
-        env->preview_voice_delay_line[i] = NULL;
-    }
-    for (uint32_t i = 0; i < WAR_PLAY_BAR_VOICES; i++) {
-        free(env->play_bar_voice_delay_line[i]);
-        env->play_bar_voice_delay_line[i] = NULL;
-    }
-    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++) {
-        free(env->capture_slots[i].samples);
-        env->capture_slots[i].samples = NULL;
-    }
-    free(env->capture_accumulator);
-    env->capture_accumulator = NULL;
+    war_autotune_shutdown(env);
+    war_save_shutdown(env);
+    war_freeze_shutdown(env);
+    war_load_shutdown(env);
+    war_spill_shutdown(env);
+    war_trace_free();
+    for (uint32_t i = 0; i < 128 * WAR_CAPTURE_SLOT_LAYERS; i++)
+        war_slot_clear(&env->capture_slots[i]);
     for (uint32_t i = 0; i < WAR_MACRO_REGISTERS; i++) {
         free(env->macro_regs[i]);
         env->macro_regs[i] = NULL;
@@ -4133,11 +4142,4 @@ int main(int argc, char** argv) {
     FT_Done_Face(env->ft_face);
     FT_Done_FreeType(env->ft_lib);
     wl_display_disconnect(ctx_wayland->display);
-    // unload virtual loopback sinks created at startup
-    for (int _li = 0; _li < 3; _li++)
-        if (env->loopback_modules[_li]) {
-            char _uc[64];
-            snprintf(_uc, sizeof(_uc), "pactl unload-module %u 2>/dev/null", env->loopback_modules[_li]);
-            system(_uc);
-        }
 }